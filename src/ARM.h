@@ -151,7 +151,7 @@ public:
 
 #ifdef JIT_ENABLED
     u32 FastBlockLookupStart, FastBlockLookupSize;
-    u64* FastBlockLookup;
+    u64** FastBlockLookup;
 #endif
 
     static u32 ConditionTable[16];
@@ -191,6 +191,9 @@ public:
 
     // all code accesses are forced nonseq 32bit
     u32 CodeRead32(u32 addr, bool branch);
+    // the cycles CodeRead32 would take in a region with the given
+    // code timing, without touching the CPU state
+    s32 CodeFetchCycles(u32 addr, bool branch, s32 regionCodeCycles) const;
 
     void DataRead8(u32 addr, u32* val);
     void DataRead16(u32 addr, u32* val);
@@ -467,12 +470,4 @@ void T_UNK(ARM* cpu);
 
 }
 
-namespace NDS
-{
-
-extern ARMv5* ARM9;
-extern ARMv4* ARM7;
-
-}
-
 #endif // ARM_H
@@ -20,12 +20,15 @@
 
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
 #include <unordered_map>
 
 #define XXH_STATIC_LINKING_ONLY
 #include "xxhash/xxhash.h"
 
 #include "Config.h"
+#include "Platform.h"
 
 #include "ARMJIT_Internal.h"
 #include "ARMJIT_Memory.h"
@@ -82,19 +85,25 @@ AddressRange CodeIndexNWRAM_A[DSi::NWRAMSize / 512];
 AddressRange CodeIndexNWRAM_B[DSi::NWRAMSize / 512];
 AddressRange CodeIndexNWRAM_C[DSi::NWRAMSize / 512];
 
-u64 FastBlockLookupITCM[ITCMPhysicalSize / 2];
-u64 FastBlockLookupMainRAM[NDS::MainRAMMaxSize / 2];
-u64 FastBlockLookupSWRAM[NDS::SharedWRAMSize / 2];
-u64 FastBlockLookupVRAM[0x100000 / 2];
-u64 FastBlockLookupARM9BIOS[sizeof(NDS::ARM9BIOS) / 2];
-u64 FastBlockLookupARM7BIOS[sizeof(NDS::ARM7BIOS) / 2];
-u64 FastBlockLookupARM7WRAM[NDS::ARM7WRAMSize / 2];
-u64 FastBlockLookupARM7WVRAM[0x40000 / 2];
-u64 FastBlockLookupBIOS9DSi[0x10000 / 2];
-u64 FastBlockLookupBIOS7DSi[0x10000 / 2];
-u64 FastBlockLookupNWRAM_A[DSi::NWRAMSize / 2];
-u64 FastBlockLookupNWRAM_B[DSi::NWRAMSize / 2];
-u64 FastBlockLookupNWRAM_C[DSi::NWRAMSize / 2];
+// the block lookup tables are split into pages, which
+// are only allocated once a block starts inside of them
+const u32 FastBlockLookupPageShift = 12;
+const u32 FastBlockLookupPageSize = 1 << FastBlockLookupPageShift;
+const u64 FastBlockLookupEmpty = (u64)UINT32_MAX << 32;
+
+u64* FastBlockLookupITCM[ITCMPhysicalSize / FastBlockLookupPageSize];
+u64* FastBlockLookupMainRAM[NDS::MainRAMMaxSize / FastBlockLookupPageSize];
+u64* FastBlockLookupSWRAM[NDS::SharedWRAMSize / FastBlockLookupPageSize];
+u64* FastBlockLookupVRAM[0x100000 / FastBlockLookupPageSize];
+u64* FastBlockLookupARM9BIOS[sizeof(NDS::ARM9BIOS) / FastBlockLookupPageSize];
+u64* FastBlockLookupARM7BIOS[sizeof(NDS::ARM7BIOS) / FastBlockLookupPageSize];
+u64* FastBlockLookupARM7WRAM[NDS::ARM7WRAMSize / FastBlockLookupPageSize];
+u64* FastBlockLookupARM7WVRAM[0x40000 / FastBlockLookupPageSize];
+u64* FastBlockLookupBIOS9DSi[0x10000 / FastBlockLookupPageSize];
+u64* FastBlockLookupBIOS7DSi[0x10000 / FastBlockLookupPageSize];
+u64* FastBlockLookupNWRAM_A[DSi::NWRAMSize / FastBlockLookupPageSize];
+u64* FastBlockLookupNWRAM_B[DSi::NWRAMSize / FastBlockLookupPageSize];
+u64* FastBlockLookupNWRAM_C[DSi::NWRAMSize / FastBlockLookupPageSize];
 
 const u32 CodeRegionSizes[ARMJIT_Memory::memregions_Count] =
 {
@@ -140,7 +149,7 @@ AddressRange* const CodeMemRegions[ARMJIT_Memory::memregions_Count] =
     CodeIndexNWRAM_C
 };
 
-u64* const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
+u64** const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
 {
     NULL,
     FastBlockLookupITCM,
@@ -162,6 +171,91 @@ u64* const FastBlockLookupRegions[ARMJIT_Memory::memregions_Count] =
     FastBlockLookupNWRAM_C
 };
 
+// a small direct mapped cache in front of the lookup tables for the
+// most recently dispatched blocks. An entry is dropped whenever the
+// lookup entry it was taken from changes
+struct DispatchCacheEntry
+{
+    u32 Addr;
+    u32 Offset;
+    u64** Entries;
+    JitBlockEntry Entry;
+    u32 Hits;
+};
+
+const u32 DispatchCacheSize = 1024;
+DispatchCacheEntry DispatchCache[2][DispatchCacheSize];
+
+// blocks which are dispatched this often from the cache are compiled
+// again as a trace, which may be longer and also follows loops
+const u32 HotBlockThreshold = 1024;
+const int MaxTraceSize = 128;
+bool TraceRequested[2];
+
+void ClearDispatchCache()
+{
+    for (int i = 0; i < 2; i++)
+    {
+        for (u32 j = 0; j < DispatchCacheSize; j++)
+            DispatchCache[i][j].Addr = UINT32_MAX;
+    }
+}
+
+void InvalidateDispatchCache(u64 entry)
+{
+    u32 key = entry >> 32;
+    if (key == UINT32_MAX)
+        return;
+
+    // the key is the address of the block ORed with the CPU number
+    DispatchCacheEntry& cached = DispatchCache[key & 1][(key >> 1) & (DispatchCacheSize - 1)];
+    if (cached.Addr == (key & ~1))
+        cached.Addr = UINT32_MAX;
+}
+
+void SetFastBlockLookupEntry(u32 localAddr, u64 value)
+{
+    u64*& page = FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) >> FastBlockLookupPageShift];
+    if (!page)
+    {
+        page = new u64[FastBlockLookupPageSize / 2];
+        for (u32 i = 0; i < FastBlockLookupPageSize / 2; i++)
+            page[i] = FastBlockLookupEmpty;
+    }
+
+    u64& entry = page[(localAddr & (FastBlockLookupPageSize - 1)) / 2];
+    InvalidateDispatchCache(entry);
+    entry = value;
+}
+
+void ClearFastBlockLookupEntry(u32 localAddr)
+{
+    u64* page = FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) >> FastBlockLookupPageShift];
+    if (page)
+    {
+        u64& entry = page[(localAddr & (FastBlockLookupPageSize - 1)) / 2];
+        InvalidateDispatchCache(entry);
+        entry = FastBlockLookupEmpty;
+    }
+}
+
+void FreeFastBlockLookupPages()
+{
+    for (int i = 0; i < ARMJIT_Memory::memregions_Count; i++)
+    {
+        if (!FastBlockLookupRegions[i])
+            continue;
+
+        for (u32 j = 0; j < CodeRegionSizes[i] / FastBlockLookupPageSize; j++)
+        {
+            delete[] FastBlockLookupRegions[i][j];
+            FastBlockLookupRegions[i][j] = NULL;
+        }
+    }
+
+    ClearDispatchCache();
+}
+
 u32 LocaliseCodeAddress(u32 num, u32 addr)
 {
     int region = num == 0
@@ -258,6 +352,22 @@ void SlowWrite7(u32 addr, u32 val)
         (ConsoleType == 0 ? NDS::ARM7Write8 : DSi::ARM7Write8)(addr, val);
 }
 
+template <typename T, int ConsoleType>
+u32 SlowSwap9(u32 addr, ARMv5* cpu, u32 val)
+{
+    u32 oldval = SlowRead9<T, ConsoleType>(addr, cpu);
+    SlowWrite9<T, ConsoleType>(addr, cpu, val);
+    return oldval;
+}
+
+template <typename T, int ConsoleType>
+u32 SlowSwap7(u32 addr, u32 val)
+{
+    u32 oldval = SlowRead7<T, ConsoleType>(addr);
+    SlowWrite7<T, ConsoleType>(addr, val);
+    return oldval;
+}
+
 template <bool Write, int ConsoleType>
 void SlowBlockTransfer9(u32 addr, u64* data, u32 num, ARMv5* cpu)
 {
@@ -303,6 +413,11 @@ void SlowBlockTransfer7(u32 addr, u64* data, u32 num)
     template u16 SlowRead7<u16, consoleType>(u32); \
     template u8 SlowRead7<u8, consoleType>(u32); \
     \
+    template u32 SlowSwap9<u32, consoleType>(u32, ARMv5*, u32); \
+    template u32 SlowSwap9<u8, consoleType>(u32, ARMv5*, u32); \
+    template u32 SlowSwap7<u32, consoleType>(u32, u32); \
+    template u32 SlowSwap7<u8, consoleType>(u32, u32); \
+    \
     template void SlowBlockTransfer9<false, consoleType>(u32, u64*, u32, ARMv5*); \
     template void SlowBlockTransfer9<true, consoleType>(u32, u64*, u32, ARMv5*); \
     template void SlowBlockTransfer7<false, consoleType>(u32 addr, u64* data, u32 num); \
@@ -311,15 +426,185 @@ void SlowBlockTransfer7(u32 addr, u64* data, u32 num)
 INSTANTIATE_SLOWMEM(0)
 INSTANTIATE_SLOWMEM(1)
 
+// with background compilation enabled the front end still runs on the
+// emulation thread (it interprets the block while decoding it), but the
+// code is emitted on a worker thread. Until a block is published the
+// emulation thread keeps interpreting it through the front end.
+//
+// Everything which touches the emitted code or the compiler besides
+// the worker (invalidation, fastmem patching, resets) first waits for
+// it to become idle with FinishCompileJobs. The same goes for changes to
+// what the backends read while compiling: the TCM and WRAM mappings,
+// the DSi BIOS protection and the memory timings.
+struct CompileJob
+{
+    JitBlock* Block;
+    ARM* CPU;
+    bool Thumb;
+    bool HasMemoryInstr;
+    int NumInstrs;
+    FetchedInstr Instrs[MaxTraceSize];
+
+    JitBlockEntry EntryPoint;
+    s32 FreeCodeSpace;
+};
+
+// rather pessimistic upper bound for the code a single block emits
+const s32 MaxBlockCodeSize = 1024 * 32;
+
+const u32 MaxCompileJobs = 64;
+CompileJob CompileJobs[MaxCompileJobs];
+std::atomic<u32> CompileJobsSubmitted;
+std::atomic<u32> CompileJobsDone;
+u32 CompileJobsPublished;
+s32 PublishedFreeCodeSpace;
+
+Platform::Thread* CompileThread = NULL;
+Platform::Semaphore* Sema_CompileWork;
+Platform::Semaphore* Sema_CompileIdle;
+volatile bool CompileThreadRunning;
+std::atomic<bool> CompileSyncRequested;
+
+void RunCompileJobs()
+{
+    u32 done = CompileJobsDone.load(std::memory_order_relaxed);
+    while (done != CompileJobsSubmitted.load(std::memory_order_acquire))
+    {
+        CompileJob& job = CompileJobs[done % MaxCompileJobs];
+
+        #if defined(__APPLE__) && defined(__aarch64__)
+            pthread_jit_write_protect_np(false);
+        #endif
+        job.EntryPoint = JITCompiler->CompileBlock(job.CPU, job.Thumb, job.Instrs, job.NumInstrs, job.HasMemoryInstr);
+        #if defined(__APPLE__) && defined(__aarch64__)
+            pthread_jit_write_protect_np(true);
+        #endif
+        job.FreeCodeSpace = JITCompiler->FreeCodeSpace();
+
+        CompileJobsDone.store(++done, std::memory_order_release);
+    }
+}
+
+void CompileThreadFunc()
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_CompileWork);
+        if (!CompileThreadRunning) return;
+
+        RunCompileJobs();
+
+        if (CompileSyncRequested.load(std::memory_order_acquire))
+        {
+            // the emulation thread is waiting for us, so
+            // what's submitted at this point is everything
+            RunCompileJobs();
+            CompileSyncRequested.store(false, std::memory_order_relaxed);
+            Platform::Semaphore_Post(Sema_CompileIdle);
+        }
+    }
+}
+
+void StartCompileThread()
+{
+    CompileJobsSubmitted = 0;
+    CompileJobsDone = 0;
+    CompileJobsPublished = 0;
+    CompileSyncRequested = false;
+
+    Sema_CompileWork = Platform::Semaphore_Create();
+    Sema_CompileIdle = Platform::Semaphore_Create();
+
+    CompileThreadRunning = true;
+    CompileThread = Platform::Thread_Create(CompileThreadFunc);
+}
+
+void StopCompileThread()
+{
+    FinishCompileJobs();
+
+    CompileThreadRunning = false;
+    Platform::Semaphore_Post(Sema_CompileWork);
+    Platform::Thread_Wait(CompileThread);
+    Platform::Thread_Free(CompileThread);
+    CompileThread = NULL;
+
+    Platform::Semaphore_Free(Sema_CompileWork);
+    Platform::Semaphore_Free(Sema_CompileIdle);
+}
+
+// makes the blocks the worker is done with visible to the dispatcher
+void PublishCompiledBlocks()
+{
+    u32 done = CompileJobsDone.load(std::memory_order_acquire);
+    if (CompileJobsPublished == done)
+        return;
+
+    while (CompileJobsPublished != done)
+    {
+        CompileJob& job = CompileJobs[CompileJobsPublished++ % MaxCompileJobs];
+        JitBlock* block = job.Block;
+
+        block->EntryPoint = job.EntryPoint;
+        PublishedFreeCodeSpace = job.FreeCodeSpace;
+
+        SetFastBlockLookupEntry(block->StartAddrLocal, (((u64)block->StartAddr | block->Num) << 32)
+            | JITCompiler->SubEntryOffset(block->EntryPoint));
+    }
+
+    #ifdef __aarch64__
+        // the code was written by another core
+        __asm__ volatile ("isb" ::: "memory");
+    #endif
+}
+
+void FinishCompileJobs()
+{
+    if (!CompileThread)
+        return;
+
+    if (CompileJobsDone.load(std::memory_order_acquire) != CompileJobsSubmitted.load(std::memory_order_relaxed))
+    {
+        CompileSyncRequested.store(true, std::memory_order_release);
+        Platform::Semaphore_Post(Sema_CompileWork);
+        Platform::Semaphore_Wait(Sema_CompileIdle);
+    }
+
+    PublishCompiledBlocks();
+}
+
+void SubmitCompileJob(JitBlock* block, ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
+{
+    u32 num = CompileJobsSubmitted.load(std::memory_order_relaxed);
+    if (num - CompileJobsDone.load(std::memory_order_acquire) == MaxCompileJobs)
+        FinishCompileJobs();
+
+    CompileJob& job = CompileJobs[num % MaxCompileJobs];
+    job.Block = block;
+    job.CPU = cpu;
+    job.Thumb = thumb;
+    job.HasMemoryInstr = hasMemoryInstr;
+    job.NumInstrs = instrsCount;
+    memcpy(job.Instrs, instrs, instrsCount * sizeof(FetchedInstr));
+
+    CompileJobsSubmitted.store(num + 1, std::memory_order_release);
+    Platform::Semaphore_Post(Sema_CompileWork);
+}
+
 void Init()
 {
     JITCompiler = new Compiler();
 
     ARMJIT_Memory::Init();
+
+    ClearDispatchCache();
 }
 
 void DeInit()
 {
+    if (CompileThread)
+        StopCompileThread();
+
     #if defined(__APPLE__) && defined(__aarch64__)
         pthread_jit_write_protect_np(false);
     #endif
@@ -337,6 +622,11 @@ void Reset()
     ResetBlockCache();
 
     ARMJIT_Memory::Reset();
+
+    if (Config::JIT_BackgroundCompile && !CompileThread)
+        StartCompileThread();
+    else if (!Config::JIT_BackgroundCompile && CompileThread)
+        StopCompileThread();
 }
 
 void FloodFillSetFlags(FetchedInstr instrs[], int start, u8 flags)
@@ -384,6 +674,41 @@ bool DecodeLiteral(bool thumb, const FetchedInstr& instr, u32& addr)
     return false;
 }
 
+// the address the backends inline a literal load from (see Comp_MemAccess)
+bool DecodeInlinedLiteral(bool thumb, const FetchedInstr& instr, u32& addr)
+{
+    if (thumb)
+    {
+        if (instr.Info.Kind != ARMInstrInfo::tk_LDR_PCREL)
+            return false;
+
+        addr = ((instr.Addr + 4) & ~0x2) + ((instr.Instr & 0xFF) << 2);
+        return true;
+    }
+
+    u32 offset;
+    switch (instr.Info.Kind)
+    {
+    case ARMInstrInfo::ak_LDR_IMM:
+    case ARMInstrInfo::ak_LDRB_IMM:
+        offset = instr.Instr & 0xFFF;
+        break;
+    case ARMInstrInfo::ak_LDRH_IMM:
+    case ARMInstrInfo::ak_LDRSB_IMM:
+    case ARMInstrInfo::ak_LDRSH_IMM:
+        offset = (instr.Instr & 0xF) | ((instr.Instr >> 4) & 0xF0);
+        break;
+    default:
+        return false;
+    }
+
+    if (instr.A_Reg(16) != 15 || instr.A_Reg(12) == 15 || instr.Instr & (1 << 21))
+        return false;
+
+    addr = (instr.Addr + 8) + offset * (instr.Instr & (1 << 23) ? 1 : -1);
+    return true;
+}
+
 bool DecodeBranch(bool thumb, const FetchedInstr& instr, u32& cond, bool hasLink, u32 lr, bool& link, 
     u32& linkAddr, u32& targetAddr)
 {
@@ -476,6 +801,83 @@ bool IsIdleLoop(bool thumb, FetchedInstr* instrs, int instrsCount)
     return true;
 }
 
+// code behind a block exit is only looked at for this many instructions,
+// which can touch at most this many new address ranges per exit
+const int ExitScanLength = 8;
+const int ExitScanMaxRanges = 2;
+
+u32 ReadCodeForScan(ARM* cpu, bool thumb, u32 addr)
+{
+    // the regular code fetch functions would use the memory
+    // of the region which is currently executed
+    u32 aligned = addr & ~3;
+    u32 val;
+    if (cpu->Num == 0)
+    {
+        ARMv5* cpuv5 = (ARMv5*)cpu;
+        if (aligned < cpuv5->ITCMSize)
+            val = *(u32*)&cpuv5->ITCM[aligned & (ITCMPhysicalSize - 1)];
+        else
+            val = (NDS::ConsoleType == 0 ? NDS::ARM9Read32 : DSi::ARM9Read32)(aligned);
+    }
+    else
+    {
+        val = (NDS::ConsoleType == 0 ? NDS::ARM7Read32 : DSi::ARM7Read32)(aligned);
+    }
+
+    return thumb ? (val >> ((addr & 0x2) * 8)) & 0xFFFF : val;
+}
+
+// which flags the straight line code at addr might read before it overwrites them
+// everything we can't follow counts as reading all flags which are still left.
+// The instructions looked at are added to the block's address ranges and hash,
+// so the block gets invalidated or isn't restored if they are modified.
+u8 FlagsReadAfterExit(ARM* cpu, bool thumb, u32 addr,
+    u32 addressRanges[], u32 addressMasks[], u32& numAddressRanges, u32 maxAddressRanges,
+    u32 instrValues[], u32& numInstrs)
+{
+    u8 flags = 0xF;
+    u8 readFlags = 0;
+    for (int j = 0; j < ExitScanLength && flags; j++, addr += thumb ? 2 : 4)
+    {
+        // the ARM7 BIOS can only be read from inside of it
+        if (cpu->Num == 1 && addr < 0x02000000)
+            break;
+
+        u32 translatedAddr = LocaliseCodeAddress(cpu->Num, addr);
+        if (!translatedAddr)
+            break;
+
+        u32 translatedAddrRounded = translatedAddr & ~0x1FF;
+        u32 k = 0;
+        for (; k < numAddressRanges; k++)
+            if (addressRanges[k] == translatedAddrRounded)
+                break;
+        if (k == numAddressRanges)
+        {
+            if (numAddressRanges == maxAddressRanges)
+                break;
+            addressRanges[numAddressRanges++] = translatedAddrRounded;
+        }
+        addressMasks[k] |= 1 << ((translatedAddr & 0x1FF) / 16);
+
+        u32 instr = ReadCodeForScan(cpu, thumb, addr);
+        instrValues[numInstrs++] = instr;
+
+        ARMInstrInfo::Info info = ARMInstrInfo::Decode(thumb, cpu->Num, instr);
+        readFlags |= info.ReadFlags & flags;
+
+        // interpreted instructions can look at the whole CPSR
+        if (info.Branches() || !JITCompiler->CanCompile(thumb, info.Kind))
+            break;
+
+        // conditional writes are in the upper nibble and don't count
+        flags &= ~info.WriteFlags;
+    }
+
+    return readFlags | flags;
+}
+
 typedef void (*InterpreterFunc)(ARM* cpu);
 
 void NOP(ARM* cpu) {}
@@ -577,6 +979,103 @@ void RetireJitBlock(JitBlock* block)
     }
 }
 
+void RemoveFromCodeIndex(JitBlock* block)
+{
+    for (int j = 0; j < block->NumAddresses; j++)
+    {
+        u32 addr = block->AddressRanges()[j];
+        AddressRange* region = CodeMemRegions[addr >> 27];
+        AddressRange* range = &region[(addr & 0x7FFFFFF) / 512];
+
+        [[maybe_unused]] bool removed = range->Blocks.RemoveByValue(block);
+        assert(removed);
+
+        // the remaining blocks still need their part of the mask
+        range->Code = 0;
+        for (int k = 0; k < range->Blocks.Length; k++)
+        {
+            JitBlock* other = range->Blocks[k];
+            for (int l = 0; l < other->NumAddresses; l++)
+            {
+                if (other->AddressRanges()[l] == addr)
+                {
+                    range->Code |= other->AddressMasks()[l];
+                    break;
+                }
+            }
+        }
+
+        if (range->Blocks.Length == 0 && !PageContainsCode(&region[(addr & 0x7FFF000) / 512]))
+            ARMJIT_Memory::SetCodeProtection(addr >> 27, addr & 0x7FFFFFF, false);
+    }
+}
+
+// The code memory is split into segments which are filled one after
+// another. Once the last one is full the oldest one is reused, so only
+// the blocks which were compiled into it have to go, instead of the
+// whole block cache.
+void EvictCodeSegment(int segment)
+{
+    JIT_DEBUGPRINT("evicting code segment %d\n", segment);
+
+    for (int num = 0; num < 2; num++)
+    {
+        auto& map = num == 0 ? JitBlocks9 : JitBlocks7;
+        for (auto it = map.begin(); it != map.end();)
+        {
+            JitBlock* block = it->second;
+            if (block->CodeSegment == segment)
+            {
+                RemoveFromCodeIndex(block);
+                ClearFastBlockLookupEntry(block->StartAddrLocal);
+                delete block;
+                it = map.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    for (auto it = RestoreCandidates.begin(); it != RestoreCandidates.end();)
+    {
+        if (it->second->CodeSegment == segment)
+        {
+            delete it->second;
+            it = RestoreCandidates.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    JITCompiler->ResetCodeSegment(segment);
+}
+
+// moves on to the next code segment if the next block might not fit
+// anymore. With jobs in flight that's only known for sure once they're
+// done, so until it gets tight the space they need is estimated instead
+void EnsureCodeSpace()
+{
+    if (CompileThread)
+    {
+        PublishCompiledBlocks();
+
+        u32 pending = CompileJobsSubmitted.load(std::memory_order_relaxed) - CompileJobsPublished;
+        if (pending > 0 && PublishedFreeCodeSpace - (s32)pending * MaxBlockCodeSize >= 0)
+            return;
+
+        FinishCompileJobs();
+    }
+
+    if (JITCompiler->FreeCodeSpace() < 0)
+        EvictCodeSegment((JITCompiler->CodeSegment() + 1) % NumCodeSegments);
+
+    PublishedFreeCodeSpace = JITCompiler->FreeCodeSpace();
+}
+
 void CompileBlock(ARM* cpu)
 {
     bool thumb = cpu->CPSR & 0x20;
@@ -594,6 +1093,15 @@ void CompileBlock(ARM* cpu)
         printf("trying to compile non executable code? %x\n", blockAddr);
     }
 
+    PublishCompiledBlocks();
+
+    bool traceRequested = TraceRequested[cpu->Num];
+    TraceRequested[cpu->Num] = false;
+
+    // the block is still being compiled, so it's only interpreted this time
+    bool interpretOnly = false;
+    bool trace = false;
+
     auto& map = cpu->Num == 0 ? JitBlocks9 : JitBlocks7;
     auto existingBlockIt = map.find(blockAddr);
     if (existingBlockIt != map.end())
@@ -605,33 +1113,66 @@ void CompileBlock(ARM* cpu)
 
         if (localAddr == otherLocalAddr)
         {
-            JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, existingBlockIt->second->StartAddr);
+            JitBlock* existingBlock = existingBlockIt->second;
+            if (traceRequested && existingBlock->EntryPoint)
+            {
+                if (!existingBlock->Extendable)
+                    return;
 
-            u64* entry = &FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) / 2];
-            *entry = ((u64)blockAddr | cpu->Num) << 32;
-            *entry |= JITCompiler->SubEntryOffset(existingBlockIt->second->EntryPoint);
-            return;
-        }
+                JIT_DEBUGPRINT("compiling trace for hot block %x\n", blockAddr);
+
+                FinishCompileJobs();
+                RemoveFromCodeIndex(existingBlock);
+                ClearFastBlockLookupEntry(localAddr);
+                RetireJitBlock(existingBlock);
+                map.erase(existingBlockIt);
+
+                trace = true;
+            }
+            else if (existingBlock->EntryPoint)
+            {
+                JIT_DEBUGPRINT("switching out block %x %x %x\n", localAddr, blockAddr, existingBlockIt->second->StartAddr);
+
+                SetFastBlockLookupEntry(localAddr, (((u64)blockAddr | cpu->Num) << 32)
+                    | JITCompiler->SubEntryOffset(existingBlockIt->second->EntryPoint));
+                return;
+            }
 
-        // some memory has been remapped
-        RetireJitBlock(existingBlockIt->second);        
-        map.erase(existingBlockIt);
+            else
+            {
+                interpretOnly = true;
+            }
+        }
+        else
+        {
+            // some memory has been remapped
+            FinishCompileJobs();
+            ClearFastBlockLookupEntry(otherLocalAddr);
+            RetireJitBlock(existingBlockIt->second);
+            map.erase(existingBlockIt);
+        }
     }
 
-    FetchedInstr instrs[Config::JIT_MaxBlockSize];
+    int maxBlockSize = trace
+        ? std::min(Config::JIT_MaxBlockSize * 4, MaxTraceSize)
+        : Config::JIT_MaxBlockSize;
+
+    FetchedInstr instrs[maxBlockSize];
     int i = 0;
     u32 r15 = cpu->R[15];
 
-    u32 addressRanges[Config::JIT_MaxBlockSize];
-    u32 addressMasks[Config::JIT_MaxBlockSize];
-    memset(addressMasks, 0, Config::JIT_MaxBlockSize * sizeof(u32));
+    // the code behind the block's exits (at most two) is tracked as well
+    u32 maxAddressRanges = maxBlockSize + 2 * ExitScanMaxRanges;
+    u32 addressRanges[maxAddressRanges];
+    u32 addressMasks[maxAddressRanges];
+    memset(addressMasks, 0, maxAddressRanges * sizeof(u32));
     u32 numAddressRanges = 0;
 
     u32 numLiterals = 0;
-    u32 literalLoadAddrs[Config::JIT_MaxBlockSize];
+    u32 literalLoadAddrs[maxBlockSize];
     // they are going to be hashed
-    u32 literalValues[Config::JIT_MaxBlockSize];
-    u32 instrValues[Config::JIT_MaxBlockSize];
+    u32 literalValues[maxBlockSize];
+    u32 instrValues[maxBlockSize + 2 * ExitScanLength];
     // due to instruction merging i might not reflect the amount of actual instructions
     u32 numInstrs = 0;
 
@@ -647,6 +1188,9 @@ void CompileBlock(ARM* cpu)
 
     bool hasMemoryInstr = false;
 
+    // whether a trace starting here could get further than this block
+    bool extendable = false;
+
     do
     {
         r15 += thumb ? 2 : 4;
@@ -812,7 +1356,8 @@ void CompileBlock(ARM* cpu)
                     }
                 }
 
-                if (cond < 0xE && target < instrs[i].Addr && target >= lastSegmentStart)
+                bool isLoop = cond < 0xE && target < instrs[i].Addr && target >= lastSegmentStart;
+                if (isLoop)
                 {
                     // we might have an idle loop
                     u32 backwardsOffset = (instrs[i].Addr - target) / (thumb ? 2 : 4);
@@ -821,8 +1366,21 @@ void CompileBlock(ARM* cpu)
                         instrs[i].BranchFlags |= branch_IdleBranch;
                         JIT_DEBUGPRINT("found %s idle loop %d in block %08x\n", thumb ? "thumb" : "arm", cpu->Num, blockAddr);
                     }
+                    else if (hasBranched)
+                    {
+                        // traces inline loops for as long as the loop is taken
+                        // while interpreting them
+                        extendable = true;
+                    }
                 }
-                else if (hasBranched && !isBackJump && i + 1 < Config::JIT_MaxBlockSize)
+
+                bool follow = hasBranched && !isBackJump
+                    && (!isLoop || (trace && !(instrs[i].BranchFlags & branch_IdleBranch)));
+                if (follow && i + 1 >= maxBlockSize)
+                {
+                    extendable = true;
+                }
+                else if (follow)
                 {
                     if (link)
                     {
@@ -850,7 +1408,11 @@ void CompileBlock(ARM* cpu)
                 }
             }
 
-            if (!hasBranched && cond < 0xE && i + 1 < Config::JIT_MaxBlockSize)
+            if (!hasBranched && cond < 0xE && i + 1 >= maxBlockSize)
+            {
+                extendable = true;
+            }
+            else if (!hasBranched && cond < 0xE)
             {
                 instrs[i].Info.EndBlock = false;
                 instrs[i].BranchFlags |= branch_FollowCondNotTaken;
@@ -863,7 +1425,41 @@ void CompileBlock(ARM* cpu)
         bool secondaryFlagReadCond = !canCompile || (instrs[i - 1].BranchFlags & (branch_FollowCondTaken | branch_FollowCondNotTaken));
         if (instrs[i - 1].Info.ReadFlags != 0 || secondaryFlagReadCond)
             FloodFillSetFlags(instrs, i - 2, !secondaryFlagReadCond ? instrs[i - 1].Info.ReadFlags : 0xF);
-    } while(!instrs[i - 1].Info.EndBlock && i < Config::JIT_MaxBlockSize && !cpu->Halted && (!cpu->IRQ || (cpu->CPSR & 0x80)));
+    } while(!instrs[i - 1].Info.EndBlock && i < maxBlockSize && !cpu->Halted && (!cpu->IRQ || (cpu->CPSR & 0x80)));
+
+    if (!instrs[i - 1].Info.EndBlock && i == maxBlockSize)
+        extendable = true;
+
+    if (interpretOnly)
+        return;
+
+    // flags nothing after the block reads don't need to be computed at its end.
+    // The exit needs to be static for this, anything else might read all of them
+    u8 exitFlags = 0xF;
+    if (Config::JIT_BranchOptimisations)
+    {
+        const FetchedInstr& lastInstr = instrs[i - 1];
+        u32 nextAddr = lastInstr.Addr + (thumb ? 2 : 4);
+
+        if (!lastInstr.Info.Branches())
+        {
+            exitFlags = FlagsReadAfterExit(cpu, thumb, nextAddr,
+                addressRanges, addressMasks, numAddressRanges, maxAddressRanges, instrValues, numInstrs);
+        }
+        else
+        {
+            bool link;
+            u32 cond, target, linkAddr;
+            if (DecodeBranch(thumb, lastInstr, cond, false, 0, link, linkAddr, target))
+            {
+                exitFlags = FlagsReadAfterExit(cpu, thumb, target,
+                    addressRanges, addressMasks, numAddressRanges, maxAddressRanges, instrValues, numInstrs);
+                if (cond < 0xE)
+                    exitFlags |= FlagsReadAfterExit(cpu, thumb, nextAddr,
+                        addressRanges, addressMasks, numAddressRanges, maxAddressRanges, instrValues, numInstrs);
+            }
+        }
+    }
 
     u32 literalHash = (u32)XXH3_64bits(literalValues, numLiterals * 4);
     u32 instrHash = (u32)XXH3_64bits(instrValues, numInstrs * 4);
@@ -916,17 +1512,46 @@ void CompileBlock(ARM* cpu)
 
         block->StartAddr = blockAddr;
         block->StartAddrLocal = localAddr;
+        block->Extendable = extendable && !trace && Config::JIT_BranchOptimisations;
 
-        FloodFillSetFlags(instrs, i - 1, 0xF);
-        #if defined(__APPLE__) && defined(__aarch64__)
-            pthread_jit_write_protect_np(false);
-        #endif
-        block->EntryPoint = JITCompiler->CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr);
-        #if defined(__APPLE__) && defined(__aarch64__)
-            pthread_jit_write_protect_np(true);
-        #endif
+        FloodFillSetFlags(instrs, i - 1, exitFlags);
 
-        JIT_DEBUGPRINT("block start %p\n", block->EntryPoint);
+        if (Config::JIT_LiteralOptimisations)
+        {
+            // the backends inline literal loads with the values they have now
+            u32 r15 = cpu->R[15];
+            for (int j = 0; j < i; j++)
+            {
+                u32 literalAddr;
+                if (DecodeInlinedLiteral(thumb, instrs[j], literalAddr))
+                {
+                    // make sure arm7 bios is accessible
+                    cpu->R[15] = instrs[j].Addr + (thumb ? 4 : 8);
+                    cpu->DataRead32(literalAddr & ~0x3, &instrs[j].LiteralWord);
+                }
+            }
+            cpu->R[15] = r15;
+        }
+
+        EnsureCodeSpace();
+        block->CodeSegment = JITCompiler->CodeSegment();
+
+        if (CompileThread)
+        {
+            SubmitCompileJob(block, cpu, thumb, instrs, i, hasMemoryInstr);
+        }
+        else
+        {
+            #if defined(__APPLE__) && defined(__aarch64__)
+                pthread_jit_write_protect_np(false);
+            #endif
+            block->EntryPoint = JITCompiler->CompileBlock(cpu, thumb, instrs, i, hasMemoryInstr);
+            #if defined(__APPLE__) && defined(__aarch64__)
+                pthread_jit_write_protect_np(true);
+            #endif
+
+            JIT_DEBUGPRINT("block start %p\n", block->EntryPoint);
+        }
     }
     else
     {
@@ -956,15 +1581,20 @@ void CompileBlock(ARM* cpu)
     else
         JitBlocks7[blockAddr] = block;
 
-    u64* entry = &FastBlockLookupRegions[(localAddr >> 27)][(localAddr & 0x7FFFFFF) / 2];
-    *entry = ((u64)blockAddr | cpu->Num) << 32;
-    *entry |= JITCompiler->SubEntryOffset(block->EntryPoint);
+    // otherwise that's done once the worker is finished with it
+    if (block->EntryPoint)
+    {
+        SetFastBlockLookupEntry(localAddr, (((u64)blockAddr | cpu->Num) << 32)
+            | JITCompiler->SubEntryOffset(block->EntryPoint));
+    }
 }
 
 void InvalidateByAddr(u32 localAddr)
 {
     JIT_DEBUGPRINT("invalidating by addr %x\n", localAddr);
 
+    FinishCompileJobs();
+
     AddressRange* region = CodeMemRegions[localAddr >> 27];
     AddressRange* range = &region[(localAddr & 0x7FFFFFF) / 512];
     u32 mask = 1 << ((localAddr & 0x1FF) / 16);
@@ -1025,7 +1655,7 @@ void InvalidateByAddr(u32 localAddr)
                 AddressRange* otherRange = &otherRegion[(addr & 0x7FFFFFF) / 512];
                 assert(otherRange != range);
 
-                bool removed = otherRange->Blocks.RemoveByValue(block);
+                [[maybe_unused]] bool removed = otherRange->Blocks.RemoveByValue(block);
                 assert(removed);
 
                 if (otherRange->Blocks.Length == 0)
@@ -1038,7 +1668,7 @@ void InvalidateByAddr(u32 localAddr)
             }
         }
 
-        FastBlockLookupRegions[block->StartAddrLocal >> 27][(block->StartAddrLocal & 0x7FFFFFF) / 2] = (u64)UINT32_MAX << 32;
+        ClearFastBlockLookupEntry(block->StartAddrLocal);
         if (block->Num == 0)
             JitBlocks9.erase(block->StartAddr);
         else
@@ -1074,21 +1704,66 @@ void CheckAndInvalidate(u32 addr)
         InvalidateByAddr(localAddr);
 }
 
-JitBlockEntry LookUpBlock(u32 num, u64* entries, u32 offset, u32 addr)
+template <u32 num, int region>
+void CheckAndInvalidateRange(u32 addr, u32 size)
+{
+    u32 localAddr = ARMJIT_Memory::LocaliseAddress(region, num, addr);
+    u32 end = localAddr + size;
+    localAddr &= ~0xF;
+    while (localAddr < end)
+    {
+        u32 code = CodeMemRegions[region][(localAddr & 0x7FFFFFF) / 512].Code;
+        if (!code)
+        {
+            // nothing in this 512 byte chunk
+            localAddr = (localAddr & ~0x1FF) + 512;
+            continue;
+        }
+
+        if (code & (1 << ((localAddr & 0x1FF) / 16)))
+            InvalidateByAddr(localAddr);
+        localAddr += 16;
+    }
+}
+
+JitBlockEntry LookUpBlock(u32 num, u64** entries, u32 offset, u32 addr)
 {
-    u64* entry = &entries[offset / 2];
-    if (*entry >> 32 == (addr | num))
-        return JITCompiler->AddEntryOffset((u32)*entry);
+    DispatchCacheEntry& cached = DispatchCache[num][(addr >> 1) & (DispatchCacheSize - 1)];
+    if (cached.Addr == addr && cached.Offset == offset && cached.Entries == entries)
+    {
+        if (++cached.Hits != HotBlockThreshold)
+            return cached.Entry;
+
+        // let CompileBlock decide whether it's worth turning into a trace
+        TraceRequested[num] = true;
+        return NULL;
+    }
+
+    u64* page = entries[offset >> FastBlockLookupPageShift];
+    if (page)
+    {
+        u64 entry = page[(offset & (FastBlockLookupPageSize - 1)) / 2];
+        if (entry >> 32 == (addr | num))
+        {
+            cached.Addr = addr;
+            cached.Offset = offset;
+            cached.Entries = entries;
+            cached.Entry = JITCompiler->AddEntryOffset((u32)entry);
+            cached.Hits = 0;
+            return cached.Entry;
+        }
+    }
     return NULL;
 }
 
 void blockSanityCheck(u32 num, u32 blockAddr, JitBlockEntry entry)
 {
     u32 localAddr = LocaliseCodeAddress(num, blockAddr);
-    assert(JITCompiler->AddEntryOffset((u32)FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) / 2]) == entry);
+    [[maybe_unused]] u64* page = FastBlockLookupRegions[localAddr >> 27][(localAddr & 0x7FFFFFF) >> FastBlockLookupPageShift];
+    assert(page && JITCompiler->AddEntryOffset((u32)page[(localAddr & (FastBlockLookupPageSize - 1)) / 2]) == entry);
 }
 
-bool SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32& size)
+bool SetupExecutableRegion(u32 num, u32 blockAddr, u64**& entry, u32& start, u32& size)
 {
     // amazingly ignoring the DTCM is the proper behaviour for code fetches
     int region = num == 0
@@ -1100,7 +1775,8 @@ bool SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32&
         && ARMJIT_Memory::GetMirrorLocation(region, num, blockAddr, memoryOffset, start, size))
     {
         //printf("setup exec region %d %d %08x %08x %x %x\n", num, region, blockAddr, start, size, memoryOffset);
-        entry = FastBlockLookupRegions[region] + memoryOffset / 2;
+        assert((memoryOffset & (FastBlockLookupPageSize - 1)) == 0);
+        entry = FastBlockLookupRegions[region] + (memoryOffset >> FastBlockLookupPageShift);
         return true;
     }
     return false;
@@ -1114,6 +1790,11 @@ template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_WRAM7>(u32);
 template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_VWRAM>(u32);
 template void CheckAndInvalidate<0, ARMJIT_Memory::memregion_VRAM>(u32);
 template void CheckAndInvalidate<0, ARMJIT_Memory::memregion_ITCM>(u32);
+template void CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_MainRAM>(u32, u32);
+template void CheckAndInvalidateRange<1, ARMJIT_Memory::memregion_MainRAM>(u32, u32);
+template void CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_SharedWRAM>(u32, u32);
+template void CheckAndInvalidateRange<1, ARMJIT_Memory::memregion_WRAM7>(u32, u32);
+template void CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_VRAM>(u32, u32);
 template void CheckAndInvalidate<0, ARMJIT_Memory::memregion_NewSharedWRAM_A>(u32);
 template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_NewSharedWRAM_A>(u32);
 template void CheckAndInvalidate<0, ARMJIT_Memory::memregion_NewSharedWRAM_B>(u32);
@@ -1121,51 +1802,85 @@ template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_NewSharedWRAM_B>(u3
 template void CheckAndInvalidate<0, ARMJIT_Memory::memregion_NewSharedWRAM_C>(u32);
 template void CheckAndInvalidate<1, ARMJIT_Memory::memregion_NewSharedWRAM_C>(u32);
 
+// the settings the compiled code was generated with
+int CompiledMaxBlockSize;
+int CompiledBranchOptimisations;
+int CompiledLiteralOptimisations;
+int CompiledFastMemory;
+
+template <bool keepCode>
+void ClearBlocks(std::unordered_map<u32, JitBlock*>& blocks)
+{
+    for (auto it : blocks)
+    {
+        JitBlock* block = it.second;
+        for (int j = 0; j < block->NumAddresses; j++)
+        {
+            u32 addr = block->AddressRanges()[j];
+            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
+            range->Blocks.Clear();
+            range->Code = 0;
+        }
+
+        if (keepCode)
+            RetireJitBlock(block);
+        else
+            delete block;
+    }
+    blocks.clear();
+}
+
 void ResetBlockCache()
 {
     printf("Resetting JIT block cache...\n");
 
+    FinishCompileJobs();
+
     // could be replace through a function which only resets
     // the permissions but we're too lazy
     ARMJIT_Memory::Reset();
 
     InvalidLiterals.Clear();
-    for (int i = 0; i < ARMJIT_Memory::memregions_Count; i++)
-    {
-        if (FastBlockLookupRegions[i])
-            memset(FastBlockLookupRegions[i], 0xFF, CodeRegionSizes[i] * sizeof(u64) / 2);
-    }
     for (auto it = RestoreCandidates.begin(); it != RestoreCandidates.end(); it++)
         delete it->second;
     RestoreCandidates.clear();
-    for (auto it : JitBlocks9)
-    {
-        JitBlock* block = it.second;
-        for (int j = 0; j < block->NumAddresses; j++)
-        {
-            u32 addr = block->AddressRanges()[j];
-            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
-            range->Blocks.Clear();
-            range->Code = 0;
-        }
-        delete block;
-    }
-    for (auto it : JitBlocks7)
+    ClearBlocks<false>(JitBlocks9);
+    ClearBlocks<false>(JitBlocks7);
+
+    FreeFastBlockLookupPages();
+
+    JITCompiler->Reset();
+
+    CompiledMaxBlockSize = Config::JIT_MaxBlockSize;
+    CompiledBranchOptimisations = Config::JIT_BranchOptimisations;
+    CompiledLiteralOptimisations = Config::JIT_LiteralOptimisations;
+    CompiledFastMemory = Config::JIT_FastMemory;
+
+    PublishedFreeCodeSpace = JITCompiler->FreeCodeSpace();
+}
+
+void RetireBlockCache()
+{
+    if (CompiledMaxBlockSize != Config::JIT_MaxBlockSize
+        || CompiledBranchOptimisations != Config::JIT_BranchOptimisations
+        || CompiledLiteralOptimisations != Config::JIT_LiteralOptimisations
+        || CompiledFastMemory != Config::JIT_FastMemory)
     {
-        JitBlock* block = it.second;
-        for (int j = 0; j < block->NumAddresses; j++)
-        {
-            u32 addr = block->AddressRanges()[j];
-            AddressRange* range = &CodeMemRegions[addr >> 27][(addr & 0x7FFFFFF) / 512];
-            range->Blocks.Clear();
-            range->Code = 0;
-        }
-        delete block;
+        ResetBlockCache();
+        return;
     }
-    JitBlocks9.clear();
-    JitBlocks7.clear();
 
-    JITCompiler->Reset();
+    FinishCompileJobs();
+
+    ARMJIT_Memory::Reset();
+
+    // every block becomes a candidate for restoration, so code which
+    // is still the same is picked up again without being recompiled
+    InvalidLiterals.Clear();
+    ClearBlocks<true>(JitBlocks9);
+    ClearBlocks<true>(JitBlocks7);
+
+    FreeFastBlockLookupPages();
 }
 
 }
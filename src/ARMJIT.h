@@ -40,13 +40,23 @@ void InvalidateByAddr(u32 pseudoPhysical);
 
 template <u32 num, int region>
 void CheckAndInvalidate(u32 addr);
+// same for a whole block of memory, it may not wrap around in the region
+template <u32 num, int region>
+void CheckAndInvalidateRange(u32 addr, u32 size);
 
 void CompileBlock(ARM* cpu);
 
 void ResetBlockCache();
-
-JitBlockEntry LookUpBlock(u32 num, u64* entries, u32 offset, u32 addr);
-bool SetupExecutableRegion(u32 num, u32 blockAddr, u64*& entry, u32& start, u32& size);
+// waits for the blocks which are compiled in the background. The backends
+// read the memory map and the timings while compiling, so this has to be
+// called before any of those change
+void FinishCompileJobs();
+// throws away all blocks but keeps their code, to be reused
+// if the same code is compiled again (e.g. after loading a savestate)
+void RetireBlockCache();
+
+JitBlockEntry LookUpBlock(u32 num, u64** entries, u32 offset, u32 addr);
+bool SetupExecutableRegion(u32 num, u32 blockAddr, u64**& entry, u32& start, u32& size);
 
 }
 
@@ -764,6 +764,42 @@ void Compiler::A_Comp_Mul_Short()
     }
 }
 
+void Compiler::A_Comp_QArith()
+{
+    ARM64Reg rd = MapReg(CurInstr.A_Reg(12));
+    ARM64Reg rm = MapReg(CurInstr.A_Reg(0));
+    ARM64Reg rn = MapReg(CurInstr.A_Reg(16));
+
+    bool doubling = CurInstr.Instr & (1 << 22);
+    bool sub = CurInstr.Instr & (1 << 21);
+
+    // CPSR with the Q flag set, selected on overflow
+    ORRI2R(W3, RCPSR, 0x08000000);
+
+    if (doubling)
+    {
+        ADDS(W1, rn, rn);
+        ASR(W2, W1, 31);
+        EORI2R(W2, W2, 0x80000000);
+        CSEL(W1, W2, W1, CC_VS);
+        CSEL(RCPSR, W3, RCPSR, CC_VS);
+        rn = W1;
+    }
+
+    if (sub)
+        SUBS(W0, rm, rn);
+    else
+        ADDS(W0, rm, rn);
+    ASR(W2, W0, 31);
+    EORI2R(W2, W2, 0x80000000);
+    CSEL(rd, W2, W0, CC_VS);
+    CSEL(RCPSR, W3, RCPSR, CC_VS);
+
+    CPSRDirty = true;
+
+    Comp_AddCycles_C();
+}
+
 void Compiler::A_Comp_Mul()
 {
     ARM64Reg rd = MapReg(CurInstr.A_Reg(16));
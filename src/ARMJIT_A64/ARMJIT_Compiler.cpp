@@ -176,6 +176,64 @@ void Compiler::A_Comp_MSR()
     }
 }
 
+void CP15WriteTrampoline(ARMv5* cpu, u32 id, u32 val)
+{
+    cpu->CP15Write(id, val);
+}
+
+u32 CP15ReadTrampoline(ARMv5* cpu, u32 id)
+{
+    return cpu->CP15Read(id);
+}
+
+void Compiler::A_Comp_MCR()
+{
+    // the decoder already turned every coprocessor access other than
+    // p15 on the ARM9 and p14 on the ARM7 into UNK, p14 is a nop
+    if (Num == 0)
+    {
+        u32 cn = (CurInstr.Instr >> 16) & 0xF;
+        u32 cm = CurInstr.Instr & 0xF;
+        u32 cpinfo = (CurInstr.Instr >> 5) & 0x7;
+
+        PushRegs(false, false);
+
+        MOV(W2, MapReg(CurInstr.A_Reg(12)));
+        MOVI2R(W1, (cn << 8) | (cm << 4) | cpinfo);
+        MOV(X0, RCPU);
+        QuickCallFunction(X3, CP15WriteTrampoline);
+
+        PopRegs(false, false);
+    }
+
+    Comp_AddCycles_CI(1 + 1);
+}
+
+void Compiler::A_Comp_MRC()
+{
+    if (Num == 0)
+    {
+        u32 cn = (CurInstr.Instr >> 16) & 0xF;
+        u32 cm = CurInstr.Instr & 0xF;
+        u32 cpinfo = (CurInstr.Instr >> 5) & 0x7;
+
+        PushRegs(false, false);
+
+        MOVI2R(W1, (cn << 8) | (cm << 4) | cpinfo);
+        MOV(X0, RCPU);
+        QuickCallFunction(X3, CP15ReadTrampoline);
+
+        PopRegs(false, false);
+
+        if (CurInstr.A_Reg(12) == 15)
+            SaveReg(15, W0);
+        else
+            MOV(MapReg(CurInstr.A_Reg(12)), W0);
+    }
+
+    Comp_AddCycles_CI(2 + 1);
+}
+
 
 void Compiler::PushRegs(bool saveHiRegs, bool saveRegsToBeChanged, bool allowUnload)
 {
@@ -469,6 +527,14 @@ Compiler::Compiler()
     JitMemMainSize -= JitMemSecondarySize;
 
     SetCodeBase((u8*)GetRWPtr(), (u8*)GetRXPtr());
+
+    const u32 brk_0 = 0xD4200000;
+
+    for (int i = 0; i < (JitMemMainSize + JitMemSecondarySize) / 4; i++)
+        *(((u32*)GetRWPtr()) + i) = brk_0;
+
+    OtherCodeRegion = JitMemMainSize;
+    CurCodeSegment = 0;
 }
 
 Compiler::~Compiler()
@@ -595,7 +661,7 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     // Mul
     F(Mul), F(Mul), F(Mul_Long), F(Mul_Long), F(Mul_Long), F(Mul_Long), F(Mul_Short), F(Mul_Short), F(Mul_Short), F(Mul_Short), F(Mul_Short),
     // ARMv5 exclusives
-    F(Clz), NULL, NULL, NULL, NULL, 
+    F(Clz), F(QArith), F(QArith), F(QArith), F(QArith),
     
     // STR
     F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB), F(MemWB),
@@ -608,9 +674,9 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     // STRH
     F(MemHD), F(MemHD), F(MemHD), F(MemHD),
     // LDRD
-    NULL, NULL, NULL, NULL,
+    F(MemDouble), F(MemDouble), F(MemDouble), F(MemDouble),
     // STRD
-    NULL, NULL, NULL, NULL,
+    F(MemDouble), F(MemDouble), F(MemDouble), F(MemDouble),
     // LDRH
     F(MemHD), F(MemHD), F(MemHD), F(MemHD),
     // LDRSB
@@ -618,13 +684,13 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     // LDRSH
     F(MemHD), F(MemHD), F(MemHD), F(MemHD),
     // Swap
-    NULL, NULL,
+    F(SWP), F(SWP),
     // LDM, STM
     F(LDM_STM), F(LDM_STM),
     // Branch
     F(BranchImm), F(BranchImm), F(BranchImm), F(BranchXchangeReg), F(BranchXchangeReg),
     // Special
-    NULL, F(MSR), F(MSR), F(MRS), NULL, NULL, NULL,
+    NULL, F(MSR), F(MSR), F(MRS), F(MCR), F(MRC), NULL,
     &Compiler::Nop
 };
 #undef F
@@ -690,18 +756,16 @@ void Compiler::Comp_BranchSpecialBehaviour(bool taken)
     }
 }
 
+s32 Compiler::FreeCodeSpace()
+{
+    s32 nearSpace = (JitMemMainSize / NumCodeSegments & ~3) * (CurCodeSegment + 1) - GetCodeOffset() - 1024 * 16;
+    s32 farSpace = JitMemMainSize + (JitMemSecondarySize / NumCodeSegments & ~3) * (CurCodeSegment + 1)
+        - OtherCodeRegion - 1024 * 8;
+    return nearSpace < farSpace ? nearSpace : farSpace;
+}
+
 JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemInstr)
 {
-    if (JitMemMainSize - GetCodeOffset() < 1024 * 16)
-    {
-        printf("JIT near memory full, resetting...\n");
-        ResetBlockCache();
-    }
-    if ((JitMemMainSize +  JitMemSecondarySize) - OtherCodeRegion < 1024 * 8)
-    {
-        printf("JIT far memory full, resetting...\n");
-        ResetBlockCache();
-    }
 
     JitBlockEntry res = (JitBlockEntry)GetRXPtr();
 
@@ -848,13 +912,40 @@ void Compiler::Reset()
 {
     LoadStorePatches.clear();
 
-    SetCodePtr(0);
-    OtherCodeRegion = JitMemMainSize;
+    // once the segments have wrapped around, code is left in the
+    // ones behind the current code pointer as well, so all of it is cleared
+    for (int i = NumCodeSegments - 1; i >= 0; i--)
+        ResetCodeSegment(i);
+}
+
+void Compiler::ResetCodeSegment(int segment)
+{
+    ptrdiff_t mainSegmentSize = JitMemMainSize / NumCodeSegments & ~3;
+    ptrdiff_t secondarySegmentSize = JitMemSecondarySize / NumCodeSegments & ~3;
+    ptrdiff_t mainSegmentStart = mainSegmentSize * segment;
+    ptrdiff_t secondarySegmentStart = JitMemMainSize + secondarySegmentSize * segment;
+
+    for (auto it = LoadStorePatches.begin(); it != LoadStorePatches.end();)
+    {
+        if ((it->first >= mainSegmentStart && it->first < mainSegmentStart + mainSegmentSize)
+            || (it->first >= secondarySegmentStart && it->first < secondarySegmentStart + secondarySegmentSize))
+            it = LoadStorePatches.erase(it);
+        else
+            it++;
+    }
 
     const u32 brk_0 = 0xD4200000;
 
-    for (int i = 0; i < (JitMemMainSize + JitMemSecondarySize) / 4; i++)
-        *(((u32*)GetRWPtr()) + i) = brk_0;
+    SetCodePtr(0);
+    u32* code = (u32*)GetRWPtr();
+    for (ptrdiff_t i = mainSegmentStart / 4; i < (mainSegmentStart + mainSegmentSize) / 4; i++)
+        code[i] = brk_0;
+    for (ptrdiff_t i = secondarySegmentStart / 4; i < (secondarySegmentStart + secondarySegmentSize) / 4; i++)
+        code[i] = brk_0;
+
+    SetCodePtr(mainSegmentStart);
+    OtherCodeRegion = secondarySegmentStart;
+    CurCodeSegment = segment;
 }
 
 void Compiler::Comp_AddCycles_C(bool forceNonConstant)
@@ -110,6 +110,13 @@ public:
     }
 
     JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemInstr);
+    // how much code can still be emitted into the current code
+    // segment, negative once the next one has to be reused
+    s32 FreeCodeSpace();
+    int CodeSegment()
+    { return CurCodeSegment; }
+    // clears the segment and continues emitting code into it
+    void ResetCodeSegment(int segment);
 
     bool CanCompile(bool thumb, u16 kind);
 
@@ -148,9 +155,12 @@ public:
     void A_Comp_Mul_Short();
 
     void A_Comp_Clz();
+    void A_Comp_QArith();
 
     void A_Comp_MemWB();
     void A_Comp_MemHD();
+    void A_Comp_MemDouble();
+    void A_Comp_SWP();
 
     void A_Comp_LDM_STM();
     
@@ -159,6 +169,8 @@ public:
 
     void A_Comp_MRS();
     void A_Comp_MSR();
+    void A_Comp_MCR();
+    void A_Comp_MRC();
 
     void T_Comp_ShiftImm();
     void T_Comp_AddSub_();
@@ -244,6 +256,7 @@ public:
     }
 
     ptrdiff_t OtherCodeRegion;
+    int CurCodeSegment;
 
     bool Exit;
 
@@ -73,28 +73,24 @@ bool Compiler::Comp_MemLoadLiteral(int size, bool signExtend, int rd, u32 addr)
 
     Comp_AddCycles_CDI();
 
-    u32 val;
-    // make sure arm7 bios is accessible
-    u32 tmpR15 = CurCPU->R[15];
-    CurCPU->R[15] = R15;
+    // the front end already read the word for us
+    u32 val = CurInstr.LiteralWord;
     if (size == 32)
     {
-        CurCPU->DataRead32(addr & ~0x3, &val);
         val = ::ROR(val, (addr & 0x3) << 3);
     }
     else if (size == 16)
     {
-        CurCPU->DataRead16(addr & ~0x1, &val);
+        val = (val >> ((addr & 0x2) << 3)) & 0xFFFF;
         if (signExtend)
             val = ((s32)val << 16) >> 16;
     }
     else
     {
-        CurCPU->DataRead8(addr, &val);
+        val = (val >> ((addr & 0x3) << 3)) & 0xFF;
         if (signExtend)
             val = ((s32)val << 24) >> 24;
     }
-    CurCPU->R[15] = tmpR15;
 
     MOVI2R(MapReg(rd), val);
 
@@ -401,6 +397,88 @@ void Compiler::A_Comp_MemHD()
     Comp_MemAccess(CurInstr.A_Reg(12), CurInstr.A_Reg(16), offset, size, flags);
 }
 
+void Compiler::A_Comp_MemDouble()
+{
+    if (Num == 1)
+        return; // NOP
+
+    bool load = !(CurInstr.Instr & (1 << 5));
+    bool pre = CurInstr.Instr & (1 << 24);
+    bool add = CurInstr.Instr & (1 << 23);
+    bool writeback = !pre || (CurInstr.Instr & (1 << 21));
+
+    ARM64Reg rn = MapReg(CurInstr.A_Reg(16));
+
+    if (CurInstr.Instr & (1 << 22))
+    {
+        u32 offset = (CurInstr.Instr & 0xF) | ((CurInstr.Instr >> 4) & 0xF0);
+        if (add)
+            ADDI2R(W1, rn, offset);
+        else
+            SUBI2R(W1, rn, offset);
+    }
+    else
+    {
+        ARM64Reg rm = MapReg(CurInstr.A_Reg(0));
+        if (add)
+            ADD(W1, rn, rm);
+        else
+            SUB(W1, rn, rm);
+    }
+
+    MOV(W0, pre ? W1 : rn);
+
+    // like the interpreter the base register is updated before the access
+    if (writeback && CurInstr.A_Reg(16) != 15)
+        MOV(rn, W1);
+
+    // misaligned register pairs are rounded down to the even register
+    int rd = CurInstr.A_Reg(12) & ~1;
+    Comp_MemAccessBlock(-1, BitSet16(3 << rd), !load, false, false, false);
+}
+
+void Compiler::A_Comp_SWP()
+{
+    bool byte = CurInstr.Instr & (1 << 22);
+    int rd = CurInstr.A_Reg(12);
+
+    Comp_AddCycles_CDI();
+
+    PushRegs(false, false);
+
+    MOV(W0, MapReg(CurInstr.A_Reg(16)));
+    if (Num == 0)
+    {
+        MOV(X1, RCPU);
+        MOV(W2, MapReg(CurInstr.A_Reg(0)));
+        switch (byte * 2 | NDS::ConsoleType)
+        {
+        case 0: QuickCallFunction(X3, SlowSwap9<u32, 0>); break;
+        case 1: QuickCallFunction(X3, SlowSwap9<u32, 1>); break;
+        case 2: QuickCallFunction(X3, SlowSwap9<u8, 0>); break;
+        case 3: QuickCallFunction(X3, SlowSwap9<u8, 1>); break;
+        }
+    }
+    else
+    {
+        MOV(W1, MapReg(CurInstr.A_Reg(0)));
+        switch (byte * 2 | NDS::ConsoleType)
+        {
+        case 0: QuickCallFunction(X3, SlowSwap7<u32, 0>); break;
+        case 1: QuickCallFunction(X3, SlowSwap7<u32, 1>); break;
+        case 2: QuickCallFunction(X3, SlowSwap7<u8, 0>); break;
+        case 3: QuickCallFunction(X3, SlowSwap7<u8, 1>); break;
+        }
+    }
+
+    PopRegs(false, false);
+
+    if (rd == 15)
+        SaveReg(15, W0);
+    else
+        MOV(MapReg(rd), W0);
+}
+
 void Compiler::T_Comp_MemReg()
 {
     int op = (CurInstr.Instr >> 10) & 0x3;
@@ -500,6 +578,13 @@ s32 Compiler::Comp_MemAccessBlock(int rn, BitSet16 regs, bool store, bool preinc
     bool compileFastPath = Config::JIT_FastMemory
         && store && !usermode && (CurInstr.Cond() < 0xE || ARMJIT_Memory::IsFastmemCompatible(expectedTarget));
 
+    // a negative rn means the caller already put the start address into W0
+    if (rn < 0)
+    {
+        if (compileFastPath)
+            ANDI2R(W0, W0, ~3);
+    }
+    else
     {
         s32 offset = decrement
             ? -regsCount * 4 + (preinc ? 0 : 4)
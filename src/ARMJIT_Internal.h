@@ -66,6 +66,10 @@ struct FetchedInstr
     u16 CodeCycles;
     u32 DataRegion;
 
+    // the word an inlined literal load is taken from. It's read by the
+    // front end, so the backends don't have to touch memory themselves
+    u32 LiteralWord;
+
     ARMInstrInfo::Info Info;
 };
 
@@ -171,6 +175,9 @@ struct __attribute__((packed)) TinyVector
     }
 };
 
+// the code memory is reused one segment at a time
+const int NumCodeSegments = 4;
+
 class JitBlock
 {
 public:
@@ -180,6 +187,9 @@ public:
         NumAddresses = numAddresses;
         NumLiterals = numLiterals;
         Data.SetLength(numAddresses * 2 + numLiterals);
+        EntryPoint = NULL;
+        Extendable = false;
+        CodeSegment = 0;
     }
 
     u32 StartAddr;
@@ -189,8 +199,15 @@ public:
     u16 NumAddresses;
     u16 NumLiterals;
 
+    // NULL while the block is still being compiled in the background
     JitBlockEntry EntryPoint;
 
+    // the block was cut short by the size limit or a loop, so it's
+    // compiled again as a trace once it becomes hot
+    bool Extendable;
+    // part of the code memory the block was emitted into
+    u8 CodeSegment;
+
     u32* AddressRanges()
     { return &Data[0]; }
     u32* AddressMasks()
@@ -237,6 +254,8 @@ template <typename T, int ConsoleType> T SlowRead9(u32 addr, ARMv5* cpu);
 template <typename T, int ConsoleType> void SlowWrite9(u32 addr, ARMv5* cpu, u32 val);
 template <typename T, int ConsoleType> T SlowRead7(u32 addr);
 template <typename T, int ConsoleType> void SlowWrite7(u32 addr, u32 val);
+template <typename T, int ConsoleType> u32 SlowSwap9(u32 addr, ARMv5* cpu, u32 val);
+template <typename T, int ConsoleType> u32 SlowSwap7(u32 addr, u32 val);
 
 template <bool Write, int ConsoleType> void SlowBlockTransfer9(u32 addr, u64* data, u32 num, ARMv5* cpu);
 template <bool Write, int ConsoleType> void SlowBlockTransfer7(u32 addr, u64* data, u32 num);
@@ -488,6 +488,8 @@ void SetCodeProtection(int region, u32 offset, bool protect)
 
 void RemapDTCM(u32 newBase, u32 newSize)
 {
+    ARMJIT::FinishCompileJobs();
+
     // this first part could be made more efficient
     // by unmapping DTCM first and then map the holes
     u32 oldDTCMBase = NDS::ARM9->DTCMBase;
@@ -535,6 +537,8 @@ void RemapDTCM(u32 newBase, u32 newSize)
 
 void RemapNWRAM(int num)
 {
+    ARMJIT::FinishCompileJobs();
+
     for (int i = 0; i < Mappings[memregion_SharedWRAM].Length;)
     {
         Mapping& mapping = Mappings[memregion_SharedWRAM][i];
@@ -558,6 +562,8 @@ void RemapNWRAM(int num)
 
 void RemapSWRAM()
 {
+    ARMJIT::FinishCompileJobs();
+
     printf("remapping SWRAM\n");
     for (int i = 0; i < Mappings[memregion_WRAM7].Length;)
     {
@@ -694,7 +700,11 @@ bool FaultHandler(FaultDescription& faultDesc)
             rewriteToSlowPath = !MapAtAddress(faultDesc.EmulatedFaultAddr);
 
         if (rewriteToSlowPath)
+        {
+            // the patch list is shared with blocks compiled in the background
+            ARMJIT::FinishCompileJobs();
             faultDesc.FaultPC = ARMJIT::JITCompiler->RewriteMemAccess(faultDesc.FaultPC);
+        }
 
         return true;
     }
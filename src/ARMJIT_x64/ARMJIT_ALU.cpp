@@ -404,6 +404,122 @@ void Compiler::A_Comp_Mul_Long()
     MOV(32, rd, R(RSCRATCH2));
 }
 
+void Compiler::Comp_SignedHalf(X64Reg dst, OpArg src, bool top)
+{
+    MOV(32, R(dst), src);
+    if (top)
+        SAR(32, R(dst), Imm8(16));
+    else
+        MOVSX(32, 16, dst, R(dst));
+}
+
+void Compiler::A_Comp_Mul_Short()
+{
+    OpArg rd = MapReg(CurInstr.A_Reg(16));
+    OpArg rm = MapReg(CurInstr.A_Reg(0));
+    OpArg rs = MapReg(CurInstr.A_Reg(8));
+    u32 op = (CurInstr.Instr >> 21) & 0xF;
+
+    bool x = CurInstr.Instr & (1 << 5);
+    bool y = CurInstr.Instr & (1 << 6);
+
+    Comp_SignedHalf(RSCRATCH2, rs, y);
+
+    if (op == 0b1000 || op == 0b1011)
+    {
+        // SMLAxy/SMULxy
+        Comp_SignedHalf(RSCRATCH, rm, x);
+        IMUL(32, RSCRATCH, R(RSCRATCH2));
+    }
+    else if (op == 0b1001)
+    {
+        // SMLAWy/SMULWy
+        MOV(32, R(RSCRATCH), rm);
+        MOVSX(64, 32, RSCRATCH, R(RSCRATCH));
+        MOVSX(64, 32, RSCRATCH2, R(RSCRATCH2));
+        IMUL(64, RSCRATCH, R(RSCRATCH2));
+        SAR(64, R(RSCRATCH), Imm8(16));
+    }
+
+    if (op == 0b1010)
+    {
+        // SMLALxy
+        OpArg rn = MapReg(CurInstr.A_Reg(12));
+
+        Comp_SignedHalf(RSCRATCH, rm, x);
+        IMUL(32, RSCRATCH, R(RSCRATCH2));
+        MOVSX(64, 32, RSCRATCH, R(RSCRATCH));
+
+        MOV(32, R(RSCRATCH2), rd);
+        SHL(64, R(RSCRATCH2), Imm8(32));
+        OR(64, R(RSCRATCH2), rn);
+        ADD(64, R(RSCRATCH2), R(RSCRATCH));
+
+        MOV(32, rn, R(RSCRATCH2));
+        SHR(64, R(RSCRATCH2), Imm8(32));
+        MOV(32, rd, R(RSCRATCH2));
+
+        Comp_AddCycles_CI(1);
+    }
+    else
+    {
+        if (op == 0b1000 || (op == 0b1001 && !x))
+        {
+            // the accumulating variants set Q on overflow
+            ADD(32, R(RSCRATCH), MapReg(CurInstr.A_Reg(12)));
+            FixupBranch noOverflow = J_CC(CC_NO);
+            OR(32, R(RCPSR), Imm32(0x08000000));
+            SetJumpTarget(noOverflow);
+
+            CPSRDirty = true;
+        }
+
+        MOV(32, rd, R(RSCRATCH));
+
+        Comp_AddCycles_C();
+    }
+}
+
+void Compiler::Comp_Saturate(X64Reg reg)
+{
+    // expects the flags of the preceding add/sub
+    FixupBranch noOverflow = J_CC(CC_NO);
+    SAR(32, R(reg), Imm8(31));
+    XOR(32, R(reg), Imm32(0x80000000));
+    OR(32, R(RCPSR), Imm32(0x08000000));
+    SetJumpTarget(noOverflow);
+}
+
+void Compiler::A_Comp_QArith()
+{
+    OpArg rd = MapReg(CurInstr.A_Reg(12));
+    OpArg rm = MapReg(CurInstr.A_Reg(0));
+    OpArg rn = MapReg(CurInstr.A_Reg(16));
+
+    bool doubling = CurInstr.Instr & (1 << 22);
+    bool sub = CurInstr.Instr & (1 << 21);
+
+    MOV(32, R(RSCRATCH2), rn);
+    if (doubling)
+    {
+        ADD(32, R(RSCRATCH2), R(RSCRATCH2));
+        Comp_Saturate(RSCRATCH2);
+    }
+
+    MOV(32, R(RSCRATCH), rm);
+    if (sub)
+        SUB(32, R(RSCRATCH), R(RSCRATCH2));
+    else
+        ADD(32, R(RSCRATCH), R(RSCRATCH2));
+    Comp_Saturate(RSCRATCH);
+
+    MOV(32, rd, R(RSCRATCH));
+
+    CPSRDirty = true;
+
+    Comp_AddCycles_C();
+}
+
 void Compiler::Comp_RetriveFlags(bool sign, bool retriveCV, bool carryUsed)
 {
     if (CurInstr.SetFlags == 0)
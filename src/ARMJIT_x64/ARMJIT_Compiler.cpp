@@ -226,6 +226,64 @@ void Compiler::A_Comp_MSR()
     }
 }
 
+void CP15WriteTrampoline(ARMv5* cpu, u32 id, u32 val)
+{
+    cpu->CP15Write(id, val);
+}
+
+u32 CP15ReadTrampoline(ARMv5* cpu, u32 id)
+{
+    return cpu->CP15Read(id);
+}
+
+void Compiler::A_Comp_MCR()
+{
+    // the decoder already turned every coprocessor access other than
+    // p15 on the ARM9 and p14 on the ARM7 into UNK, p14 is a nop
+    if (Num == 0)
+    {
+        u32 cn = (CurInstr.Instr >> 16) & 0xF;
+        u32 cm = CurInstr.Instr & 0xF;
+        u32 cpinfo = (CurInstr.Instr >> 5) & 0x7;
+
+        PushRegs(false, false);
+
+        MOV(32, R(ABI_PARAM3), MapReg(CurInstr.A_Reg(12)));
+        MOV(32, R(ABI_PARAM2), Imm32((cn << 8) | (cm << 4) | cpinfo));
+        MOV(64, R(ABI_PARAM1), R(RCPU));
+        CALL((void*)&CP15WriteTrampoline);
+
+        PopRegs(false, false);
+    }
+
+    Comp_AddCycles_CI(1 + 1);
+}
+
+void Compiler::A_Comp_MRC()
+{
+    if (Num == 0)
+    {
+        u32 cn = (CurInstr.Instr >> 16) & 0xF;
+        u32 cm = CurInstr.Instr & 0xF;
+        u32 cpinfo = (CurInstr.Instr >> 5) & 0x7;
+
+        PushRegs(false, false);
+
+        MOV(32, R(ABI_PARAM2), Imm32((cn << 8) | (cm << 4) | cpinfo));
+        MOV(64, R(ABI_PARAM1), R(RCPU));
+        CALL((void*)&CP15ReadTrampoline);
+
+        PopRegs(false, false);
+
+        if (CurInstr.A_Reg(12) == 15)
+            SaveReg(15, RSCRATCH);
+        else
+            MOV(32, MapReg(CurInstr.A_Reg(12)), R(RSCRATCH));
+    }
+
+    Comp_AddCycles_CI(2 + 1);
+}
+
 /*
     We'll repurpose this .bss memory
 
@@ -260,7 +318,8 @@ Compiler::Compiler()
         CodeMemSize = alignedSize;
     }
 
-    Reset();
+    memset(ResetStart, 0xcc, CodeMemSize);
+    SetCodePtr(ResetStart);
 
     {
         // RSCRATCH mode
@@ -454,6 +513,11 @@ Compiler::Compiler()
 
     NearSize = FarStart - ResetStart;
     FarSize = (ResetStart + CodeMemSize) - FarStart;
+
+    NearCode = NearStart;
+    FarCode = FarStart;
+
+    CurCodeSegment = 0;
 }
 
 void Compiler::LoadCPSR()
@@ -560,9 +624,9 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     // CMN
     F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp), F(A_Comp_CmpOp),
     // Mul
-    F(A_Comp_MUL_MLA), F(A_Comp_MUL_MLA), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), NULL, NULL, NULL, NULL, NULL,
+    F(A_Comp_MUL_MLA), F(A_Comp_MUL_MLA), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), F(A_Comp_Mul_Long), F(A_Comp_Mul_Short), F(A_Comp_Mul_Short), F(A_Comp_Mul_Short), F(A_Comp_Mul_Short), F(A_Comp_Mul_Short),
     // ARMv5 stuff
-    F(A_Comp_CLZ), NULL, NULL, NULL, NULL,
+    F(A_Comp_CLZ), F(A_Comp_QArith), F(A_Comp_QArith), F(A_Comp_QArith), F(A_Comp_QArith),
     // STR
     F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB),
     // STRB
@@ -573,8 +637,10 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB), F(A_Comp_MemWB),
     // STRH
     F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf),
-    // LDRD, STRD never used by anything so they stay interpreted (by anything I mean the 5 games I checked)
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    // LDRD
+    F(A_Comp_MemDouble), F(A_Comp_MemDouble), F(A_Comp_MemDouble), F(A_Comp_MemDouble),
+    // STRD
+    F(A_Comp_MemDouble), F(A_Comp_MemDouble), F(A_Comp_MemDouble), F(A_Comp_MemDouble),
     // LDRH
     F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf),
     // LDRSB
@@ -582,13 +648,13 @@ const Compiler::CompileFunc A_Comp[ARMInstrInfo::ak_Count] =
     // LDRSH
     F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf), F(A_Comp_MemHalf),
     // swap
-    NULL, NULL,
+    F(A_Comp_SWP), F(A_Comp_SWP),
     // LDM/STM
     F(A_Comp_LDM_STM), F(A_Comp_LDM_STM),
     // Branch
     F(A_Comp_BranchImm), F(A_Comp_BranchImm), F(A_Comp_BranchImm), F(A_Comp_BranchXchangeReg), F(A_Comp_BranchXchangeReg),
     // system stuff
-    NULL, F(A_Comp_MSR), F(A_Comp_MSR), F(A_Comp_MRS), NULL, NULL, NULL,
+    NULL, F(A_Comp_MSR), F(A_Comp_MSR), F(A_Comp_MRS), F(A_Comp_MCR), F(A_Comp_MRC), NULL,
     F(Nop)
 };
 
@@ -639,15 +705,46 @@ bool Compiler::CanCompile(bool thumb, u16 kind)
 
 void Compiler::Reset()
 {
-    memset(ResetStart, 0xcc, CodeMemSize);
-    SetCodePtr(ResetStart);
+    // once the segments have wrapped around, code is left in the
+    // ones behind the current code pointer as well, so all of it is cleared
+    memset(NearStart, 0xcc, NearSize);
+    memset(FarStart, 0xcc, FarSize);
+    SetCodePtr(NearStart);
 
     NearCode = NearStart;
     FarCode = FarStart;
 
+    CurCodeSegment = 0;
+
     LoadStorePatches.clear();
 }
 
+void Compiler::ResetCodeSegment(int segment)
+{
+    u32 nearSegmentSize = NearSize / NumCodeSegments;
+    u32 farSegmentSize = FarSize / NumCodeSegments;
+    u8* nearSegmentStart = NearStart + nearSegmentSize * segment;
+    u8* farSegmentStart = FarStart + farSegmentSize * segment;
+
+    memset(nearSegmentStart, 0xcc, nearSegmentSize);
+    memset(farSegmentStart, 0xcc, farSegmentSize);
+    SetCodePtr(nearSegmentStart);
+
+    NearCode = nearSegmentStart;
+    FarCode = farSegmentStart;
+
+    CurCodeSegment = segment;
+
+    for (auto it = LoadStorePatches.begin(); it != LoadStorePatches.end();)
+    {
+        if ((it->first >= nearSegmentStart && it->first < nearSegmentStart + nearSegmentSize)
+            || (it->first >= farSegmentStart && it->first < farSegmentStart + farSegmentSize))
+            it = LoadStorePatches.erase(it);
+        else
+            it++;
+    }
+}
+
 bool Compiler::IsJITFault(u8* addr)
 {
     return (u64)addr >= (u64)ResetStart && (u64)addr < (u64)ResetStart + CodeMemSize;
@@ -668,18 +765,16 @@ void Compiler::Comp_SpecialBranchBehaviour(bool taken)
     }
 }
 
+s32 Compiler::FreeCodeSpace()
+{
+    // guess...
+    s32 nearSpace = NearSize / NumCodeSegments * (CurCodeSegment + 1) - (GetCodePtr() - NearStart) - 1024 * 32;
+    s32 farSpace = FarSize / NumCodeSegments * (CurCodeSegment + 1) - (FarCode - FarStart) - 1024 * 32;
+    return nearSpace < farSpace ? nearSpace : farSpace;
+}
+
 JitBlockEntry Compiler::CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr)
 {
-    if (NearSize - (GetCodePtr() - NearStart) < 1024 * 32) // guess...
-    {
-        printf("near reset\n");
-        ResetBlockCache();
-    }
-    if (FarSize - (FarCode - FarStart) < 1024 * 32) // guess...
-    {
-        printf("far reset\n");
-        ResetBlockCache();
-    }
 
     ConstantCycles = 0;
     Thumb = thumb;
@@ -80,6 +80,13 @@ public:
     void Reset();
 
     JitBlockEntry CompileBlock(ARM* cpu, bool thumb, FetchedInstr instrs[], int instrsCount, bool hasMemoryInstr);
+    // how much code can still be emitted into the current code
+    // segment, negative once the next one has to be reused
+    s32 FreeCodeSpace();
+    int CodeSegment()
+    { return CurCodeSegment; }
+    // clears the segment and continues emitting code into it
+    void ResetCodeSegment(int segment);
 
     void LoadReg(int reg, Gen::X64Reg nativeReg);
     void SaveReg(int reg, Gen::X64Reg nativeReg);
@@ -115,11 +122,15 @@ public:
 
     void A_Comp_MUL_MLA();
     void A_Comp_Mul_Long();
+    void A_Comp_Mul_Short();
 
     void A_Comp_CLZ();
+    void A_Comp_QArith();
     
     void A_Comp_MemWB();
     void A_Comp_MemHalf();
+    void A_Comp_MemDouble();
+    void A_Comp_SWP();
     void A_Comp_LDM_STM();
 
     void A_Comp_BranchImm();
@@ -127,6 +138,8 @@ public:
 
     void A_Comp_MRS();
     void A_Comp_MSR();
+    void A_Comp_MCR();
+    void A_Comp_MRC();
 
     void T_Comp_ShiftImm();
     void T_Comp_AddSub_();
@@ -173,6 +186,8 @@ public:
     void Comp_CmpOp(int op, Gen::OpArg rn, Gen::OpArg op2, bool carryUsed);
 
     void Comp_MulOp(bool S, bool add, Gen::OpArg rd, Gen::OpArg rm, Gen::OpArg rs, Gen::OpArg rn);
+    void Comp_SignedHalf(Gen::X64Reg dst, Gen::OpArg src, bool top);
+    void Comp_Saturate(Gen::X64Reg reg);
 
     void Comp_RetriveFlags(bool sign, bool retriveCV, bool carryUsed);
 
@@ -238,6 +253,8 @@ public:
     u8* NearStart;
     u8* FarStart;
 
+    int CurCodeSegment;
+
     void* PatchedStoreFuncs[2][2][3][16];
     void* PatchedLoadFuncs[2][2][3][2][16];
 
@@ -80,28 +80,24 @@ bool Compiler::Comp_MemLoadLiteral(int size, bool signExtend, int rd, u32 addr)
 
     Comp_AddCycles_CDI();
 
-    u32 val;
-    // make sure arm7 bios is accessible
-    u32 tmpR15 = CurCPU->R[15];
-    CurCPU->R[15] = R15;
+    // the front end already read the word for us
+    u32 val = CurInstr.LiteralWord;
     if (size == 32)
     {
-        CurCPU->DataRead32(addr & ~0x3, &val);
         val = ::ROR(val, (addr & 0x3) << 3);
     }
     else if (size == 16)
     {
-        CurCPU->DataRead16(addr & ~0x1, &val);
+        val = (val >> ((addr & 0x2) << 3)) & 0xFFFF;
         if (signExtend)
             val = ((s32)val << 16) >> 16;
     }
     else
     {
-        CurCPU->DataRead8(addr, &val);
+        val = (val >> ((addr & 0x3) << 3)) & 0xFF;
         if (signExtend)
             val = ((s32)val << 24) >> 24;
     }
-    CurCPU->R[15] = tmpR15;
 
     MOV(32, MapReg(rd), Imm32(val));
 
@@ -443,7 +439,10 @@ s32 Compiler::Comp_MemAccessBlock(int rn, BitSet16 regs, bool store, bool preinc
 #endif
     u32 allocOffset = stackAlloc - regsCount * 8;
 
-    if (decrement)
+    // a negative rn means the caller already put the start address into RSCRATCH4
+    if (rn < 0)
+        ;
+    else if (decrement)
         MOV_sum(32, RSCRATCH4, MapReg(rn), Imm32(-regsCount * 4 + (preinc ? 0 : 4)));
     else
         MOV_sum(32, RSCRATCH4, MapReg(rn), Imm32(preinc ? 4 : 0));
@@ -726,6 +725,79 @@ void Compiler::A_Comp_MemHalf()
     Comp_MemAccess(CurInstr.A_Reg(12), CurInstr.A_Reg(16), offset, size, flags);
 }
 
+void Compiler::A_Comp_MemDouble()
+{
+    if (Num == 1)
+        return; // NOP
+
+    bool load = !(CurInstr.Instr & (1 << 5));
+    bool pre = CurInstr.Instr & (1 << 24);
+    bool writeback = !pre || (CurInstr.Instr & (1 << 21));
+
+    OpArg rn = MapReg(CurInstr.A_Reg(16));
+    OpArg offset = CurInstr.Instr & (1 << 22)
+        ? Imm32(CurInstr.Instr & 0xF | ((CurInstr.Instr >> 4) & 0xF0))
+        : MapReg(CurInstr.A_Reg(0));
+
+    MOV(32, R(RSCRATCH3), rn);
+    if (CurInstr.Instr & (1 << 23))
+        ADD(32, R(RSCRATCH3), offset);
+    else
+        SUB(32, R(RSCRATCH3), offset);
+
+    MOV(32, R(RSCRATCH4), pre ? R(RSCRATCH3) : rn);
+
+    // like the interpreter the base register is updated before the access
+    if (writeback && CurInstr.A_Reg(16) != 15)
+        MOV(32, rn, R(RSCRATCH3));
+
+    // misaligned register pairs are rounded down to the even register
+    int rd = CurInstr.A_Reg(12) & ~1;
+    Comp_MemAccessBlock(-1, BitSet16(3 << rd), !load, false, false, false);
+}
+
+void Compiler::A_Comp_SWP()
+{
+    bool byte = CurInstr.Instr & (1 << 22);
+    int rd = CurInstr.A_Reg(12);
+
+    Comp_AddCycles_CDI();
+
+    PushRegs(false, false);
+
+    MOV(32, R(ABI_PARAM1), MapReg(CurInstr.A_Reg(16)));
+    if (Num == 0)
+    {
+        MOV(32, R(ABI_PARAM3), MapReg(CurInstr.A_Reg(0)));
+        MOV(64, R(ABI_PARAM2), R(RCPU));
+        switch (byte * 2 | NDS::ConsoleType)
+        {
+        case 0: CALL((void*)&SlowSwap9<u32, 0>); break;
+        case 1: CALL((void*)&SlowSwap9<u32, 1>); break;
+        case 2: CALL((void*)&SlowSwap9<u8, 0>); break;
+        case 3: CALL((void*)&SlowSwap9<u8, 1>); break;
+        }
+    }
+    else
+    {
+        MOV(32, R(ABI_PARAM2), MapReg(CurInstr.A_Reg(0)));
+        switch (byte * 2 | NDS::ConsoleType)
+        {
+        case 0: CALL((void*)&SlowSwap7<u32, 0>); break;
+        case 1: CALL((void*)&SlowSwap7<u32, 1>); break;
+        case 2: CALL((void*)&SlowSwap7<u8, 0>); break;
+        case 3: CALL((void*)&SlowSwap7<u8, 1>); break;
+        }
+    }
+
+    PopRegs(false, false);
+
+    if (rd == 15)
+        SaveReg(15, RSCRATCH);
+    else
+        MOV(32, MapReg(rd), R(RSCRATCH));
+}
+
 void Compiler::T_Comp_MemReg()
 {
     int op = (CurInstr.Instr >> 10) & 0x3;
@@ -485,13 +485,13 @@ Info Decode(bool thumb, u32 num, u32 instr)
         
         if (data & A_Read12Double)
         {
-            res.SrcRegs |= 1 << ((instr >> 12) & 0xF);
-            res.SrcRegs |= 1 << (((instr >> 12) & 0xF) + 1);
+            res.SrcRegs |= 1 << ((instr >> 12) & 0xE);
+            res.SrcRegs |= 1 << (((instr >> 12) & 0xE) + 1);
         }
         if (data & A_Write12Double)
         {
-            res.DstRegs |= 1 << ((instr >> 12) & 0xF);
-            res.DstRegs |= 1 << (((instr >> 12) & 0xF) + 1);
+            res.DstRegs |= 1 << ((instr >> 12) & 0xE);
+            res.DstRegs |= 1 << (((instr >> 12) & 0xE) + 1);
         }
 
         if (data & A_Link)
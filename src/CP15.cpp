@@ -73,6 +73,11 @@ void ARMv5::CP15DoSavestate(Savestate* file)
 {
     file->Section("CP15");
 
+    u32 oldControl = CP15Control;
+    u32 oldPU[5] = {PU_CodeCacheable, PU_DataCacheable, PU_DataCacheWrite, PU_CodeRW, PU_DataRW};
+    u32 oldRegions[8];
+    memcpy(oldRegions, PU_Region, sizeof(oldRegions));
+
     file->Var32(&CP15Control);
 
     file->Var32(&DTCMSetting);
@@ -94,7 +99,14 @@ void ARMv5::CP15DoSavestate(Savestate* file)
     {
         UpdateDTCMSetting();
         UpdateITCMSetting();
-        UpdatePURegions(true);
+
+        // rebuilding the PU maps is slow, while states which are loaded
+        // in quick succession (e.g. for rewinding) mostly share the same settings
+        u32 newPU[5] = {PU_CodeCacheable, PU_DataCacheable, PU_DataCacheWrite, PU_CodeRW, PU_DataRW};
+        if (CP15Control != oldControl
+            || memcmp(oldPU, newPU, sizeof(oldPU))
+            || memcmp(oldRegions, PU_Region, sizeof(oldRegions)))
+            UpdatePURegions(true);
     }
 }
 
@@ -127,16 +139,24 @@ void ARMv5::UpdateDTCMSetting()
 
 void ARMv5::UpdateITCMSetting()
 {
+    u32 newITCMSize;
     if (CP15Control & (1<<18))
     {
-        ITCMSize = 0x200 << ((ITCMSetting >> 1) & 0x1F);
-        //printf("ITCM [%08X] enabled at %08X, size %X\n", ITCMSetting, 0, ITCMSize);
+        newITCMSize = 0x200 << ((ITCMSetting >> 1) & 0x1F);
+        //printf("ITCM [%08X] enabled at %08X, size %X\n", ITCMSetting, 0, newITCMSize);
     }
     else
     {
-        ITCMSize = 0;
+        newITCMSize = 0;
         //printf("ITCM disabled\n");
     }
+    if (newITCMSize != ITCMSize)
+    {
+#ifdef JIT_ENABLED
+        ARMJIT::FinishCompileJobs();
+#endif
+        ITCMSize = newITCMSize;
+    }
 }
 
 
@@ -271,6 +291,10 @@ void ARMv5::UpdatePURegions(bool update_all)
 
 void ARMv5::UpdateRegionTimings(u32 addrstart, u32 addrend)
 {
+#ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
+#endif
+
     addrstart >>= 12;
     addrend   >>= 12;
 
@@ -767,6 +791,17 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
     return BusRead32(addr);
 }
 
+s32 ARMv5::CodeFetchCycles(u32 addr, bool branch, s32 regionCodeCycles) const
+{
+    if (addr < ITCMSize)
+        return 1;
+
+    if (regionCodeCycles == 0xFF)
+        return (branch || !(addr & 0x1F)) ? kCodeCacheTiming : 1;
+
+    return regionCodeCycles;
+}
+
 
 void ARMv5::DataRead8(u32 addr, u32* val)
 {
@@ -43,12 +43,18 @@ char DSiSDPath[1024];
 
 int RandomizeMAC;
 
+int RewindEnable;
+int RewindInterval; // frames between snapshots
+int RewindDepth; // maximum amount of snapshots
+int RewindMemory; // in MB
+
 #ifdef JIT_ENABLED
 int JIT_Enable = false;
 int JIT_MaxBlockSize = 32;
 int JIT_BranchOptimisations = true;
 int JIT_LiteralOptimisations = true;
 int JIT_FastMemory = true;
+int JIT_BackgroundCompile = false;
 #endif
 
 ConfigEntry ConfigFile[] =
@@ -68,6 +74,11 @@ ConfigEntry ConfigFile[] =
 
     {"RandomizeMAC", 0, &RandomizeMAC, 0, NULL, 0},
 
+    {"RewindEnable", 0, &RewindEnable, 0, NULL, 0},
+    {"RewindInterval", 0, &RewindInterval, 4, NULL, 0},
+    {"RewindDepth", 0, &RewindDepth, 600, NULL, 0},
+    {"RewindMemory", 0, &RewindMemory, 128, NULL, 0},
+
 #ifdef JIT_ENABLED
     {"JIT_Enable", 0, &JIT_Enable, 0, NULL, 0},
     {"JIT_MaxBlockSize", 0, &JIT_MaxBlockSize, 32, NULL, 0},
@@ -78,6 +89,7 @@ ConfigEntry ConfigFile[] =
     #else
         {"JIT_FastMemory", 0, &JIT_FastMemory, 1, NULL, 0},
     #endif
+    {"JIT_BackgroundCompile", 0, &JIT_BackgroundCompile, 0, NULL, 0},
 #endif
 
     {"", -1, NULL, 0, NULL, 0}
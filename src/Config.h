@@ -56,12 +56,18 @@ extern char DSiSDPath[1024];
 
 extern int RandomizeMAC;
 
+extern int RewindEnable;
+extern int RewindInterval;
+extern int RewindDepth;
+extern int RewindMemory;
+
 #ifdef JIT_ENABLED
 extern int JIT_Enable;
 extern int JIT_MaxBlockSize;
 extern int JIT_BranchOptimisations;
 extern int JIT_LiteralOptimisations;
 extern int JIT_FastMemory;
+extern int JIT_BackgroundCompile;
 #endif
 
 }
@@ -17,11 +17,18 @@
 */
 
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include "NDS.h"
 #include "DSi.h"
 #include "DMA.h"
 #include "GPU.h"
 
+#ifdef JIT_ENABLED
+#include "ARMJIT.h"
+#include "ARMJIT_Memory.h"
+#endif
+
 
 
 // DMA TIMINGS
@@ -183,6 +190,166 @@ void DMA::Start()
     NDS::StopCPU(CPU, 1<<Num);
 }
 
+
+// BULK TRANSFERS
+//
+// as long as both ends of a transfer are plain memory nothing can happen
+// between two units which could be observed before the CPU target is reached,
+// so everything up to that point is moved at once. Everything which isn't
+// RAM, or VRAM backed by a single bank, goes through the regular path.
+
+enum
+{
+    bulk_MainRAM,
+    bulk_SharedWRAM,
+    bulk_WRAM7,
+    bulk_VRAM,
+};
+
+struct BulkSpan
+{
+    u8* Ptr;
+    // contiguous bytes before and from Ptr
+    u32 Before, After;
+    u32 Kind;
+    u32 VRAMBank;
+};
+
+template <int ConsoleType>
+static bool GetBulkSpan(u32 cpu, u32 addr, bool write, BulkSpan& span)
+{
+    NDS::MemRegion region;
+    bool mapped;
+    if (cpu == 0)
+        mapped = ConsoleType == 1 ? DSi::ARM9GetMemRegion(addr, write, &region) : NDS::ARM9GetMemRegion(addr, write, &region);
+    else
+        mapped = ConsoleType == 1 ? DSi::ARM7GetMemRegion(addr, write, &region) : NDS::ARM7GetMemRegion(addr, write, &region);
+
+    if (mapped)
+    {
+        u32 offset = addr & region.Mask;
+        span.Ptr = &region.Mem[offset];
+        span.Before = offset;
+        span.After = region.Mask + 1 - offset;
+        if (region.Mem == NDS::MainRAM)
+            span.Kind = bulk_MainRAM;
+        else if (region.Mem == NDS::ARM7WRAM)
+            span.Kind = bulk_WRAM7;
+        else
+            span.Kind = bulk_SharedWRAM; // or a BIOS, which can't be written to
+        return true;
+    }
+
+    if (cpu == 0 && (addr >> 24) == 0x06)
+    {
+        u8* page = GPU::GetVRAMPagePtr(addr, span.VRAMBank);
+        if (!page) return false;
+
+        span.Ptr = page + (addr & 0x3FFF);
+        span.Before = addr & 0x3FFF;
+        span.After = 0x4000 - span.Before;
+        span.Kind = bulk_VRAM;
+        return true;
+    }
+
+    return false;
+}
+
+template <int ConsoleType, typename T>
+bool DMA::RunBulk(s32 unitcycles)
+{
+    u64& timestamp = CPU ? NDS::ARM7Timestamp : NDS::ARM9Timestamp;
+    u64 target = CPU ? NDS::ARM7Target : NDS::ARM9Target;
+    u64 cycles = CPU ? unitcycles : (unitcycles << NDS::ARM9ClockShift);
+
+    if (((CurSrcAddr | CurDstAddr) & (sizeof(T)-1)) || unitcycles <= 0)
+        return false;
+
+    BulkSpan src, dst;
+    if (!GetBulkSpan<ConsoleType>(CPU, CurSrcAddr, false, src)
+        || !GetBulkSpan<ConsoleType>(CPU, CurDstAddr, true, dst))
+        return false;
+
+    // the regular path stops after the first unit which reaches the target
+    u32 count = std::min<u64>(IterCount, (target - timestamp + cycles - 1) / cycles);
+
+    s32 srcstep = (s32)SrcAddrInc * (s32)sizeof(T);
+    s32 dststep = (s32)DstAddrInc * (s32)sizeof(T);
+    if (srcstep > 0) count = std::min(count, src.After / (u32)sizeof(T));
+    else if (srcstep < 0) count = std::min(count, src.Before / (u32)sizeof(T) + 1);
+    if (dststep > 0) count = std::min(count, dst.After / (u32)sizeof(T));
+    else if (dststep < 0) count = std::min(count, dst.Before / (u32)sizeof(T) + 1);
+
+    if (count == 0)
+        return false;
+
+    u32 len = count * sizeof(T);
+    if (srcstep > 0 && dststep > 0 && !(dst.Ptr > src.Ptr && dst.Ptr < src.Ptr + len))
+    {
+        // copying backwards over itself is the only case
+        // where unit by unit isn't the same as memmove
+        memmove(dst.Ptr, src.Ptr, len);
+    }
+    else if (srcstep == 0 && dststep > 0)
+    {
+        T val = *(T*)src.Ptr;
+        for (u32 i = 0; i < count; i++)
+            ((T*)dst.Ptr)[i] = val;
+    }
+    else
+    {
+        u8* srcptr = src.Ptr;
+        u8* dstptr = dst.Ptr;
+        for (u32 i = 0; i < count; i++)
+        {
+            *(T*)dstptr = *(T*)srcptr;
+            srcptr += srcstep;
+            dstptr += dststep;
+        }
+    }
+
+    // notify everyone who's interested about the written memory
+    u32 dstlow = CurDstAddr;
+    u32 dstlen = len;
+    if (dststep < 0)
+        dstlow -= len - sizeof(T);
+    else if (dststep == 0)
+        dstlen = sizeof(T);
+
+    if (dst.Kind == bulk_VRAM)
+    {
+        GPU::MarkVRAMDirtyRange(dst.VRAMBank, (dst.Ptr - GPU::VRAM[dst.VRAMBank]) - (CurDstAddr - dstlow), dstlen);
+#ifdef JIT_ENABLED
+        ARMJIT::CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_VRAM>(dstlow, dstlen);
+#endif
+    }
+#ifdef JIT_ENABLED
+    else if (CPU == 0)
+    {
+        if (dst.Kind == bulk_MainRAM)
+            ARMJIT::CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_MainRAM>(dstlow, dstlen);
+        else
+            ARMJIT::CheckAndInvalidateRange<0, ARMJIT_Memory::memregion_SharedWRAM>(dstlow, dstlen);
+    }
+    else
+    {
+        // the ARM7 doesn't get to see shared WRAM through a MemRegion
+        if (dst.Kind == bulk_MainRAM)
+            ARMJIT::CheckAndInvalidateRange<1, ARMJIT_Memory::memregion_MainRAM>(dstlow, dstlen);
+        else
+            ARMJIT::CheckAndInvalidateRange<1, ARMJIT_Memory::memregion_WRAM7>(dstlow, dstlen);
+    }
+#endif
+
+    timestamp += cycles * count;
+    CurSrcAddr += srcstep * count;
+    CurDstAddr += dststep * count;
+    IterCount -= count;
+    RemCount -= count;
+
+    return true;
+}
+
 template <int ConsoleType>
 void DMA::Run9()
 {
@@ -217,8 +384,19 @@ void DMA::Run9()
             }*/
         }
 
+        bool bulk = true;
         while (IterCount > 0 && !Stall)
         {
+            if (bulk)
+            {
+                bulk = RunBulk<ConsoleType, u16>(unitcycles);
+                if (bulk)
+                {
+                    if (NDS::ARM9Timestamp >= NDS::ARM9Target) break;
+                    continue;
+                }
+            }
+
             NDS::ARM9Timestamp += (unitcycles << NDS::ARM9ClockShift);
 
             if (ConsoleType == 1)
@@ -271,8 +449,19 @@ void DMA::Run9()
         }
         else
         {
+            bool bulk = true;
             while (IterCount > 0 && !Stall)
             {
+                if (bulk)
+                {
+                    bulk = RunBulk<ConsoleType, u32>(unitcycles);
+                    if (bulk)
+                    {
+                        if (NDS::ARM9Timestamp >= NDS::ARM9Target) break;
+                        continue;
+                    }
+                }
+
                 NDS::ARM9Timestamp += (unitcycles << NDS::ARM9ClockShift);
 
                 if (ConsoleType == 1)
@@ -352,8 +541,19 @@ void DMA::Run7()
             }*/
         }
 
+        bool bulk = true;
         while (IterCount > 0 && !Stall)
         {
+            if (bulk)
+            {
+                bulk = RunBulk<ConsoleType, u16>(unitcycles);
+                if (bulk)
+                {
+                    if (NDS::ARM7Timestamp >= NDS::ARM7Target) break;
+                    continue;
+                }
+            }
+
             NDS::ARM7Timestamp += unitcycles;
 
             if (ConsoleType == 1)
@@ -391,8 +591,19 @@ void DMA::Run7()
             }*/
         }
 
+        bool bulk = true;
         while (IterCount > 0 && !Stall)
         {
+            if (bulk)
+            {
+                bulk = RunBulk<ConsoleType, u32>(unitcycles);
+                if (bulk)
+                {
+                    if (NDS::ARM7Timestamp >= NDS::ARM7Target) break;
+                    continue;
+                }
+            }
+
             NDS::ARM7Timestamp += unitcycles;
 
             if (ConsoleType == 1)
@@ -73,6 +73,9 @@ public:
 private:
     u32 CPU, Num;
 
+    template <int ConsoleType, typename T>
+    bool RunBulk(s32 unitcycles);
+
     u32 StartMode;
     u32 CurSrcAddr;
     u32 CurDstAddr;
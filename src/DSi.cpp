@@ -196,6 +196,7 @@ void SoftReset()
     // also, BPTWL[0x70] could be abused to quickly boot specific titles
 
 #ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
     ARMJIT_Memory::Reset();
     ARMJIT::CheckAndInvalidateITCM();
 #endif
@@ -765,6 +766,18 @@ void Set_SCFG_Clock9(u16 val)
     NDS::ARM9->UpdateRegionTimings(0x00000000, 0xFFFFFFFF);
 }
 
+// the BIOS protection bits can only be set
+void Set_SCFG_BIOS(u16 val)
+{
+    if ((SCFG_BIOS | val) == SCFG_BIOS)
+        return;
+
+#ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
+#endif
+    SCFG_BIOS |= val;
+}
+
 void Set_SCFG_MC(u32 val)
 {
     u32 oldslotstatus = SCFG_MC & 0xC;
@@ -2018,10 +2031,10 @@ void ARM7IOWrite8(u32 addr, u8 val)
     switch (addr)
     {
     case 0x04004000:
-        SCFG_BIOS |= (val & 0x03);
+        Set_SCFG_BIOS(val & 0x03);
         return;
     case 0x04004001:
-        SCFG_BIOS |= ((val & 0x07) << 8);
+        Set_SCFG_BIOS((val & 0x07) << 8);
         return;
 
     case 0x04004500: DSi_I2C::WriteData(val); return;
@@ -2039,7 +2052,7 @@ void ARM7IOWrite16(u32 addr, u16 val)
     case 0x0400021C: NDS::IF2 &= ~(val & 0x7FF7); NDS::UpdateIRQ(1); return;
 
     case 0x04004000:
-        SCFG_BIOS |= (val & 0x0703);
+        Set_SCFG_BIOS(val & 0x0703);
         return;
     case 0x04004004:
         SCFG_Clock7 = val & 0x0187;
@@ -2071,7 +2084,7 @@ void ARM7IOWrite32(u32 addr, u32 val)
     case 0x0400021C: NDS::IF2 &= ~(val & 0x7FF7); NDS::UpdateIRQ(1); return;
 
     case 0x04004000:
-        SCFG_BIOS |= (val & 0x0703);
+        Set_SCFG_BIOS(val & 0x0703);
         return;
     case 0x04004008:
         SCFG_EXT[0] &= ~0x03000000;
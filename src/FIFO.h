@@ -19,6 +19,8 @@
 #ifndef FIFO_H
 #define FIFO_H
 
+#include <string.h>
+
 #include "types.h"
 
 template<typename T, u32 NumEntries>
@@ -18,10 +18,23 @@
 
 #include <stdio.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include "NDS.h"
 #include "GPU.h"
 
 #include "GPU2D_Soft.h"
+#include "GPU2D_Deferred.h"
+
+#ifdef NEONSOFTGPU_ENABLED
+#include "GPU2D_NeonSoft.h"
+#ifdef __x86_64__
+#include "dolphin/CPUDetect.h"
+#endif
+#endif
 
 #ifdef DEKOGPU_ENABLED
 #include "GPU2D_Deko.h"
@@ -91,6 +104,11 @@ GPU2D::Unit GPU2D_B(1);
 
 std::unique_ptr<GPU2D::Renderer2D> GPU2D_Renderer = {};
 
+int CurRenderer2D;
+bool Deferred2D;
+bool Threaded2D;
+bool Deferred2DPending;
+
 /*
     VRAM invalidation tracking
 
@@ -126,6 +144,8 @@ VRAMTrackingSet<512*1024, 128*1024> VRAMDirty_Texture;
 VRAMTrackingSet<128*1024, 16*1024> VRAMDirty_TexPal;
 
 NonStupidBitField<128*1024/VRAMDirtyGranularity> VRAMDirty[9];
+u32 VRAMGeneration[9];
+u32 VRAMMapGeneration;
 
 u8 VRAMFlat_ABG[512*1024];
 u8 VRAMFlat_BBG[128*1024];
@@ -146,8 +166,6 @@ std::unique_ptr<GLCompositor> CurGLCompositor = {};
 
 bool Init()
 {
-    //GPU2D_Renderer = std::make_unique<GPU2D::SoftRenderer>();
-    GPU2D_Renderer = std::make_unique<GPU2D::DekoRenderer>();
     if (!GPU3D::Init()) return false;
 
     FrontBuffer = 0;
@@ -155,12 +173,16 @@ bool Init()
     Framebuffer[1][0] = NULL; Framebuffer[1][1] = NULL;
     Renderer = 0;
 
+    Deferred2DPending = false;
+    SetRenderer2D(GetFastestRenderer2D(), false, false);
+
     return true;
 }
 
 void DeInit()
 {
     GPU2D_Renderer.reset();
+    Deferred2DPending = false;
     GPU3D::DeInit();
 
     if (Framebuffer[0][0]) delete[] Framebuffer[0][0];
@@ -173,6 +195,7 @@ void ResetVRAMCache()
 {
     for (int i = 0; i < 9; i++)
         VRAMDirty[i] = NonStupidBitField<128*1024/VRAMDirtyGranularity>();
+    VRAMMapGeneration++;
 
     VRAMDirty_ABG.Reset();
     VRAMDirty_BBG.Reset();
@@ -198,10 +221,15 @@ void ResetVRAMCache()
 
     OAMDirty = 0x3;
     PaletteDirty = 0xF;
+
+    if (GPU2D_Renderer)
+        GPU2D_Renderer->MemoryReloaded();
 }
 
 void Reset()
 {
+    GPU2D_Renderer->Flush();
+
     VCount = 0;
     NextVCount = -1;
     TotalScanlines = 0;
@@ -307,6 +335,8 @@ void Stop()
 
 void DoSavestate(Savestate* file)
 {
+    GPU2D_Renderer->Flush();
+
     file->Section("GPUG");
 
     file->Var16(&VCount);
@@ -368,7 +398,8 @@ void DoSavestate(Savestate* file)
     GPU2D_B.DoSavestate(file);
     GPU3D::DoSavestate(file);
 
-    ResetVRAMCache();
+    if (!file->Saving)
+        ResetVRAMCache();
 }
 
 void AssignFramebuffers()
@@ -386,6 +417,105 @@ void AssignFramebuffers()
     }
 }
 
+bool IsRenderer2DAvailable(int renderer)
+{
+    switch (renderer)
+    {
+    case renderer2D_Soft:
+        return true;
+#ifdef NEONSOFTGPU_ENABLED
+    case renderer2D_NeonSoft:
+#ifdef __x86_64__
+        // the x86 version is built on SSE4.1
+        return cpu_info.bSSE4_1;
+#else
+        return true;
+#endif
+#endif
+#ifdef DEKOGPU_ENABLED
+    case renderer2D_Deko:
+        return true;
+#endif
+    }
+
+    return false;
+}
+
+int GetFastestRenderer2D()
+{
+    if (IsRenderer2DAvailable(renderer2D_Deko))
+        return renderer2D_Deko;
+    if (IsRenderer2DAvailable(renderer2D_NeonSoft))
+        return renderer2D_NeonSoft;
+    return renderer2D_Soft;
+}
+
+const char* GetRenderer2DName(int renderer)
+{
+    switch (renderer)
+    {
+    case renderer2D_Soft: return "Software";
+#ifdef __x86_64__
+    case renderer2D_NeonSoft: return "SSE4.1 software";
+#else
+    case renderer2D_NeonSoft: return "NEON software";
+#endif
+    case renderer2D_Deko: return "deko3d";
+    }
+
+    return "";
+}
+
+void SetRenderer2D(int renderer, bool deferred, bool threaded)
+{
+    if (!IsRenderer2DAvailable(renderer))
+        renderer = GetFastestRenderer2D();
+    if (threaded)
+        deferred = true;
+    if (renderer == renderer2D_Deko)
+        deferred = threaded = false;
+
+    if (GPU2D_Renderer)
+    {
+        if (renderer == CurRenderer2D && deferred == Deferred2D && threaded == Threaded2D)
+            return;
+
+        GPU2D_Renderer->Flush();
+    }
+
+    std::unique_ptr<GPU2D::Renderer2D> newRenderer;
+    switch (renderer)
+    {
+#ifdef NEONSOFTGPU_ENABLED
+    case renderer2D_NeonSoft:
+        newRenderer = std::make_unique<GPU2D::NeonSoftRenderer>();
+        break;
+#endif
+#ifdef DEKOGPU_ENABLED
+    case renderer2D_Deko:
+        newRenderer = std::make_unique<GPU2D::DekoRenderer>();
+        break;
+#endif
+    default:
+        newRenderer = std::make_unique<GPU2D::SoftRenderer>();
+        break;
+    }
+
+    if (deferred)
+        newRenderer = std::make_unique<GPU2D::DeferredRenderer>(std::move(newRenderer), threaded);
+
+    GPU2D_Renderer = std::move(newRenderer);
+    CurRenderer2D = renderer;
+    Deferred2D = deferred;
+    Threaded2D = threaded;
+
+    AssignFramebuffers();
+    GPU2D_Renderer->Reset();
+
+    // the new renderer has none of the graphics data cached
+    ResetVRAMCache();
+}
+
 void InitRenderer(int renderer)
 {
 #ifdef OGLRENDERER_ENABLED
@@ -533,6 +663,52 @@ u8* GetUniqueBankPtr(u32 mask, u32 offset)
     return &VRAM[num][offset & VRAMMask[num]];
 }
 
+u8* GetVRAMPagePtr(u32 addr, u32& bank)
+{
+    u32 mask;
+    u8* ptr;
+
+    switch (addr & 0x00E00000)
+    {
+    case 0x00000000:
+        mask = VRAMMap_ABG[(addr >> 14) & 0x1F];
+        ptr = VRAMPtr_ABG[(addr >> 14) & 0x1F];
+        break;
+    case 0x00200000:
+        mask = VRAMMap_BBG[(addr >> 14) & 0x7];
+        ptr = VRAMPtr_BBG[(addr >> 14) & 0x7];
+        break;
+    case 0x00400000:
+        mask = VRAMMap_AOBJ[(addr >> 14) & 0xF];
+        ptr = VRAMPtr_AOBJ[(addr >> 14) & 0xF];
+        break;
+    case 0x00600000:
+        mask = VRAMMap_BOBJ[(addr >> 14) & 0x7];
+        ptr = VRAMPtr_BOBJ[(addr >> 14) & 0x7];
+        break;
+    default:
+        {
+            static const u32 lcdcStart[10] = {0x00000, 0x20000, 0x40000, 0x60000, 0x80000, 0x90000, 0x94000, 0x98000, 0xA0000, 0xA4000};
+            u32 offset = addr & 0xFFFFF;
+            for (int i = 0; i < 9; i++)
+            {
+                if (offset < lcdcStart[i+1])
+                {
+                    if (!(VRAMMap_LCDC & (1<<i)))
+                        return NULL;
+                    bank = i;
+                    return &VRAM[i][(offset - lcdcStart[i]) & ~0x3FFF];
+                }
+            }
+            return NULL;
+        }
+    }
+
+    if (!ptr) return NULL;
+    bank = __builtin_ctz(mask);
+    return ptr;
+}
+
 #define MAP_RANGE(map, base, n)    for (int i = 0; i < n; i++) VRAMMap_##map[(base)+i] |= bankmask;
 #define UNMAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) VRAMMap_##map[(base)+i] &= ~bankmask;
 
@@ -548,6 +724,8 @@ void MapVRAM_AB(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u8 oldofs = (oldcnt >> 3) & 0x3;
     u8 ofs = (cnt >> 3) & 0x3;
     u32 bankmask = 1 << bank;
@@ -608,6 +786,8 @@ void MapVRAM_CD(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -662,6 +842,7 @@ void MapVRAM_CD(u32 bank, u8 cnt)
             ofs &= 0x1;
             VRAMMap_ARM7[ofs] |= bankmask;
             memset(VRAMDirty[bank].Data, 0xFF, sizeof(VRAMDirty[bank].Data));
+            VRAMGeneration[bank]++;
             VRAMSTAT |= (1 << (bank-2));
             break;
 
@@ -690,6 +871,8 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -752,6 +935,8 @@ void MapVRAM_FG(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -850,6 +1035,8 @@ void MapVRAM_H(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -910,6 +1097,8 @@ void MapVRAM_I(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    VRAMMapGeneration++;
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -1037,8 +1226,8 @@ void StartHBlank(u32 line)
         // note: this should start 48 cycles after the scanline start
         if (line < 192)
         {
-            GPU2D_Renderer->DrawScanline(line, &GPU2D_A);
-            GPU2D_Renderer->DrawScanline(line, &GPU2D_B);
+            GPU2D_Renderer->DrawScanline(line, VCount, &GPU2D_A);
+            GPU2D_Renderer->DrawScanline(line, VCount, &GPU2D_B);
         }
 
         // sprites are pre-rendered one scanline in advance
@@ -1141,6 +1330,9 @@ void StartScanline(u32 line)
     {
         if (VCount == 192)
         {
+            if (Deferred2DPending)
+                GPU2D_Renderer->Flush();
+
             // in reality rendering already finishes at line 144
             // and games might already start to modify texture memory.
             // That doesn't matter for us because we cache the entire
@@ -1201,6 +1393,24 @@ template <u32 Size, u32 MappingGranularity>
 NonStupidBitField<Size/VRAMDirtyGranularity> VRAMTrackingSet<Size, MappingGranularity>::DeriveState(u32* currentMappings)
 {
     NonStupidBitField<Size/VRAMDirtyGranularity> result;
+
+    // nothing was remapped and none of the mapped banks
+    // was written to since the last time
+    if (MapGeneration == VRAMMapGeneration)
+    {
+        u32 banks = MappedBanks;
+        while (banks != 0)
+        {
+            u32 num = __builtin_ctz(banks);
+            banks &= ~(1 << num);
+
+            if (BankGeneration[num] != VRAMGeneration[num])
+                goto changed;
+        }
+        return result;
+    }
+changed:
+
     u16 banksToBeZeroed = 0;
     for (u32 i = 0; i < Size / MappingGranularity; i++)
     {
@@ -1251,11 +1461,15 @@ NonStupidBitField<Size/VRAMDirtyGranularity> VRAMTrackingSet<Size, MappingGranul
         }
     }
 
+    MapGeneration = VRAMMapGeneration;
+    MappedBanks = banksToBeZeroed & 0x1FF;
+
     while (banksToBeZeroed != 0)
     {
         u32 num = __builtin_ctz(banksToBeZeroed);
         banksToBeZeroed &= ~(1 << num);
         VRAMDirty[num].Clear();
+        BankGeneration[num] = VRAMGeneration[num];
     }
 
     return result;
@@ -1268,124 +1482,148 @@ template NonStupidBitField<128*1024/VRAMDirtyGranularity> VRAMTrackingSet<128*10
 template NonStupidBitField<256*1024/VRAMDirtyGranularity> VRAMTrackingSet<256*1024, 16*1024>::DeriveState(u32*);
 template NonStupidBitField<512*1024/VRAMDirtyGranularity> VRAMTrackingSet<512*1024, 16*1024>::DeriveState(u32*);
 
+// ORs len bytes from src into dst, len is a multiple of VRAMDirtyGranularity
+inline void OrVRAMBlock(u8* dst, u8* src, u32 len)
+{
+#if defined(__SSE2__)
+    for (u32 i = 0; i < len; i += 64)
+    {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((__m128i*)&dst[i+0]), _mm_loadu_si128((__m128i*)&src[i+0]));
+        __m128i b = _mm_or_si128(_mm_loadu_si128((__m128i*)&dst[i+16]), _mm_loadu_si128((__m128i*)&src[i+16]));
+        __m128i c = _mm_or_si128(_mm_loadu_si128((__m128i*)&dst[i+32]), _mm_loadu_si128((__m128i*)&src[i+32]));
+        __m128i d = _mm_or_si128(_mm_loadu_si128((__m128i*)&dst[i+48]), _mm_loadu_si128((__m128i*)&src[i+48]));
+        _mm_storeu_si128((__m128i*)&dst[i+0], a);
+        _mm_storeu_si128((__m128i*)&dst[i+16], b);
+        _mm_storeu_si128((__m128i*)&dst[i+32], c);
+        _mm_storeu_si128((__m128i*)&dst[i+48], d);
+    }
+#elif defined(__ARM_NEON)
+    for (u32 i = 0; i < len; i += 64)
+    {
+        uint8x16x4_t a = vld1q_u8_x4(&dst[i]);
+        uint8x16x4_t b = vld1q_u8_x4(&src[i]);
+        a.val[0] = vorrq_u8(a.val[0], b.val[0]);
+        a.val[1] = vorrq_u8(a.val[1], b.val[1]);
+        a.val[2] = vorrq_u8(a.val[2], b.val[2]);
+        a.val[3] = vorrq_u8(a.val[3], b.val[3]);
+        vst1q_u8_x4(&dst[i], a);
+    }
+#else
+    for (u32 i = 0; i < len; i += 8)
+        *(u64*)&dst[i] |= *(u64*)&src[i];
+#endif
+}
+
 template <u32 MappingGranularity, u32 Size>
-inline bool CopyLinearVRAM(u8* flat, u32* mappings, NonStupidBitField<Size>& dirty, u64 (*slowAccess)(u32 addr))
+inline bool CopyLinearVRAM(u8* flat, u32* mappings, NonStupidBitField<Size>& dirty)
 {
     const u32 VRAMBitsPerMapping = MappingGranularity / VRAMDirtyGranularity;
 
     bool change = false;
 
-    typename NonStupidBitField<Size>::Iterator it = dirty.Begin();
-    while (it != dirty.End())
+    u32 start = 0;
+    while (start < Size)
     {
-        u32 offset = *it * VRAMDirtyGranularity;
+        u64 bits = dirty.Data[start >> 6] >> (start & 0x3F);
+        if (!bits)
+        {
+            start = (start & ~0x3F) + 64;
+            continue;
+        }
+        start += __builtin_ctzll(bits);
+
+        // consecutive dirty blocks are copied at once, as long
+        // as they're mapped to the same banks. Every bank is
+        // at least as large as the mapping granularity, so
+        // the blocks are contiguous within each of them
+        u32 mappingEnd = (start / VRAMBitsPerMapping + 1) * VRAMBitsPerMapping;
+        u32 end = start;
+        while (end < mappingEnd)
+        {
+            u64 clean = ~dirty.Data[end >> 6] >> (end & 0x3F);
+            if (clean)
+            {
+                end += __builtin_ctzll(clean);
+                break;
+            }
+            end = (end & ~0x3F) + 64;
+        }
+        if (end > mappingEnd) end = mappingEnd;
+
+        u32 offset = start * VRAMDirtyGranularity;
+        u32 len = (end - start) * VRAMDirtyGranularity;
         u8* dst = flat + offset;
-        u8* fastAccess = GetUniqueBankPtr(mappings[*it / VRAMBitsPerMapping], offset);
-        if (fastAccess)
+        u32 mapping = mappings[start / VRAMBitsPerMapping];
+
+        if (!mapping)
         {
-            memcpy(dst, fastAccess, VRAMDirtyGranularity);
+            memset(dst, 0, len);
         }
         else
         {
-            for (u32 i = 0; i < VRAMDirtyGranularity; i += 8)
-                *(u64*)&dst[i] = slowAccess(offset + i);
+            // if several banks are mapped to the same place
+            // their contents are ORed together
+            u32 num = __builtin_ctz(mapping);
+            mapping &= ~(1 << num);
+            memcpy(dst, &VRAM[num][offset & VRAMMask[num]], len);
+
+            while (mapping != 0)
+            {
+                num = __builtin_ctz(mapping);
+                mapping &= ~(1 << num);
+                OrVRAMBlock(dst, &VRAM[num][offset & VRAMMask[num]], len);
+            }
         }
+
         change = true;
-        it++;
+        start = end;
     }
     return change;
 }
 
 bool MakeVRAMFlat_TextureCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<128*1024>(VRAMFlat_Texture, VRAMMap_Texture, dirty, ReadVRAM_Texture<u64>);
+    return CopyLinearVRAM<128*1024>(VRAMFlat_Texture, VRAMMap_Texture, dirty);
 }
 bool MakeVRAMFlat_TexPalCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_TexPal, VRAMMap_TexPal, dirty, ReadVRAM_TexPal<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_TexPal, VRAMMap_TexPal, dirty);
 }
 
 bool MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty, ReadVRAM_ABG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty);
 }
 bool MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty, ReadVRAM_BBG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty);
 }
 
 bool MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty, ReadVRAM_AOBJ<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty);
 }
 bool MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty, ReadVRAM_BOBJ<u64>);
-}
-
-template<typename T>
-T ReadVRAM_ABGExtPal(u32 addr)
-{
-    u32 mask = VRAMMap_ABGExtPal[(addr >> 13) & 0x3];
-
-    T ret = 0;
-    if (mask & (1<<4)) ret |= *(T*)&VRAM_E[addr & 0x7FFF];
-    if (mask & (1<<5)) ret |= *(T*)&VRAM_F[addr & 0x3FFF];
-    if (mask & (1<<6)) ret |= *(T*)&VRAM_G[addr & 0x3FFF];
-
-    return ret;
-}
-
-template<typename T>
-T ReadVRAM_BBGExtPal(u32 addr)
-{
-    u32 mask = VRAMMap_BBGExtPal[(addr >> 13) & 0x3];
-
-    T ret = 0;
-    if (mask & (1<<7)) ret |= *(T*)&VRAM_H[addr & 0x7FFF];
-
-    return ret;
-}
-
-template<typename T>
-T ReadVRAM_AOBJExtPal(u32 addr)
-{
-    u32 mask = VRAMMap_AOBJExtPal;
-
-    T ret = 0;
-    if (mask & (1<<4)) ret |= *(T*)&VRAM_F[addr & 0x1FFF];
-    if (mask & (1<<5)) ret |= *(T*)&VRAM_G[addr & 0x1FFF];
-
-    return ret;
-}
-
-template<typename T>
-T ReadVRAM_BOBJExtPal(u32 addr)
-{
-    u32 mask = VRAMMap_BOBJExtPal;
-
-    T ret = 0;
-    if (mask & (1<<8)) ret |= *(T*)&VRAM_I[addr & 0x1FFF];
-
-    return ret;
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty);
 }
 
 bool MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty, ReadVRAM_ABGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty);
 }
 bool MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty, ReadVRAM_BBGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty);
 }
 
 bool MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty, ReadVRAM_AOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty);
 }
 bool MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty)
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty, ReadVRAM_BOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty);
 }
 
 }
@@ -92,15 +92,54 @@ extern std::unique_ptr<GPU2D::Renderer2D> GPU2D_Renderer;
 
 extern int Renderer;
 
+enum
+{
+    renderer2D_Soft = 0,
+    renderer2D_NeonSoft,
+    renderer2D_Deko,
+
+    renderer2D_Count
+};
+
+extern int CurRenderer2D;
+extern bool Deferred2D;
+extern bool Threaded2D;
+// set while the deferred 2D renderer has scanlines left to draw
+extern bool Deferred2DPending;
+
 const u32 VRAMDirtyGranularity = 512;
 
 extern NonStupidBitField<128*1024/VRAMDirtyGranularity> VRAMDirty[9];
 
+// incremented whenever a bank is written to and whenever
+// the VRAM mapping changes, so unchanged banks can be skipped
+extern u32 VRAMGeneration[9];
+extern u32 VRAMMapGeneration;
+
+inline void MarkVRAMDirty(u32 bank, u32 addr)
+{
+    VRAMDirty[bank][addr / VRAMDirtyGranularity] = true;
+    VRAMGeneration[bank]++;
+}
+
+inline void MarkVRAMDirtyRange(u32 bank, u32 addr, u32 len)
+{
+    u32 first = addr / VRAMDirtyGranularity;
+    u32 last = (addr + len - 1) / VRAMDirtyGranularity;
+    VRAMDirty[bank].SetRange(first, last - first + 1);
+    VRAMGeneration[bank]++;
+}
+
 template <u32 Size, u32 MappingGranularity>
 struct VRAMTrackingSet
 {
     u16 Mapping[Size / MappingGranularity];
 
+    // the generations which were seen the last time the state was derived
+    u32 MapGeneration;
+    u32 BankGeneration[9];
+    u16 MappedBanks;
+
     const u32 VRAMBitsPerMapping = MappingGranularity / VRAMDirtyGranularity;
 
     void Reset()
@@ -111,6 +150,8 @@ struct VRAMTrackingSet
             // so it will always be a mismatch => the bank will be completely invalidated
             Mapping[i] = 0x8000;
         }
+        MapGeneration = VRAMMapGeneration - 1;
+        MappedBanks = 0;
     }
     NonStupidBitField<Size/VRAMDirtyGranularity> DeriveState(u32* currentMappings);
 };
@@ -163,6 +204,7 @@ extern std::unique_ptr<GLCompositor> CurGLCompositor;
 struct RenderSettings
 {
     bool Soft_Threaded;
+    int Soft_NumThreads; // 0 = depending on the amount of cores
 
     int GL_ScaleFactor;
     bool GL_BetterPolygons;
@@ -182,8 +224,21 @@ void ResetRenderer();
 
 void SetRenderSettings(int renderer, RenderSettings& settings);
 
+bool IsRenderer2DAvailable(int renderer);
+int GetFastestRenderer2D();
+const char* GetRenderer2DName(int renderer);
+// renderers which aren't available (e.g. -1) are replaced with the fastest one
+// with deferred set the scanlines of a frame are drawn all at once
+// at the start of VBlank, with threaded set they're drawn on a separate
+// thread as they come in. Neither is done for the deko3d renderer
+// which already batches them by itself
+void SetRenderer2D(int renderer, bool deferred, bool threaded);
+
 
 u8* GetUniqueBankPtr(u32 mask, u32 offset);
+// returns the start of the 16KB page backing an ARM9 VRAM address if it's
+// backed by exactly one bank (the one accesses go to), otherwise NULL
+u8* GetVRAMPagePtr(u32 addr, u32& bank);
 
 void MapVRAM_AB(u32 bank, u8 cnt);
 void MapVRAM_CD(u32 bank, u8 cnt);
@@ -321,7 +376,7 @@ void WriteVRAM_LCDC(u32 addr, T val)
     if (VRAMMap_LCDC & (1<<bank))
     {
         *(T*)&VRAM[bank][addr] = val;
-        VRAMDirty[bank][addr / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(bank, addr);
     }
 }
 
@@ -353,37 +408,37 @@ void WriteVRAM_ABG(u32 addr, T val)
 
     if (mask & (1<<0))
     {
-        VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(0, addr & 0x1FFFF);
         *(T*)&VRAM_A[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<1))
     {
-        VRAMDirty[1][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(1, addr & 0x1FFFF);
         *(T*)&VRAM_B[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<2))
     {
-        VRAMDirty[2][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(2, addr & 0x1FFFF);
         *(T*)&VRAM_C[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<3))
     {
-        VRAMDirty[3][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(3, addr & 0x1FFFF);
         *(T*)&VRAM_D[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<4))
     {
-        VRAMDirty[4][(addr & 0xFFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(4, addr & 0xFFFF);
         *(T*)&VRAM_E[addr & 0xFFFF] = val;
     }
     if (mask & (1<<5))
     {
-        VRAMDirty[5][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(5, addr & 0x3FFF);
         *(T*)&VRAM_F[addr & 0x3FFF] = val;
     }
     if (mask & (1<<6))
     {
-        VRAMDirty[6][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(6, addr & 0x3FFF);
         *(T*)&VRAM_G[addr & 0x3FFF] = val;
     }
 }
@@ -414,27 +469,27 @@ void WriteVRAM_AOBJ(u32 addr, T val)
 
     if (mask & (1<<0))
     {
-        VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(0, addr & 0x1FFFF);
         *(T*)&VRAM_A[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<1))
     {
-        VRAMDirty[1][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(1, addr & 0x1FFFF);
         *(T*)&VRAM_B[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<4))
     {
-        VRAMDirty[4][(addr & 0xFFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(4, addr & 0xFFFF);
         *(T*)&VRAM_E[addr & 0xFFFF] = val;
     }
     if (mask & (1<<5))
     {
-        VRAMDirty[5][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(5, addr & 0x3FFF);
         *(T*)&VRAM_F[addr & 0x3FFF] = val;
     }
     if (mask & (1<<6))
     {
-        VRAMDirty[6][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(6, addr & 0x3FFF);
         *(T*)&VRAM_G[addr & 0x3FFF] = val;
     }
 }
@@ -463,17 +518,17 @@ void WriteVRAM_BBG(u32 addr, T val)
 
     if (mask & (1<<2))
     {
-        VRAMDirty[2][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(2, addr & 0x1FFFF);
         *(T*)&VRAM_C[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<7))
     {
-        VRAMDirty[7][(addr & 0x7FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(7, addr & 0x7FFF);
         *(T*)&VRAM_H[addr & 0x7FFF] = val;
     }
     if (mask & (1<<8))
     {
-        VRAMDirty[8][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(8, addr & 0x3FFF);
         *(T*)&VRAM_I[addr & 0x3FFF] = val;
     }
 }
@@ -501,12 +556,12 @@ void WriteVRAM_BOBJ(u32 addr, T val)
 
     if (mask & (1<<3))
     {
-        VRAMDirty[3][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(3, addr & 0x1FFFF);
         *(T*)&VRAM_D[addr & 0x1FFFF] = val;
     }
     if (mask & (1<<8))
     {
-        VRAMDirty[8][(addr & 0x3FFF) / VRAMDirtyGranularity] = true;
+        MarkVRAMDirty(8, addr & 0x3FFF);
         *(T*)&VRAM_I[addr & 0x3FFF] = val;
     }
 }
@@ -592,6 +647,9 @@ void WritePalette(u32 addr, T val)
 
     *(T*)&Palette[addr] = val;
     PaletteDirty |= 1 << (addr / VRAMDirtyGranularity);
+
+    if (Deferred2D)
+        GPU2D_Renderer->PaletteWritten(addr, sizeof(T));
 }
 
 template<typename T>
@@ -607,6 +665,9 @@ void WriteOAM(u32 addr, T val)
 
     *(T*)&OAM[addr] = val;
     OAMDirty |= 1 << (addr / 1024);
+
+    if (Deferred2D)
+        GPU2D_Renderer->OAMWritten(addr, sizeof(T));
 }
 
 void SetPowerCnt(u32 val);
@@ -136,6 +136,8 @@ void Unit::Reset()
     CaptureLatch = false;
 
     MasterBrightness = 0;
+
+    ReloadMask = 0;
 }
 
 void Unit::DoSavestate(Savestate* file)
@@ -420,21 +422,21 @@ void Unit::Write16(u32 addr, u16 val)
     case 0x026: BGRotD[0] = val; return;
     case 0x028:
         BGXRef[0] = (BGXRef[0] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+        if (GPU::VCount < 192) ReloadBGXRef(0);
         return;
     case 0x02A:
         if (val & 0x0800) val |= 0xF000;
         BGXRef[0] = (BGXRef[0] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+        if (GPU::VCount < 192) ReloadBGXRef(0);
         return;
     case 0x02C:
         BGYRef[0] = (BGYRef[0] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+        if (GPU::VCount < 192) ReloadBGYRef(0);
         return;
     case 0x02E:
         if (val & 0x0800) val |= 0xF000;
         BGYRef[0] = (BGYRef[0] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+        if (GPU::VCount < 192) ReloadBGYRef(0);
         return;
 
     case 0x030: BGRotA[1] = val; return;
@@ -443,21 +445,21 @@ void Unit::Write16(u32 addr, u16 val)
     case 0x036: BGRotD[1] = val; return;
     case 0x038:
         BGXRef[1] = (BGXRef[1] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+        if (GPU::VCount < 192) ReloadBGXRef(1);
         return;
     case 0x03A:
         if (val & 0x0800) val |= 0xF000;
         BGXRef[1] = (BGXRef[1] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+        if (GPU::VCount < 192) ReloadBGXRef(1);
         return;
     case 0x03C:
         BGYRef[1] = (BGYRef[1] & 0xFFFF0000) | val;
-        if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+        if (GPU::VCount < 192) ReloadBGYRef(1);
         return;
     case 0x03E:
         if (val & 0x0800) val |= 0xF000;
         BGYRef[1] = (BGYRef[1] & 0xFFFF) | (val << 16);
-        if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+        if (GPU::VCount < 192) ReloadBGYRef(1);
         return;
 
     case 0x040:
@@ -541,23 +543,23 @@ void Unit::Write32(u32 addr, u32 val)
     case 0x028:
         if (val & 0x08000000) val |= 0xF0000000;
         BGXRef[0] = val;
-        if (GPU::VCount < 192) BGXRefInternal[0] = BGXRef[0];
+        if (GPU::VCount < 192) ReloadBGXRef(0);
         return;
     case 0x02C:
         if (val & 0x08000000) val |= 0xF0000000;
         BGYRef[0] = val;
-        if (GPU::VCount < 192) BGYRefInternal[0] = BGYRef[0];
+        if (GPU::VCount < 192) ReloadBGYRef(0);
         return;
 
     case 0x038:
         if (val & 0x08000000) val |= 0xF0000000;
         BGXRef[1] = val;
-        if (GPU::VCount < 192) BGXRefInternal[1] = BGXRef[1];
+        if (GPU::VCount < 192) ReloadBGXRef(1);
         return;
     case 0x03C:
         if (val & 0x08000000) val |= 0xF0000000;
         BGYRef[1] = val;
-        if (GPU::VCount < 192) BGYRefInternal[1] = BGYRef[1];
+        if (GPU::VCount < 192) ReloadBGYRef(1);
         return;
     }
 
@@ -594,16 +596,29 @@ void Unit::VBlank()
     DispFIFOWritePtr = 0;
 }
 
+void Unit::ReloadBGXRef(u32 num)
+{
+    BGXRefInternal[num] = BGXRef[num];
+    ReloadMask |= reload_BGXRef0 << num;
+}
+
+void Unit::ReloadBGYRef(u32 num)
+{
+    BGYRefInternal[num] = BGYRef[num];
+    ReloadMask |= reload_BGYRef0 << num;
+}
+
 void Unit::VBlankEnd()
 {
     // TODO: find out the exact time this happens
-    BGXRefInternal[0] = BGXRef[0];
-    BGXRefInternal[1] = BGXRef[1];
-    BGYRefInternal[0] = BGYRef[0];
-    BGYRefInternal[1] = BGYRef[1];
+    ReloadBGXRef(0);
+    ReloadBGXRef(1);
+    ReloadBGYRef(0);
+    ReloadBGYRef(1);
 
     BGMosaicY = 0;
     BGMosaicYMax = BGMosaicSize[1];
+    ReloadMask |= reload_BGMosaic;
     //OBJMosaicY = 0;
     //OBJMosaicYMax = OBJMosaicSize[1];
     //OBJMosaicY = 0;
@@ -721,4 +736,11 @@ void Unit::GetOBJVRAM(u8*& data, u32& mask)
     }
 }
 
-}
\ No newline at end of file
+Renderer2D::Renderer2D()
+{
+    PaletteMem = GPU::AllPaletteMemory;
+    OAMMem = GPU::OAM;
+    OAMDirtyMem = &GPU::OAMDirty;
+}
+
+}
@@ -32,7 +32,8 @@ public:
     Unit(u32 num);
 
     Unit(const Unit&) = delete;
-    Unit& operator=(const Unit&) = delete;
+    // the deferred renderer keeps copies of the register state
+    Unit& operator=(const Unit&) = default;
 
     void Reset();
 
@@ -70,6 +71,9 @@ public:
     void GetBGVRAM(u8*& data, u32& mask);
     void GetOBJVRAM(u8*& data, u32& mask);
 
+    void ReloadBGXRef(u32 num);
+    void ReloadBGYRef(u32 num);
+
     void UpdateMosaicCounters(u32 line);
     void CalculateWindowMask(u32 line, u8* windowMask, u8* objWindow);
 
@@ -117,33 +121,82 @@ public:
     u32 CaptureCnt;
 
     u16 MasterBrightness;
+
+    // the internal affine references and the BG mosaic counter are advanced
+    // by the renderer from one scanline to the next. Whenever they are
+    // reloaded instead the respective bit is set, so that the deferred
+    // renderer knows which of its own copies are outdated
+    enum
+    {
+        reload_BGXRef0 = 1 << 0,
+        reload_BGXRef1 = 1 << 1,
+        reload_BGYRef0 = 1 << 2,
+        reload_BGYRef1 = 1 << 3,
+        reload_BGMosaic = 1 << 4,
+    };
+    u32 ReloadMask;
 };
 
 class Renderer2D
 {
 public:
+    Renderer2D();
     virtual ~Renderer2D() {}
 
     virtual void Reset() = 0;
 
-    virtual void DrawScanline(u32 line, Unit* unit) = 0;
+    // vcount is the value of VCOUNT during the scanline, which can differ
+    // from line if the game wrote to it
+    virtual void DrawScanline(u32 line, u32 vcount, Unit* unit) = 0;
     virtual void DrawSprites(u32 line, Unit* unit) = 0;
 
     virtual void VBlankEnd(Unit* unitA, Unit* unitB) = 0;
 
-    void SetFramebuffer(bool unitAIsTop)
+    // finishes all scanlines whose drawing was put off
+    virtual void Flush() {}
+
+    // called after the emulation wrote to palette or OAM
+    virtual void PaletteWritten(u32 addr, u32 size) {}
+    virtual void OAMWritten(u32 addr, u32 size) {}
+    // palette, OAM and the flattened VRAM were replaced as a whole
+    virtual void MemoryReloaded() {}
+    // parts of the flattened BG VRAM of a unit were updated, dirty
+    // has one bit per GPU::VRAMDirtyGranularity bytes
+    virtual void BGVRAMUpdated(u32 num, u64* dirty) {}
+
+    virtual void SetFramebuffer(bool unitAIsTop)
     {
         UnitAIsTop = unitAIsTop;
     }
-    void SetFramebuffer(u32* unitA, u32* unitB)
+    virtual void SetFramebuffer(u32* unitA, u32* unitB)
     {
         Framebuffer[0] = unitA;
         Framebuffer[1] = unitB;
     }
+
+    // when set the flattened VRAM is kept up to date by the caller
+    void SetExternalVRAMSync(bool external)
+    {
+        ExternalVRAMSync = external;
+    }
+
+    // palette is laid out like GPU::AllPaletteMemory
+    void SetMemory(u8* palette, u8* oam, u32* oamDirty)
+    {
+        PaletteMem = palette;
+        OAMMem = oam;
+        OAMDirtyMem = oamDirty;
+    }
 protected:
     bool UnitAIsTop;
     u32* Framebuffer[2];
 
+    bool ExternalVRAMSync = false;
+
+    u8* PaletteMem;
+    u8* OAMMem;
+    u32* OAMDirtyMem;
+
     Unit* CurUnit;
 };
 
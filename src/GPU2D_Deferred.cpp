@@ -0,0 +1,386 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include <functional>
+#include "GPU2D_Deferred.h"
+#include "GPU3D.h"
+
+namespace GPU2D
+{
+
+// copies the state the renderer advances by itself
+// from src to dst, except for the parts which were reloaded
+void CarryState(Unit& dst, const Unit& src, u32 reload)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (!(reload & (Unit::reload_BGXRef0 << i)))
+            dst.BGXRefInternal[i] = src.BGXRefInternal[i];
+        if (!(reload & (Unit::reload_BGYRef0 << i)))
+            dst.BGYRefInternal[i] = src.BGYRefInternal[i];
+    }
+
+    if (!(reload & Unit::reload_BGMosaic))
+    {
+        dst.BGMosaicY = src.BGMosaicY;
+        dst.BGMosaicYMax = src.BGMosaicYMax;
+    }
+
+    dst.OBJMosaicY = src.OBJMosaicY;
+    dst.OBJMosaicYCount = src.OBJMosaicYCount;
+
+    // the vertical window state is kept by the unit, the horizontal one by the renderer
+    dst.Win0Active = (dst.Win0Active & 0x1) | (src.Win0Active & 0x2);
+    dst.Win1Active = (dst.Win1Active & 0x1) | (src.Win1Active & 0x2);
+}
+
+
+DeferredRenderer::DeferredRenderer(std::unique_ptr<Renderer2D> renderer, bool threaded)
+    : Renderer2D(), Renderer(std::move(renderer))
+{
+    PaletteCopy = std::make_unique<u8[]>(sizeof(GPU::AllPaletteMemory));
+
+    Renderer->SetExternalVRAMSync(true);
+    Renderer->SetMemory(PaletteCopy.get(), OAMCopy, &OAMCopyDirty);
+
+    Commands = std::make_unique<Command[]>(MaxCommands);
+    CommandsSubmitted = 0;
+    CommandsDrawn = 0;
+
+    Writes = std::make_unique<MemoryWrite[]>(MaxWrites);
+    WritesSubmitted = 0;
+    WritesDone = 0;
+
+    Units[0] = nullptr;
+    Units[1] = nullptr;
+    WorkValid[0] = false;
+    WorkValid[1] = false;
+
+    Threaded = threaded;
+    RenderThreadRunning = false;
+    SyncRequested = false;
+    if (Threaded)
+    {
+        Sema_Work = Platform::Semaphore_Create();
+        Sema_Idle = Platform::Semaphore_Create();
+
+        RenderThreadRunning = true;
+        RenderThread = Platform::Thread_Create(std::bind(&DeferredRenderer::RenderThreadFunc, this));
+    }
+
+    MemoryReloaded();
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+    if (Threaded)
+    {
+        RenderThreadRunning = false;
+        Platform::Semaphore_Post(Sema_Work);
+        Platform::Thread_Wait(RenderThread);
+        Platform::Thread_Free(RenderThread);
+
+        Platform::Semaphore_Free(Sema_Work);
+        Platform::Semaphore_Free(Sema_Idle);
+    }
+}
+
+void DeferredRenderer::Reset()
+{
+    Flush();
+
+    WorkValid[0] = false;
+    WorkValid[1] = false;
+
+    Renderer->Reset();
+}
+
+void DeferredRenderer::MemoryReloaded()
+{
+    Flush();
+
+    memcpy(PaletteCopy.get(), GPU::AllPaletteMemory, sizeof(GPU::AllPaletteMemory));
+    memcpy(OAMCopy, GPU::OAM, sizeof(OAMCopy));
+    OAMCopyDirty = 0x3;
+}
+
+void DeferredRenderer::SyncBGVRAM(u32 num)
+{
+    // the outstanding scanlines have to be drawn with
+    // the old contents before the flattened VRAM is updated
+    u8* bgExtPal;
+    u8* objExtPal;
+    bool bgExtPalChanged, objExtPalChanged;
+    if (num == 0)
+    {
+        auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
+        auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
+        auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
+        if (bgDirty || bgExtPalDirty || objExtPalDirty)
+            Flush();
+        if (GPU::MakeVRAMFlat_ABGCoherent(bgDirty))
+            Renderer->BGVRAMUpdated(0, bgDirty.Data);
+        bgExtPalChanged = GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
+        objExtPalChanged = GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
+        bgExtPal = GPU::VRAMFlat_ABGExtPal;
+        objExtPal = GPU::VRAMFlat_AOBJExtPal;
+    }
+    else
+    {
+        auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
+        auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
+        auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
+        if (bgDirty || bgExtPalDirty || objExtPalDirty)
+            Flush();
+        if (GPU::MakeVRAMFlat_BBGCoherent(bgDirty))
+            Renderer->BGVRAMUpdated(1, bgDirty.Data);
+        bgExtPalChanged = GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
+        objExtPalChanged = GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        bgExtPal = GPU::VRAMFlat_BBGExtPal;
+        objExtPal = GPU::VRAMFlat_BOBJExtPal;
+    }
+
+    // the copy of the palette memory includes the extended palettes
+    if (bgExtPalChanged)
+        memcpy(&PaletteCopy[bgExtPal - GPU::AllPaletteMemory], bgExtPal, GPU::BGExtPalSize);
+    if (objExtPalChanged)
+        memcpy(&PaletteCopy[objExtPal - GPU::AllPaletteMemory], objExtPal, GPU::OBJExtPalSize);
+}
+
+void DeferredRenderer::SyncOBJVRAM(u32 num)
+{
+    if (num == 0)
+    {
+        auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
+        if (objDirty)
+            Flush();
+        GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
+    }
+    else
+    {
+        auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
+        if (objDirty)
+            Flush();
+        GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
+    }
+}
+
+void DeferredRenderer::Record(bool sprites, u32 line, u32 vcount, Unit* unit)
+{
+    u32 num = CommandsSubmitted.load(std::memory_order_relaxed);
+    if (num - CommandsDrawn.load(std::memory_order_acquire) == MaxCommands)
+        Flush();
+
+    Command& cmd = Commands[num % MaxCommands];
+    cmd.Sprites = sprites;
+    cmd.Line = line;
+    cmd.VCount = vcount;
+    cmd.State = *unit;
+
+    unit->ReloadMask = 0;
+    GPU::Deferred2DPending = true;
+
+    CommandsSubmitted.store(num + 1, std::memory_order_release);
+    if (Threaded)
+        Platform::Semaphore_Post(Sema_Work);
+}
+
+void DeferredRenderer::DrawScanline(u32 line, u32 vcount, Unit* unit)
+{
+    Units[unit->Num] = unit;
+    SyncBGVRAM(unit->Num);
+
+    // display capture writes to VRAM and VRAM display reads from
+    // VRAM which isn't flattened, so those are drawn right away.
+    // Same for the 3D layer of the OpenGL renderer, which
+    // can only be read on the emulation thread.
+    // A capture is latched on line 0, so that's where it can start
+    if (unit->Num == 0 &&
+        (unit->CaptureLatch || (vcount == 0 && (unit->CaptureCnt & (1<<31))) ||
+        ((unit->DispCnt >> 16) & 0x3) == 2 ||
+        (Threaded && GPU3D::CurrentRenderer->Accelerated)))
+    {
+        Flush();
+        Renderer->DrawScanline(line, vcount, unit);
+        return;
+    }
+
+    Record(false, line, vcount, unit);
+}
+
+void DeferredRenderer::DrawSprites(u32 line, Unit* unit)
+{
+    Units[unit->Num] = unit;
+    SyncOBJVRAM(unit->Num);
+
+    Record(true, line, 0, unit);
+}
+
+void DeferredRenderer::VBlankEnd(Unit* unitA, Unit* unitB)
+{
+    Renderer->VBlankEnd(unitA, unitB);
+}
+
+void DeferredRenderer::QueueWrite(u8* dst, u8* src, u32 size)
+{
+    MemoryWrite write;
+    write.Dst = dst;
+    write.Size = size;
+    memcpy(&write.Val, src, size);
+
+    u32 num = WritesSubmitted.load(std::memory_order_relaxed);
+    if (GPU::Deferred2DPending && num - WritesDone.load(std::memory_order_acquire) == MaxWrites)
+        Flush();
+
+    if (!GPU::Deferred2DPending)
+    {
+        // nothing is drawn which could still need the old contents
+        DoWrite(write);
+        return;
+    }
+
+    write.Command = CommandsSubmitted.load(std::memory_order_relaxed);
+    Writes[num % MaxWrites] = write;
+    WritesSubmitted.store(num + 1, std::memory_order_release);
+}
+
+void DeferredRenderer::PaletteWritten(u32 addr, u32 size)
+{
+    QueueWrite(&PaletteCopy[addr], &GPU::Palette[addr], size);
+}
+
+void DeferredRenderer::OAMWritten(u32 addr, u32 size)
+{
+    QueueWrite(&OAMCopy[addr], &GPU::OAM[addr], size);
+}
+
+void DeferredRenderer::DoWrite(MemoryWrite& write)
+{
+    memcpy(write.Dst, &write.Val, write.Size);
+
+    if (write.Dst >= OAMCopy && write.Dst < OAMCopy + sizeof(OAMCopy))
+        OAMCopyDirty |= 1 << ((write.Dst - OAMCopy) / 1024);
+}
+
+void DeferredRenderer::Draw(Command& cmd)
+{
+    u32 num = cmd.State.Num;
+    if (WorkValid[num])
+        CarryState(cmd.State, Work[num], cmd.State.ReloadMask);
+
+    Work[num] = cmd.State;
+    WorkValid[num] = true;
+
+    if (cmd.Sprites)
+        Renderer->DrawSprites(cmd.Line, &Work[num]);
+    else
+        Renderer->DrawScanline(cmd.Line, cmd.VCount, &Work[num]);
+}
+
+void DeferredRenderer::DrawSubmitted()
+{
+    // the writes which have to be done before a command
+    // are always submitted before the command itself
+    u32 numCommands = CommandsSubmitted.load(std::memory_order_acquire);
+    u32 numWrites = WritesSubmitted.load(std::memory_order_acquire);
+
+    u32 write = WritesDone.load(std::memory_order_relaxed);
+    for (u32 i = CommandsDrawn.load(std::memory_order_relaxed); i != numCommands; i++)
+    {
+        while (write != numWrites && (s32)(Writes[write % MaxWrites].Command - i) <= 0)
+            DoWrite(Writes[write++ % MaxWrites]);
+
+        Draw(Commands[i % MaxCommands]);
+
+        WritesDone.store(write, std::memory_order_release);
+        CommandsDrawn.store(i + 1, std::memory_order_release);
+    }
+}
+
+void DeferredRenderer::RenderThreadFunc()
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_Work);
+        if (!RenderThreadRunning) return;
+
+        DrawSubmitted();
+
+        if (SyncRequested.load(std::memory_order_acquire))
+        {
+            // the emulation thread is waiting for us, so
+            // what's submitted at this point is everything
+            DrawSubmitted();
+            SyncRequested.store(false, std::memory_order_release);
+            Platform::Semaphore_Post(Sema_Idle);
+        }
+    }
+}
+
+void DeferredRenderer::Flush()
+{
+    if (!GPU::Deferred2DPending)
+        return;
+
+    if (Threaded)
+    {
+        if (CommandsDrawn.load(std::memory_order_acquire) != CommandsSubmitted.load(std::memory_order_relaxed))
+        {
+            SyncRequested.store(true, std::memory_order_release);
+            Platform::Semaphore_Post(Sema_Work);
+            Platform::Semaphore_Wait(Sema_Idle);
+        }
+    }
+    else
+        DrawSubmitted();
+
+    // the writes after the last scanline
+    u32 numWrites = WritesSubmitted.load(std::memory_order_relaxed);
+    u32 write = WritesDone.load(std::memory_order_acquire);
+    while (write != numWrites)
+        DoWrite(Writes[write++ % MaxWrites]);
+    WritesDone.store(write, std::memory_order_relaxed);
+
+    GPU::Deferred2DPending = false;
+
+    // hand the advanced state back, so that it's up to date
+    // for savestates and scanlines which are drawn right away
+    for (int i = 0; i < 2; i++)
+    {
+        if (WorkValid[i])
+            CarryState(*Units[i], Work[i], Units[i]->ReloadMask);
+        WorkValid[i] = false;
+    }
+}
+
+void DeferredRenderer::SetFramebuffer(bool unitAIsTop)
+{
+    Flush();
+    Renderer2D::SetFramebuffer(unitAIsTop);
+    Renderer->SetFramebuffer(unitAIsTop);
+}
+
+void DeferredRenderer::SetFramebuffer(u32* unitA, u32* unitB)
+{
+    Flush();
+    Renderer2D::SetFramebuffer(unitA, unitB);
+    Renderer->SetFramebuffer(unitA, unitB);
+}
+
+}
@@ -0,0 +1,131 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+
+#pragma once
+
+#include <memory>
+#include <atomic>
+
+#include "GPU2D.h"
+#include "GPU.h"
+#include "Platform.h"
+
+namespace GPU2D
+{
+
+// instead of drawing every scanline as soon as it's due, copies of the
+// register state are queued and drawn by the wrapped renderer, either all at
+// once at the start of VBlank or continuously on a separate thread.
+//
+// The wrapped renderer reads palette and OAM from copies which writes are
+// queued for, so that every scanline sees them like at the time it was due.
+// The flattened VRAM isn't copied, a change to the VRAM used for 2D draws
+// the outstanding scanlines first.
+class DeferredRenderer : public Renderer2D
+{
+public:
+    DeferredRenderer(std::unique_ptr<Renderer2D> renderer, bool threaded);
+    ~DeferredRenderer() override;
+
+    void Reset() override;
+
+    void DrawScanline(u32 line, u32 vcount, Unit* unit) override;
+    void DrawSprites(u32 line, Unit* unit) override;
+
+    void VBlankEnd(Unit* unitA, Unit* unitB) override;
+
+    void Flush() override;
+
+    void PaletteWritten(u32 addr, u32 size) override;
+    void OAMWritten(u32 addr, u32 size) override;
+    void MemoryReloaded() override;
+
+    void SetFramebuffer(bool unitAIsTop) override;
+    void SetFramebuffer(u32* unitA, u32* unitB) override;
+
+private:
+    struct Command
+    {
+        bool Sprites;
+        u32 Line;
+        u32 VCount;
+        Unit State {0};
+    };
+
+    struct MemoryWrite
+    {
+        // the number of the command it has to be done before
+        u32 Command;
+        u8* Dst;
+        u32 Size;
+        u32 Val;
+    };
+
+    static constexpr u32 MaxCommands = 1024;
+    static constexpr u32 MaxWrites = 16384;
+
+    std::unique_ptr<Renderer2D> Renderer;
+
+    // both are ring buffers, the counters only ever increase.
+    // The ones for submitting are only changed by the emulation thread,
+    // the ones for drawing by whoever draws
+    std::unique_ptr<Command[]> Commands;
+    std::atomic<u32> CommandsSubmitted;
+    std::atomic<u32> CommandsDrawn;
+
+    std::unique_ptr<MemoryWrite[]> Writes;
+    std::atomic<u32> WritesSubmitted;
+    std::atomic<u32> WritesDone;
+
+    // the copies of palette and OAM the wrapped renderer reads
+    std::unique_ptr<u8[]> PaletteCopy;
+    u8 OAMCopy[2*1024];
+    u32 OAMCopyDirty;
+
+    // the units the register state is copied from
+    Unit* Units[2];
+
+    // the copies the wrapped renderer draws with. What it advances from
+    // one scanline to the next is carried over from here
+    Unit Work[2] {0, 1};
+    bool WorkValid[2];
+
+    bool Threaded;
+    Platform::Thread* RenderThread;
+    std::atomic_bool RenderThreadRunning;
+    // set by the emulation thread when it waits for everything submitted
+    // to be drawn, cleared by the render thread once it's done
+    std::atomic<bool> SyncRequested;
+    Platform::Semaphore* Sema_Work;
+    Platform::Semaphore* Sema_Idle;
+
+    void RenderThreadFunc();
+
+    void SyncBGVRAM(u32 num);
+    void SyncOBJVRAM(u32 num);
+
+    void Record(bool sprites, u32 line, u32 vcount, Unit* unit);
+    void QueueWrite(u8* dst, u8* src, u32 size);
+
+    void DoWrite(MemoryWrite& write);
+    void DrawSubmitted();
+    void Draw(Command& cmd);
+};
+
+}
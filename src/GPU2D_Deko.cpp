@@ -292,12 +292,12 @@ void DekoRenderer::Reset()
     memset(OAMShadow, 0, sizeof(OAMShadow));
 }
 
-void DekoRenderer::DrawScanline(u32 line, Unit* unit)
+void DekoRenderer::DrawScanline(u32 line, u32 vcount, Unit* unit)
 {
     CurUnit = unit;
 
     int n3dline = line;
-    line = GPU::VCount;
+    line = vcount;
 
     int num = CurUnit->Num;
 
@@ -716,7 +716,7 @@ void DekoRenderer::DoCapture()
 
     static_assert(GPU::VRAMDirtyGranularity == 512, "");
     for (u32 i = 0; i < height; i++)
-        GPU::VRAMDirty[dstvram][(((dstaddr + i*256) * 2) & 0x1FFFF) / GPU::VRAMDirtyGranularity] = true;
+        GPU::MarkVRAMDirty(dstvram, ((dstaddr + i*256) * 2) & 0x1FFFF);
 
     u32 eva = CaptureCnt & 0x1F;
     u32 evb = (CaptureCnt >> 8) & 0x1F;
@@ -19,7 +19,7 @@ public:
 
     void Reset() override;
 
-    void DrawScanline(u32 line, Unit* unit) override;
+    void DrawScanline(u32 line, u32 vcount, Unit* unit) override;
     void DrawSprites(u32 line, Unit* unit) override;
 
     void VBlankEnd(Unit* unitA, Unit* unitB) override;
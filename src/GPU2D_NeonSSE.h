@@ -0,0 +1,295 @@
+#ifndef GPU2D_NEONSSE
+#define GPU2D_NEONSSE
+
+/*
+    the subset of NEON intrinsics used by the NEON 2D renderer,
+    implemented with SSE4.1 so that it can be used on x86_64 hosts as well
+
+    vector types are GCC vector extensions, so most of the arithmetic is
+    left to the compiler. The 64-bit vectors live in the lower half
+    of an XMM register
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <smmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+typedef uint8_t uint8x16_t __attribute__((vector_size(16)));
+typedef uint8_t uint8x8_t __attribute__((vector_size(8)));
+typedef uint16_t uint16x8_t __attribute__((vector_size(16)));
+typedef uint16_t uint16x4_t __attribute__((vector_size(8)));
+typedef int16_t int16x8_t __attribute__((vector_size(16)));
+typedef int16_t int16x4_t __attribute__((vector_size(8)));
+typedef uint32_t uint32x4_t __attribute__((vector_size(16)));
+typedef uint32_t uint32x2_t __attribute__((vector_size(8)));
+typedef int32_t int32x4_t __attribute__((vector_size(16)));
+typedef uint64_t uint64x2_t __attribute__((vector_size(16)));
+typedef uint64_t uint64x1_t __attribute__((vector_size(8)));
+
+struct uint8x16x2_t { uint8x16_t val[2]; };
+struct uint8x16x4_t { uint8x16_t val[4]; };
+struct uint8x8x2_t { uint8x8_t val[2]; };
+struct uint8x8x4_t { uint8x8_t val[4]; };
+struct uint16x8x2_t { uint16x8_t val[2]; };
+struct uint16x8x4_t { uint16x8_t val[4]; };
+struct int32x4x4_t { int32x4_t val[4]; };
+
+#define N_ALWAYS static inline __attribute__((always_inline))
+
+// only for taking the low part of a vector (or all of one of the same size)
+template <typename D, typename S> N_ALWAYS D n_cast(S s)
+{
+    static_assert(sizeof(D) <= sizeof(S), "n_cast can't widen");
+    D d; memcpy(&d, &s, sizeof(d)); return d;
+}
+N_ALWAYS __m128i n_m(uint8x16_t v) { return (__m128i)v; }
+// a 64-bit vector in the lower half of an XMM register, with the upper half cleared
+template <typename S> N_ALWAYS __m128i n_m64(S v)
+{
+    static_assert(sizeof(S) == 8, "n_m64 takes a 64-bit vector");
+    return _mm_loadl_epi64((const __m128i*)&v);
+}
+
+// dup
+N_ALWAYS uint8x16_t vdupq_n_u8(uint8_t x) { return (uint8x16_t){} + x; }
+N_ALWAYS uint8x8_t vdup_n_u8(uint8_t x) { return (uint8x8_t){} + x; }
+N_ALWAYS uint16x8_t vdupq_n_u16(uint16_t x) { return (uint16x8_t){} + x; }
+N_ALWAYS int16x8_t vdupq_n_s16(int16_t x) { return (int16x8_t){} + x; }
+N_ALWAYS int32x4_t vdupq_n_s32(int32_t x) { return (int32x4_t){} + x; }
+N_ALWAYS uint64x2_t vdupq_n_u64(uint64_t x) { return (uint64x2_t){} + x; }
+N_ALWAYS uint64x1_t vdup_n_u64(uint64_t x) { return (uint64x1_t){x}; }
+
+// reinterpret
+#define N_REINT(name, D, S) N_ALWAYS D name(S s) { return (D)s; }
+N_REINT(vreinterpretq_u8_u64, uint8x16_t, uint64x2_t)
+N_REINT(vreinterpretq_u64_u8, uint64x2_t, uint8x16_t)
+N_REINT(vreinterpretq_u8_u32, uint8x16_t, uint32x4_t)
+N_REINT(vreinterpretq_u32_u8, uint32x4_t, uint8x16_t)
+N_REINT(vreinterpretq_u8_u16, uint8x16_t, uint16x8_t)
+N_REINT(vreinterpretq_u16_u8, uint16x8_t, uint8x16_t)
+N_REINT(vreinterpretq_u32_s32, uint32x4_t, int32x4_t)
+N_REINT(vreinterpretq_s32_u32, int32x4_t, uint32x4_t)
+N_REINT(vreinterpretq_u16_s16, uint16x8_t, int16x8_t)
+N_REINT(vreinterpret_u8_u64, uint8x8_t, uint64x1_t)
+N_REINT(vreinterpret_u64_u8, uint64x1_t, uint8x8_t)
+N_REINT(vreinterpret_u8_u32, uint8x8_t, uint32x2_t)
+N_REINT(vreinterpret_u32_u8, uint32x2_t, uint8x8_t)
+
+// halves
+N_ALWAYS uint8x8_t vget_low_u8(uint8x16_t v) { return n_cast<uint8x8_t>(v); }
+N_ALWAYS uint16x4_t vget_low_u16(uint16x8_t v) { return n_cast<uint16x4_t>(v); }
+N_ALWAYS uint8x16_t vcombine_u8(uint8x8_t lo, uint8x8_t hi) { return (uint8x16_t)_mm_unpacklo_epi64(n_m64(lo), n_m64(hi)); }
+N_ALWAYS uint16x8_t n_combine_u16(uint16x4_t lo, uint16x4_t hi) { return (uint16x8_t)_mm_unpacklo_epi64(n_m64(lo), n_m64(hi)); }
+N_ALWAYS int16x8_t n_combine_s16(int16x4_t lo, int16x4_t hi) { return (int16x8_t)_mm_unpacklo_epi64(n_m64(lo), n_m64(hi)); }
+
+// logic
+N_ALWAYS uint8x16_t vandq_u8(uint8x16_t a, uint8x16_t b) { return a & b; }
+N_ALWAYS uint8x8_t vand_u8(uint8x8_t a, uint8x8_t b) { return a & b; }
+N_ALWAYS uint16x8_t vandq_u16(uint16x8_t a, uint16x8_t b) { return a & b; }
+N_ALWAYS int32x4_t vandq_s32(int32x4_t a, int32x4_t b) { return a & b; }
+N_ALWAYS uint8x16_t vorrq_u8(uint8x16_t a, uint8x16_t b) { return a | b; }
+N_ALWAYS uint8x8_t vorr_u8(uint8x8_t a, uint8x8_t b) { return a | b; }
+N_ALWAYS uint16x8_t vorrq_u16(uint16x8_t a, uint16x8_t b) { return a | b; }
+N_ALWAYS uint32x4_t vorrq_u32(uint32x4_t a, uint32x4_t b) { return a | b; }
+N_ALWAYS int32x4_t vorrq_s32(int32x4_t a, int32x4_t b) { return a | b; }
+N_ALWAYS uint8x16_t vbicq_u8(uint8x16_t a, uint8x16_t b) { return a & ~b; }
+N_ALWAYS uint8x8_t vbic_u8(uint8x8_t a, uint8x8_t b) { return a & ~b; }
+N_ALWAYS uint8x16_t vornq_u8(uint8x16_t a, uint8x16_t b) { return a | ~b; }
+N_ALWAYS uint8x16_t vmvnq_u8(uint8x16_t a) { return ~a; }
+N_ALWAYS uint8x16_t vbslq_u8(uint8x16_t m, uint8x16_t a, uint8x16_t b) { return (m & a) | (~m & b); }
+N_ALWAYS uint8x8_t vbsl_u8(uint8x8_t m, uint8x8_t a, uint8x8_t b) { return (m & a) | (~m & b); }
+N_ALWAYS uint16x8_t vbslq_u16(uint16x8_t m, uint16x8_t a, uint16x8_t b) { return (m & a) | (~m & b); }
+
+// compare
+N_ALWAYS uint8x16_t vtstq_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)((a & b) != 0); }
+N_ALWAYS uint8x8_t vtst_u8(uint8x8_t a, uint8x8_t b) { return (uint8x8_t)((a & b) != 0); }
+N_ALWAYS uint16x8_t vtstq_u16(uint16x8_t a, uint16x8_t b) { return (uint16x8_t)((a & b) != 0); }
+N_ALWAYS uint32x4_t vtstq_u32(uint32x4_t a, uint32x4_t b) { return (uint32x4_t)((a & b) != 0); }
+N_ALWAYS uint8x16_t vceqq_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)(a == b); }
+N_ALWAYS uint8x16_t vceqzq_u8(uint8x16_t a) { return (uint8x16_t)(a == 0); }
+N_ALWAYS uint8x8_t vceqz_u8(uint8x8_t a) { return (uint8x8_t)(a == 0); }
+N_ALWAYS uint16x8_t vceqzq_u16(uint16x8_t a) { return (uint16x8_t)(a == 0); }
+N_ALWAYS uint8x16_t vcltq_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)(a < b); }
+N_ALWAYS uint8x16_t vcleq_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)(a <= b); }
+N_ALWAYS uint8x16_t vcgeq_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)(a >= b); }
+N_ALWAYS uint16x8_t vcgeq_u16(uint16x8_t a, uint16x8_t b) { return (uint16x8_t)(a >= b); }
+
+// arithmetic
+N_ALWAYS uint8x16_t vaddq_u8(uint8x16_t a, uint8x16_t b) { return a + b; }
+N_ALWAYS uint8x8_t vadd_u8(uint8x8_t a, uint8x8_t b) { return a + b; }
+N_ALWAYS uint16x8_t vaddq_u16(uint16x8_t a, uint16x8_t b) { return a + b; }
+N_ALWAYS int32x4_t vaddq_s32(int32x4_t a, int32x4_t b) { return a + b; }
+N_ALWAYS uint8x16_t vsubq_u8(uint8x16_t a, uint8x16_t b) { return a - b; }
+N_ALWAYS uint16x8_t vsubq_u16(uint16x8_t a, uint16x8_t b) { return a - b; }
+N_ALWAYS uint16x8_t vmulq_u16(uint16x8_t a, uint16x8_t b) { return a * b; }
+N_ALWAYS int32x4_t vmulq_s32(int32x4_t a, int32x4_t b) { return a * b; }
+N_ALWAYS uint16x8_t vminq_u16(uint16x8_t a, uint16x8_t b) { return (uint16x8_t)_mm_min_epu16((__m128i)a, (__m128i)b); }
+N_ALWAYS uint16x8_t vmull_u8(uint8x8_t a, uint8x8_t b) { return __builtin_convertvector(a, uint16x8_t) * __builtin_convertvector(b, uint16x8_t); }
+N_ALWAYS uint16x8_t vmull_high_u8(uint8x16_t a, uint8x16_t b)
+{
+    return vmull_u8(n_cast<uint8x8_t>(_mm_unpackhi_epi64(n_m(a), n_m(a))), n_cast<uint8x8_t>(_mm_unpackhi_epi64(n_m(b), n_m(b))));
+}
+
+// reductions
+N_ALWAYS uint8_t vmaxvq_u8(uint8x16_t v)
+{
+    __m128i x = n_m(v);
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 8));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 4));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 2));
+    x = _mm_max_epu8(x, _mm_srli_si128(x, 1));
+    return _mm_cvtsi128_si32(x);
+}
+N_ALWAYS uint8_t vminvq_u8(uint8x16_t v)
+{
+    __m128i x = n_m(v);
+    x = _mm_min_epu8(x, _mm_srli_si128(x, 8));
+    x = _mm_min_epu8(x, _mm_srli_si128(x, 4));
+    x = _mm_min_epu8(x, _mm_srli_si128(x, 2));
+    x = _mm_min_epu8(x, _mm_srli_si128(x, 1));
+    return _mm_cvtsi128_si32(x);
+}
+
+// shifts
+#define vshlq_n_u8(a, n) ((uint8x16_t)((a) << (n)))
+#define vshl_n_u8(a, n) ((uint8x8_t)((a) << (n)))
+#define vshrq_n_u8(a, n) ((uint8x16_t)((a) >> (n)))
+#define vshr_n_u8(a, n) ((uint8x8_t)((a) >> (n)))
+#define vshlq_n_u16(a, n) ((uint16x8_t)((a) << (n)))
+#define vshrq_n_u16(a, n) ((uint16x8_t)((a) >> (n)))
+#define vshlq_n_s32(a, n) ((int32x4_t)((a) << (n)))
+#define vshrq_n_s32(a, n) ((int32x4_t)((a) >> (n)))
+N_ALWAYS int32x4_t vshlq_s32(int32x4_t a, int32x4_t b)
+{
+#ifdef __AVX2__
+    __m128i left = _mm_sllv_epi32((__m128i)a, (__m128i)b);
+    __m128i right = _mm_srav_epi32((__m128i)a, _mm_sub_epi32(_mm_setzero_si128(), (__m128i)b));
+    return (int32x4_t)_mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right), _mm_castsi128_ps((__m128i)b)));
+#else
+    int32x4_t r;
+    for (int i = 0; i < 4; i++)
+        r[i] = b[i] >= 0 ? a[i] << b[i] : a[i] >> -b[i];
+    return r;
+#endif
+}
+N_ALWAYS uint16x8_t vshlq_u16(uint16x8_t a, int16x8_t b)
+{
+    uint16x8_t r;
+    for (int i = 0; i < 8; i++)
+        r[i] = b[i] >= 0 ? a[i] << b[i] : a[i] >> -b[i];
+    return r;
+}
+
+// narrowing / widening
+#define vmovn_u16(a) (__builtin_convertvector((uint16x8_t)(a), uint8x8_t))
+#define vmovn_high_u16(lo, a) vcombine_u8((lo), vmovn_u16(a))
+#define vshrn_n_u16(a, n) (__builtin_convertvector((uint16x8_t)((a) >> (n)), uint8x8_t))
+#define vshrn_high_n_u16(lo, a, n) vcombine_u8((lo), vshrn_n_u16(a, n))
+#define vshrn_n_u32(a, n) (__builtin_convertvector((uint32x4_t)((a) >> (n)), uint16x4_t))
+#define vshrn_high_n_u32(lo, a, n) n_combine_u16((lo), vshrn_n_u32(a, n))
+#define vshrn_n_s32(a, n) (__builtin_convertvector((int32x4_t)((a) >> (n)), int16x4_t))
+#define vshrn_high_n_s32(lo, a, n) n_combine_s16((lo), vshrn_n_s32(a, n))
+#define vshll_n_u8(a, n) ((uint16x8_t)(__builtin_convertvector((uint8x8_t)(a), uint16x8_t) << (n)))
+#define vshll_high_n_u8(a, n) vshll_n_u8(n_cast<uint8x8_t>(_mm_unpackhi_epi64(n_m(a), n_m(a))), n)
+#define vshll_n_u16(a, n) ((uint32x4_t)(__builtin_convertvector((uint16x4_t)(a), uint32x4_t) << (n)))
+
+// permutes
+N_ALWAYS uint8x16_t vzip1q_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)_mm_unpacklo_epi8(n_m(a), n_m(b)); }
+N_ALWAYS uint8x16_t vzip2q_u8(uint8x16_t a, uint8x16_t b) { return (uint8x16_t)_mm_unpackhi_epi8(n_m(a), n_m(b)); }
+N_ALWAYS uint8x8_t vzip1_u8(uint8x8_t a, uint8x8_t b) { return vget_low_u8(vzip1q_u8(vcombine_u8(a, a), vcombine_u8(b, b))); }
+N_ALWAYS uint8x16_t vuzp1q_u8(uint8x16_t a, uint8x16_t b)
+{
+    const __m128i even = _mm_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+    return (uint8x16_t)_mm_unpacklo_epi64(_mm_shuffle_epi8(n_m(a), even), _mm_shuffle_epi8(n_m(b), even));
+}
+N_ALWAYS uint8x16_t vuzp2q_u8(uint8x16_t a, uint8x16_t b)
+{
+    const __m128i even = _mm_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+    return (uint8x16_t)_mm_unpackhi_epi64(_mm_shuffle_epi8(n_m(a), even), _mm_shuffle_epi8(n_m(b), even));
+}
+N_ALWAYS uint8x16_t vrev64q_u8(uint8x16_t a) { return (uint8x16_t)_mm_shuffle_epi8(n_m(a), _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8)); }
+N_ALWAYS uint8x8_t vrev64_u8(uint8x8_t a) { return vget_low_u8(vrev64q_u8(vcombine_u8(a, a))); }
+
+// lanes
+template <typename V, typename T> N_ALWAYS V n_setlane(V v, T x, int lane) { v[lane] = x; return v; }
+#define vsetq_lane_u32(x, v, lane) n_setlane((uint32x4_t)(v), (uint32_t)(x), lane)
+#define vsetq_lane_u64(x, v, lane) n_setlane((uint64x2_t)(v), (uint64_t)(x), lane)
+#define vld1q_lane_u8(p, v, lane) n_setlane((uint8x16_t)(v), *(const uint8_t*)(p), lane)
+#define vld1_lane_u8(p, v, lane) n_setlane((uint8x8_t)(v), *(const uint8_t*)(p), lane)
+#define vld1q_lane_u16(p, v, lane) n_setlane((uint16x8_t)(v), *(const uint16_t*)(p), lane)
+#define vld1q_lane_u64(p, v, lane) n_setlane((uint64x2_t)(v), *(const uint64_t*)(p), lane)
+#define vld1_lane_u32(p, v, lane) n_setlane((uint32x2_t)(v), *(const uint32_t*)(p), lane)
+N_ALWAYS uint8x16x2_t n_ld2lane(const uint8_t* p, uint8x16x2_t v, int lane) { v.val[0][lane] = p[0]; v.val[1][lane] = p[1]; return v; }
+N_ALWAYS uint8x8x2_t n_ld2lane(const uint8_t* p, uint8x8x2_t v, int lane) { v.val[0][lane] = p[0]; v.val[1][lane] = p[1]; return v; }
+#define vld2q_lane_u8(p, v, lane) n_ld2lane((const uint8_t*)(p), v, lane)
+#define vld2_lane_u8(p, v, lane) n_ld2lane((const uint8_t*)(p), v, lane)
+N_ALWAYS uint32x2_t vld1_dup_u32(const uint32_t* p) { return (uint32x2_t){} + *p; }
+
+// loads / stores
+N_ALWAYS uint8x16_t vld1q_u8(const uint8_t* p) { return (uint8x16_t)_mm_loadu_si128((const __m128i*)p); }
+N_ALWAYS uint8x8_t vld1_u8(const uint8_t* p) { uint8x8_t r; memcpy(&r, p, 8); return r; }
+N_ALWAYS void vst1q_u8(uint8_t* p, uint8x16_t v) { _mm_storeu_si128((__m128i*)p, n_m(v)); }
+N_ALWAYS void vst1_u8(uint8_t* p, uint8x8_t v) { memcpy(p, &v, 8); }
+N_ALWAYS uint8x16x2_t vld1q_u8_x2(const uint8_t* p) { return {vld1q_u8(p), vld1q_u8(p + 16)}; }
+N_ALWAYS uint16x8x2_t vld1q_u16_x2(const uint16_t* p) { return {(uint16x8_t)vld1q_u8((const uint8_t*)p), (uint16x8_t)vld1q_u8((const uint8_t*)p + 16)}; }
+N_ALWAYS void vst1q_u16_x2(uint16_t* p, uint16x8x2_t v) { vst1q_u8((uint8_t*)p, (uint8x16_t)v.val[0]); vst1q_u8((uint8_t*)p + 16, (uint8x16_t)v.val[1]); }
+
+N_ALWAYS uint8x16x2_t vld2q_u8(const uint8_t* p)
+{
+    const __m128i even = _mm_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), even);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), even);
+    return {(uint8x16_t)_mm_unpacklo_epi64(a, b), (uint8x16_t)_mm_unpackhi_epi64(a, b)};
+}
+N_ALWAYS uint8x8x2_t vld2_u8(const uint8_t* p)
+{
+    const __m128i even = _mm_setr_epi8(0,2,4,6,8,10,12,14, 1,3,5,7,9,11,13,15);
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), even);
+    return {n_cast<uint8x8_t>(a), n_cast<uint8x8_t>(_mm_unpackhi_epi64(a, a))};
+}
+
+N_ALWAYS uint8x16x4_t vld4q_u8(const uint8_t* p)
+{
+    const __m128i m = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), m);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), m);
+    __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 32)), m);
+    __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 48)), m);
+    __m128i ab0 = _mm_unpacklo_epi32(a, b), ab1 = _mm_unpackhi_epi32(a, b);
+    __m128i cd0 = _mm_unpacklo_epi32(c, d), cd1 = _mm_unpackhi_epi32(c, d);
+    return {(uint8x16_t)_mm_unpacklo_epi64(ab0, cd0), (uint8x16_t)_mm_unpackhi_epi64(ab0, cd0),
+        (uint8x16_t)_mm_unpacklo_epi64(ab1, cd1), (uint8x16_t)_mm_unpackhi_epi64(ab1, cd1)};
+}
+N_ALWAYS void vst4q_u8(uint8_t* p, uint8x16x4_t v)
+{
+    const __m128i m = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+    __m128i rg0 = _mm_unpacklo_epi32(n_m(v.val[0]), n_m(v.val[1])), rg1 = _mm_unpackhi_epi32(n_m(v.val[0]), n_m(v.val[1]));
+    __m128i ba0 = _mm_unpacklo_epi32(n_m(v.val[2]), n_m(v.val[3])), ba1 = _mm_unpackhi_epi32(n_m(v.val[2]), n_m(v.val[3]));
+    _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(_mm_unpacklo_epi64(rg0, ba0), m));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_shuffle_epi8(_mm_unpackhi_epi64(rg0, ba0), m));
+    _mm_storeu_si128((__m128i*)(p + 32), _mm_shuffle_epi8(_mm_unpacklo_epi64(rg1, ba1), m));
+    _mm_storeu_si128((__m128i*)(p + 48), _mm_shuffle_epi8(_mm_unpackhi_epi64(rg1, ba1), m));
+}
+N_ALWAYS uint8x8x4_t vld4_u8(const uint8_t* p)
+{
+    const __m128i m = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), m);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), m);
+    __m128i rg = _mm_unpacklo_epi32(a, b), ba = _mm_unpackhi_epi32(a, b);
+    return {n_cast<uint8x8_t>(rg), n_cast<uint8x8_t>(_mm_unpackhi_epi64(rg, rg)),
+        n_cast<uint8x8_t>(ba), n_cast<uint8x8_t>(_mm_unpackhi_epi64(ba, ba))};
+}
+N_ALWAYS void vst4_u8(uint8_t* p, uint8x8x4_t v)
+{
+    // the 4x4 byte transpose is its own inverse
+    const __m128i m = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+    __m128i rg = _mm_shuffle_epi32(n_m(vcombine_u8(v.val[0], v.val[1])), 0xD8);
+    __m128i ba = _mm_shuffle_epi32(n_m(vcombine_u8(v.val[2], v.val[3])), 0xD8);
+    _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(_mm_unpacklo_epi64(rg, ba), m));
+    _mm_storeu_si128((__m128i*)(p + 16), _mm_shuffle_epi8(_mm_unpackhi_epi64(rg, ba), m));
+}
+
+#endif
@@ -4,11 +4,22 @@
 #include "GPU.h"
 
 #include <string.h>
-#include <arm_neon.h>
-
 #include <assert.h>
 
-#include "frontend/switch/Profiler.h"
+#ifdef __x86_64__
+// only the renderer itself is built for SSE4.1, everything included above
+// has to stay runnable on any x86_64 CPU. GPU::IsRenderer2DAvailable
+// makes sure it's never used on a CPU without SSE4.1
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+#include "GPU2D_NeonSSE.h"
+#else
+#include <arm_neon.h>
+#endif
 
 typedef __uint128_t u128;
 
@@ -16,6 +27,8 @@ typedef __uint128_t u128;
     optimised GPU2D for aarch64 devices
     which are usually less powerful, but support the NEON vector instruction set
 
+    on x86_64 the NEON intrinsics are provided by GPU2D_NeonSSE.h
+
     BGOBJLine format:
         * when palette index:
             * byte 0: color index
@@ -55,6 +68,9 @@ typedef __uint128_t u128;
             * bit 5-7: source (same as BGOBJLine)
 */
 
+namespace GPU2D
+{
+
 #define unroll8(n, body) \
     { const int n = 0; body } \
     { const int n = 1; body } \
@@ -73,9 +89,26 @@ typedef __uint128_t u128;
     { const int n = 0; body } \
     { const int n = 1; body }
 
-GPU2D_NeonSoft::GPU2D_NeonSoft(u32 num)
-    : GPU2D(num)
-{}
+NeonSoftRenderer::NeonSoftRenderer()
+    : Renderer2D()
+{
+    // initialize mosaic table
+    for (int m = 0; m < 16; m++)
+    {
+        for (int x = 0; x < 256; x++)
+        {
+            int offset = x % (m+1);
+            MosaicTable[m][x] = offset;
+        }
+    }
+}
+
+void NeonSoftRenderer::Reset()
+{
+    // the sprite lists are rebuilt once OAM is marked dirty
+    memset(NumSpritesPerLayer, 0, sizeof(NumSpritesPerLayer));
+    *OAMDirtyMem = 0x3;
+}
 
 inline uint8x16_t ColorBrightnessDown(uint8x16_t val, uint8x16_t factor)
 {
@@ -132,17 +165,23 @@ inline void RGB5ToRGB6(uint8x16_t lo, uint8x16_t hi, uint8x16_t& red, uint8x16_t
     blue = vandq_u8(vshrq_n_u8(hi, 1), vdupq_n_u8(0x3E));
 }
 
+inline uint8x16_t RGB6ToRGB8(uint8x16_t val)
+{
+    // the upper bits are repeated, so that the result matches the regular renderer
+    return vorrq_u8(vshlq_n_u8(val, 2), vshrq_n_u8(val, 4));
+}
+
 template <bool enable3DBlend, int secondSrcBlend>
-void GPU2D_NeonSoft::ApplyColorEffect()
+void NeonSoftRenderer::ApplyColorEffect()
 {
-    uint8x16_t blendTargets1 = vdupq_n_u8(BlendCnt);
-    uint8x16_t blendTargets2 = vdupq_n_u8(BlendCnt >> 8);
+    uint8x16_t blendTargets1 = vdupq_n_u8(CurUnit->BlendCnt);
+    uint8x16_t blendTargets2 = vdupq_n_u8(CurUnit->BlendCnt >> 8);
 
-    uint8x16_t cntBlendMode = vdupq_n_u8((BlendCnt >> 6) & 0x3);
+    uint8x16_t cntBlendMode = vdupq_n_u8((CurUnit->BlendCnt >> 6) & 0x3);
 
-    uint8x16_t vecEVY = vdupq_n_u8(EVY);
-    uint8x16_t vecEVA = vdupq_n_u8(EVA);
-    uint8x16_t vecEVB = vdupq_n_u8(EVB);
+    uint8x16_t vecEVY = vdupq_n_u8(CurUnit->EVY);
+    uint8x16_t vecEVA = vdupq_n_u8(CurUnit->EVA);
+    uint8x16_t vecEVB = vdupq_n_u8(CurUnit->EVB);
 
     for (int i = 0; i < 256; i += 16)
     {
@@ -183,7 +222,7 @@ void GPU2D_NeonSoft::ApplyColorEffect()
             coloreffect = vbslq_u8(vandq_u8(maskSpriteBlend1, pixelsTarget2), vdupq_n_u8(1), coloreffect);
 
         uint8x16_t blendPixels = vceqq_u8(coloreffect, vdupq_n_u8(1));
-        if (vmaxvq_u8(blendPixels) && secondSrcBlend == 2)
+        if (vmaxvq_u8(blendPixels) && secondSrcBlend > 0)
         {
             uint8x16_t bitmapAlpha = vandq_u8(bgobjline.val[3], vdupq_n_u8(0x1F));
             uint8x16_t eva = vbslq_u8(mask3DOrBmpSpriteBlend1, bitmapAlpha, vecEVA);
@@ -247,12 +286,14 @@ inline void DrawPixels(u32* bgobjline, uint8x16_t moveMask,
     }
 }
 
-void GPU2D_NeonSoft::DrawScanline(u32 line)
+void NeonSoftRenderer::DrawScanline(u32 line, u32 vcount, Unit* unit)
 {
-    u32* dst = &Framebuffer[256 * line];
+    CurUnit = unit;
+
+    u32* dst = &Framebuffer[CurUnit->Num][256 * line];
 
     int n3dline = line;
-    line = GPU::VCount;
+    line = vcount;
 
     bool forceblank = false;
 
@@ -262,29 +303,32 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
 
     // GPU B can be completely disabled by POWCNT1
     // oddly that's not the case for GPU A
-    if (Num && !Enabled) forceblank = true;
+    if (CurUnit->Num && !CurUnit->Enabled) forceblank = true;
 
-    if (Num == 0)
+    if (!ExternalVRAMSync)
     {
-        auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
-        GPU::MakeVRAMFlat_ABGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
-        GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
-        GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
-    }
-    else
-    {
-        auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
-        bool bgchanged = GPU::MakeVRAMFlat_BBGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
-        GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
-        GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        if (CurUnit->Num == 0)
+        {
+            auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
+            GPU::MakeVRAMFlat_ABGCoherent(bgDirty);
+            auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
+            GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
+            auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
+            GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
+        }
+        else
+        {
+            auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
+            GPU::MakeVRAMFlat_BBGCoherent(bgDirty);
+            auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
+            GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
+            auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
+            GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        }
     }
 
-    u32 dispmode = DispCnt >> 16;
-    dispmode &= (Num ? 0x1 : 0x3);
+    u32 dispmode = CurUnit->DispCnt >> 16;
+    dispmode &= (CurUnit->Num ? 0x1 : 0x3);
 
     if (forceblank)
     {
@@ -292,17 +336,17 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
         return;
     }
 
-    if (Num == 0)
+    if (CurUnit->Num == 0)
         _3DLine = GPU3D::GetLine(n3dline);
 
-    if (line == 0 && CaptureCnt & (1 << 31))
-        CaptureLatch = true;
+    if (line == 0 && CurUnit->CaptureCnt & (1 << 31))
+        CurUnit->CaptureLatch = true;
 
     SkipRendering = !(dispmode == 1
-        || ((Num == 0) && CaptureLatch && !(CaptureCnt & (1 << 24))));
+        || ((CurUnit->Num == 0) && CurUnit->CaptureLatch && !(CurUnit->CaptureCnt & (1 << 24))));
 
     DrawScanline_BGOBJ(line);
-    UpdateMosaicCounters(line);
+    CurUnit->UpdateMosaicCounters(line);
 
     switch (dispmode)
     {
@@ -323,7 +367,7 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
             u16* colors = NULL;
             if (dispmode == 2)
             {
-                u32 vrambank = (DispCnt >> 18) & 0x3;
+                u32 vrambank = (CurUnit->DispCnt >> 18) & 0x3;
                 if (GPU::VRAMMap_LCDC & (1<<vrambank))
                 {
                     u16* vram = (u16*)GPU::VRAM[vrambank];
@@ -333,7 +377,7 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
                     memset(dst, 0, 256*4);
             }
             else
-                colors = DispFIFOBuffer;
+                colors = CurUnit->DispFIFOBuffer;
 
             if (colors != NULL)
             {
@@ -352,10 +396,10 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
         };
     }
 
-    if (Num == 0 && CaptureLatch)
+    if (CurUnit->Num == 0 && CurUnit->CaptureLatch)
     {
         u32 capwidth, capheight;
-        switch ((CaptureCnt >> 20) & 0x3)
+        switch ((CurUnit->CaptureCnt >> 20) & 0x3)
         {
         case 0: capwidth = 128; capheight = 128; break;
         case 1: capwidth = 256; capheight = 64;  break;
@@ -369,10 +413,10 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
 
     // we combine master brightness and RGB6 -> RGB8 conversion into a single step
     {
-        u32 factor = MasterBrightness & 0x1F;
+        u32 factor = CurUnit->MasterBrightness & 0x1F;
         if (factor > 16)
             factor = 16;
-        if (dispmode != 0 && (MasterBrightness >> 14) == 1 && factor > 0)
+        if (dispmode != 0 && (CurUnit->MasterBrightness >> 14) == 1 && factor > 0)
         {
             // up
             uint8x16_t factorVec = vdupq_n_u8(factor);
@@ -382,16 +426,16 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
 
                 uint8x16x4_t result =
                 {
-                    vshlq_n_u8(ColorBrightnessUp(colors.val[2], factorVec), 2),
-                    vshlq_n_u8(ColorBrightnessUp(colors.val[1], factorVec), 2),
-                    vshlq_n_u8(ColorBrightnessUp(colors.val[0], factorVec), 2),
+                    RGB6ToRGB8(ColorBrightnessUp(colors.val[2], factorVec)),
+                    RGB6ToRGB8(ColorBrightnessUp(colors.val[1], factorVec)),
+                    RGB6ToRGB8(ColorBrightnessUp(colors.val[0], factorVec)),
                     vdupq_n_u8(0xFF)
                 };
 
                 vst4q_u8((u8*)&dst[i], result);
             }
         }
-        else if (dispmode != 0 && (MasterBrightness >> 14) == 2 && factor > 0)
+        else if (dispmode != 0 && (CurUnit->MasterBrightness >> 14) == 2 && factor > 0)
         {
             // down
             uint8x16_t factorVec = vdupq_n_u8(factor);
@@ -402,9 +446,9 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
 
                 uint8x16x4_t result =
                 {
-                    vshlq_n_u8(ColorBrightnessDown(colors.val[2], factorVec), 2),
-                    vshlq_n_u8(ColorBrightnessDown(colors.val[1], factorVec), 2),
-                    vshlq_n_u8(ColorBrightnessDown(colors.val[0], factorVec), 2),
+                    RGB6ToRGB8(ColorBrightnessDown(colors.val[2], factorVec)),
+                    RGB6ToRGB8(ColorBrightnessDown(colors.val[1], factorVec)),
+                    RGB6ToRGB8(ColorBrightnessDown(colors.val[0], factorVec)),
                     vdupq_n_u8(0xFF)
                 };
 
@@ -419,9 +463,9 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
                 uint8x16x4_t colors = vld4q_u8((u8*)&dst[i]);
                 uint8x16x4_t result =
                 {
-                    vshlq_n_u8(colors.val[2], 2),
-                    vshlq_n_u8(colors.val[1], 2),
-                    vshlq_n_u8(colors.val[0], 2),
+                    RGB6ToRGB8(colors.val[2]),
+                    RGB6ToRGB8(colors.val[1]),
+                    RGB6ToRGB8(colors.val[0]),
                     vdupq_n_u8(0xFF)
                 };
 
@@ -431,7 +475,7 @@ void GPU2D_NeonSoft::DrawScanline(u32 line)
     }
 }
 
-void GPU2D_NeonSoft::PalettiseRange(u32 start)
+void NeonSoftRenderer::PalettiseRange(u32 start)
 {
     uint8x16_t colorMask = vdupq_n_u8(0x3E);
 
@@ -450,10 +494,10 @@ void GPU2D_NeonSoft::PalettiseRange(u32 start)
 
         uint16x8_t colorsLo = vdupq_n_u16(0);
         unroll8(i,
-            colorsLo = vld1q_lane_u16((u16*)&GPU::Palette[indices0[i] * 2], colorsLo, i);)
+            colorsLo = vld1q_lane_u16((u16*)&PaletteMem[indices0[i] * 2], colorsLo, i);)
         uint16x8_t colorsHi = vdupq_n_u16(0);
         unroll8(i,
-            colorsHi = vld1q_lane_u16((u16*)&GPU::Palette[indices1[i] * 2], colorsHi, i);)
+            colorsHi = vld1q_lane_u16((u16*)&PaletteMem[indices1[i] * 2], colorsHi, i);)
 
         uint8x16_t red = vandq_u8(vshlq_n_u8(vuzp1q_u8(vreinterpretq_u8_u16(colorsLo), vreinterpretq_u8_u16(colorsHi)), 1), colorMask);
         uint8x16_t green = vandq_u8(vshrn_high_n_u16(vshrn_n_u16(colorsLo, 4), colorsHi, 4), colorMask);
@@ -471,37 +515,43 @@ void GPU2D_NeonSoft::PalettiseRange(u32 start)
     }
 }
 
-void GPU2D_NeonSoft::DrawScanline_BGOBJ(u32 line)
+void NeonSoftRenderer::DrawScanline_BGOBJ(u32 line)
 {
-    if (DispCnt & (1<<7))
+    if (CurUnit->DispCnt & (1<<7))
     {
-        u128 val = 0xFFBF3F3FL | (0xFFBF3F3FL << 32);
+        u128 val = 0xFF3F3F3FUL | (0xFF3F3F3FUL << 32);
         val |= val << 64;
         for (int i = 0; i < 256; i += 4)
-            *(u128*)&BGOBJLine[i] = val;
+            *(u128*)&BGOBJLine[i + 8] = val;
         return;
     }
 
     {
         u128 backdrop;
-        if (Num) backdrop = *(u128*)&GPU::Palette[0x400];
-        else     backdrop = *(u128*)&GPU::Palette[0];
+        if (CurUnit->Num) backdrop = *(u128*)&PaletteMem[0x400];
+        else     backdrop = *(u128*)&PaletteMem[0];
         backdrop = ((backdrop & 0x1F) << 1) | ((backdrop & 0x3E0) << 4) | ((backdrop & 0x7C00) << 7) | 0x20000000;
         backdrop |= backdrop << 32;
         backdrop |= backdrop << 64;
 
+        // nothing is below the backdrop for it to be blended with
         for (int i = 0; i < 256; i+=4)
+        {
             *(u128*)&BGOBJLine[i + 8] = backdrop;
+            *(u128*)&BGOBJLine[i + 8 + 272] = 0;
+        }
     }
 
-    if (DispCnt & 0xE000)
-        CalculateWindowMask(line, &WindowMask[8], &OBJWindow[8]);
+    if (CurUnit->DispCnt & 0xE000)
+        CurUnit->CalculateWindowMask(line, &WindowMask[8], &OBJWindow[CurUnit->Num][8]);
     else
         memset(WindowMask + 8, 0xFF, 256);
 
+    ApplySpriteMosaicX();
+
     _3DSemiTransparencies = false;
 
-    switch (DispCnt & 0x7)
+    switch (CurUnit->DispCnt & 0x7)
     {
     case 0: DrawScanlineBGMode<0>(line); break;
     case 1: DrawScanlineBGMode<1>(line); break;
@@ -513,22 +563,30 @@ void GPU2D_NeonSoft::DrawScanline_BGOBJ(u32 line)
     case 7: DrawScanlineBGMode7(line); break;
     }
 
+    if (CurUnit->BGMosaicY >= CurUnit->BGMosaicYMax)
+    {
+        CurUnit->BGMosaicY = 0;
+        CurUnit->BGMosaicYMax = CurUnit->BGMosaicSize[1];
+    }
+    else
+        CurUnit->BGMosaicY++;
+
     PalettiseRange(8);
 
-    u32 cntBlendMode = (BlendCnt >> 6) & 0x3;
-    bool threeDEnabled = !Num && (DispCnt & (1 << 3)) && _3DSemiTransparencies;
+    u32 cntBlendMode = (CurUnit->BlendCnt >> 6) & 0x3;
+    bool threeDEnabled = !CurUnit->Num && (CurUnit->DispCnt & (1 << 3)) && _3DSemiTransparencies;
 
     u32 blendSrc2 = 0;
     if (cntBlendMode == 1)
         blendSrc2 = 2;
     else
-        blendSrc2 = !!((BlendCnt >> 8) & 0x3F);
+        blendSrc2 = !!((CurUnit->BlendCnt >> 8) & 0x3F);
 
-    bool semiTransSprites = SemiTransBitmapSprites || (SemiTransTileSprites && !(EVA == 16 && EVB == 0));
+    bool semiTransSprites = SemiTransBitmapSprites[CurUnit->Num] || (SemiTransTileSprites[CurUnit->Num] && !(CurUnit->EVA == 16 && CurUnit->EVB == 0));
 
-    u32 blendSrc1 = BlendCnt & 0x3F;
+    u32 blendSrc1 = CurUnit->BlendCnt & 0x3F;
     if ((blendSrc1 == 0
-        || (cntBlendMode >= 2 && EVY == 0))
+        || (cntBlendMode >= 2 && CurUnit->EVY == 0))
         && !semiTransSprites
         && !_3DSemiTransparencies)
     {
@@ -539,9 +597,9 @@ void GPU2D_NeonSoft::DrawScanline_BGOBJ(u32 line)
     {
         if (cntBlendMode == 0)
             return;
-        if (cntBlendMode == 1 && EVA == 16 && EVB == 0)
+        if (cntBlendMode == 1 && CurUnit->EVA == 16 && CurUnit->EVB == 0)
             return;
-        if (cntBlendMode >= 2 && EVY == 0)
+        if (cntBlendMode >= 2 && CurUnit->EVY == 0)
             return;
     }
     else
@@ -561,76 +619,115 @@ void GPU2D_NeonSoft::DrawScanline_BGOBJ(u32 line)
 }
 
 
+/*
+    the BG drawing functions only apply vertical mosaic. a layer with
+    horizontal mosaic is first drawn on its own over an empty line, with
+    every pixel enabled by the window. afterwards each pixel takes the
+    colour of the first pixel of its mosaic block and is moved over
+    the layers which were there before, if the window allows it.
+*/
+void NeonSoftRenderer::BeginBGMosaicX(u32 bgnum)
+{
+    memcpy(MosaicBGOBJLine, BGOBJLine, sizeof(BGOBJLine));
+    memcpy(MosaicWindowMask, WindowMask, sizeof(WindowMask));
+
+    memset(BGOBJLine, 0, 272*4);
+    for (int i = 0; i < 272; i++)
+        WindowMask[i] |= (1 << bgnum);
+}
+
+void NeonSoftRenderer::FinishBGMosaicX(u32 bgnum)
+{
+    u8* mosaicTable = MosaicTable[CurUnit->BGMosaicSize[0]];
+
+    for (int i = 0; i < 256; i++)
+    {
+        u32 color = BGOBJLine[8 + i - mosaicTable[i]];
+        if ((color >> 24) && (MosaicWindowMask[8 + i] & (1 << bgnum)))
+        {
+            MosaicBGOBJLine[8 + 272 + i] = MosaicBGOBJLine[8 + i];
+            MosaicBGOBJLine[8 + i] = color;
+        }
+    }
+
+    memcpy(BGOBJLine, MosaicBGOBJLine, sizeof(BGOBJLine));
+    memcpy(WindowMask, MosaicWindowMask, sizeof(WindowMask));
+}
+
 #define DoDrawBG(type, line, num) \
-    { if ((BGCnt[num] & 0x0040) && (BGMosaicSize[0] > 0)) DrawBG_##type<true>(line, num); else DrawBG_##type<false>(line, num); }
+    { if ((CurUnit->BGCnt[num] & 0x0040) && (CurUnit->BGMosaicSize[0] > 0)) { BeginBGMosaicX(num); DrawBG_##type<true>(line, num); FinishBGMosaicX(num); } \
+      else DrawBG_##type<false>(line, num); }
 
 #define DoDrawBG_Large(line) \
-    { if ((BGCnt[2] & 0x0040) && (BGMosaicSize[0] > 0)) DrawBG_Large<true>(line); else DrawBG_Large<false>(line); }
+    { if ((CurUnit->BGCnt[2] & 0x0040) && (CurUnit->BGMosaicSize[0] > 0)) { BeginBGMosaicX(2); DrawBG_Large<true>(line); FinishBGMosaicX(2); } \
+      else DrawBG_Large<false>(line); }
 
-void GPU2D_NeonSoft::DrawScanlineBGMode6(u32 line)
+void NeonSoftRenderer::DrawScanlineBGMode6(u32 line)
 {
     for (int i = 3; i >= 0; i--)
     {
-        if ((BGCnt[2] & 0x3) == i)
+        if ((CurUnit->BGCnt[2] & 0x3) == i)
         {
-            if (DispCnt & 0x0400)
+            if (CurUnit->DispCnt & 0x0400)
             {
                 DoDrawBG_Large(line)
             }
         }
-        if ((BGCnt[0] & 0x3) == i)
+        if ((CurUnit->BGCnt[0] & 0x3) == i)
         {
-            if (DispCnt & 0x0100)
+            if (CurUnit->DispCnt & 0x0100)
             {
-                if ((!Num) && (DispCnt & 0x8))
+                if ((!CurUnit->Num) && (CurUnit->DispCnt & 0x8))
                     DrawBG_3D();
             }
         }
-        if ((DispCnt & 0x1000) && NumSprites[i] && !SkipRendering)
+        if ((CurUnit->DispCnt & 0x1000) && NumSprites[CurUnit->Num][i] && !SkipRendering)
             InterleaveSprites(0x4 | i);
     }
 }
 
-void GPU2D_NeonSoft::DrawScanlineBGMode7(u32 line)
+void NeonSoftRenderer::DrawScanlineBGMode7(u32 line)
 {
     for (int i = 3; i >= 0; i--)
     {
-        if ((BGCnt[1] & 0x3) == i)
+        if ((CurUnit->BGCnt[1] & 0x3) == i)
         {
-            if (DispCnt & 0x0200)
+            if (CurUnit->DispCnt & 0x0200)
             {
                 DoDrawBG(Text, line, 1)
             }
         }
-        if ((BGCnt[0] & 0x3) == i)
+        if ((CurUnit->BGCnt[0] & 0x3) == i)
         {
-            if (DispCnt & 0x0100)
+            if (CurUnit->DispCnt & 0x0100)
             {
-                if ((!Num) && (DispCnt & 0x8))
+                if ((!CurUnit->Num) && (CurUnit->DispCnt & 0x8))
                     DrawBG_3D();
                 else
                     DoDrawBG(Text, line, 0)
             }
         }
-        if ((DispCnt & 0x1000) && NumSprites[i] && !SkipRendering)
+        if ((CurUnit->DispCnt & 0x1000) && NumSprites[CurUnit->Num][i] && !SkipRendering)
             InterleaveSprites(0x4 | i);
     }
 }
 
 #define DoDrawBG(type, line, num) \
-    { if ((BGCnt[num] & 0x0040) && (BGMosaicSize[0] > 0)) DrawBG_##type<true>(line, num); else DrawBG_##type<false>(line, num); }
+    { if ((CurUnit->BGCnt[num] & 0x0040) && (CurUnit->BGMosaicSize[0] > 0)) { BeginBGMosaicX(num); DrawBG_##type<true>(line, num); FinishBGMosaicX(num); } \
+      else DrawBG_##type<false>(line, num); }
 
 #define DoDrawBG_Large(line) \
-    { if ((BGCnt[2] & 0x0040) && (BGMosaicSize[0] > 0)) DrawBG_Large<true>(line); else DrawBG_Large<false>(line); }
+    { if ((CurUnit->BGCnt[2] & 0x0040) && (CurUnit->BGMosaicSize[0] > 0)) { BeginBGMosaicX(2); DrawBG_Large<true>(line); FinishBGMosaicX(2); } \
+      else DrawBG_Large<false>(line); }
 
 template<u32 bgmode>
-void GPU2D_NeonSoft::DrawScanlineBGMode(u32 line)
+void NeonSoftRenderer::DrawScanlineBGMode(u32 line)
 {
     for (int i = 3; i >= 0; i--)
     {
-        if ((BGCnt[3] & 0x3) == i)
+        if ((CurUnit->BGCnt[3] & 0x3) == i)
         {
-            if (DispCnt & 0x0800)
+            if (CurUnit->DispCnt & 0x0800)
             {
                 if (bgmode >= 3)
                     DoDrawBG(Extended, line, 3)
@@ -640,9 +737,9 @@ void GPU2D_NeonSoft::DrawScanlineBGMode(u32 line)
                     DoDrawBG(Text, line, 3)
             }
         }
-        if ((BGCnt[2] & 0x3) == i)
+        if ((CurUnit->BGCnt[2] & 0x3) == i)
         {
-            if (DispCnt & 0x0400)
+            if (CurUnit->DispCnt & 0x0400)
             {
                 if (bgmode == 5)
                     DoDrawBG(Extended, line, 2)
@@ -652,35 +749,64 @@ void GPU2D_NeonSoft::DrawScanlineBGMode(u32 line)
                     DoDrawBG(Text, line, 2)
             }
         }
-        if ((BGCnt[1] & 0x3) == i)
+        if ((CurUnit->BGCnt[1] & 0x3) == i)
         {
-            if (DispCnt & 0x0200)
+            if (CurUnit->DispCnt & 0x0200)
             {
                 DoDrawBG(Text, line, 1)
             }
         }
-        if ((BGCnt[0] & 0x3) == i)
+        if ((CurUnit->BGCnt[0] & 0x3) == i)
         {
-            if (DispCnt & 0x0100)
+            if (CurUnit->DispCnt & 0x0100)
             {
-                if ((!Num) && (DispCnt & 0x8))
+                if ((!CurUnit->Num) && (CurUnit->DispCnt & 0x8))
                     DrawBG_3D();
                 else
                     DoDrawBG(Text, line, 0)
             }
         }
-        if ((DispCnt & 0x1000) && NumSprites[i] && !SkipRendering)
+        if ((CurUnit->DispCnt & 0x1000) && NumSprites[CurUnit->Num][i] && !SkipRendering)
             InterleaveSprites(0x4 | i);
     }
 }
 
-void GPU2D_NeonSoft::InterleaveSprites(u32 prio)
+void NeonSoftRenderer::ApplySpriteMosaicX()
+{
+    // X mosaic for sprites is applied after all sprites are rendered,
+    // in the same way as the regular software renderer does it
+
+    if (CurUnit->OBJMosaicSize[0] == 0) return;
+
+    u32* objLine = &OBJLine[CurUnit->Num][8];
+    u8* objIndex = &OBJIndex[CurUnit->Num][8];
+
+    u8* curOBJXMosaicTable = MosaicTable[CurUnit->OBJMosaicSize[1]];
+
+    u32 lastcolor = objLine[0];
+
+    for (u32 i = 1; i < 256; i++)
+    {
+        if (!(objLine[i] & 0x80000))
+        {
+            // not a mosaic'd sprite pixel
+            continue;
+        }
+
+        if ((objIndex[i] != objIndex[i-1]) || (curOBJXMosaicTable[i] == 0))
+            lastcolor = objLine[i];
+        else
+            objLine[i] = lastcolor;
+    }
+}
+
+void NeonSoftRenderer::InterleaveSprites(u32 prio)
 {
     uint8x16_t vecPrio = vdupq_n_u8(prio);
     for (int i = 0; i < 256; i += 32)
     {
         unroll2(j,
-            uint8x16x4_t pixels = vld4q_u8((u8*)&OBJLine[8 + i + j * 16]);
+            uint8x16x4_t pixels = vld4q_u8((u8*)&OBJLine[CurUnit->Num][8 + i + j * 16]);
             
             uint8x16_t windowMask = vtstq_u8(vld1q_u8(&WindowMask[8 + i + j * 16]), vdupq_n_u8(0x10));
             uint8x16_t moveMask = vandq_u8(windowMask, vceqq_u8(vandq_u8(pixels.val[2], vdupq_n_u8(0x7)), vecPrio));
@@ -706,7 +832,7 @@ void GPU2D_NeonSoft::InterleaveSprites(u32 prio)
     }
 }
 
-void GPU2D_NeonSoft::DrawBG_3D()
+void NeonSoftRenderer::DrawBG_3D()
 {
     if (SkipRendering)
         return;
@@ -733,9 +859,9 @@ void GPU2D_NeonSoft::DrawBG_3D()
     _3DSemiTransparencies = vmaxvq_u8(semiTransparent) != 0;
 }
 
-void GPU2D_NeonSoft::DoCapture(u32 line, u32 width)
+void NeonSoftRenderer::DoCapture(u32 line, u32 width)
 {
-    u32 dstvram = (CaptureCnt >> 16) & 0x3;
+    u32 dstvram = (CurUnit->CaptureCnt >> 16) & 0x3;
 
     // TODO: confirm this
     // it should work like VRAM display mode, which requires VRAM to be mapped to LCDC
@@ -743,10 +869,10 @@ void GPU2D_NeonSoft::DoCapture(u32 line, u32 width)
         return;
 
     u16* dst = (u16*)GPU::VRAM[dstvram];
-    u32 dstaddr = (((CaptureCnt >> 18) & 0x3) << 14) + (line * width);
+    u32 dstaddr = (((CurUnit->CaptureCnt >> 18) & 0x3) << 14) + (line * width);
 
     u32* srcA;
-    if (CaptureCnt & (1<<24))
+    if (CurUnit->CaptureCnt & (1<<24))
         srcA = _3DLine;
     else
         srcA = &BGOBJLine[8];
@@ -754,28 +880,28 @@ void GPU2D_NeonSoft::DoCapture(u32 line, u32 width)
     u16* srcB = NULL;
     u32 srcBaddr = line * 256;
 
-    if (CaptureCnt & (1<<25))
+    if (CurUnit->CaptureCnt & (1<<25))
     {
-        srcB = &DispFIFOBuffer[0];
+        srcB = &CurUnit->DispFIFOBuffer[0];
         srcBaddr = 0;
     }
     else
     {
-        u32 srcvram = (DispCnt >> 18) & 0x3;
+        u32 srcvram = (CurUnit->DispCnt >> 18) & 0x3;
         if (GPU::VRAMMap_LCDC & (1<<srcvram))
             srcB = (u16*)GPU::VRAM[srcvram];
 
-        if (((DispCnt >> 16) & 0x3) != 2)
-            srcBaddr += ((CaptureCnt >> 26) & 0x3) << 14;
+        if (((CurUnit->DispCnt >> 16) & 0x3) != 2)
+            srcBaddr += ((CurUnit->CaptureCnt >> 26) & 0x3) << 14;
     }
 
     dstaddr &= 0xFFFF;
     srcBaddr &= 0xFFFF;
 
     static_assert(GPU::VRAMDirtyGranularity == 512);
-    GPU::VRAMDirty[dstvram][dstaddr * 2 / GPU::VRAMDirtyGranularity] = true;
+    GPU::MarkVRAMDirty(dstvram, dstaddr * 2);
 
-    switch ((CaptureCnt >> 29) & 0x3)
+    switch ((CurUnit->CaptureCnt >> 29) & 0x3)
     {
     case 0: // source A
         {
@@ -846,8 +972,8 @@ void GPU2D_NeonSoft::DoCapture(u32 line, u32 width)
     case 2: // sources A+B
     case 3:
         {
-            u32 eva = CaptureCnt & 0x1F;
-            u32 evb = (CaptureCnt >> 8) & 0x1F;
+            u32 eva = CurUnit->CaptureCnt & 0x1F;
+            u32 evb = (CurUnit->CaptureCnt >> 8) & 0x1F;
 
             // checkme
             if (eva > 16) eva = 16;
@@ -989,43 +1115,43 @@ void GPU2D_NeonSoft::DoCapture(u32 line, u32 width)
 }
 
 template<bool mosaic>
-void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
+void NeonSoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
 {
     if (SkipRendering)
         return;
 
-    u16 bgcnt = BGCnt[bgnum];
+    u16 bgcnt = CurUnit->BGCnt[bgnum];
 
     u32 tilesetaddr, tilemapaddr;
 
-    u16 xoff = BGXPos[bgnum];
-    u16 yoff = BGYPos[bgnum] + line;
+    u16 xoff = CurUnit->BGXPos[bgnum];
+    u16 yoff = CurUnit->BGYPos[bgnum] + line;
 
     if (bgcnt & 0x0040)
     {
         // vertical mosaic
-        yoff -= BGMosaicY;
+        yoff -= CurUnit->BGMosaicY;
     }
 
     u32 widexmask = (bgcnt & 0x4000) ? 0x100 : 0;
 
-    u32 extpal = (DispCnt & 0x40000000);
+    u32 extpal = (CurUnit->DispCnt & 0x40000000);
     u32 extpalslot = ((bgnum<2) && (bgcnt&0x2000)) ? (2+bgnum) : bgnum;
 
-    if (Num)
+    if (CurUnit->Num)
     {
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
     }
     else
     {
-        tilesetaddr = ((DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
-        tilemapaddr = ((DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
+        tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
+        tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
     }
 
     u8* bgvram;
     u32 bgvrammask;
-    GetBGVRAM(bgvram, bgvrammask);
+    CurUnit->GetBGVRAM(bgvram, bgvrammask);
 
     // adjust Y position in tilemap
     if (bgcnt & 0x8000)
@@ -1050,9 +1176,9 @@ void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
     {
         u32 palOffset;
         if (extpal)
-            palOffset = extpalslot * 16 + ((Num ? GPU::VRAMFlat_BBGExtPal : GPU::VRAMFlat_ABGExtPal) - GPU::AllPaletteMemory) / 512;
+            palOffset = extpalslot * 16 + ((CurUnit->Num ? GPU::VRAMFlat_BBGExtPal : GPU::VRAMFlat_ABGExtPal) - GPU::AllPaletteMemory) / 512;
         else
-            palOffset = Num ? 2 : 0;
+            palOffset = CurUnit->Num ? 2 : 0;
         u64 extpalsUsed = 0;
 
         uint8x16_t extpalMask = vdupq_n_u8(extpal ? 0xFF : 0);
@@ -1196,7 +1322,7 @@ void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
                 resLayerBelow.val[3] = vbsl_u8(movemask, resLayer.val[3], resLayerBelow.val[3]);
 
                 resLayer.val[0] = vbsl_u8(movemask, vadd_u8(pixels, extpal), resLayer.val[0]);
-                resLayer.val[1] = vbsl_u8(movemask, vdup_n_u8(Num ? 2 : 0), resLayer.val[1]);
+                resLayer.val[1] = vbsl_u8(movemask, vdup_n_u8(CurUnit->Num ? 2 : 0), resLayer.val[1]);
                 resLayer.val[2] = vbsl_u8(movemask, vdup_n_u8(0x80), resLayer.val[2]);
                 resLayer.val[3] = vbsl_u8(movemask, vget_low_u8(compositorFlag), resLayer.val[3]);
 
@@ -1253,7 +1379,7 @@ void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
 
                 pixels = vaddq_u8(pixels, vzip1q_u8(pal, pal));
 
-                DrawPixels(dst, movemask, pixels, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80), compositorFlag);
+                DrawPixels(dst, movemask, pixels, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80), compositorFlag);
             }
             dst += 16;
             if (pixels2 || pixels3)
@@ -1267,7 +1393,7 @@ void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
 
                 pixels = vaddq_u8(pixels, vzip2q_u8(pal, pal));
 
-                DrawPixels(dst, movemask, pixels, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80), compositorFlag);
+                DrawPixels(dst, movemask, pixels, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80), compositorFlag);
             }
             dst += 16;
         }
@@ -1275,9 +1401,9 @@ void GPU2D_NeonSoft::DrawBG_Text(u32 line, u32 bgnum)
 }
 
 template<bool mosaic>
-void GPU2D_NeonSoft::DrawBG_Affine(u32 line, u32 bgnum)
+void NeonSoftRenderer::DrawBG_Affine(u32 line, u32 bgnum)
 {
-    u16 bgcnt = BGCnt[bgnum];
+    u16 bgcnt = CurUnit->BGCnt[bgnum];
 
     u32 tilesetaddr, tilemapaddr;
 
@@ -1297,16 +1423,16 @@ void GPU2D_NeonSoft::DrawBG_Affine(u32 line, u32 bgnum)
     if (bgcnt & 0x2000) overflowmask = 0;
     else                overflowmask = ~(coordmask | 0x7FF);
 
-    s16 rotA = BGRotA[bgnum-2];
-    s16 rotB = BGRotB[bgnum-2];
-    s16 rotC = BGRotC[bgnum-2];
-    s16 rotD = BGRotD[bgnum-2];
+    s16 rotA = CurUnit->BGRotA[bgnum-2];
+    s16 rotB = CurUnit->BGRotB[bgnum-2];
+    s16 rotC = CurUnit->BGRotC[bgnum-2];
+    s16 rotD = CurUnit->BGRotD[bgnum-2];
 
-    s32 rotX = BGXRefInternal[bgnum-2];
-    s32 rotY = BGYRefInternal[bgnum-2];
+    s32 rotX = CurUnit->BGXRefInternal[bgnum-2];
+    s32 rotY = CurUnit->BGYRefInternal[bgnum-2];
 
-    BGXRefInternal[bgnum-2] += rotB;
-    BGYRefInternal[bgnum-2] += rotD;
+    CurUnit->BGXRefInternal[bgnum-2] += rotB;
+    CurUnit->BGYRefInternal[bgnum-2] += rotD;
 
     if (SkipRendering)
         return;
@@ -1314,23 +1440,23 @@ void GPU2D_NeonSoft::DrawBG_Affine(u32 line, u32 bgnum)
     if (bgcnt & 0x0040)
     {
         // vertical mosaic
-        rotX -= (BGMosaicY * rotB);
-        rotY -= (BGMosaicY * rotD);
+        rotX -= (CurUnit->BGMosaicY * rotB);
+        rotY -= (CurUnit->BGMosaicY * rotD);
     }
 
-    if (Num)
+    if (CurUnit->Num)
     {
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
     }
     else
     {
-        tilesetaddr = ((DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
-        tilemapaddr = ((DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
+        tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
+        tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
     }
     u8* bgvram;
     u32 bgvrammask;
-    GetBGVRAM(bgvram, bgvrammask);
+    CurUnit->GetBGVRAM(bgvram, bgvrammask);
     
     int32x4_t dx = vshlq_n_s32(vdupq_n_s32(rotA), 2);
     int32x4_t dy = vshlq_n_s32(vdupq_n_s32(rotC), 2);
@@ -1388,28 +1514,28 @@ void GPU2D_NeonSoft::DrawBG_Affine(u32 line, u32 bgnum)
 
         moveMask = vbicq_u8(vbicq_u8(windowMask, vceqzq_u8(pixels)), moveMask);
 
-        DrawPixels(&BGOBJLine[8 + i], moveMask, pixels, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80), vdupq_n_u8(1 << bgnum));
+        DrawPixels(&BGOBJLine[8 + i], moveMask, pixels, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80), vdupq_n_u8(1 << bgnum));
     }
 }
 
 template<bool mosaic>
-void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
+void NeonSoftRenderer::DrawBG_Extended(u32 line, u32 bgnum)
 {
-    u16 bgcnt = BGCnt[bgnum];
+    u16 bgcnt = CurUnit->BGCnt[bgnum];
 
     u32 tilesetaddr, tilemapaddr;
-    u32 extpal = (DispCnt & 0x40000000);
+    u32 extpal = (CurUnit->DispCnt & 0x40000000);
 
-    s16 rotA = BGRotA[bgnum-2];
-    s16 rotB = BGRotB[bgnum-2];
-    s16 rotC = BGRotC[bgnum-2];
-    s16 rotD = BGRotD[bgnum-2];
+    s16 rotA = CurUnit->BGRotA[bgnum-2];
+    s16 rotB = CurUnit->BGRotB[bgnum-2];
+    s16 rotC = CurUnit->BGRotC[bgnum-2];
+    s16 rotD = CurUnit->BGRotD[bgnum-2];
 
-    s32 rotX = BGXRefInternal[bgnum-2];
-    s32 rotY = BGYRefInternal[bgnum-2];
+    s32 rotX = CurUnit->BGXRefInternal[bgnum-2];
+    s32 rotY = CurUnit->BGYRefInternal[bgnum-2];
 
-    BGXRefInternal[bgnum-2] += rotB;
-    BGYRefInternal[bgnum-2] += rotD;
+    CurUnit->BGXRefInternal[bgnum-2] += rotB;
+    CurUnit->BGYRefInternal[bgnum-2] += rotD;
 
     if (SkipRendering)
         return;
@@ -1417,13 +1543,13 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
     if (bgcnt & 0x0040)
     {
         // vertical mosaic
-        rotX -= (BGMosaicY * rotB);
-        rotY -= (BGMosaicY * rotD);
+        rotX -= (CurUnit->BGMosaicY * rotB);
+        rotY -= (CurUnit->BGMosaicY * rotD);
     }
 
     u8* bgvram;
     u32 bgvrammask;
-    GetBGVRAM(bgvram, bgvrammask);
+    CurUnit->GetBGVRAM(bgvram, bgvrammask);
 
     int32x4_t dx = vshlq_n_s32(vdupq_n_s32(rotA), 2);
     int32x4_t dy = vshlq_n_s32(vdupq_n_s32(rotC), 2);
@@ -1575,7 +1701,7 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
                     movemask = vandq_u8(vandq_u8(movemask, vcgeq_u8(indices, overflowStart)), vcleq_u8(indices, overflowEnd));
 
                     DrawPixels(&BGOBJLine[8 + i], movemask,
-                        colors, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80),
+                        colors, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80),
                         vdupq_n_u8(1 << bgnum));
                 }
             }
@@ -1611,7 +1737,7 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
                     moveMask = vbicq_u8(vbicq_u8(windowMask, vceqzq_u8(pixels)), moveMask);
 
                     DrawPixels(&BGOBJLine[8 + i], moveMask, 
-                        pixels, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80),
+                        pixels, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80),
                         vdupq_n_u8(1 << bgnum));
                 }
             }
@@ -1654,15 +1780,15 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
                 return;
         }
 
-        if (Num)
+        if (CurUnit->Num)
         {
             tilesetaddr = ((bgcnt & 0x003C) << 12);
             tilemapaddr = ((bgcnt & 0x1F00) << 3);
         }
         else
         {
-            tilesetaddr = ((DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
-            tilemapaddr = ((DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
+            tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
+            tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
         }
 
         uint16x8_t tilenumMask = vdupq_n_u16(0x3FF);
@@ -1679,9 +1805,9 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
 
         u32 paletteOffset;
         if (extpal)
-            paletteOffset = ((Num ? GPU::VRAMFlat_BBGExtPal : GPU::VRAMFlat_ABGExtPal) - GPU::AllPaletteMemory) / 512 + bgnum * 16;
+            paletteOffset = ((CurUnit->Num ? GPU::VRAMFlat_BBGExtPal : GPU::VRAMFlat_ABGExtPal) - GPU::AllPaletteMemory) / 512 + bgnum * 16;
         else
-            paletteOffset = Num ? 2 : 0;
+            paletteOffset = CurUnit->Num ? 2 : 0;
         uint8x16_t vecPaletteOffset = vdupq_n_u8(paletteOffset);
 
         for (int i = 0; i < 256; i += 32)
@@ -1765,9 +1891,9 @@ void GPU2D_NeonSoft::DrawBG_Extended(u32 line, u32 bgnum)
 }
 
 template <bool mosaic>
-void GPU2D_NeonSoft::DrawBG_Large(u32 line)
+void NeonSoftRenderer::DrawBG_Large(u32 line)
 {
-    u16 bgcnt = BGCnt[2];
+    u16 bgcnt = CurUnit->BGCnt[2];
 
     // large BG sizes:
     // 0: 512x1024
@@ -1796,16 +1922,16 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
         ofymask = ~ymask;
     }
 
-    s16 rotA = BGRotA[0];
-    s16 rotB = BGRotB[0];
-    s16 rotC = BGRotC[0];
-    s16 rotD = BGRotD[0];
+    s16 rotA = CurUnit->BGRotA[0];
+    s16 rotB = CurUnit->BGRotB[0];
+    s16 rotC = CurUnit->BGRotC[0];
+    s16 rotD = CurUnit->BGRotD[0];
 
-    s32 rotX = BGXRefInternal[0];
-    s32 rotY = BGYRefInternal[0];
+    s32 rotX = CurUnit->BGXRefInternal[0];
+    s32 rotY = CurUnit->BGYRefInternal[0];
 
-    BGXRefInternal[0] += rotB;
-    BGYRefInternal[0] += rotD;
+    CurUnit->BGXRefInternal[0] += rotB;
+    CurUnit->BGYRefInternal[0] += rotD;
 
     if (SkipRendering)
         return;
@@ -1813,8 +1939,8 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
     if (bgcnt & 0x0040)
     {
         // vertical mosaic
-        rotX -= (BGMosaicY * rotB);
-        rotY -= (BGMosaicY * rotD);
+        rotX -= (CurUnit->BGMosaicY * rotB);
+        rotY -= (CurUnit->BGMosaicY * rotD);
     }
 
     const int32x4_t factorDist = {0, 1, 2, 3};
@@ -1833,7 +1959,7 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
 
     u8* bgvram;
     u32 bgvrammask;
-    GetBGVRAM(bgvram, bgvrammask);
+    CurUnit->GetBGVRAM(bgvram, bgvrammask);
 
     // 256-color bitmap
     for (int i = 0; i < 256; i += 16)
@@ -1853,7 +1979,7 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
                     vshlq_s32(vshrq_n_s32(vandq_s32(vecRotY, vecYMask), 8), vecYShift), 
                     vshrq_n_s32(vandq_s32(vecRotX, vecXMask), 8));
 
-            unroll4(k, pixels = vld1q_lane_u8(bgvram + offset[k], pixels, j * 4 + k);)
+            unroll4(k, pixels = vld1q_lane_u8(bgvram + (offset[k] & bgvrammask), pixels, j * 4 + k);)
 
             vecRotX = vaddq_s32(vecRotX, dx);
             vecRotY = vaddq_s32(vecRotY, dy);
@@ -1863,7 +1989,7 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
         moveMask = vbicq_u8(vbicq_u8(windowMask, vceqzq_u8(pixels)), moveMask);
 
         DrawPixels(&BGOBJLine[8 + i], moveMask, 
-            pixels, vdupq_n_u8(Num ? 2 : 0), vdupq_n_u8(0x80),
+            pixels, vdupq_n_u8(CurUnit->Num ? 2 : 0), vdupq_n_u8(0x80),
             vdupq_n_u8(0x4));
     }
 }
@@ -1877,8 +2003,10 @@ void GPU2D_NeonSoft::DrawBG_Large(u32 line)
     { \
         DrawSprite_##type<false>(__VA_ARGS__); \
     }
-void GPU2D_NeonSoft::DrawSprites(u32 line)
+void NeonSoftRenderer::DrawSprites(u32 line, Unit* unit)
 {
+    CurUnit = unit;
+
     if (line == 0)
     {
         // reset those counters here
@@ -1887,36 +2015,39 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
         // however, sprites are rendered one scanline in advance
         // so they need to be reset a bit earlier
 
-        OBJMosaicY = 0;
-        OBJMosaicYCount = 0;
+        CurUnit->OBJMosaicY = 0;
+        CurUnit->OBJMosaicYCount = 0;
     }
 
-    if (Num == 0)
+    if (!ExternalVRAMSync)
     {
-        auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
-        GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
-    }
-    else
-    {
-        auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
-        GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
+        if (CurUnit->Num == 0)
+        {
+            auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
+            GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
+        }
+        else
+        {
+            auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
+            GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
+        }
     }
 
-    SemiTransBitmapSprites = SemiTransTileSprites = false;
+    SemiTransBitmapSprites[CurUnit->Num] = SemiTransTileSprites[CurUnit->Num] = false;
 
-    NumSprites[0] = NumSprites[1] = NumSprites[2] = NumSprites[3] = 0;
-    memset(OBJLine, 0, 272*4);
-    memset(OBJWindow, 0, 272);
+    NumSprites[CurUnit->Num][0] = NumSprites[CurUnit->Num][1] = NumSprites[CurUnit->Num][2] = NumSprites[CurUnit->Num][3] = 0;
+    memset(OBJLine[CurUnit->Num], 0, 272*4);
+    memset(OBJWindow[CurUnit->Num], 0, 272);
 
-    if (!(DispCnt & 0x1000)) return;
+    if (!(CurUnit->DispCnt & 0x1000)) return;
 
-    memset(OBJIndex, 0xFF, 272);
+    memset(OBJIndex[CurUnit->Num], 0xFF, 272);
 
-    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
 
-    if (GPU::OAMDirty & (1 << Num))
+    if (*OAMDirtyMem & (1 << CurUnit->Num))
     {
-        NumSpritesPerLayer[0] = NumSpritesPerLayer[1] = NumSpritesPerLayer[2] = NumSpritesPerLayer[3] = 0;
+        NumSpritesPerLayer[CurUnit->Num][0] = NumSpritesPerLayer[CurUnit->Num][1] = NumSpritesPerLayer[CurUnit->Num][2] = NumSpritesPerLayer[CurUnit->Num][3] = 0;
         for (int i = 127; i >= 0; i--)
         {
             u16* attrib = &oam[i*4];
@@ -1925,10 +2056,10 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
                 continue;
 
             u32 bgnum = 3 - ((attrib[2] & 0x0C00) >> 10);
-            u32 index = NumSpritesPerLayer[bgnum]++;
-            SpriteCache[bgnum][index] = i;
+            u32 index = NumSpritesPerLayer[CurUnit->Num][bgnum]++;
+            SpriteCache[CurUnit->Num][bgnum][index] = i;
         }
-        GPU::OAMDirty &= ~(1 << Num);
+        *OAMDirtyMem &= ~(1 << CurUnit->Num);
     }
 
     const s32 spritewidth[16] =
@@ -1948,9 +2079,9 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
 
     for (int bgnum = 0; bgnum < 4; bgnum++)
     {
-        for (int i = 0; i < NumSpritesPerLayer[bgnum]; i++)
+        for (int i = 0; i < NumSpritesPerLayer[CurUnit->Num][bgnum]; i++)
         {
-            u32 sprnum = SpriteCache[bgnum][i];
+            u32 sprnum = SpriteCache[CurUnit->Num][bgnum][i];
             u16* attrib = &oam[sprnum*4];
 
             bool iswin = (((attrib[0] >> 10) & 0x3) == 2);
@@ -1959,7 +2090,7 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
             if ((attrib[0] & 0x1000) && !iswin)
             {
                 // apply Y mosaic
-                sprline = OBJMosaicY;
+                sprline = CurUnit->OBJMosaicY;
             }
             else
                 sprline = line;
@@ -1991,7 +2122,7 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
 
                 DoDrawSprite(Rotscale, sprnum, boundwidth, boundheight, width, height, xpos, ypos);
 
-                NumSprites[3 - bgnum]++;
+                NumSprites[CurUnit->Num][3 - bgnum]++;
             }
             else
             {
@@ -2010,7 +2141,7 @@ void GPU2D_NeonSoft::DrawSprites(u32 line)
 
                 DoDrawSprite(Normal, sprnum, width, height, xpos, ypos);
 
-                NumSprites[3 - bgnum]++;
+                NumSprites[CurUnit->Num][3 - bgnum]++;
             }
         }
     }
@@ -2030,8 +2161,9 @@ inline void DrawSpritePixels(u32* objlinePtr, u8* objindicesPtr, uint8x16_t move
     objline.val[2] = vbslq_u8(moveMask, tertiary, objline.val[2]);
     objline.val[3] = vbslq_u8(moveMask, quaternary, objline.val[3]);
 
-    objline.val[2] = vbslq_u8(vbicq_u8(objlineEmpty, moveMask), tertiaryTrans, objline.val[2]);
-    indices = vbslq_u8(vorrq_u8(objlineEmpty, moveMask), index, indices);
+    uint8x16_t transMask = vandq_u8(objlineEmpty, vtstq_u8(tertiaryTrans, tertiaryTrans));
+    objline.val[2] = vbslq_u8(vbicq_u8(transMask, moveMask), tertiaryTrans, objline.val[2]);
+    indices = vbslq_u8(vorrq_u8(transMask, moveMask), index, indices);
 
     vst4q_u8((u8*)objlinePtr, objline);
     vst1q_u8(objindicesPtr, indices);
@@ -2043,15 +2175,16 @@ inline void DrawSpritePixelsHalf(u32* objlinePtr, u8* objindicesPtr, uint8x8_t m
     uint8x8x4_t objline = vld4_u8((u8*)objlinePtr);
     uint8x8_t indices = vld1_u8(objindicesPtr);
 
-    uint8x8_t objlineEmpty = vceqz_u8(objline.val[3]);
+    uint8x8_t objlineEmpty = vceqz_u8(objline.val[2]);
 
     objline.val[0] = vbsl_u8(moveMask, primary, objline.val[0]);
     objline.val[1] = vbsl_u8(moveMask, secondary, objline.val[1]);
     objline.val[2] = vbsl_u8(moveMask, tertiary, objline.val[2]);
     objline.val[3] = vbsl_u8(moveMask, quaternary, objline.val[3]);
 
-    objline.val[2] = vbsl_u8(vbic_u8(objlineEmpty, moveMask), tertiaryTrans, objline.val[2]);
-    indices = vbsl_u8(vorr_u8(objlineEmpty, moveMask), index, indices);
+    uint8x8_t transMask = vand_u8(objlineEmpty, vtst_u8(tertiaryTrans, tertiaryTrans));
+    objline.val[2] = vbsl_u8(vbic_u8(transMask, moveMask), tertiaryTrans, objline.val[2]);
+    indices = vbsl_u8(vorr_u8(transMask, moveMask), index, indices);
 
     vst4_u8((u8*)objlinePtr, objline);
     vst1_u8(objindicesPtr, indices);
@@ -2070,9 +2203,9 @@ inline void DrawSpritePixelsWindowHalf(u8* windowPtr, uint8x8_t moveMask)
 }
 
 template<bool window>
-void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos)
+void NeonSoftRenderer::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
 
     u8 compositorFlag = 0;
@@ -2123,7 +2256,7 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         if (!alpha) return;
         alpha++;
 
-        SemiTransBitmapSprites |= alpha < 16;
+        SemiTransBitmapSprites[CurUnit->Num] |= alpha < 16;
 
         compositorFlag |= alpha | 0xC0;
 
@@ -2131,9 +2264,9 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         uint8x16_t vecSpriteFlags = vdupq_n_u8(spriteFlags);
         uint8x16_t vecSpriteFlagsTrans = vdupq_n_u8(spriteFlags & 0x18);
 
-        if (DispCnt & 0x40)
+        if (CurUnit->DispCnt & 0x40)
         {
-            if (DispCnt & 0x20)
+            if (CurUnit->DispCnt & 0x20)
             {
                 // 'reserved'
                 // draws nothing
@@ -2141,13 +2274,13 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
             }
             else
             {
-                tilenum <<= (7 + ((DispCnt >> 22) & 0x1));
+                tilenum <<= (7 + ((CurUnit->DispCnt >> 22) & 0x1));
                 tilenum += (ypos * width * 2);
             }
         }
         else
         {
-            if (DispCnt & 0x20)
+            if (CurUnit->DispCnt & 0x20)
             {
                 tilenum = ((tilenum & 0x01F) << 4) + ((tilenum & 0x3E0) << 7);
                 tilenum += (ypos * 256 * 2);
@@ -2159,30 +2292,30 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
             }
         }
 
-        u8* pixelsptr;
+        u8* objvram;
         u32 vrammask;
-        GetOBJVRAM(pixelsptr, vrammask);
-        pixelsptr += tilenum & vrammask;
+        CurUnit->GetOBJVRAM(objvram, vrammask);
+        u32 pixelsaddr = tilenum;
         s32 pixelstride;
         if (attrib[1] & 0x1000) // xflip
         {
-            pixelsptr += (width << 1);
-            pixelsptr -= (xoff << 1);
-            pixelsptr -= 16;
+            pixelsaddr += (width << 1);
+            pixelsaddr -= (xoff << 1);
+            pixelsaddr -= 16;
             pixelstride = -16;
         }
         else
         {
-            pixelsptr += (xoff << 1);
+            pixelsaddr += (xoff << 1);
             pixelstride = 16;
         }
 
         for (; xleft >= 16; xleft -= 16)
         {
-            uint8x8x2_t pixels0 = vld2_u8(pixelsptr);
-            pixelsptr += pixelstride;
-            uint8x8x2_t pixels1 = vld2_u8(pixelsptr);
-            pixelsptr += pixelstride;
+            uint8x8x2_t pixels0 = vld2_u8(objvram + (pixelsaddr & vrammask));
+            pixelsaddr += pixelstride;
+            uint8x8x2_t pixels1 = vld2_u8(objvram + (pixelsaddr & vrammask));
+            pixelsaddr += pixelstride;
 
             uint8x16_t pixelsLo = vcombine_u8(pixels0.val[0], pixels1.val[0]);
             uint8x16_t pixelsHi = vcombine_u8(pixels0.val[1], pixels1.val[1]);
@@ -2193,9 +2326,9 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
             uint8x16_t moveMask = vtstq_u8(pixelsHi, vdupq_n_u8(0x80));
 
             if (window)
-                DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
             else
-                DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos], 
+                DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], 
                     moveMask, pixelsLo, pixelsHi, vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, 
                     vecIndex);
 
@@ -2203,8 +2336,8 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         }
         if (xleft == 8)
         {
-            uint8x8x2_t pixels = vld2_u8(pixelsptr);
-            pixelsptr += pixelstride;
+            uint8x8x2_t pixels = vld2_u8(objvram + (pixelsaddr & vrammask));
+            pixelsaddr += pixelstride;
 
             pixels.val[0] = vbsl_u8(vget_low_u8(hflipMask), vrev64_u8(pixels.val[0]), pixels.val[0]);
             pixels.val[1] = vbsl_u8(vget_low_u8(hflipMask), vrev64_u8(pixels.val[1]), pixels.val[1]);
@@ -2212,9 +2345,9 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
             uint8x8_t moveMask = vtst_u8(pixels.val[1], vdup_n_u8(0x80));
 
             if (window)
-                DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
             else
-                DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos], 
+                DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], 
                     moveMask, pixels.val[0], pixels.val[1], vget_low_u8(vecSpriteFlags), 
                     vget_low_u8(vecCompositorFlags), vget_low_u8(vecSpriteFlagsTrans), vget_low_u8(vecIndex));
             xpos += 8;
@@ -2223,9 +2356,9 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
     }
     else
     {
-        if (DispCnt & 0x10)
+        if (CurUnit->DispCnt & 0x10)
         {
-            tilenum <<= ((DispCnt >> 20) & 0x3);
+            tilenum <<= ((CurUnit->DispCnt >> 20) & 0x3);
             tilenum += ((ypos >> 3) * (width >> 3)) << ((attrib[0] & 0x2000) ? 1:0);
         }
         else
@@ -2236,7 +2369,7 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         // compositor flag (semi transparent or not)
         if (spritemode == 1)
         {
-            SemiTransTileSprites = true;
+            SemiTransTileSprites[CurUnit->Num] = true;
             compositorFlag |= 0x80;
         }
         else
@@ -2250,73 +2383,73 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         if (attrib[0] & 0x2000)
         {
             // 256-color
-            u8* pixelsptr;
+            u8* objvram;
             u32 vrammask;
-            GetOBJVRAM(pixelsptr, vrammask);
-            pixelsptr += (tilenum << 5) + ((ypos & 0x7) << 3);
+            CurUnit->GetOBJVRAM(objvram, vrammask);
+            u32 pixelsaddr = (tilenum << 5) + ((ypos & 0x7) << 3);
 
             s32 pixelstride;
             if (attrib[1] & 0x1000) // xflip
             {
-                pixelsptr += (((width-1) & wmask) << 3);
-                pixelsptr -= ((xoff & wmask) << 3);
+                pixelsaddr += (((width-1) & wmask) << 3);
+                pixelsaddr -= ((xoff & wmask) << 3);
                 pixelstride = -64;
             }
             else
             {
-                pixelsptr += ((xoff & wmask) << 3);
+                pixelsaddr += ((xoff & wmask) << 3);
                 pixelstride = 64;
             }
 
             u8 paletteIndex = 0;
             if (!window)
             {
-                if (DispCnt & 0x80000000)
+                if (CurUnit->DispCnt & 0x80000000)
                 {
                     u32 extPalSlot = (attrib[2] & 0xF000) >> 12;
 
-                    paletteIndex = ((Num ? GPU::VRAMFlat_BOBJExtPal : GPU::VRAMFlat_AOBJExtPal)
+                    paletteIndex = ((CurUnit->Num ? GPU::VRAMFlat_BOBJExtPal : GPU::VRAMFlat_AOBJExtPal)
                         - GPU::AllPaletteMemory) / 512 + extPalSlot;
                 }
                 else
-                    paletteIndex = Num ? 3 : 1;
+                    paletteIndex = CurUnit->Num ? 3 : 1;
             }
             uint8x16_t vecPalIndex = vdupq_n_u8(paletteIndex);
             for (; xleft >= 16; xleft -= 16)
             {
-                uint8x16x4_t objline = vld4q_u8((u8*)&OBJLine[xpos]);
-                uint8x16_t indices = vld1q_u8((u8*)&OBJIndex[xpos]);
+                uint8x16x4_t objline = vld4q_u8((u8*)&OBJLine[CurUnit->Num][xpos]);
+                uint8x16_t indices = vld1q_u8((u8*)&OBJIndex[CurUnit->Num][xpos]);
 
                 uint8x16_t pixels = vdupq_n_u8(0);
-                pixels = vreinterpretq_u8_u64(vld1q_lane_u64((uint64_t*)pixelsptr, vreinterpretq_u64_u8(pixels), 0));
-                pixelsptr += pixelstride;
-                pixels = vreinterpretq_u8_u64(vld1q_lane_u64((uint64_t*)pixelsptr, vreinterpretq_u64_u8(pixels), 1));
-                pixelsptr += pixelstride;
+                pixels = vreinterpretq_u8_u64(vld1q_lane_u64((uint64_t*)(objvram + (pixelsaddr & vrammask)), vreinterpretq_u64_u8(pixels), 0));
+                pixelsaddr += pixelstride;
+                pixels = vreinterpretq_u8_u64(vld1q_lane_u64((uint64_t*)(objvram + (pixelsaddr & vrammask)), vreinterpretq_u64_u8(pixels), 1));
+                pixelsaddr += pixelstride;
 
                 pixels = vbslq_u8(hflipMask, vrev64q_u8(pixels), pixels);
 
                 uint8x16_t moveMask = vtstq_u8(pixels, pixels);
 
                 if (window)
-                    DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos], moveMask,
-                        pixels, vecPalIndex, vecSpriteFlags, vecSpriteFlagsTrans, vecCompositorFlags, vecIndex);
+                    DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask,
+                        pixels, vecPalIndex, vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, vecIndex);
 
                 xpos += 16;
             }
             if (xleft == 8)
             {
-                uint8x8_t pixels = vld1_u8(pixelsptr);
-                pixelsptr += pixelstride;
+                uint8x8_t pixels = vld1_u8(objvram + (pixelsaddr & vrammask));
+                pixelsaddr += pixelstride;
 
                 pixels = vbsl_u8(vget_low_u8(hflipMask), vrev64_u8(pixels), pixels);
 
                 uint8x8_t moveMask = vtst_u8(pixels, pixels);
                 if (window)
-                    DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos], moveMask, 
+                    DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, 
                         pixels, vget_low_u8(vecPalIndex), vget_low_u8(vecSpriteFlags), 
                         vget_low_u8(vecCompositorFlags), vget_low_u8(vecSpriteFlagsTrans),
                         vget_low_u8(vecIndex));
@@ -2329,37 +2462,37 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
         else
         {
             // 16-color
-            u8* pixelsptr;
+            u8* objvram;
             u32 vrammask;
-            GetOBJVRAM(pixelsptr, vrammask);
-            pixelsptr += (tilenum << 5) + ((ypos & 0x7) << 2);
+            CurUnit->GetOBJVRAM(objvram, vrammask);
+            u32 pixelsaddr = (tilenum << 5) + ((ypos & 0x7) << 2);
 
             s32 pixelstride;
             if (attrib[1] & 0x1000) // xflip
             {
-                pixelsptr += (((width-1) & wmask) << 2);
-                pixelsptr -= ((xoff & wmask) << 2);
+                pixelsaddr += (((width-1) & wmask) << 2);
+                pixelsaddr -= ((xoff & wmask) << 2);
                 pixelstride = -32;
             }
             else
             {
-                pixelsptr += ((xoff & wmask) << 2);
+                pixelsaddr += ((xoff & wmask) << 2);
                 pixelstride = 32;
             }
 
-            u8 paletteIndex = Num ? 3 : 1;
+            u8 paletteIndex = CurUnit->Num ? 3 : 1;
             uint8x16_t paletteOffset = vdupq_n_u8((attrib[2] & 0xF000) >> 8);
             uint8x16_t paletteIndexVec = vdupq_n_u8(paletteIndex);
             for (; xleft >= 16; xleft -= 16)
             {
-                uint8x16x4_t objline = vld4q_u8((u8*)&OBJLine[xpos]);
-                uint8x16_t indices = vld1q_u8((u8*)&OBJIndex[xpos]);
+                uint8x16x4_t objline = vld4q_u8((u8*)&OBJLine[CurUnit->Num][xpos]);
+                uint8x16_t indices = vld1q_u8((u8*)&OBJIndex[CurUnit->Num][xpos]);
 
                 uint8x8_t pixels4Bit;
-                pixels4Bit = vreinterpret_u8_u32(vld1_lane_u32((u32*)pixelsptr, vreinterpret_u32_u8(pixels4Bit), 0));
-                pixelsptr += pixelstride;
-                pixels4Bit = vreinterpret_u8_u32(vld1_lane_u32((u32*)pixelsptr, vreinterpret_u32_u8(pixels4Bit), 1));
-                pixelsptr += pixelstride;
+                pixels4Bit = vreinterpret_u8_u32(vld1_lane_u32((u32*)(objvram + (pixelsaddr & vrammask)), vreinterpret_u32_u8(pixels4Bit), 0));
+                pixelsaddr += pixelstride;
+                pixels4Bit = vreinterpret_u8_u32(vld1_lane_u32((u32*)(objvram + (pixelsaddr & vrammask)), vreinterpret_u32_u8(pixels4Bit), 1));
+                pixelsaddr += pixelstride;
 
                 uint8x16_t pixels = vzip1q_u8(
                     vcombine_u8(vand_u8(pixels4Bit, vdup_n_u8(0xF)), vdup_n_u8(0)), 
@@ -2369,30 +2502,30 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
                 uint8x16_t moveMask = vtstq_u8(pixels, pixels);
 
                 if (window)
-                    DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos],
+                    DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos],
                         moveMask, vaddq_u8(pixels, paletteOffset), 
                         paletteIndexVec, vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, vecIndex);
                 xpos += 16;
             }
             if (xleft == 8)
             {
-                uint8x8x4_t objline = vld4_u8((u8*)&OBJLine[xpos]);
-                uint8x8_t indices = vld1_u8((u8*)&OBJIndex[xpos]);
+                uint8x8x4_t objline = vld4_u8((u8*)&OBJLine[CurUnit->Num][xpos]);
+                uint8x8_t indices = vld1_u8((u8*)&OBJIndex[CurUnit->Num][xpos]);
 
                 uint8x8_t pixels;
-                pixels = vreinterpret_u8_u32(vld1_dup_u32((u32*)pixelsptr));
-                pixelsptr += pixelstride;
+                pixels = vreinterpret_u8_u32(vld1_dup_u32((u32*)(objvram + (pixelsaddr & vrammask))));
+                pixelsaddr += pixelstride;
 
                 pixels = vzip1_u8(vand_u8(pixels, vdup_n_u8(0xF)), vshr_n_u8(pixels, 4));
                 pixels = vbsl_u8(vget_low_u8(hflipMask), vrev64_u8(pixels), pixels);
 
                 uint8x8_t moveMask = vtst_u8(pixels, pixels);
                 if (window)
-                    DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos],
+                    DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos],
                         moveMask, vadd_u8(pixels, vget_low_u8(paletteOffset)), 
                         vget_low_u8(paletteIndexVec), vget_low_u8(vecSpriteFlags), 
                         vget_low_u8(vecCompositorFlags), vget_low_u8(vecSpriteFlagsTrans),
@@ -2408,14 +2541,14 @@ void GPU2D_NeonSoft::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos,
 
 
 template<bool window>
-void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos)
+void NeonSoftRenderer::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
     u16* rotparams = &oam[(((attrib[1] >> 9) & 0x1F) * 16) + 3];
 
     u8 compositorFlags = 0;
-    u8 spriteFlags = ((attrib[2] & 0x0C00) >> 10) | 0xC;
+    u8 spriteFlags = ((attrib[2] & 0x0C00) >> 10) | 0x14;
     u32 tilenum = attrib[2] & 0x03FF;
     u32 spritemode = window ? 0 : ((attrib[0] >> 10) & 0x3);
 
@@ -2476,15 +2609,15 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
 
         compositorFlags |= 0xC0 | alpha;
 
-        SemiTransBitmapSprites |= alpha < 16;
+        SemiTransBitmapSprites[CurUnit->Num] |= alpha < 16;
 
         uint8x16_t vecCompositorFlags = vdupq_n_u8(compositorFlags);
         uint8x16_t vecSpriteFlags = vdupq_n_u8(spriteFlags);
         uint8x16_t vecSpriteFlagsTrans = vdupq_n_u8(spriteFlags & 0x18);
 
-        if (DispCnt & 0x40)
+        if (CurUnit->DispCnt & 0x40)
         {
-            if (DispCnt & 0x20)
+            if (CurUnit->DispCnt & 0x20)
             {
                 // 'reserved'
                 // draws nothing
@@ -2493,13 +2626,13 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
             }
             else
             {
-                tilenum <<= (7 + ((DispCnt >> 22) & 0x1));
-                ytilefactor = ((width >> 8) * 2);
+                tilenum <<= (7 + ((CurUnit->DispCnt >> 22) & 0x1));
+                ytilefactor = (width * 2);
             }
         }
         else
         {
-            if (DispCnt & 0x20)
+            if (CurUnit->DispCnt & 0x20)
             {
                 tilenum = ((tilenum & 0x01F) << 4) + ((tilenum & 0x3E0) << 7);
                 ytilefactor = (256 * 2);
@@ -2512,10 +2645,9 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
         }
 
         uint16x8_t vecYTileFactor = vdupq_n_u16(ytilefactor);
-        u8* pixelsptr;
+        u8* objvram;
         u32 vrammask;
-        GetOBJVRAM(pixelsptr, vrammask);
-        pixelsptr += tilenum;
+        CurUnit->GetOBJVRAM(objvram, vrammask);
 
         for (; xleft >= 16; xleft -= 16)
         {
@@ -2552,15 +2684,16 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
 
             uint8x16x2_t pixels;
             unroll2(j, unroll8(k,
-                    pixels = vld2q_lane_u8(pixelsptr + offsets.val[j][k], pixels, j * 8 + k);))
+                    pixels = vld2q_lane_u8(objvram + ((tilenum + offsets.val[j][k]) & vrammask), pixels, j * 8 + k);))
 
+            uint8x16_t spriteFlagsTrans = vbicq_u8(vecSpriteFlagsTrans, moveMask);
             moveMask = vbicq_u8(vtstq_u8(pixels.val[1], vdupq_n_u8(0x80)), moveMask);
 
             if (window)
-                DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
             else
-                DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos], moveMask, pixels.val[0], 
-                    pixels.val[1], vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, vecIndex);
+                DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, pixels.val[0], 
+                    pixels.val[1], vecSpriteFlags, vecCompositorFlags, spriteFlagsTrans, vecIndex);
 
             xpos += 16;
         }
@@ -2587,25 +2720,25 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
             vecRotY = vaddq_s32(tweenRotY, dy);
 
             uint8x8x2_t pixels;
-            unroll8(j, pixels = vld2_lane_u8(pixelsptr + offsets[j], pixels, j);)
+            unroll8(j, pixels = vld2_lane_u8(objvram + ((tilenum + offsets[j]) & vrammask), pixels, j);)
 
-            uint8x8_t moveMask = vbic_u8(vtst_u8(pixels.val[1], vdup_n_u8(0x80)), moveMask);
+            uint8x8_t moveMask = vbic_u8(vtst_u8(pixels.val[1], vdup_n_u8(0x80)), vmovn_u16(outsideBounds));
 
             if (window)
-                DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
             else
-                DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos], moveMask, pixels.val[0], 
+                DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, pixels.val[0], 
                     pixels.val[1], vget_low_u8(vecSpriteFlags), vget_low_u8(vecCompositorFlags), 
-                    vget_low_u8(vecSpriteFlagsTrans), vget_low_u8(vecIndex));
+                    vbic_u8(vget_low_u8(vecSpriteFlagsTrans), vmovn_u16(outsideBounds)), vget_low_u8(vecIndex));
 
             xpos += 8;
         }
     }
     else
     {
-        if (DispCnt & 0x10)
+        if (CurUnit->DispCnt & 0x10)
         {
-            tilenum <<= ((DispCnt >> 20) & 0x3);
+            tilenum <<= ((CurUnit->DispCnt >> 20) & 0x3);
             ytilefactor = (width >> 3) << ((attrib[0] & 0x2000) ? 1:0);
         }
         else
@@ -2615,7 +2748,7 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
 
         if (spritemode == 1)
         {
-            SemiTransTileSprites = true;
+            SemiTransTileSprites[CurUnit->Num] = true;
             compositorFlags |= 0x80;
         }
         else
@@ -2632,23 +2765,22 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
             // 256-color
             tilenum <<= 5;
             ytilefactor <<= 5;
-            u8* pixelsptr;
+            u8* objvram;
             u32 vrammask;
-            GetOBJVRAM(pixelsptr, vrammask);
-            pixelsptr += tilenum;
+            CurUnit->GetOBJVRAM(objvram, vrammask);
 
             u32 paletteIndex = 0;
             if (!window)
             {
-                if (DispCnt & 0x80000000)
+                if (CurUnit->DispCnt & 0x80000000)
                 {
                     u32 extPalSlot = (attrib[2] & 0xF000) >> 12;
 
-                    paletteIndex = ((Num ? GPU::VRAMFlat_BOBJExtPal : GPU::VRAMFlat_AOBJExtPal)
+                    paletteIndex = ((CurUnit->Num ? GPU::VRAMFlat_BOBJExtPal : GPU::VRAMFlat_AOBJExtPal)
                         - GPU::AllPaletteMemory) / 512 + extPalSlot;
                 }
                 else
-                    paletteIndex = Num ? 3 : 1;
+                    paletteIndex = CurUnit->Num ? 3 : 1;
             }
 
             uint8x16_t vecPaletteIndex = vdupq_n_u8(paletteIndex);
@@ -2694,16 +2826,17 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
 
                 uint8x16_t pixels = vdupq_n_u8(0);
                 unroll2(j, unroll8(k,
-                        pixels = vld1q_lane_u8(pixelsptr + offsets.val[j][k], pixels, j * 8 + k);
+                        pixels = vld1q_lane_u8(objvram + ((tilenum + offsets.val[j][k]) & vrammask), pixels, j * 8 + k);
                 ))
 
+                uint8x16_t spriteFlagsTrans = vbicq_u8(vecSpriteFlagsTrans, moveMask);
                 moveMask = vbicq_u8(vtstq_u8(pixels, pixels), moveMask);
 
                 if (window)
-                    DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos], moveMask, pixels, 
-                        vecPaletteIndex, vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, vecIndex);
+                    DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, pixels, 
+                        vecPaletteIndex, vecSpriteFlags, vecCompositorFlags, spriteFlagsTrans, vecIndex);
 
                 xpos += 16;
             }
@@ -2733,16 +2866,16 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
 
                 uint8x8_t pixels;
                 unroll8(j,
-                    pixels = vld1_lane_u8(pixelsptr + offsets[j], pixels, j);)
+                    pixels = vld1_lane_u8(objvram + ((tilenum + offsets[j]) & vrammask), pixels, j);)
 
                 uint8x8_t moveMask = vbic_u8(vtst_u8(pixels, pixels), vmovn_u16(outsideBounds));
 
                 if (window)
-                    DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos], moveMask, pixels,
+                    DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, pixels,
                         vget_low_u8(vecPaletteIndex), vget_low_u8(vecSpriteFlags), vget_low_u8(vecCompositorFlags),
-                        vget_low_u8(vecSpriteFlagsTrans), vget_low_u8(vecIndex));
+                        vbic_u8(vget_low_u8(vecSpriteFlagsTrans), vmovn_u16(outsideBounds)), vget_low_u8(vecIndex));
 
                 xpos += 8;
             }
@@ -2752,17 +2885,16 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
             // 16-color
             tilenum <<= 5;
             ytilefactor <<= 5;
-            u8* pixelsptr;
+            u8* objvram;
             u32 vrammask;
-            GetOBJVRAM(pixelsptr, vrammask);
-            pixelsptr += tilenum;
+            CurUnit->GetOBJVRAM(objvram, vrammask);
 
             uint16x8_t vecYTileFactor = vdupq_n_u16(ytilefactor);
 
             uint16x8_t tileMaskX = vdupq_n_u16(0x3);
             uint16x8_t tileMaskY = vdupq_n_u16(0x1C);
 
-            uint8x16_t vecPaletteIndex = vdupq_n_u8(Num ? 3 : 1);
+            uint8x16_t vecPaletteIndex = vdupq_n_u8(CurUnit->Num ? 3 : 1);
             uint8x16_t colorOffset = vdupq_n_u8((attrib[2] & 0xF000) >> 8);
 
             for (; xleft >= 16; xleft -= 16)
@@ -2811,17 +2943,18 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
                 uint8x16_t pixels = vdupq_n_u8(0);
                 unroll2(j,
                     unroll8(k,
-                        pixels = vld1q_lane_u8(pixelsptr + offsets.val[j][k], pixels, j * 8 + k);
+                        pixels = vld1q_lane_u8(objvram + ((tilenum + offsets.val[j][k]) & vrammask), pixels, j * 8 + k);
                 ))
                 pixels = vbslq_u8(evenPixel, vshrq_n_u8(vshlq_n_u8(pixels, 4), 4), vshrq_n_u8(pixels, 4));
 
+                uint8x16_t spriteFlagsTrans = vbicq_u8(vecSpriteFlagsTrans, moveMask);
                 moveMask = vbicq_u8(vtstq_u8(pixels, pixels), moveMask);
 
                 if (window)
-                    DrawSpritePixelsWindow(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindow(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixels(&OBJLine[xpos], &OBJIndex[xpos], moveMask, vaddq_u8(pixels, colorOffset), 
-                        vecPaletteIndex, vecSpriteFlags, vecCompositorFlags, vecSpriteFlagsTrans, vecIndex);
+                    DrawSpritePixels(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, vaddq_u8(pixels, colorOffset), 
+                        vecPaletteIndex, vecSpriteFlags, vecCompositorFlags, spriteFlagsTrans, vecIndex);
                 xpos += 16;
             }
             if (xleft == 8)
@@ -2854,19 +2987,29 @@ void GPU2D_NeonSoft::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheigh
                 vecRotY = vaddq_s32(tweenRotY, dy);
 
                 uint8x8_t pixels;
-                unroll8(j, pixels = vld1_lane_u8(pixelsptr + offsets[j], pixels, j);)
+                unroll8(j, pixels = vld1_lane_u8(objvram + ((tilenum + offsets[j]) & vrammask), pixels, j);)
                 pixels = vbsl_u8(evenPixel, vshr_n_u8(vshl_n_u8(pixels, 4), 4), vshr_n_u8(pixels, 4));
 
                 uint8x8_t moveMask = vbic_u8(vtst_u8(pixels, pixels), vmovn_u16(outsideBounds));
 
                 if (window)
-                    DrawSpritePixelsWindowHalf(&OBJWindow[xpos], moveMask);
+                    DrawSpritePixelsWindowHalf(&OBJWindow[CurUnit->Num][xpos], moveMask);
                 else
-                    DrawSpritePixelsHalf(&OBJLine[xpos], &OBJIndex[xpos], moveMask, vadd_u8(pixels, vget_low_u8(colorOffset)), 
+                    DrawSpritePixelsHalf(&OBJLine[CurUnit->Num][xpos], &OBJIndex[CurUnit->Num][xpos], moveMask, vadd_u8(pixels, vget_low_u8(colorOffset)), 
                         vget_low_u8(vecPaletteIndex), vget_low_u8(vecSpriteFlags), vget_low_u8(vecCompositorFlags), 
-                        vget_low_u8(vecSpriteFlagsTrans), vget_low_u8(vecIndex));
+                        vbic_u8(vget_low_u8(vecSpriteFlagsTrans), vmovn_u16(outsideBounds)), vget_low_u8(vecIndex));
                 xpos += 8;
             }
         }
     }
-}
\ No newline at end of file
+}
+
+}
+
+#ifdef __x86_64__
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
@@ -3,70 +3,91 @@
 
 #include "GPU2D.h"
 
-class GPU2D_NeonSoft : public GPU2D
+// on x86_64 the renderer is built for SSE4.1 (see GPU2D_NeonSoft.cpp).
+// templates which are used before they're defined only get the target
+// they were declared with, so it has to be given here for them
+#ifdef __x86_64__
+#define NEONSOFT_TARGET __attribute__((target("sse4.1")))
+#else
+#define NEONSOFT_TARGET
+#endif
+
+namespace GPU2D
+{
+
+class NeonSoftRenderer : public Renderer2D
 {
 public:
-    GPU2D_NeonSoft(u32 num);
-    ~GPU2D_NeonSoft() override {}
+    NeonSoftRenderer();
+    ~NeonSoftRenderer() override {}
 
-    void DrawScanline(u32 line) override;
-    void DrawSprites(u32 line) override;
+    void Reset() override;
 
-protected:
-    void MosaicXSizeChanged() {}
+    void DrawScanline(u32 line, u32 vcount, Unit* unit) override;
+    void DrawSprites(u32 line, Unit* unit) override;
+    void VBlankEnd(Unit* unitA, Unit* unitB) override {}
 
 private:
     u32 BGOBJLine[272*2] __attribute__((aligned (16)));
     u32* _3DLine;
 
-    u32 OBJLine[272*2] __attribute__((aligned (16)));
-    u8 OBJIndex[256];
+    // sprites are drawn one scanline ahead, so this is kept per unit
+    u32 OBJLine[2][272*2] __attribute__((aligned (16)));
+    u8 OBJIndex[2][272];
+    u8 OBJWindow[2][272] __attribute__((aligned (16)));
 
     u8 WindowMask[272] __attribute__((aligned (16)));
-    u8 OBJWindow[272] __attribute__((aligned (16)));
+
+    // what a layer drawn with horizontal mosaic is drawn over
+    u32 MosaicBGOBJLine[272*2] __attribute__((aligned (16)));
+    u8 MosaicWindowMask[272] __attribute__((aligned (16)));
 
     u8 MosaicTable[16][256];
-    u8* CurBGXMosaicTable;
-    u8* CurOBJXMosaicTable;
 
-    u32 NumSprites[4];
-    u32 NumSpritesPerLayer[4];
-    u8 SpriteCache[4][128];
+    u32 NumSprites[2][4];
+    u32 NumSpritesPerLayer[2][4];
+    u8 SpriteCache[2][4][128];
 
     bool SkipRendering;
     bool _3DSemiTransparencies;
-    bool SemiTransBitmapSprites;
-    bool SemiTransTileSprites;
+    bool SemiTransBitmapSprites[2];
+    bool SemiTransTileSprites[2];
 
     template <bool Enable3DBlend, int SecondSrcBlend>
-    void ApplyColorEffect();
+    NEONSOFT_TARGET void ApplyColorEffect();
 
     void PalettiseRange(u32 start);
 
+    void ApplySpriteMosaicX();
     void InterleaveSprites(u32 prio);
 
     void DoCapture(u32 line, u32 width);
 
     template<u32 bgmode>
-    void DrawScanlineBGMode(u32 line);
+    NEONSOFT_TARGET void DrawScanlineBGMode(u32 line);
     void DrawScanlineBGMode6(u32 line);
     void DrawScanlineBGMode7(u32 line);
     void DrawScanline_BGOBJ(u32 line);
 
+    void BeginBGMosaicX(u32 bgnum);
+    void FinishBGMosaicX(u32 bgnum);
+
     void DrawBG_3D();
     template <bool mosaic>
-    void DrawBG_Text(u32 line, u32 bgnum);
+    NEONSOFT_TARGET void DrawBG_Text(u32 line, u32 bgnum);
     template <bool mosaic>
-    void DrawBG_Affine(u32 line, u32 bgnum);
+    NEONSOFT_TARGET void DrawBG_Affine(u32 line, u32 bgnum);
     template <bool mosaic>
-    void DrawBG_Extended(u32 line, u32 bgnum);
+    NEONSOFT_TARGET void DrawBG_Extended(u32 line, u32 bgnum);
     template <bool mosaic>
-    void DrawBG_Large(u32 line);
+    NEONSOFT_TARGET void DrawBG_Large(u32 line);
 
     template <bool window>
-    void DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos);
+    NEONSOFT_TARGET void DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos);
     template <bool window>
-    void DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos);
+    NEONSOFT_TARGET void DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos);
 };
 
-#endif
\ No newline at end of file
+}
+
+#endif
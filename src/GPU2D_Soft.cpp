@@ -34,6 +34,70 @@ SoftRenderer::SoftRenderer()
             MosaicTable[m][x] = offset;
         }
     }
+
+    memset(BGTileValid, 0, sizeof(BGTileValid));
+}
+
+void SoftRenderer::Reset()
+{
+    memset(BGTileValid, 0, sizeof(BGTileValid));
+}
+
+void SoftRenderer::BGVRAMUpdated(u32 num, u64* dirty)
+{
+    const u32 tilesPerBlock = GPU::VRAMDirtyGranularity / 32;
+    const u32 numBlocks = (num ? 128*1024 : 512*1024) / GPU::VRAMDirtyGranularity;
+    u32 firstTile = num ? (512*1024 / 32) : 0;
+
+    for (u32 i = 0; i < numBlocks; i++)
+    {
+        if (!(dirty[i >> 6] & (1ULL << (i & 0x3F))))
+            continue;
+
+        u32 tile = firstTile + i * tilesPerBlock;
+        BGTileValid[tile >> 6] &= ~(((1ULL << tilesPerBlock) - 1) << (tile & 0x3F));
+    }
+}
+
+u64 SoftRenderer::GetBGTileRow4bpp(u8* bgvram, u32 rowaddr)
+{
+    u32 tile = (rowaddr >> 5) + (CurUnit->Num ? (512*1024 / 32) : 0);
+    u64* rows = &BGTileCache[tile << 3];
+
+    if (!(BGTileValid[tile >> 6] & (1ULL << (tile & 0x3F))))
+    {
+        u32* src = (u32*)&bgvram[rowaddr & ~0x1F];
+        for (int i = 0; i < 8; i++)
+        {
+            // spread the 8 nibbles of the row over 8 bytes
+            u64 row = src[i];
+            row = (row | (row << 16)) & 0x0000FFFF0000FFFFULL;
+            row = (row | (row << 8)) & 0x00FF00FF00FF00FFULL;
+            row = (row | (row << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            rows[i] = row;
+        }
+
+        BGTileValid[tile >> 6] |= (1ULL << (tile & 0x3F));
+    }
+
+    return rows[(rowaddr >> 2) & 0x7];
+}
+
+// returns the color indices of one row of a tile, ordered from left to right
+u64 SoftRenderer::GetBGTileRow(u8* bgvram, u32 bgvrammask, u32 tilesetaddr, u16 tile, u32 yoff, bool is256)
+{
+    u32 tileyoff = (tile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7);
+
+    u64 row;
+    if (is256)
+        row = *(u64*)&bgvram[(tilesetaddr + ((tile & 0x03FF) << 6) + (tileyoff << 3)) & bgvrammask];
+    else
+        row = GetBGTileRow4bpp(bgvram, (tilesetaddr + ((tile & 0x03FF) << 5) + (tileyoff << 2)) & bgvrammask);
+
+    if (tile & 0x0400)
+        row = __builtin_bswap64(row);
+
+    return row;
 }
 
 u32 SoftRenderer::ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb)
@@ -168,7 +232,7 @@ u32 SoftRenderer::ColorComposite(int i, u32 val1, u32 val2)
     return val1;
 }
 
-void SoftRenderer::DrawScanline(u32 line, Unit* unit)
+void SoftRenderer::DrawScanline(u32 line, u32 vcount, Unit* unit)
 {
     CurUnit = unit;
 
@@ -176,25 +240,30 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
     u32* dst = &Framebuffer[CurUnit->Num][stride * line];
 
     int n3dline = line;
-    line = GPU::VCount;
+    line = vcount;
 
-    if (CurUnit->Num == 0)
-    {
-        auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
-        GPU::MakeVRAMFlat_ABGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
-        GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
-        GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
-    }
-    else
+    if (!ExternalVRAMSync)
     {
-        auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
-        GPU::MakeVRAMFlat_BBGCoherent(bgDirty);
-        auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
-        GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
-        auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
-        GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        if (CurUnit->Num == 0)
+        {
+            auto bgDirty = GPU::VRAMDirty_ABG.DeriveState(GPU::VRAMMap_ABG);
+            if (GPU::MakeVRAMFlat_ABGCoherent(bgDirty))
+                BGVRAMUpdated(0, bgDirty.Data);
+            auto bgExtPalDirty = GPU::VRAMDirty_ABGExtPal.DeriveState(GPU::VRAMMap_ABGExtPal);
+            GPU::MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
+            auto objExtPalDirty = GPU::VRAMDirty_AOBJExtPal.DeriveState(&GPU::VRAMMap_AOBJExtPal);
+            GPU::MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
+        }
+        else
+        {
+            auto bgDirty = GPU::VRAMDirty_BBG.DeriveState(GPU::VRAMMap_BBG);
+            if (GPU::MakeVRAMFlat_BBGCoherent(bgDirty))
+                BGVRAMUpdated(1, bgDirty.Data);
+            auto bgExtPalDirty = GPU::VRAMDirty_BBGExtPal.DeriveState(GPU::VRAMMap_BBGExtPal);
+            GPU::MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
+            auto objExtPalDirty = GPU::VRAMDirty_BOBJExtPal.DeriveState(&GPU::VRAMMap_BOBJExtPal);
+            GPU::MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        }
     }
 
     bool forceblank = false;
@@ -486,7 +555,7 @@ void SoftRenderer::DoCapture(u32 line, u32 width)
     srcBaddr &= 0xFFFF;
 
     static_assert(GPU::VRAMDirtyGranularity == 512, "");
-    GPU::VRAMDirty[dstvram][(dstaddr * 2) / GPU::VRAMDirtyGranularity] = true;
+    GPU::MarkVRAMDirty(dstvram, dstaddr * 2);
 
     switch ((captureCnt >> 29) & 0x3)
     {
@@ -763,8 +832,8 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
     }
 
     u64 backdrop;
-    if (CurUnit->Num) backdrop = *(u16*)&GPU::Palette[0x400];
-    else     backdrop = *(u16*)&GPU::Palette[0];
+    if (CurUnit->Num) backdrop = *(u16*)&PaletteMem[0x400];
+    else     backdrop = *(u16*)&PaletteMem[0];
 
     {
         u8 r = (backdrop & 0x001F) << 1;
@@ -774,8 +843,12 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
         backdrop = r | (g << 8) | (b << 16) | 0x20000000;
         backdrop |= (backdrop << 32);
 
+        // nothing is below the backdrop for it to be blended with
         for (int i = 0; i < 256; i+=2)
+        {
             *(u64*)&BGOBJLine[i] = backdrop;
+            *(u64*)&BGOBJLine[256+i] = 0;
+        }
     }
 
     if (CurUnit->DispCnt & 0xE000)
@@ -1004,14 +1077,14 @@ void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0x400];
+        pal = (u16*)&PaletteMem[0x400];
     }
     else
     {
         tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0];
+        pal = (u16*)&PaletteMem[0];
     }
 
     // adjust Y position in tilemap
@@ -1024,116 +1097,67 @@ void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
     else
         tilemapaddr += ((yoff & 0xF8) << 3);
 
+    bool is256 = bgcnt & 0x0080;
+
     u16 curtile;
-    u16* curpal;
-    u32 pixelsaddr;
-    u8 color;
+    u16* curpal = pal;
+    u64 currow = 0;
     u32 lastxpos;
 
-    if (bgcnt & 0x0080)
+    // preload shit as needed
+    if ((xoff & 0x7) || mosaic)
     {
-        // 256-color
+        curtile = *(u16*)&bgvram[(tilemapaddr + ((xoff & 0xF8) >> 2) + ((xoff & widexmask) << 3)) & bgvrammask];
 
-        // preload shit as needed
-        if ((xoff & 0x7) || mosaic)
-        {
-            curtile = *(u16*)&bgvram[(tilemapaddr + ((xoff & 0xF8) >> 2) + ((xoff & widexmask) << 3)) & bgvrammask];
+        if (!is256)     curpal = pal + ((curtile & 0xF000) >> 8);
+        else if (extpal) curpal = CurUnit->GetBGExtPal(extpalslot, curtile>>12);
+        else            curpal = pal;
 
-            if (extpal) curpal = CurUnit->GetBGExtPal(extpalslot, curtile>>12);
-            else        curpal = pal;
+        currow = GetBGTileRow(bgvram, bgvrammask, tilesetaddr, curtile, yoff, is256);
+    }
 
-            pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 6)
-                                     + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 3);
-        }
+    if (mosaic) lastxpos = xoff;
 
-        if (mosaic) lastxpos = xoff;
+    for (int i = 0; i < 256; i++)
+    {
+        u32 xpos;
+        if (mosaic) xpos = xoff - CurBGXMosaicTable[i];
+        else        xpos = xoff;
 
-        for (int i = 0; i < 256; i++)
+        if ((!mosaic && (!(xpos & 0x7))) ||
+            (mosaic && ((xpos >> 3) != (lastxpos >> 3))))
         {
-            u32 xpos;
-            if (mosaic) xpos = xoff - CurBGXMosaicTable[i];
-            else        xpos = xoff;
-
-            if ((!mosaic && (!(xpos & 0x7))) ||
-                (mosaic && ((xpos >> 3) != (lastxpos >> 3))))
-            {
-                // load a new tile
-                curtile = *(u16*)&bgvram[(tilemapaddr + ((xpos & 0xF8) >> 2) + ((xpos & widexmask) << 3)) & bgvrammask];
+            // load a new tile
+            curtile = *(u16*)&bgvram[(tilemapaddr + ((xpos & 0xF8) >> 2) + ((xpos & widexmask) << 3)) & bgvrammask];
 
-                if (extpal) curpal = CurUnit->GetBGExtPal(extpalslot, curtile>>12);
-                else        curpal = pal;
+            if (!is256)     curpal = pal + ((curtile & 0xF000) >> 8);
+            else if (extpal) curpal = CurUnit->GetBGExtPal(extpalslot, curtile>>12);
+            else            curpal = pal;
 
-                pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 6)
-                                         + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 3);
+            currow = GetBGTileRow(bgvram, bgvrammask, tilesetaddr, curtile, yoff, is256);
 
-                if (mosaic) lastxpos = xpos;
-            }
-
-            // draw pixel
-            if (WindowMask[i] & (1<<bgnum))
-            {
-                u32 tilexoff = (curtile & 0x0400) ? (7-(xpos&0x7)) : (xpos&0x7);
-                color = bgvram[(pixelsaddr + tilexoff) & bgvrammask];
-
-                if (color)
-                    drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
-            }
-
-            xoff++;
+            if (mosaic) lastxpos = xpos;
         }
-    }
-    else
-    {
-        // 16-color
 
-        // preload shit as needed
-        if ((xoff & 0x7) || mosaic)
+        if (!mosaic && !currow)
         {
-            curtile = *(u16*)&bgvram[((tilemapaddr + ((xoff & 0xF8) >> 2) + ((xoff & widexmask) << 3))) & bgvrammask];
-            curpal = pal + ((curtile & 0xF000) >> 8);
-            pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 5)
-                                     + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 2);
+            // the rest of this tile is transparent
+            u32 skip = 7 - (xpos & 0x7);
+            i += skip;
+            xoff += skip + 1;
+            continue;
         }
 
-        if (mosaic) lastxpos = xoff;
-
-        for (int i = 0; i < 256; i++)
+        // draw pixel
+        if (WindowMask[i] & (1<<bgnum))
         {
-            u32 xpos;
-            if (mosaic) xpos = xoff - CurBGXMosaicTable[i];
-            else        xpos = xoff;
-
-            if ((!mosaic && (!(xpos & 0x7))) ||
-                (mosaic && ((xpos >> 3) != (lastxpos >> 3))))
-            {
-                // load a new tile
-                curtile = *(u16*)&bgvram[(tilemapaddr + ((xpos & 0xF8) >> 2) + ((xpos & widexmask) << 3)) & bgvrammask];
-                curpal = pal + ((curtile & 0xF000) >> 8);
-                pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 5)
-                                         + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 2);
+            u8 color = currow >> ((xpos & 0x7) << 3);
 
-                if (mosaic) lastxpos = xpos;
-            }
-
-            // draw pixel
-            if (WindowMask[i] & (1<<bgnum))
-            {
-                u32 tilexoff = (curtile & 0x0400) ? (7-(xpos&0x7)) : (xpos&0x7);
-                if (tilexoff & 0x1)
-                {
-                    color = bgvram[(pixelsaddr + (tilexoff >> 1)) & bgvrammask] >> 4;
-                }
-                else
-                {
-                    color = bgvram[(pixelsaddr + (tilexoff >> 1)) & bgvrammask] & 0x0F;
-                }
-
-                if (color)
-                    drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
-            }
-
-            xoff++;
+            if (color)
+                drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
         }
+
+        xoff++;
     }
 }
 
@@ -1183,14 +1207,14 @@ void SoftRenderer::DrawBG_Affine(u32 line, u32 bgnum)
         tilesetaddr = ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0x400];
+        pal = (u16*)&PaletteMem[0x400];
     }
     else
     {
         tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
         tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-        pal = (u16*)&GPU::Palette[0];
+        pal = (u16*)&PaletteMem[0];
     }
 
     u16 curtile;
@@ -1337,8 +1361,8 @@ void SoftRenderer::DrawBG_Extended(u32 line, u32 bgnum)
         {
             // 256-color bitmap
 
-            if (CurUnit->Num) pal = (u16*)&GPU::Palette[0x400];
-            else              pal = (u16*)&GPU::Palette[0];
+            if (CurUnit->Num) pal = (u16*)&PaletteMem[0x400];
+            else              pal = (u16*)&PaletteMem[0];
 
             u8 color;
 
@@ -1396,62 +1420,99 @@ void SoftRenderer::DrawBG_Extended(u32 line, u32 bgnum)
             tilesetaddr = ((bgcnt & 0x003C) << 12);
             tilemapaddr = ((bgcnt & 0x1F00) << 3);
 
-            pal = (u16*)&GPU::Palette[0x400];
+            pal = (u16*)&PaletteMem[0x400];
         }
         else
         {
             tilesetaddr = ((CurUnit->DispCnt & 0x07000000) >> 8) + ((bgcnt & 0x003C) << 12);
             tilemapaddr = ((CurUnit->DispCnt & 0x38000000) >> 11) + ((bgcnt & 0x1F00) << 3);
 
-            pal = (u16*)&GPU::Palette[0];
+            pal = (u16*)&PaletteMem[0];
         }
 
         u16 curtile;
-        u16* curpal;
+        u16* curpal = pal;
         u8 color;
 
         yshift -= 3;
 
-        for (int i = 0; i < 256; i++)
+        if (!mosaic && rotA == 0x100 && rotC == 0)
         {
-            if (WindowMask[i] & (1<<bgnum))
+            // not rotated or scaled horizontally, so one row
+            // of each tile can be fetched at once
+            u64 currow = 0;
+
+            for (int i = 0; i < 256; i++)
             {
-                s32 finalX, finalY;
-                if (mosaic)
+                if (i == 0 || !(rotX & 0x700))
                 {
-                    int im = CurBGXMosaicTable[i];
-                    finalX = rotX - (im * rotA);
-                    finalY = rotY - (im * rotC);
+                    currow = 0;
+
+                    if (!((rotX|rotY) & overflowmask))
+                    {
+                        curtile = *(u16*)&bgvram[(tilemapaddr + (((((rotY & coordmask) >> 11) << yshift) + ((rotX & coordmask) >> 11)) << 1)) & bgvrammask];
+
+                        if (extpal) curpal = CurUnit->GetBGExtPal(bgnum, curtile>>12);
+                        else        curpal = pal;
+
+                        currow = GetBGTileRow(bgvram, bgvrammask, tilesetaddr, curtile, rotY >> 8, true);
+                    }
                 }
-                else
+
+                if (currow && (WindowMask[i] & (1<<bgnum)))
                 {
-                    finalX = rotX;
-                    finalY = rotY;
+                    color = currow >> (((rotX >> 8) & 0x7) << 3);
+
+                    if (color)
+                        drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
                 }
 
-                if ((!((finalX|finalY) & overflowmask)))
+                rotX += rotA;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                if (WindowMask[i] & (1<<bgnum))
                 {
-                    curtile = *(u16*)&bgvram[(tilemapaddr + (((((finalY & coordmask) >> 11) << yshift) + ((finalX & coordmask) >> 11)) << 1)) & bgvrammask];
+                    s32 finalX, finalY;
+                    if (mosaic)
+                    {
+                        int im = CurBGXMosaicTable[i];
+                        finalX = rotX - (im * rotA);
+                        finalY = rotY - (im * rotC);
+                    }
+                    else
+                    {
+                        finalX = rotX;
+                        finalY = rotY;
+                    }
+
+                    if ((!((finalX|finalY) & overflowmask)))
+                    {
+                        curtile = *(u16*)&bgvram[(tilemapaddr + (((((finalY & coordmask) >> 11) << yshift) + ((finalX & coordmask) >> 11)) << 1)) & bgvrammask];
 
-                    if (extpal) curpal = CurUnit->GetBGExtPal(bgnum, curtile>>12);
-                    else        curpal = pal;
+                        if (extpal) curpal = CurUnit->GetBGExtPal(bgnum, curtile>>12);
+                        else        curpal = pal;
 
-                    // draw pixel
-                    u32 tilexoff = (finalX >> 8) & 0x7;
-                    u32 tileyoff = (finalY >> 8) & 0x7;
+                        // draw pixel
+                        u32 tilexoff = (finalX >> 8) & 0x7;
+                        u32 tileyoff = (finalY >> 8) & 0x7;
 
-                    if (curtile & 0x0400) tilexoff = 7-tilexoff;
-                    if (curtile & 0x0800) tileyoff = 7-tileyoff;
+                        if (curtile & 0x0400) tilexoff = 7-tilexoff;
+                        if (curtile & 0x0800) tileyoff = 7-tileyoff;
 
-                    color = bgvram[(tilesetaddr + ((curtile & 0x03FF) << 6) + (tileyoff << 3) + tilexoff) & bgvrammask];
+                        color = bgvram[(tilesetaddr + ((curtile & 0x03FF) << 6) + (tileyoff << 3) + tilexoff) & bgvrammask];
 
-                    if (color)
-                        drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
+                        if (color)
+                            drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
+                    }
                 }
-            }
 
-            rotX += rotA;
-            rotY += rotC;
+                rotX += rotA;
+                rotY += rotC;
+            }
         }
     }
 
@@ -1514,8 +1575,8 @@ void SoftRenderer::DrawBG_Large(u32 line) // BG is always BG2
 
     // 256-color bitmap
 
-    if (CurUnit->Num) pal = (u16*)&GPU::Palette[0x400];
-    else     pal = (u16*)&GPU::Palette[0];
+    if (CurUnit->Num) pal = (u16*)&PaletteMem[0x400];
+    else     pal = (u16*)&PaletteMem[0];
 
     u8 color;
 
@@ -1593,7 +1654,7 @@ template <SoftRenderer::DrawPixel drawPixel>
 void SoftRenderer::InterleaveSprites(u32 prio)
 {
     u32* objLine = OBJLine[CurUnit->Num];
-    u16* pal = (u16*)&GPU::Palette[CurUnit->Num ? 0x600 : 0x200];
+    u16* pal = (u16*)&PaletteMem[CurUnit->Num ? 0x600 : 0x200];
 
     if (CurUnit->DispCnt & 0x80000000)
     {
@@ -1665,15 +1726,18 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
         CurUnit->OBJMosaicYCount = 0;
     }
 
-    if (CurUnit->Num == 0)
+    if (!ExternalVRAMSync)
     {
-        auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
-        GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
-    }
-    else
-    {
-        auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
-        GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
+        if (CurUnit->Num == 0)
+        {
+            auto objDirty = GPU::VRAMDirty_AOBJ.DeriveState(GPU::VRAMMap_AOBJ);
+            GPU::MakeVRAMFlat_AOBJCoherent(objDirty);
+        }
+        else
+        {
+            auto objDirty = GPU::VRAMDirty_BOBJ.DeriveState(GPU::VRAMMap_BOBJ);
+            GPU::MakeVRAMFlat_BOBJCoherent(objDirty);
+        }
     }
 
     NumSprites[CurUnit->Num] = 0;
@@ -1681,9 +1745,9 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
     memset(OBJWindow[CurUnit->Num], 0, 256);
     if (!(CurUnit->DispCnt & 0x1000)) return;
 
-    memset(OBJIndex, 0xFF, 256);
+    memset(OBJIndex[CurUnit->Num], 0xFF, 256);
 
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
 
     const s32 spritewidth[16] =
     {
@@ -1778,7 +1842,7 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 template<bool window>
 void SoftRenderer::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
     u16* rotparams = &oam[(((attrib[1] >> 9) & 0x1F) * 16) + 3];
 
@@ -2000,7 +2064,7 @@ void SoftRenderer::DrawSprite_Rotscale(u32 num, u32 boundwidth, u32 boundheight,
 template<bool window>
 void SoftRenderer::DrawSprite_Normal(u32 num, u32 width, u32 height, s32 xpos, s32 ypos)
 {
-    u16* oam = (u16*)&GPU::OAM[CurUnit->Num ? 0x400 : 0];
+    u16* oam = (u16*)&OAMMem[CurUnit->Num ? 0x400 : 0];
     u16* attrib = &oam[num * 4];
 
     u32 pixelattr = ((attrib[2] & 0x0C00) << 6) | 0xC0000;
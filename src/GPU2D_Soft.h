@@ -29,11 +29,12 @@ public:
     SoftRenderer();
     ~SoftRenderer() override {}
 
-    void Reset() override {}
+    void Reset() override;
 
-    void DrawScanline(u32 line, Unit* unit) override;
+    void DrawScanline(u32 line, u32 vcount, Unit* unit) override;
     void DrawSprites(u32 line, Unit* unit) override;
     void VBlankEnd(Unit* unitA, Unit* unitB) override;
+    void BGVRAMUpdated(u32 num, u64* dirty) override;
 private:
     alignas(8) u32 BGOBJLine[256*3];
     u32* _3DLine;
@@ -49,6 +50,15 @@ private:
     u8* CurBGXMosaicTable;
     u8 MosaicTable[16][256];
 
+    // 16-color BG tiles decoded to one byte per pixel,
+    // the tiles of unit A are followed by those of unit B
+    static const u32 BGTileCount = (512*1024 + 128*1024) / 32;
+    u64 BGTileCache[BGTileCount * 8];
+    u64 BGTileValid[BGTileCount / 64];
+
+    u64 GetBGTileRow4bpp(u8* bgvram, u32 rowaddr);
+    u64 GetBGTileRow(u8* bgvram, u32 bgvrammask, u32 tilesetaddr, u16 tile, u32 yoff, bool is256);
+
     u32 ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb);
     u32 ColorBlend5(u32 val1, u32 val2);
     u32 ColorBrightnessUp(u32 val, u32 factor);
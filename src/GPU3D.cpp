@@ -275,6 +275,8 @@ u32 RenderNumPolygons;
 u32 FlushRequest;
 u32 FlushAttributes;
 
+void (*CaptureCommand)(u8 command, u32 param) = nullptr;
+
 std::unique_ptr<GPU3D::Renderer3D> CurrentRenderer = {};
 
 void MatrixMult4x4(s32* m, s32* s);
@@ -287,6 +289,7 @@ template<bool attribs>
 int ClipPolygon(Vertex* vertices, int nverts, int clipstart);
 
 void TransformVertex(s16* inVertex, s32* outVertex);
+void LightVertex(s16* normal, u8* outColor);
 
 bool Init()
 {
@@ -1295,67 +1298,10 @@ void CalculateLighting()
         TexCoords[1] = RawTexCoords[1] + (((s64)Normal[0]*TexMatrix[1] + (s64)Normal[1]*TexMatrix[5] + (s64)Normal[2]*TexMatrix[9]) >> 21);
     }
 
-    s32 normaltrans[3];
-    normaltrans[0] = (Normal[0]*VecMatrix[0] + Normal[1]*VecMatrix[4] + Normal[2]*VecMatrix[8]) >> 12;
-    normaltrans[1] = (Normal[0]*VecMatrix[1] + Normal[1]*VecMatrix[5] + Normal[2]*VecMatrix[9]) >> 12;
-    normaltrans[2] = (Normal[0]*VecMatrix[2] + Normal[1]*VecMatrix[6] + Normal[2]*VecMatrix[10]) >> 12;
-
-    VertexColor[0] = MatEmission[0];
-    VertexColor[1] = MatEmission[1];
-    VertexColor[2] = MatEmission[2];
-
-    s32 c = 0;
-    for (int i = 0; i < 4; i++)
-    {
-        if (!(CurPolygonAttr & (1<<i)))
-            continue;
-
-        // overflow handling (for example, if the normal length is >1)
-        // according to some hardware tests
-        // * diffuse level is saturated to 255
-        // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
-        // TODO: check how it behaves when the computed shininess is >=0x200
-
-        s32 difflevel = (-(LightDirection[i][0]*normaltrans[0] +
-                         LightDirection[i][1]*normaltrans[1] +
-                         LightDirection[i][2]*normaltrans[2])) >> 10;
-        if (difflevel < 0) difflevel = 0;
-        else if (difflevel > 255) difflevel = 255;
-
-        s32 shinelevel = -(((LightDirection[i][0]>>1)*normaltrans[0] +
-                          (LightDirection[i][1]>>1)*normaltrans[1] +
-                          ((LightDirection[i][2]-0x200)>>1)*normaltrans[2]) >> 10);
-        if (shinelevel < 0) shinelevel = 0;
-        else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
-        shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
-        if (shinelevel < 0) shinelevel = 0;
-
-        if (UseShininessTable)
-        {
-            // checkme
-            shinelevel >>= 1;
-            shinelevel = ShininessTable[shinelevel];
-        }
-
-        VertexColor[0] += ((MatSpecular[0] * LightColor[i][0] * shinelevel) >> 13);
-        VertexColor[0] += ((MatDiffuse[0] * LightColor[i][0] * difflevel) >> 13);
-        VertexColor[0] += ((MatAmbient[0] * LightColor[i][0]) >> 5);
-
-        VertexColor[1] += ((MatSpecular[1] * LightColor[i][1] * shinelevel) >> 13);
-        VertexColor[1] += ((MatDiffuse[1] * LightColor[i][1] * difflevel) >> 13);
-        VertexColor[1] += ((MatAmbient[1] * LightColor[i][1]) >> 5);
-
-        VertexColor[2] += ((MatSpecular[2] * LightColor[i][2] * shinelevel) >> 13);
-        VertexColor[2] += ((MatDiffuse[2] * LightColor[i][2] * difflevel) >> 13);
-        VertexColor[2] += ((MatAmbient[2] * LightColor[i][2]) >> 5);
-
-        if (VertexColor[0] > 31) VertexColor[0] = 31;
-        if (VertexColor[1] > 31) VertexColor[1] = 31;
-        if (VertexColor[2] > 31) VertexColor[2] = 31;
-
-        c++;
-    }
+    LightVertex(Normal, VertexColor);
 
+    // one cycle per enabled light
+    s32 c = __builtin_popcount(CurPolygonAttr & 0xF);
     if (c < 1) c = 1;
     NormalPipeline = 7;
     AddCycles(c);
@@ -1522,6 +1468,52 @@ void CmdFIFOWrite(CmdFIFOEntry& entry)
     }
 }
 
+// same as calling CmdFIFOWrite for each entry in order, but the
+// status bits and counters are only updated once for the whole batch
+void CmdFIFOWriteBatch(CmdFIFOEntry* entries, u32 count)
+{
+    u32 i = 0;
+    while (i < count && CmdFIFO.IsEmpty() && !CmdPIPE.IsFull())
+        CmdPIPE.Write(entries[i++]);
+    while (i < count && !CmdFIFO.IsFull())
+        CmdFIFO.Write(entries[i++]);
+
+    u32 numQueued = i;
+    if (i < count)
+    {
+        // see CmdFIFOWrite for the stall queue
+        for (; i < count; i++)
+            CmdStallQueue.Write(entries[i]);
+        NDS::GXFIFOStall();
+    }
+
+    if (numQueued == 0)
+        return;
+
+    GXStat |= (1<<27);
+
+    u32 numPushPop = 0, numTest = 0;
+    for (u32 j = 0; j < numQueued; j++)
+    {
+        u8 cmd = entries[j].Command;
+        if (cmd == 0x11 || cmd == 0x12)
+            numPushPop++;
+        else if (cmd == 0x70 || cmd == 0x71 || cmd == 0x72)
+            numTest++;
+    }
+
+    if (numPushPop)
+    {
+        GXStat |= (1<<14); // push/pop matrix
+        NumPushPopCommands += numPushPop;
+    }
+    if (numTest)
+    {
+        GXStat |= (1<<0); // box/pos/vec test
+        NumTestCommands += numTest;
+    }
+}
+
 CmdFIFOEntry CmdFIFORead()
 {
     CmdFIFOEntry ret = CmdPIPE.Read();
@@ -1591,6 +1583,8 @@ void ExecuteCommand()
 {
     CmdFIFOEntry entry = CmdFIFORead();
 
+    if (CaptureCommand) CaptureCommand(entry.Command, entry.Param);
+
     //printf("FIFO: processing %02X %08X. Levels: FIFO=%d, PIPE=%d\n", entry.Command, entry.Param, CmdFIFO->Level(), CmdPIPE->Level());
 
     // each FIFO entry takes 1 cycle to be processed
@@ -2280,6 +2274,11 @@ void CheckFIFOIRQ()
     case 2: irq = CmdFIFO.IsEmpty(); break;
     }
 
+    // this runs after every couple of commands, so only
+    // go through the IRQ update when something changes
+    if (irq == !!(NDS::IF[0] & (1<<NDS::IRQ_GXFIFO)))
+        return;
+
     if (irq) NDS::SetIRQ(0, NDS::IRQ_GXFIFO);
     else     NDS::ClearIRQ(0, NDS::IRQ_GXFIFO);
 }
@@ -2479,6 +2478,12 @@ void WriteBatchToGXFIFO(u32* values, u32 count)
         WriteToGXFIFO(values[i++]);
     }
 
+    // unpack the commands into a local buffer first, so they
+    // can be put into the FIFO in one go
+    const u32 batchSize = 256;
+    CmdFIFOEntry batch[batchSize];
+    u32 batchLen = 0;
+
     for (; i < count; i++)
     {
         CurCommand = values[i];
@@ -2493,21 +2498,30 @@ void WriteBatchToGXFIFO(u32* values, u32 count)
                 {
                     i++;
                     if (i == count)
+                    {
+                        CmdFIFOWriteBatch(batch, batchLen);
                         return;
+                    }
 
-                    CmdFIFOEntry entry;
-                    entry.Command = CurCommand & 0xFF;
-                    entry.Param = values[i];
-                    CmdFIFOWrite(entry);
+                    batch[batchLen].Command = CurCommand & 0xFF;
+                    batch[batchLen].Param = values[i];
+                    if (++batchLen == batchSize)
+                    {
+                        CmdFIFOWriteBatch(batch, batchLen);
+                        batchLen = 0;
+                    }
                 }
             }
             else
             {
-                CmdFIFOEntry entry;
-                entry.Command = CurCommand & 0xFF;
+                batch[batchLen].Command = CurCommand & 0xFF;
                 // probably not necessary
-                entry.Param = values[i];
-                CmdFIFOWrite(entry);
+                batch[batchLen].Param = values[i];
+                if (++batchLen == batchSize)
+                {
+                    CmdFIFOWriteBatch(batch, batchLen);
+                    batchLen = 0;
+                }
             }
 
             CurCommand >>= 8;
@@ -2516,6 +2530,8 @@ void WriteBatchToGXFIFO(u32* values, u32 count)
 
         NumCommands = 0;
     }
+
+    CmdFIFOWriteBatch(batch, batchLen);
 }
 
 
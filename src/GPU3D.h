@@ -99,6 +99,10 @@ extern u32 RenderNumPolygons;
 
 extern u64 Timestamp;
 
+// if set, every command is passed to this when it's executed,
+// so that display lists can be captured and replayed
+extern void (*CaptureCommand)(u8 command, u32 param);
+
 bool Init();
 void DeInit();
 void Reset();
@@ -20,10 +20,17 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "NDS.h"
 #include "GPU.h"
 #include "Config.h"
 
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 
 namespace GPU3D
 {
@@ -31,6 +38,94 @@ namespace GPU3D
 void RenderThreadFunc();
 
 
+// same as Interpolator<0>::SetX
+u32 PerspectiveFactorX(s32 x, s32 xdiff, s32 w0, s32 w1)
+{
+    s64 num = ((s64)x * w0) << 8;
+    s32 den = (x * w0) + ((xdiff-x) * w1);
+
+    if (den == 0) return 0;
+    return (s32)(num / den);
+}
+
+// all the operands of the division fit into a double exactly. The error of the
+// quotient is below 2^-20/den, so it never crosses an integer boundary and
+// truncating it gives the same result as the integer division
+void CalcPerspectiveFactorsX(u32* factors, s32 x, s32 count, s32 xdiff, s32 w0, s32 w1)
+{
+    s32 i = 0;
+
+#if defined(__x86_64__)
+    __m128d xv = _mm_set_pd(x+1, x);
+    __m128d w0v = _mm_set1_pd(w0);
+    __m128d w1v = _mm_set1_pd(w1);
+    __m128d numscale = _mm_set1_pd(w0 * 256.0);
+    __m128d xdiffv = _mm_set1_pd(xdiff);
+    __m128d two = _mm_set1_pd(2.0);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d xv2 = _mm_add_pd(xv, two);
+
+        __m128d num0 = _mm_mul_pd(xv, numscale);
+        __m128d num1 = _mm_mul_pd(xv2, numscale);
+        __m128d den0 = _mm_add_pd(_mm_mul_pd(xv, w0v), _mm_mul_pd(_mm_sub_pd(xdiffv, xv), w1v));
+        __m128d den1 = _mm_add_pd(_mm_mul_pd(xv2, w0v), _mm_mul_pd(_mm_sub_pd(xdiffv, xv2), w1v));
+
+        // a zero denominator gives a factor of 0
+        __m128d q0 = _mm_andnot_pd(_mm_cmpeq_pd(den0, _mm_setzero_pd()), _mm_div_pd(num0, den0));
+        __m128d q1 = _mm_andnot_pd(_mm_cmpeq_pd(den1, _mm_setzero_pd()), _mm_div_pd(num1, den1));
+
+        __m128i res = _mm_unpacklo_epi64(_mm_cvttpd_epi32(q0), _mm_cvttpd_epi32(q1));
+        _mm_storeu_si128((__m128i*)&factors[i], res);
+
+        // quotients which don't fit into 32 bits (only possible with
+        // negative W) end up as 0x80000000, unlike with the integer division
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(res, _mm_set1_epi32(0x80000000))))
+        {
+            for (int j = 0; j < 4; j++)
+                factors[i+j] = PerspectiveFactorX(x+i+j, xdiff, w0, w1);
+        }
+
+        xv = _mm_add_pd(xv2, two);
+    }
+#elif defined(__aarch64__)
+    float64x2_t xv = {(double)x, (double)(x+1)};
+    float64x2_t w0v = vdupq_n_f64(w0);
+    float64x2_t w1v = vdupq_n_f64(w1);
+    float64x2_t numscale = vdupq_n_f64(w0 * 256.0);
+    float64x2_t xdiffv = vdupq_n_f64(xdiff);
+    float64x2_t two = vdupq_n_f64(2.0);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        float64x2_t xv2 = vaddq_f64(xv, two);
+
+        float64x2_t num0 = vmulq_f64(xv, numscale);
+        float64x2_t num1 = vmulq_f64(xv2, numscale);
+        float64x2_t den0 = vaddq_f64(vmulq_f64(xv, w0v), vmulq_f64(vsubq_f64(xdiffv, xv), w1v));
+        float64x2_t den1 = vaddq_f64(vmulq_f64(xv2, w0v), vmulq_f64(vsubq_f64(xdiffv, xv2), w1v));
+
+        // converting to 64-bit and then taking the lower half
+        // wraps around the same way the integer division does
+        int64x2_t q0 = vcvtq_s64_f64(vdivq_f64(num0, den0));
+        int64x2_t q1 = vcvtq_s64_f64(vdivq_f64(num1, den1));
+
+        // a zero denominator gives a factor of 0
+        q0 = vbslq_s64(vceqzq_f64(den0), vdupq_n_s64(0), q0);
+        q1 = vbslq_s64(vceqzq_f64(den1), vdupq_n_s64(0), q1);
+
+        vst1q_u32(&factors[i], vreinterpretq_u32_s32(vcombine_s32(vmovn_s64(q0), vmovn_s64(q1))));
+
+        xv = vaddq_f64(xv2, two);
+    }
+#endif
+
+    for (; i < count; i++)
+        factors[i] = PerspectiveFactorX(x+i, xdiff, w0, w1);
+}
+
+
 void SoftRenderer::StopRenderThread()
 {
     if (RenderThreadRunning.load(std::memory_order_relaxed))
@@ -39,6 +134,18 @@ void SoftRenderer::StopRenderThread()
         Platform::Semaphore_Post(Sema_RenderStart);
         Platform::Thread_Wait(RenderThread);
         Platform::Thread_Free(RenderThread);
+
+        // the band threads are only started by the render thread,
+        // so they're all waiting by now
+        for (int i = 1; i < NumBands; i++)
+        {
+            Platform::Semaphore_Post(Bands[i].Sema_Start);
+            Platform::Thread_Wait(Bands[i].Thread);
+            Platform::Thread_Free(Bands[i].Thread);
+
+            delete[] Bands[i].PolygonList;
+            Bands[i].PolygonList = nullptr;
+        }
     }
 }
 
@@ -48,8 +155,29 @@ void SoftRenderer::SetupRenderThread()
     {
         if (!RenderThreadRunning.load(std::memory_order_relaxed))
         {
+            // the render thread renders the first band itself
+            // one core is left for the emulator thread
+            NumBands = NumThreads;
+            if (NumBands <= 0)
+                NumBands = (int)std::thread::hardware_concurrency() - 1;
+            NumBands = std::clamp(NumBands, 1, MaxBands);
+
+            for (int i = 0; i < NumBands; i++)
+            {
+                Bands[i].YStart = (192 * i) / NumBands;
+                Bands[i].YEnd = (192 * (i+1)) / NumBands;
+                for (int y = Bands[i].YStart; y < Bands[i].YEnd; y++)
+                    LineBand[y] = i;
+            }
+
             RenderThreadRunning = true;
             RenderThread = Platform::Thread_Create(std::bind(&SoftRenderer::RenderThreadFunc, this));
+
+            for (int i = 1; i < NumBands; i++)
+            {
+                Bands[i].PolygonList = new RendererPolygon[2048];
+                Bands[i].Thread = Platform::Thread_Create(std::bind(&SoftRenderer::BandThreadFunc, this, i));
+            }
         }
 
         // otherwise more than one frame can be queued up at once
@@ -60,7 +188,12 @@ void SoftRenderer::SetupRenderThread()
 
         Platform::Semaphore_Reset(Sema_RenderDone);
         Platform::Semaphore_Reset(Sema_RenderStart);
-        Platform::Semaphore_Reset(Sema_ScanlineCount);
+        for (int i = 0; i < NumBands; i++)
+        {
+            Platform::Semaphore_Reset(Bands[i].Sema_ScanlineCount);
+            Platform::Semaphore_Reset(Bands[i].Sema_FirstLineDone);
+            Platform::Semaphore_Reset(Bands[i].Sema_LastLineDone);
+        }
 
         Platform::Semaphore_Post(Sema_RenderStart);
     }
@@ -81,9 +214,23 @@ bool SoftRenderer::Init()
 {
     Sema_RenderStart = Platform::Semaphore_Create();
     Sema_RenderDone = Platform::Semaphore_Create();
-    Sema_ScanlineCount = Platform::Semaphore_Create();
+    Sema_BandDone = Platform::Semaphore_Create();
+
+    for (int i = 0; i < MaxBands; i++)
+    {
+        Bands[i].PolygonList = nullptr;
+        Bands[i].Sema_Start = Platform::Semaphore_Create();
+        Bands[i].Sema_ScanlineCount = Platform::Semaphore_Create();
+        Bands[i].Sema_FirstLineDone = Platform::Semaphore_Create();
+        Bands[i].Sema_LastLineDone = Platform::Semaphore_Create();
+    }
+    Bands[0].PolygonList = PolygonList;
+    NumBands = 1;
 
     Threaded = false;
+    NumThreads = 0;
+
+    ClearTexCache();
     RenderThreadRunning = false;
     RenderThreadRendering = false;
 
@@ -94,9 +241,19 @@ void SoftRenderer::DeInit()
 {
     StopRenderThread();
 
+    ClearTexCache();
+
     Platform::Semaphore_Free(Sema_RenderStart);
     Platform::Semaphore_Free(Sema_RenderDone);
-    Platform::Semaphore_Free(Sema_ScanlineCount);
+    Platform::Semaphore_Free(Sema_BandDone);
+
+    for (int i = 0; i < MaxBands; i++)
+    {
+        Platform::Semaphore_Free(Bands[i].Sema_Start);
+        Platform::Semaphore_Free(Bands[i].Sema_ScanlineCount);
+        Platform::Semaphore_Free(Bands[i].Sema_FirstLineDone);
+        Platform::Semaphore_Free(Bands[i].Sema_LastLineDone);
+    }
 }
 
 void SoftRenderer::Reset()
@@ -107,60 +264,31 @@ void SoftRenderer::Reset()
 
     PrevIsShadowMask = false;
 
+    ClearTexCache();
+
     SetupRenderThread();
 }
 
 void SoftRenderer::SetRenderSettings(GPU::RenderSettings& settings)
 {
+    if (settings.Soft_NumThreads != NumThreads)
+    {
+        // the bands are laid out once the threads are started
+        StopRenderThread();
+        NumThreads = settings.Soft_NumThreads;
+    }
+
     Threaded = settings.Soft_Threaded;
     SetupRenderThread();
 }
 
-void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha)
+u32 SoftRenderer::DecodeTexel(u32 texparam, u32 texpal, s32 s, s32 t)
 {
     u32 vramaddr = (texparam & 0xFFFF) << 3;
 
     s32 width = 8 << ((texparam >> 20) & 0x7);
-    s32 height = 8 << ((texparam >> 23) & 0x7);
-
-    s >>= 4;
-    t >>= 4;
-
-    // texture wrapping
-    // TODO: optimize this somehow
-    // testing shows that it's hardly worth optimizing, actually
-
-    if (texparam & (1<<16))
-    {
-        if (texparam & (1<<18))
-        {
-            if (s & width) s = (width-1) - (s & (width-1));
-            else           s = (s & (width-1));
-        }
-        else
-            s &= width-1;
-    }
-    else
-    {
-        if (s < 0) s = 0;
-        else if (s >= width) s = width-1;
-    }
 
-    if (texparam & (1<<17))
-    {
-        if (texparam & (1<<19))
-        {
-            if (t & height) t = (height-1) - (t & (height-1));
-            else            t = (t & (height-1));
-        }
-        else
-            t &= height-1;
-    }
-    else
-    {
-        if (t < 0) t = 0;
-        else if (t >= height) t = height-1;
-    }
+    u16 color = 0; u8 alpha = 0;
 
     u8 alpha0;
     if (texparam & (1<<29)) alpha0 = 0;
@@ -174,8 +302,8 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             u8 pixel = ReadVRAM_Texture<u8>(vramaddr);
 
             texpal <<= 4;
-            *color = ReadVRAM_TexPal<u16>(texpal + ((pixel&0x1F)<<1));
-            *alpha = ((pixel >> 3) & 0x1C) + (pixel >> 6);
+            color = ReadVRAM_TexPal<u16>(texpal + ((pixel&0x1F)<<1));
+            alpha = ((pixel >> 3) & 0x1C) + (pixel >> 6);
         }
         break;
 
@@ -187,8 +315,8 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             pixel &= 0x3;
 
             texpal <<= 3;
-            *color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
-            *alpha = (pixel==0) ? alpha0 : 31;
+            color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
+            alpha = (pixel==0) ? alpha0 : 31;
         }
         break;
 
@@ -200,8 +328,8 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             else         pixel &= 0xF;
 
             texpal <<= 4;
-            *color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
-            *alpha = (pixel==0) ? alpha0 : 31;
+            color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
+            alpha = (pixel==0) ? alpha0 : 31;
         }
         break;
 
@@ -211,8 +339,8 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             u8 pixel = ReadVRAM_Texture<u8>(vramaddr);
 
             texpal <<= 4;
-            *color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
-            *alpha = (pixel==0) ? alpha0 : 31;
+            color = ReadVRAM_TexPal<u16>(texpal + (pixel<<1));
+            alpha = (pixel==0) ? alpha0 : 31;
         }
         break;
 
@@ -235,13 +363,13 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             switch (val & 0x3)
             {
             case 0:
-                *color = ReadVRAM_TexPal<u16>(texpal + paloffset);
-                *alpha = 31;
+                color = ReadVRAM_TexPal<u16>(texpal + paloffset);
+                alpha = 31;
                 break;
 
             case 1:
-                *color = ReadVRAM_TexPal<u16>(texpal + paloffset + 2);
-                *alpha = 31;
+                color = ReadVRAM_TexPal<u16>(texpal + paloffset + 2);
+                alpha = 31;
                 break;
 
             case 2:
@@ -261,7 +389,7 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
                     u32 g = ((g0 + g1) >> 1) & 0x03E0;
                     u32 b = ((b0 + b1) >> 1) & 0x7C00;
 
-                    *color = r | g | b;
+                    color = r | g | b;
                 }
                 else if ((palinfo >> 14) == 3)
                 {
@@ -279,18 +407,18 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
                     u32 g = ((g0*5 + g1*3) >> 3) & 0x03E0;
                     u32 b = ((b0*5 + b1*3) >> 3) & 0x7C00;
 
-                    *color = r | g | b;
+                    color = r | g | b;
                 }
                 else
-                    *color = ReadVRAM_TexPal<u16>(texpal + paloffset + 4);
-                *alpha = 31;
+                    color = ReadVRAM_TexPal<u16>(texpal + paloffset + 4);
+                alpha = 31;
                 break;
 
             case 3:
                 if ((palinfo >> 14) == 2)
                 {
-                    *color = ReadVRAM_TexPal<u16>(texpal + paloffset + 6);
-                    *alpha = 31;
+                    color = ReadVRAM_TexPal<u16>(texpal + paloffset + 6);
+                    alpha = 31;
                 }
                 else if ((palinfo >> 14) == 3)
                 {
@@ -308,13 +436,13 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
                     u32 g = ((g0*3 + g1*5) >> 3) & 0x03E0;
                     u32 b = ((b0*3 + b1*5) >> 3) & 0x7C00;
 
-                    *color = r | g | b;
-                    *alpha = 31;
+                    color = r | g | b;
+                    alpha = 31;
                 }
                 else
                 {
-                    *color = 0;
-                    *alpha = 0;
+                    color = 0;
+                    alpha = 0;
                 }
                 break;
             }
@@ -327,18 +455,222 @@ void SoftRenderer::TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* co
             u8 pixel = ReadVRAM_Texture<u8>(vramaddr);
 
             texpal <<= 4;
-            *color = ReadVRAM_TexPal<u16>(texpal + ((pixel&0x7)<<1));
-            *alpha = (pixel >> 3);
+            color = ReadVRAM_TexPal<u16>(texpal + ((pixel&0x7)<<1));
+            alpha = (pixel >> 3);
         }
         break;
 
     case 7: // direct color
         {
             vramaddr += (((t * width) + s) << 1);
-            *color = ReadVRAM_Texture<u16>(vramaddr);
-            *alpha = (*color & 0x8000) ? 31 : 0;
+            color = ReadVRAM_Texture<u16>(vramaddr);
+            alpha = (color & 0x8000) ? 31 : 0;
+        }
+        break;
+    }
+
+    u32 r = (color << 1) & 0x3E; if (r) r++;
+    u32 g = (color >> 4) & 0x3E; if (g) g++;
+    u32 b = (color >> 9) & 0x3E; if (b) b++;
+
+    return r | (g << 8) | (b << 16) | (alpha << 24);
+}
+
+u32 SoftRenderer::TextureLookup(u32 texparam, u32 texpal, u32* texture, s16 s, s16 t)
+{
+    s32 width = 8 << ((texparam >> 20) & 0x7);
+    s32 height = 8 << ((texparam >> 23) & 0x7);
+
+    s >>= 4;
+    t >>= 4;
+
+    // texture wrapping
+    // TODO: optimize this somehow
+    // testing shows that it's hardly worth optimizing, actually
+
+    if (texparam & (1<<16))
+    {
+        if (texparam & (1<<18))
+        {
+            if (s & width) s = (width-1) - (s & (width-1));
+            else           s = (s & (width-1));
+        }
+        else
+            s &= width-1;
+    }
+    else
+    {
+        if (s < 0) s = 0;
+        else if (s >= width) s = width-1;
+    }
+
+    if (texparam & (1<<17))
+    {
+        if (texparam & (1<<19))
+        {
+            if (t & height) t = (height-1) - (t & (height-1));
+            else            t = (t & (height-1));
+        }
+        else
+            t &= height-1;
+    }
+    else
+    {
+        if (t < 0) t = 0;
+        else if (t >= height) t = height-1;
+    }
+
+    if (texture)
+        return texture[(t * width) + s];
+
+    return DecodeTexel(texparam, texpal, s, t);
+}
+
+template <u32 Size>
+void SetTexCacheDeps(NonStupidBitField<Size>& deps, u32 start, u32 len)
+{
+    // addresses wrap around the same way they do when reading VRAM
+    u32 first = start / GPU::VRAMDirtyGranularity;
+    u32 last = (start + len - 1) / GPU::VRAMDirtyGranularity;
+    for (u32 i = first; i <= last; i++)
+        deps[i % Size] = true;
+}
+
+template <u32 Size>
+bool TexCacheDepsDirty(NonStupidBitField<Size>& deps, NonStupidBitField<Size>& dirty)
+{
+    for (u32 i = 0; i < NonStupidBitField<Size>::DataLength; i++)
+    {
+        if (deps.Data[i] & dirty.Data[i])
+            return true;
+    }
+    return false;
+}
+
+void SoftRenderer::ClearTexCache()
+{
+    TexCache.clear();
+    TexCacheTexels = 0;
+    TexCacheFull = false;
+}
+
+void SoftRenderer::InvalidateTexCache(NonStupidBitField<512*1024/GPU::VRAMDirtyGranularity>& textureDirty,
+                                      NonStupidBitField<128*1024/GPU::VRAMDirtyGranularity>& texPalDirty)
+{
+    for (auto it = TexCache.begin(); it != TexCache.end();)
+    {
+        TexCacheEntry& entry = it->second;
+        if (TexCacheDepsDirty(entry.TextureDeps, textureDirty) || TexCacheDepsDirty(entry.TexPalDeps, texPalDirty))
+        {
+            TexCacheTexels -= entry.Texels.size();
+            it = TexCache.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
+u32* SoftRenderer::GetTexture(u32 texparam, u32 texpal)
+{
+    // remove sampling and texcoord gen params
+    texparam &= ~0xC00F0000;
+
+    u32 fmt = (texparam >> 26) & 0x7;
+    u64 key = texparam;
+    if (fmt != 7)
+        key |= (u64)texpal << 32;
+    // color 0 transparency only applies to the paletted formats
+    if (fmt != 2 && fmt != 3 && fmt != 4)
+        key &= ~(1<<29);
+
+    auto it = TexCache.find(key);
+    if (it != TexCache.end())
+        return it->second.Texels.data();
+
+    u32 width = 8 << ((texparam >> 20) & 0x7);
+    u32 height = 8 << ((texparam >> 23) & 0x7);
+
+    if (TexCacheTexels + width*height > TexCacheMaxTexels)
+    {
+        TexCacheFull = true;
+        return nullptr;
+    }
+
+    TexCacheEntry& entry = TexCache[key];
+    TexCacheTexels += width*height;
+
+    u32 vramaddr = (texparam & 0xFFFF) << 3;
+
+    switch (fmt)
+    {
+    case 1: // A3I5
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height);
+        SetTexCacheDeps(entry.TexPalDeps, texpal << 4, 32*2);
+        break;
+    case 2: // 4-color
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height/4);
+        SetTexCacheDeps(entry.TexPalDeps, texpal << 3, 4*2);
+        break;
+    case 3: // 16-color
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height/2);
+        SetTexCacheDeps(entry.TexPalDeps, texpal << 4, 16*2);
+        break;
+    case 4: // 256-color
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height);
+        SetTexCacheDeps(entry.TexPalDeps, texpal << 4, 256*2);
+        break;
+    case 5: // compressed
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height/4);
+        // every block has its own palette index in slot 1
+        for (u32 blockaddr = vramaddr; blockaddr < vramaddr + width*height/4; blockaddr += 4)
+        {
+            u32 slot1addr = 0x20000 + ((blockaddr & 0x1FFFC) >> 1);
+            if (blockaddr >= 0x40000)
+                slot1addr += 0x10000;
+
+            SetTexCacheDeps(entry.TextureDeps, slot1addr, 2);
+
+            u16 palinfo = ReadVRAM_Texture<u16>(slot1addr);
+            SetTexCacheDeps(entry.TexPalDeps, (texpal << 4) + ((palinfo & 0x3FFF) << 2), 4*2);
         }
         break;
+    case 6: // A5I3
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height);
+        SetTexCacheDeps(entry.TexPalDeps, texpal << 4, 8*2);
+        break;
+    case 7: // direct color
+        SetTexCacheDeps(entry.TextureDeps, vramaddr, width*height*2);
+        break;
+    }
+
+    entry.Texels.resize(width*height);
+    u32* texels = entry.Texels.data();
+    for (u32 t = 0; t < height; t++)
+    {
+        for (u32 s = 0; s < width; s++)
+            texels[(t * width) + s] = DecodeTexel(texparam, texpal, s, t);
+    }
+
+    return texels;
+}
+
+void SoftRenderer::SetupPolygonTextures()
+{
+    // the textures looked up for the frame have to stay around
+    // until it's rendered, so the cache is only cleared before
+    if (TexCacheFull)
+        ClearTexCache();
+
+    bool enableTextures = RenderDispCnt & (1<<0);
+
+    for (int i = 0; i < RenderNumPolygons; i++)
+    {
+        Polygon* polygon = RenderPolygonRAM[i];
+
+        if (enableTextures && !polygon->Degenerate && ((polygon->TexParam >> 26) & 0x7) != 0)
+            PolygonTextures[i] = GetTexture(polygon->TexParam, polygon->TexPalette);
+        else
+            PolygonTextures[i] = nullptr;
     }
 }
 
@@ -422,8 +754,9 @@ u32 AlphaBlend(u32 srccolor, u32 dstcolor, u32 alpha)
     return srcR | (srcG << 8) | (srcB << 16) | (dstalpha << 24);
 }
 
-u32 SoftRenderer::RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
+u32 SoftRenderer::RenderPixel(RendererPolygon* rp, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
 {
+    Polygon* polygon = rp->PolyData;
     u8 r, g, b, a;
 
     u32 blendmode = (polygon->Attr >> 4) & 0x3;
@@ -458,12 +791,12 @@ u32 SoftRenderer::RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16
     {
         u8 tr, tg, tb;
 
-        u16 tcolor; u8 talpha;
-        TextureLookup(polygon->TexParam, polygon->TexPalette, s, t, &tcolor, &talpha);
+        u32 texel = TextureLookup(polygon->TexParam, polygon->TexPalette, rp->Texture, s, t);
+        u8 talpha = texel >> 24;
 
-        tr = (tcolor << 1) & 0x3E; if (tr) tr++;
-        tg = (tcolor >> 4) & 0x3E; if (tg) tg++;
-        tb = (tcolor >> 9) & 0x3E; if (tb) tb++;
+        tr = texel & 0x3F;
+        tg = (texel >> 8) & 0x3F;
+        tb = (texel >> 16) & 0x3F;
 
         if (blendmode & 0x1)
         {
@@ -676,7 +1009,7 @@ void SoftRenderer::SetupPolygon(SoftRenderer::RendererPolygon* rp, Polygon* poly
     }
 }
 
-void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
+void SoftRenderer::RenderShadowMaskScanline(RenderBand* band, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -694,10 +1027,10 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    if (!PrevIsShadowMask)
+    if (!band->PrevIsShadowMask)
         memset(&StencilBuffer[256 * (y&0x1)], 0, 256);
 
-    PrevIsShadowMask = true;
+    band->PrevIsShadowMask = true;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -797,6 +1130,10 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     if (x < 0) x = 0;
     s32 xlimit;
 
+    // do the perspective divisions for the visible part of the span at once
+    u32 factors[256];
+    interpX.SetupSpan(x, std::min(xend+1, 256), factors);
+
     // for shadow masks: set stencil bits where the depth test fails.
     // draw nothing.
 
@@ -889,7 +1226,7 @@ void SoftRenderer::RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
+void SoftRenderer::RenderPolygonScanline(RenderBand* band, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -907,7 +1244,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    PrevIsShadowMask = false;
+    band->PrevIsShadowMask = false;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -1026,6 +1363,10 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     if (x < 0) x = 0;
     s32 xlimit;
 
+    // do the perspective divisions for the visible part of the span at once
+    u32 factors[256];
+    interpX.SetupSpan(x, std::min(xend+1, 256), factors);
+
     s32 xcov = 0;
 
     // part 1: left edge
@@ -1081,7 +1422,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(rp, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1177,7 +1518,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(rp, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1252,7 +1593,7 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(rp, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1304,19 +1645,19 @@ void SoftRenderer::RenderPolygonScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void SoftRenderer::RenderScanline(s32 y, int npolys)
+void SoftRenderer::RenderScanline(RenderBand* band, s32 y, int npolys)
 {
     for (int i = 0; i < npolys; i++)
     {
-        RendererPolygon* rp = &PolygonList[i];
+        RendererPolygon* rp = &band->PolygonList[i];
         Polygon* polygon = rp->PolyData;
 
         if (y >= polygon->YTop && (y < polygon->YBottom || (y == polygon->YTop && polygon->YBottom == polygon->YTop)))
         {
             if (polygon->IsShadowMask)
-                RenderShadowMaskScanline(rp, y);
+                RenderShadowMaskScanline(band, rp, y);
             else
-                RenderPolygonScanline(rp, y);
+                RenderPolygonScanline(band, rp, y);
         }
     }
 }
@@ -1529,13 +1870,14 @@ void SoftRenderer::ScanlineFinalPass(s32 y)
     }
 }
 
-void SoftRenderer::ClearBuffers()
+void SoftRenderer::ClearBuffers(s32 ystart, s32 yend)
 {
     u32 clearz = ((RenderClearAttr2 & 0x7FFF) * 0x200) + 0x1FF;
     u32 polyid = RenderClearAttr1 & 0x3F000000; // this sets the opaque polygonID
 
     // fill screen borders for edge marking
 
+    if (ystart == 0)
     for (int x = 0; x < ScanlineWidth; x++)
     {
         ColorBuffer[x] = 0;
@@ -1543,7 +1885,7 @@ void SoftRenderer::ClearBuffers()
         AttrBuffer[x] = polyid;
     }
 
-    for (int x = ScanlineWidth; x < ScanlineWidth*193; x+=ScanlineWidth)
+    for (int x = ScanlineWidth*(ystart+1); x < ScanlineWidth*(yend+1); x+=ScanlineWidth)
     {
         ColorBuffer[x] = 0;
         DepthBuffer[x] = clearz;
@@ -1553,6 +1895,7 @@ void SoftRenderer::ClearBuffers()
         AttrBuffer[x+257] = polyid;
     }
 
+    if (yend == 192)
     for (int x = ScanlineWidth*193; x < ScanlineWidth*194; x++)
     {
         ColorBuffer[x] = 0;
@@ -1565,9 +1908,9 @@ void SoftRenderer::ClearBuffers()
     if (RenderDispCnt & (1<<14))
     {
         u8 xoff = (RenderClearAttr2 >> 16) & 0xFF;
-        u8 yoff = (RenderClearAttr2 >> 24) & 0xFF;
+        u8 yoff = ((RenderClearAttr2 >> 24) & 0xFF) + ystart;
 
-        for (int y = 0; y < ScanlineWidth*192; y+=ScanlineWidth)
+        for (int y = ScanlineWidth*ystart; y < ScanlineWidth*yend; y+=ScanlineWidth)
         {
             for (int x = 0; x < 256; x++)
             {
@@ -1605,7 +1948,7 @@ void SoftRenderer::ClearBuffers()
 
         polyid |= (RenderClearAttr1 & 0x8000);
 
-        for (int y = 0; y < ScanlineWidth*192; y+=ScanlineWidth)
+        for (int y = ScanlineWidth*ystart; y < ScanlineWidth*yend; y+=ScanlineWidth)
         {
             for (int x = 0; x < 256; x++)
             {
@@ -1618,30 +1961,105 @@ void SoftRenderer::ClearBuffers()
     }
 }
 
-void SoftRenderer::RenderPolygons(bool threaded, Polygon** polygons, int npolys)
+void SoftRenderer::RenderLines(RenderBand* band, s32 ystart, s32 yend, bool threaded, bool split)
 {
+    ClearBuffers(ystart, yend);
+
     int j = 0;
-    for (int i = 0; i < npolys; i++)
+    for (int i = 0; i < RenderNumPolygons; i++)
     {
-        if (polygons[i]->Degenerate) continue;
-        SetupPolygon(&PolygonList[j++], polygons[i]);
+        Polygon* polygon = RenderPolygonRAM[i];
+        if (polygon->Degenerate) continue;
+
+        if (polygon->YTop >= yend) continue;
+        if (polygon->YBottom <= ystart && !(polygon->YTop == polygon->YBottom && polygon->YTop >= ystart)) continue;
+
+        RendererPolygon* rp = &band->PolygonList[j++];
+        SetupPolygon(rp, polygon);
+        rp->Texture = PolygonTextures[i];
+
+        // set up the edges as if the scanlines above had been rendered
+        if (polygon->YTop < ystart)
+        {
+            SetupPolygonLeftEdge(rp, ystart);
+            SetupPolygonRightEdge(rp, ystart);
+        }
     }
 
-    RenderScanline(0, j);
+    band->PrevIsShadowMask = PrevIsShadowMask;
 
-    for (s32 y = 1; y < 192; y++)
+    bool edgesync = split && (RenderDispCnt & (1<<5));
+
+    // the final pass of a scanline is done once the next one is
+    // rasterised, as edge marking looks at the neighbouring pixels
+    // (only their depth and opaque polygon ID, which the final pass leaves alone)
+    for (s32 y = ystart; y <= yend; y++)
     {
-        RenderScanline(y, j);
-        ScanlineFinalPass(y-1);
+        if (y < yend)
+        {
+            RenderScanline(band, y, j);
+
+            // only posted where a neighbouring band waits on it,
+            // so nothing is left over for the next frame
+            if (edgesync)
+            {
+                if (y == ystart && ystart > 0) Platform::Semaphore_Post(band->Sema_FirstLineDone);
+                if (y == yend-1 && yend < 192) Platform::Semaphore_Post(band->Sema_LastLineDone);
+            }
+        }
+
+        if (y == ystart) continue;
+        s32 finaly = y - 1;
+
+        if (edgesync)
+        {
+            if (finaly == ystart && ystart > 0)
+                Platform::Semaphore_Wait(Bands[LineBand[ystart-1]].Sema_LastLineDone);
+            if (finaly == yend-1 && yend < 192)
+                Platform::Semaphore_Wait(Bands[LineBand[yend]].Sema_FirstLineDone);
+        }
+
+        ScanlineFinalPass(finaly);
 
         if (threaded)
-            Platform::Semaphore_Post(Sema_ScanlineCount);
+            Platform::Semaphore_Post(Bands[LineBand[finaly]].Sema_ScanlineCount);
+    }
+}
+
+void SoftRenderer::RenderPolygons(bool threaded)
+{
+    SetupPolygonTextures();
+
+    // shadow masks leave the stencil buffer to the following scanlines,
+    // frames with shadows are rendered in one go because of that
+    bool split = threaded && NumBands > 1;
+    for (int i = 0; i < RenderNumPolygons && split; i++)
+    {
+        if (RenderPolygonRAM[i]->IsShadowMask || RenderPolygonRAM[i]->IsShadow)
+            split = false;
     }
 
-    ScanlineFinalPass(191);
+    if (split)
+    {
+        for (int i = 1; i < NumBands; i++)
+            Platform::Semaphore_Post(Bands[i].Sema_Start);
+
+        RenderLines(&Bands[0], Bands[0].YStart, Bands[0].YEnd, true, true);
+
+        for (int i = 1; i < NumBands; i++)
+            Platform::Semaphore_Wait(Sema_BandDone);
 
-    if (threaded)
-        Platform::Semaphore_Post(Sema_ScanlineCount);
+        // only shadow masks set this, so if any band rendered
+        // another polygon it ends up cleared
+        for (int i = 1; i < NumBands; i++)
+            Bands[0].PrevIsShadowMask = Bands[0].PrevIsShadowMask && Bands[i].PrevIsShadowMask;
+    }
+    else
+    {
+        RenderLines(&Bands[0], 0, 192, threaded, false);
+    }
+
+    PrevIsShadowMask = Bands[0].PrevIsShadowMask;
 }
 
 void SoftRenderer::VCount144()
@@ -1658,6 +2076,10 @@ void SoftRenderer::RenderFrame()
     bool textureChanged = GPU::MakeVRAMFlat_TextureCoherent(textureDirty);
     bool texPalChanged = GPU::MakeVRAMFlat_TexPalCoherent(texPalDirty);
 
+    // the render thread isn't running at this point
+    if (textureChanged || texPalChanged)
+        InvalidateTexCache(textureDirty, texPalDirty);
+
     FrameIdentical = !(textureChanged || texPalChanged) && RenderFrameIdentical;
 
     if (RenderThreadRunning.load(std::memory_order_relaxed))
@@ -1666,8 +2088,7 @@ void SoftRenderer::RenderFrame()
     }
     else if (!FrameIdentical)
     {
-        ClearBuffers();
-        RenderPolygons(false, &RenderPolygonRAM[0], RenderNumPolygons);
+        RenderPolygons(false);
     }
 }
 
@@ -1686,12 +2107,12 @@ void SoftRenderer::RenderThreadFunc()
         RenderThreadRendering = true;
         if (FrameIdentical)
         {
-            Platform::Semaphore_Post(Sema_ScanlineCount, 192);
+            for (int i = 0; i < NumBands; i++)
+                Platform::Semaphore_Post(Bands[i].Sema_ScanlineCount, Bands[i].YEnd - Bands[i].YStart);
         }
         else
         {
-            ClearBuffers();
-            RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
+            RenderPolygons(true);
         }
 
         Platform::Semaphore_Post(Sema_RenderDone);
@@ -1699,12 +2120,27 @@ void SoftRenderer::RenderThreadFunc()
     }
 }
 
+void SoftRenderer::BandThreadFunc(int num)
+{
+    RenderBand* band = &Bands[num];
+
+    for (;;)
+    {
+        Platform::Semaphore_Wait(band->Sema_Start);
+        if (!RenderThreadRunning) return;
+
+        RenderLines(band, band->YStart, band->YEnd, true, true);
+
+        Platform::Semaphore_Post(Sema_BandDone);
+    }
+}
+
 u32* SoftRenderer::GetLine(int line)
 {
     if (RenderThreadRunning.load(std::memory_order_relaxed))
     {
         if (line < 192)
-            Platform::Semaphore_Wait(Sema_ScanlineCount);
+            Platform::Semaphore_Wait(Bands[LineBand[line]].Sema_ScanlineCount);
     }
 
     return &ColorBuffer[(line * ScanlineWidth) + FirstPixelOffset];
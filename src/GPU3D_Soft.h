@@ -20,11 +20,20 @@
 
 #include "GPU3D.h"
 #include "Platform.h"
+#include "NonStupidBitfield.h"
 #include <thread>
 #include <atomic>
+#include <unordered_map>
+#include <vector>
 
 namespace GPU3D
 {
+
+// perspective correction factor for one position along X, and the same for
+// count positions starting at x, which does several of them at once
+u32 PerspectiveFactorX(s32 x, s32 xdiff, s32 w0, s32 w1);
+void CalcPerspectiveFactorsX(u32* factors, s32 x, s32 count, s32 xdiff, s32 w0, s32 w1);
+
 class SoftRenderer : public Renderer3D
 {
 public:
@@ -94,6 +103,10 @@ private:
             else
                 this->linear = false;
 
+            this->spanstart = 0;
+            this->spanlen = 0;
+            this->spanfactors = nullptr;
+
             if (dir)
             {
                 // along Y
@@ -125,12 +138,31 @@ private:
             }
         }
 
+        // does the divisions for SetX(xmin) to SetX(xmax-1) up front, several
+        // at once. factors has to stay around for as long as SetX is used
+        void SetupSpan(s32 xmin, s32 xmax, u32* factors)
+        {
+            spanlen = 0;
+            if (dir || xdiff == 0 || linear || xmax <= xmin) return;
+
+            spanstart = xmin - x0;
+            spanlen = xmax - xmin;
+            spanfactors = factors;
+            CalcPerspectiveFactorsX(factors, spanstart, spanlen, xdiff, w0n, w1d);
+        }
+
         void SetX(s32 x)
         {
             x -= x0;
             this->x = x;
             if (xdiff != 0 && !linear)
             {
+                if ((u32)(x - spanstart) < (u32)spanlen)
+                {
+                    yfactor = spanfactors[x - spanstart];
+                    return;
+                }
+
                 s64 num = ((s64)x * w0n) << shift;
                 s32 den = (x * w0d) + ((xdiff-x) * w1d);
 
@@ -224,6 +256,9 @@ private:
         s32 w0n, w0d, w1d;
 
         u32 yfactor;
+
+        s32 spanstart = 0, spanlen = 0;
+        u32* spanfactors = nullptr;
     };
 
 
@@ -453,24 +488,78 @@ private:
         u32 CurVL, CurVR;
         u32 NextVL, NextVR;
 
+        u32* Texture;
     };
 
     RendererPolygon PolygonList[2048];
-    void TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha);
-    u32 RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t);
+
+    // when rendering threaded the screen is split into bands of scanlines,
+    // each rendered by its own thread. Every band has its own copy of the
+    // polygons, with the edges set up for the first scanline of the band
+    struct RenderBand
+    {
+        s32 YStart, YEnd;
+        RendererPolygon* PolygonList;
+        bool PrevIsShadowMask;
+
+        Platform::Thread* Thread;
+        Platform::Semaphore* Sema_Start;
+        // posted for every finished scanline, GetLine waits on it
+        Platform::Semaphore* Sema_ScanlineCount;
+        // edge marking looks at the scanlines next to the band,
+        // so the neighbouring bands have to have rasterised those
+        Platform::Semaphore* Sema_FirstLineDone;
+        Platform::Semaphore* Sema_LastLineDone;
+    };
+
+    static constexpr int MaxBands = 8;
+    RenderBand Bands[MaxBands];
+    int NumBands;
+    u8 LineBand[192];
+
+    // textures are decoded the first time they're used and kept until
+    // the VRAM they were decoded from is modified. The texels are stored
+    // in the same format as the color buffer (RGB6 + 5 bit alpha)
+    struct TexCacheEntry
+    {
+        NonStupidBitField<512*1024/GPU::VRAMDirtyGranularity> TextureDeps;
+        NonStupidBitField<128*1024/GPU::VRAMDirtyGranularity> TexPalDeps;
+        std::vector<u32> Texels;
+    };
+    std::unordered_map<u64, TexCacheEntry> TexCache;
+    u32 TexCacheTexels;
+    bool TexCacheFull;
+
+    // the decoded texture of every polygon, looked up before
+    // the bands are started. nullptr if it didn't fit into the cache
+    u32* PolygonTextures[2048];
+
+    static constexpr u32 TexCacheMaxTexels = 8*1024*1024;
+
+    void ClearTexCache();
+    void InvalidateTexCache(NonStupidBitField<512*1024/GPU::VRAMDirtyGranularity>& textureDirty,
+                            NonStupidBitField<128*1024/GPU::VRAMDirtyGranularity>& texPalDirty);
+    u32* GetTexture(u32 texparam, u32 texpal);
+    void SetupPolygonTextures();
+
+    u32 DecodeTexel(u32 texparam, u32 texpal, s32 s, s32 t);
+    u32 TextureLookup(u32 texparam, u32 texpal, u32* texture, s16 s, s16 t);
+    u32 RenderPixel(RendererPolygon* rp, u8 vr, u8 vg, u8 vb, s16 s, s16 t);
     void PlotTranslucentPixel(u32 pixeladdr, u32 color, u32 z, u32 polyattr, u32 shadow);
     void SetupPolygonLeftEdge(RendererPolygon* rp, s32 y);
     void SetupPolygonRightEdge(RendererPolygon* rp, s32 y);
     void SetupPolygon(RendererPolygon* rp, Polygon* polygon);
-    void RenderShadowMaskScanline(RendererPolygon* rp, s32 y);
-    void RenderPolygonScanline(RendererPolygon* rp, s32 y);
-    void RenderScanline(s32 y, int npolys);
+    void RenderShadowMaskScanline(RenderBand* band, RendererPolygon* rp, s32 y);
+    void RenderPolygonScanline(RenderBand* band, RendererPolygon* rp, s32 y);
+    void RenderScanline(RenderBand* band, s32 y, int npolys);
     u32 CalculateFogDensity(u32 pixeladdr);
     void ScanlineFinalPass(s32 y);
-    void ClearBuffers();
-    void RenderPolygons(bool threaded, Polygon** polygons, int npolys);
+    void ClearBuffers(s32 ystart, s32 yend);
+    void RenderLines(RenderBand* band, s32 ystart, s32 yend, bool threaded, bool split);
+    void RenderPolygons(bool threaded);
 
     void RenderThreadFunc();
+    void BandThreadFunc(int num);
 
     // buffer dimensions are 258x194 to add a offscreen 1px border
     // which simplifies edge marking tests
@@ -506,11 +595,12 @@ private:
     // threading
 
     bool Threaded;
+    int NumThreads; // requested, 0 = depending on the amount of cores
     Platform::Thread* RenderThread;
     std::atomic_bool RenderThreadRunning;
     std::atomic_bool RenderThreadRendering;
     Platform::Semaphore* Sema_RenderStart;
     Platform::Semaphore* Sema_RenderDone;
-    Platform::Semaphore* Sema_ScanlineCount;
+    Platform::Semaphore* Sema_BandDone;
 };
 }
\ No newline at end of file
@@ -1,8 +1,18 @@
+#include <string.h>
+
 #include "types.h"
 
 #include "GPU3D.h"
 
+#if defined(NEONSOFTGPU_ENABLED) && defined(__aarch64__)
 #include <arm_neon.h>
+#endif
+
+// the SSE4.1 versions are picked at runtime, so they're always built on x86_64
+#if defined(__x86_64__)
+#define TRANSFORM_SSE41
+#include "dolphin/CPUDetect.h"
+#endif
 
 namespace GPU3D
 {
@@ -10,6 +20,28 @@ namespace GPU3D
 extern u32 CurPolygonAttr;
 
 extern s32 ClipMatrix[16];
+extern s32 VecMatrix[16];
+
+extern s16 LightDirection[4][3];
+extern u8 LightColor[4][3];
+extern u8 MatDiffuse[3];
+extern u8 MatAmbient[3];
+extern u8 MatSpecular[3];
+extern u8 MatEmission[3];
+
+extern bool UseShininessTable;
+extern u8 ShininessTable[128];
+
+#ifdef TRANSFORM_SSE41
+// see GPU3D_TransformSSE.cpp, these are only used if the CPU supports SSE4.1
+void MatrixMult4x4SSE41(s32* m, s32* s);
+void MatrixMult4x3SSE41(s32* m, s32* s);
+void MatrixMult3x3SSE41(s32* m, s32* s);
+void MatrixScaleSSE41(s32* m, s32* s);
+void MatrixTranslateSSE41(s32* m, s32* s);
+void TransformVertexSSE41(s16* inVertex, s32* outVertex);
+void LightVertexSSE41(s16* normal, u8* outColor);
+#endif
 
 template<int comp, s32 plane, bool attribs>
 void ClipSegment(Vertex* outbuf, Vertex* vin, Vertex* vout)
@@ -121,10 +153,18 @@ int ClipAgainstPlane(Vertex* vertices, int nverts, int clipstart)
     return c;
 }
 
-#ifndef NEONSOFTGPU_ENABLED
+#if !defined(NEONSOFTGPU_ENABLED) || !defined(__aarch64__)
 
 void MatrixMult4x4(s32* m, s32* s)
 {
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        MatrixMult4x4SSE41(m, s);
+        return;
+    }
+#endif
+
     s32 tmp[16];
     memcpy(tmp, m, 16*4);
 
@@ -152,6 +192,14 @@ void MatrixMult4x4(s32* m, s32* s)
 
 void MatrixMult4x3(s32* m, s32* s)
 {
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        MatrixMult4x3SSE41(m, s);
+        return;
+    }
+#endif
+
     s32 tmp[16];
     memcpy(tmp, m, 16*4);
 
@@ -179,6 +227,14 @@ void MatrixMult4x3(s32* m, s32* s)
 
 void MatrixMult3x3(s32* m, s32* s)
 {
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        MatrixMult3x3SSE41(m, s);
+        return;
+    }
+#endif
+
     s32 tmp[12];
     memcpy(tmp, m, 12*4);
 
@@ -201,6 +257,14 @@ void MatrixMult3x3(s32* m, s32* s)
 
 void MatrixScale(s32* m, s32* s)
 {
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        MatrixScaleSSE41(m, s);
+        return;
+    }
+#endif
+
     m[0] = ((s64)s[0]*m[0]) >> 12;
     m[1] = ((s64)s[0]*m[1]) >> 12;
     m[2] = ((s64)s[0]*m[2]) >> 12;
@@ -219,6 +283,14 @@ void MatrixScale(s32* m, s32* s)
 
 void MatrixTranslate(s32* m, s32* s)
 {
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        MatrixTranslateSSE41(m, s);
+        return;
+    }
+#endif
+
     m[12] += ((s64)s[0]*m[0] + (s64)s[1]*m[4] + (s64)s[2]*m[8]) >> 12;
     m[13] += ((s64)s[0]*m[1] + (s64)s[1]*m[5] + (s64)s[2]*m[9]) >> 12;
     m[14] += ((s64)s[0]*m[2] + (s64)s[1]*m[6] + (s64)s[2]*m[10]) >> 12;
@@ -252,15 +324,92 @@ int ClipPolygon(Vertex* vertices, int nverts, int clipstart)
 
 void TransformVertex(s16* inVertex, s32* outVertex)
 {
-    s64 x = input[0];
-    s64 y = input[1];
-    s64 z = input[2];
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        TransformVertexSSE41(inVertex, outVertex);
+        return;
+    }
+#endif
+
+    s64 x = inVertex[0];
+    s64 y = inVertex[1];
+    s64 z = inVertex[2];
     outVertex[0] = ((x*ClipMatrix[0] + y*ClipMatrix[4] + z*ClipMatrix[8]) >> 12) + ClipMatrix[12];
     outVertex[1] = ((x*ClipMatrix[1] + y*ClipMatrix[5] + z*ClipMatrix[9]) >> 12) + ClipMatrix[13];
     outVertex[2] = ((x*ClipMatrix[2] + y*ClipMatrix[6] + z*ClipMatrix[10]) >> 12) + ClipMatrix[14];
     outVertex[3] = ((x*ClipMatrix[3] + y*ClipMatrix[7] + z*ClipMatrix[11]) >> 12) + ClipMatrix[15];
 }
 
+void LightVertex(s16* normal, u8* outColor)
+{
+#ifdef TRANSFORM_SSE41
+    if (cpu_info.bSSE4_1)
+    {
+        LightVertexSSE41(normal, outColor);
+        return;
+    }
+#endif
+
+    s32 normaltrans[3];
+    normaltrans[0] = (normal[0]*VecMatrix[0] + normal[1]*VecMatrix[4] + normal[2]*VecMatrix[8]) >> 12;
+    normaltrans[1] = (normal[0]*VecMatrix[1] + normal[1]*VecMatrix[5] + normal[2]*VecMatrix[9]) >> 12;
+    normaltrans[2] = (normal[0]*VecMatrix[2] + normal[1]*VecMatrix[6] + normal[2]*VecMatrix[10]) >> 12;
+
+    outColor[0] = MatEmission[0];
+    outColor[1] = MatEmission[1];
+    outColor[2] = MatEmission[2];
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (!(CurPolygonAttr & (1<<i)))
+            continue;
+
+        // overflow handling (for example, if the normal length is >1)
+        // according to some hardware tests
+        // * diffuse level is saturated to 255
+        // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
+        // TODO: check how it behaves when the computed shininess is >=0x200
+
+        s32 difflevel = (-(LightDirection[i][0]*normaltrans[0] +
+                         LightDirection[i][1]*normaltrans[1] +
+                         LightDirection[i][2]*normaltrans[2])) >> 10;
+        if (difflevel < 0) difflevel = 0;
+        else if (difflevel > 255) difflevel = 255;
+
+        s32 shinelevel = -(((LightDirection[i][0]>>1)*normaltrans[0] +
+                          (LightDirection[i][1]>>1)*normaltrans[1] +
+                          ((LightDirection[i][2]-0x200)>>1)*normaltrans[2]) >> 10);
+        if (shinelevel < 0) shinelevel = 0;
+        else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
+        shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
+        if (shinelevel < 0) shinelevel = 0;
+
+        if (UseShininessTable)
+        {
+            // checkme
+            shinelevel >>= 1;
+            shinelevel = ShininessTable[shinelevel];
+        }
+
+        outColor[0] += ((MatSpecular[0] * LightColor[i][0] * shinelevel) >> 13);
+        outColor[0] += ((MatDiffuse[0] * LightColor[i][0] * difflevel) >> 13);
+        outColor[0] += ((MatAmbient[0] * LightColor[i][0]) >> 5);
+
+        outColor[1] += ((MatSpecular[1] * LightColor[i][1] * shinelevel) >> 13);
+        outColor[1] += ((MatDiffuse[1] * LightColor[i][1] * difflevel) >> 13);
+        outColor[1] += ((MatAmbient[1] * LightColor[i][1]) >> 5);
+
+        outColor[2] += ((MatSpecular[2] * LightColor[i][2] * shinelevel) >> 13);
+        outColor[2] += ((MatDiffuse[2] * LightColor[i][2] * difflevel) >> 13);
+        outColor[2] += ((MatAmbient[2] * LightColor[i][2]) >> 5);
+
+        if (outColor[0] > 31) outColor[0] = 31;
+        if (outColor[1] > 31) outColor[1] = 31;
+        if (outColor[2] > 31) outColor[2] = 31;
+    }
+}
+
 #else
 
 void MatrixMult4x4(s32* m, s32* s)
@@ -513,6 +662,67 @@ void TransformVertex(s16* inVertex, s32* outVertex)
     vst1q_s32(outVertex, vaddq_s32(vshrn_high_n_s64(vshrn_n_s64(accum0, 12), accum1, 12), clipmat.val[3]));
 }
 
+void LightVertex(s16* normal, u8* outColor)
+{
+    // every light is handled in its own lane and the disabled ones are masked
+    // out at the end. all the terms which are added to the color are positive
+    // and the color can't overflow in between, so saturating the sum once
+    // gives the same result as saturating it after every light
+
+    int32x4x3_t vecmat = vld1q_s32_x3(VecMatrix);
+    int32x4_t normaltrans = vmulq_n_s32(vecmat.val[0], normal[0]);
+    normaltrans = vmlaq_n_s32(normaltrans, vecmat.val[1], normal[1]);
+    normaltrans = vmlaq_n_s32(normaltrans, vecmat.val[2], normal[2]);
+    normaltrans = vshrq_n_s32(normaltrans, 12);
+
+    int16x4x3_t lightdir = vld3_s16(&LightDirection[0][0]);
+    int32x4_t dirX = vmovl_s16(lightdir.val[0]);
+    int32x4_t dirY = vmovl_s16(lightdir.val[1]);
+    int32x4_t dirZ = vmovl_s16(lightdir.val[2]);
+
+    int32x4_t difflevel = vmulq_laneq_s32(dirX, normaltrans, 0);
+    difflevel = vmlaq_laneq_s32(difflevel, dirY, normaltrans, 1);
+    difflevel = vmlaq_laneq_s32(difflevel, dirZ, normaltrans, 2);
+    difflevel = vshrq_n_s32(vnegq_s32(difflevel), 10);
+    difflevel = vminq_s32(vmaxq_s32(difflevel, vdupq_n_s32(0)), vdupq_n_s32(255));
+
+    int32x4_t shinelevel = vmulq_laneq_s32(vshrq_n_s32(dirX, 1), normaltrans, 0);
+    shinelevel = vmlaq_laneq_s32(shinelevel, vshrq_n_s32(dirY, 1), normaltrans, 1);
+    shinelevel = vmlaq_laneq_s32(shinelevel, vshrq_n_s32(vsubq_s32(dirZ, vdupq_n_s32(0x200)), 1), normaltrans, 2);
+    shinelevel = vnegq_s32(vshrq_n_s32(shinelevel, 10));
+    shinelevel = vbslq_s32(vcgtq_s32(shinelevel, vdupq_n_s32(255)),
+        vandq_s32(vsubq_s32(vdupq_n_s32(0x100), shinelevel), vdupq_n_s32(0xFF)),
+        vmaxq_s32(shinelevel, vdupq_n_s32(0)));
+    shinelevel = vsubq_s32(vshrq_n_s32(vmulq_s32(shinelevel, shinelevel), 7), vdupq_n_s32(0x100));
+    shinelevel = vmaxq_s32(shinelevel, vdupq_n_s32(0));
+
+    if (UseShininessTable)
+    {
+        // checkme
+        shinelevel = vshrq_n_s32(shinelevel, 1);
+        shinelevel = vsetq_lane_s32(ShininessTable[vgetq_lane_s32(shinelevel, 0)], shinelevel, 0);
+        shinelevel = vsetq_lane_s32(ShininessTable[vgetq_lane_s32(shinelevel, 1)], shinelevel, 1);
+        shinelevel = vsetq_lane_s32(ShininessTable[vgetq_lane_s32(shinelevel, 2)], shinelevel, 2);
+        shinelevel = vsetq_lane_s32(ShininessTable[vgetq_lane_s32(shinelevel, 3)], shinelevel, 3);
+    }
+
+    const uint32x4_t lightBits = {1, 2, 4, 8};
+    uint32x4_t enabled = vtstq_u32(vdupq_n_u32(CurPolygonAttr), lightBits);
+
+    for (int i = 0; i < 3; i++)
+    {
+        int32x4_t lightcolor = {LightColor[0][i], LightColor[1][i], LightColor[2][i], LightColor[3][i]};
+
+        int32x4_t color = vshrq_n_s32(vmulq_s32(vmulq_n_s32(lightcolor, MatSpecular[i]), shinelevel), 13);
+        color = vaddq_s32(color, vshrq_n_s32(vmulq_s32(vmulq_n_s32(lightcolor, MatDiffuse[i]), difflevel), 13));
+        color = vaddq_s32(color, vshrq_n_s32(vmulq_n_s32(lightcolor, MatAmbient[i]), 5));
+        color = vandq_s32(color, vreinterpretq_s32_u32(enabled));
+
+        s32 sum = MatEmission[i] + vaddvq_s32(color);
+        outColor[i] = sum > 31 ? 31 : sum;
+    }
+}
+
 #endif
 
 template int ClipPolygon<false>(Vertex*, int, int);
@@ -0,0 +1,278 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// SSE4.1 versions of the matrix, vertex and lighting math in GPU3D_Transform.cpp
+//
+// everything after the includes is compiled with SSE4.1 enabled, so nothing
+// in here may be called unless the CPU supports it. the scalar functions
+// dispatch here after checking.
+//
+// the 20.12 products are done as 64-bit multiplies of the even and odd lanes
+// (_mm_mul_epi32). the result of a product sum shifted right by 12 is truncated
+// to 32 bits, so only bits 12-43 of the sum are kept. these don't depend on
+// whether the shift is arithmetic or logical, which is why logical shifts
+// are used (SSE has no arithmetic 64-bit shift).
+
+#include <smmintrin.h>
+
+#include "types.h"
+
+#include "GPU3D.h"
+
+// the shared headers above have to stay usable on any x86_64 CPU,
+// so SSE4.1 is only enabled from here on
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+namespace GPU3D
+{
+
+extern u32 CurPolygonAttr;
+
+extern s32 ClipMatrix[16];
+extern s32 VecMatrix[16];
+
+extern s16 LightDirection[4][3];
+extern u8 LightColor[4][3];
+extern u8 MatDiffuse[3];
+extern u8 MatAmbient[3];
+extern u8 MatSpecular[3];
+extern u8 MatEmission[3];
+
+extern bool UseShininessTable;
+extern u8 ShininessTable[128];
+
+struct Accum
+{
+    __m128i Even, Odd;
+};
+
+static inline __m128i LoadRow(s32* m)
+{
+    return _mm_loadu_si128((__m128i*)m);
+}
+
+static inline void StoreRow(s32* m, __m128i row)
+{
+    _mm_storeu_si128((__m128i*)m, row);
+}
+
+// odd lanes of a row moved into the even ones, where _mm_mul_epi32 takes its inputs from
+static inline __m128i OddLanes(__m128i row)
+{
+    return _mm_srli_epi64(row, 32);
+}
+
+static inline Accum Mul(__m128i row, __m128i rowOdd, s32 factor)
+{
+    __m128i f = _mm_set1_epi32(factor);
+    return {_mm_mul_epi32(row, f), _mm_mul_epi32(rowOdd, f)};
+}
+
+static inline Accum MulAdd(Accum accum, __m128i row, __m128i rowOdd, s32 factor)
+{
+    __m128i f = _mm_set1_epi32(factor);
+    return {_mm_add_epi64(accum.Even, _mm_mul_epi32(row, f)),
+        _mm_add_epi64(accum.Odd, _mm_mul_epi32(rowOdd, f))};
+}
+
+// (accum >> 12), truncated to 32 bits per lane
+static inline __m128i Narrow(Accum accum)
+{
+    return _mm_blend_epi16(_mm_srli_epi64(accum.Even, 12), _mm_slli_epi64(accum.Odd, 20), 0xCC);
+}
+
+void MatrixMult4x4SSE41(s32* m, s32* s)
+{
+    __m128i row0 = LoadRow(&m[0]), row0Odd = OddLanes(row0);
+    __m128i row1 = LoadRow(&m[4]), row1Odd = OddLanes(row1);
+    __m128i row2 = LoadRow(&m[8]), row2Odd = OddLanes(row2);
+    __m128i row3 = LoadRow(&m[12]), row3Odd = OddLanes(row3);
+
+    // m = s*m
+    for (int i = 0; i < 16; i += 4)
+    {
+        Accum accum = Mul(row0, row0Odd, s[i]);
+        accum = MulAdd(accum, row1, row1Odd, s[i+1]);
+        accum = MulAdd(accum, row2, row2Odd, s[i+2]);
+        accum = MulAdd(accum, row3, row3Odd, s[i+3]);
+        StoreRow(&m[i], Narrow(accum));
+    }
+}
+
+void MatrixMult4x3SSE41(s32* m, s32* s)
+{
+    __m128i row0 = LoadRow(&m[0]), row0Odd = OddLanes(row0);
+    __m128i row1 = LoadRow(&m[4]), row1Odd = OddLanes(row1);
+    __m128i row2 = LoadRow(&m[8]), row2Odd = OddLanes(row2);
+    __m128i row3 = LoadRow(&m[12]);
+
+    // m = s*m
+    for (int i = 0; i < 3; i++)
+    {
+        Accum accum = Mul(row0, row0Odd, s[i*3]);
+        accum = MulAdd(accum, row1, row1Odd, s[i*3+1]);
+        accum = MulAdd(accum, row2, row2Odd, s[i*3+2]);
+        StoreRow(&m[i*4], Narrow(accum));
+    }
+
+    // the last row of s is (s[9], s[10], s[11], 0x1000), the last product
+    // is a multiple of 0x1000 and can be added after the shift
+    Accum accum = Mul(row0, row0Odd, s[9]);
+    accum = MulAdd(accum, row1, row1Odd, s[10]);
+    accum = MulAdd(accum, row2, row2Odd, s[11]);
+    StoreRow(&m[12], _mm_add_epi32(Narrow(accum), row3));
+}
+
+void MatrixMult3x3SSE41(s32* m, s32* s)
+{
+    __m128i row0 = LoadRow(&m[0]), row0Odd = OddLanes(row0);
+    __m128i row1 = LoadRow(&m[4]), row1Odd = OddLanes(row1);
+    __m128i row2 = LoadRow(&m[8]), row2Odd = OddLanes(row2);
+
+    // m = s*m
+    for (int i = 0; i < 3; i++)
+    {
+        Accum accum = Mul(row0, row0Odd, s[i*3]);
+        accum = MulAdd(accum, row1, row1Odd, s[i*3+1]);
+        accum = MulAdd(accum, row2, row2Odd, s[i*3+2]);
+        StoreRow(&m[i*4], Narrow(accum));
+    }
+}
+
+void MatrixScaleSSE41(s32* m, s32* s)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        __m128i row = LoadRow(&m[i*4]);
+        StoreRow(&m[i*4], Narrow(Mul(row, OddLanes(row), s[i])));
+    }
+}
+
+void MatrixTranslateSSE41(s32* m, s32* s)
+{
+    __m128i row0 = LoadRow(&m[0]);
+    __m128i row1 = LoadRow(&m[4]);
+    __m128i row2 = LoadRow(&m[8]);
+
+    Accum accum = Mul(row0, OddLanes(row0), s[0]);
+    accum = MulAdd(accum, row1, OddLanes(row1), s[1]);
+    accum = MulAdd(accum, row2, OddLanes(row2), s[2]);
+    StoreRow(&m[12], _mm_add_epi32(LoadRow(&m[12]), Narrow(accum)));
+}
+
+void TransformVertexSSE41(s16* inVertex, s32* outVertex)
+{
+    __m128i row0 = LoadRow(&ClipMatrix[0]);
+    __m128i row1 = LoadRow(&ClipMatrix[4]);
+    __m128i row2 = LoadRow(&ClipMatrix[8]);
+
+    Accum accum = Mul(row0, OddLanes(row0), inVertex[0]);
+    accum = MulAdd(accum, row1, OddLanes(row1), inVertex[1]);
+    accum = MulAdd(accum, row2, OddLanes(row2), inVertex[2]);
+    StoreRow(outVertex, _mm_add_epi32(Narrow(accum), LoadRow(&ClipMatrix[12])));
+}
+
+void LightVertexSSE41(s16* normal, u8* outColor)
+{
+    // every light is handled in its own lane and the disabled ones are masked
+    // out at the end. all the terms which are added to the color are positive
+    // and the color can't overflow in between, so saturating the sum once
+    // gives the same result as saturating it after every light
+
+    __m128i normaltrans = _mm_mullo_epi32(LoadRow(&VecMatrix[0]), _mm_set1_epi32(normal[0]));
+    normaltrans = _mm_add_epi32(normaltrans, _mm_mullo_epi32(LoadRow(&VecMatrix[4]), _mm_set1_epi32(normal[1])));
+    normaltrans = _mm_add_epi32(normaltrans, _mm_mullo_epi32(LoadRow(&VecMatrix[8]), _mm_set1_epi32(normal[2])));
+    normaltrans = _mm_srai_epi32(normaltrans, 12);
+
+    __m128i normalX = _mm_shuffle_epi32(normaltrans, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128i normalY = _mm_shuffle_epi32(normaltrans, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128i normalZ = _mm_shuffle_epi32(normaltrans, _MM_SHUFFLE(2, 2, 2, 2));
+
+    __m128i dirX = _mm_setr_epi32(LightDirection[0][0], LightDirection[1][0], LightDirection[2][0], LightDirection[3][0]);
+    __m128i dirY = _mm_setr_epi32(LightDirection[0][1], LightDirection[1][1], LightDirection[2][1], LightDirection[3][1]);
+    __m128i dirZ = _mm_setr_epi32(LightDirection[0][2], LightDirection[1][2], LightDirection[2][2], LightDirection[3][2]);
+
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i difflevel = _mm_mullo_epi32(dirX, normalX);
+    difflevel = _mm_add_epi32(difflevel, _mm_mullo_epi32(dirY, normalY));
+    difflevel = _mm_add_epi32(difflevel, _mm_mullo_epi32(dirZ, normalZ));
+    difflevel = _mm_srai_epi32(_mm_sub_epi32(zero, difflevel), 10);
+    difflevel = _mm_min_epi32(_mm_max_epi32(difflevel, zero), _mm_set1_epi32(255));
+
+    __m128i shinelevel = _mm_mullo_epi32(_mm_srai_epi32(dirX, 1), normalX);
+    shinelevel = _mm_add_epi32(shinelevel, _mm_mullo_epi32(_mm_srai_epi32(dirY, 1), normalY));
+    shinelevel = _mm_add_epi32(shinelevel,
+        _mm_mullo_epi32(_mm_srai_epi32(_mm_sub_epi32(dirZ, _mm_set1_epi32(0x200)), 1), normalZ));
+    shinelevel = _mm_sub_epi32(zero, _mm_srai_epi32(shinelevel, 10));
+    shinelevel = _mm_blendv_epi8(_mm_max_epi32(shinelevel, zero),
+        _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(0x100), shinelevel), _mm_set1_epi32(0xFF)),
+        _mm_cmpgt_epi32(shinelevel, _mm_set1_epi32(255)));
+    shinelevel = _mm_sub_epi32(_mm_srai_epi32(_mm_mullo_epi32(shinelevel, shinelevel), 7), _mm_set1_epi32(0x100));
+    shinelevel = _mm_max_epi32(shinelevel, zero);
+
+    if (UseShininessTable)
+    {
+        // checkme
+        shinelevel = _mm_srai_epi32(shinelevel, 1);
+        shinelevel = _mm_setr_epi32(ShininessTable[_mm_extract_epi32(shinelevel, 0)],
+            ShininessTable[_mm_extract_epi32(shinelevel, 1)],
+            ShininessTable[_mm_extract_epi32(shinelevel, 2)],
+            ShininessTable[_mm_extract_epi32(shinelevel, 3)]);
+    }
+
+    __m128i lightBits = _mm_setr_epi32(1, 2, 4, 8);
+    __m128i enabled = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(CurPolygonAttr), lightBits), lightBits);
+
+    __m128i color[3];
+    for (int i = 0; i < 3; i++)
+    {
+        __m128i lightcolor = _mm_setr_epi32(LightColor[0][i], LightColor[1][i], LightColor[2][i], LightColor[3][i]);
+
+        __m128i specular = _mm_mullo_epi32(lightcolor, _mm_set1_epi32(MatSpecular[i]));
+        __m128i diffuse = _mm_mullo_epi32(lightcolor, _mm_set1_epi32(MatDiffuse[i]));
+        __m128i ambient = _mm_mullo_epi32(lightcolor, _mm_set1_epi32(MatAmbient[i]));
+
+        color[i] = _mm_srai_epi32(_mm_mullo_epi32(specular, shinelevel), 13);
+        color[i] = _mm_add_epi32(color[i], _mm_srai_epi32(_mm_mullo_epi32(diffuse, difflevel), 13));
+        color[i] = _mm_add_epi32(color[i], _mm_srai_epi32(ambient, 5));
+        color[i] = _mm_and_si128(color[i], enabled);
+    }
+
+    // sum up the lights for each component
+    __m128i sum = _mm_hadd_epi32(_mm_hadd_epi32(color[0], color[1]), _mm_hadd_epi32(color[2], zero));
+    sum = _mm_add_epi32(sum, _mm_setr_epi32(MatEmission[0], MatEmission[1], MatEmission[2], 0));
+    sum = _mm_min_epi32(sum, _mm_set1_epi32(31));
+
+    outColor[0] = _mm_extract_epi32(sum, 0);
+    outColor[1] = _mm_extract_epi32(sum, 1);
+    outColor[2] = _mm_extract_epi32(sum, 2);
+}
+
+}
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
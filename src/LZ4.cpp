@@ -0,0 +1,226 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "LZ4.h"
+
+/*
+    LZ4 block format
+
+    a block is made of sequences, each starting with a token:
+    bit4-7 - number of literals
+    bit0-3 - match length - 4
+
+    if either is 15, it's continued in the following bytes, each adding
+    its value, until one is below 255 (literal length before the literals,
+    match length after the offset)
+
+    followed by the literals and a 16-bit offset to copy the match from.
+    The last sequence only contains literals, the last 5 bytes are always
+    literals and the last match starts at least 12 bytes before the end
+*/
+
+namespace LZ4
+{
+
+const u32 MinMatch = 4;
+const u32 LastLiterals = 5;
+const u32 MatchFindLimit = 12;
+const u32 MaxOffset = 0xFFFF;
+
+const int HashBits = 16;
+
+
+u32 Read32(const u8* ptr)
+{
+    u32 ret;
+    memcpy(&ret, ptr, 4);
+    return ret;
+}
+
+u64 Read64(const u8* ptr)
+{
+    u64 ret;
+    memcpy(&ret, ptr, 8);
+    return ret;
+}
+
+u32 Hash(u32 seq)
+{
+    return (seq * 2654435761U) >> (32 - HashBits);
+}
+
+u8* WriteLength(u8* op, u32 len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+u8* WriteLiterals(u8* op, const u8* src, u32 len, u8 matchnibble)
+{
+    *op++ = ((len >= 15 ? 15 : len) << 4) | matchnibble;
+    if (len >= 15) op = WriteLength(op, len - 15);
+
+    memcpy(op, src, len);
+    return op + len;
+}
+
+u32 CompressBound(u32 len)
+{
+    return len + len / 255 + 16;
+}
+
+u32 Compress(const u8* src, u32 len, u8* dst)
+{
+    u8* op = dst;
+    const u8* anchor = src;
+    const u8* end = src + len;
+
+    // position+1 of the last occurence of each hash, 0 if there was none
+    u32* table = len > MatchFindLimit ? (u32*)calloc(1 << HashBits, 4) : nullptr;
+    if (table)
+    {
+        const u8* matchlimit = end - LastLiterals;
+        const u8* mflimit = end - MatchFindLimit;
+        const u8* ip = src;
+        u32 misses = 0;
+
+        while (ip < mflimit)
+        {
+            u32 seq = Read32(ip);
+            u32 h = Hash(seq);
+            u32 last = table[h];
+            table[h] = (u32)(ip - src) + 1;
+
+            const u8* ref = src + last - 1;
+            if (!last || (u32)(ip - ref) > MaxOffset || Read32(ref) != seq)
+            {
+                // skip ahead faster the longer nothing is found
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            u32 matchlen = MinMatch;
+            while (ip + matchlen + 8 <= matchlimit && Read64(ip + matchlen) == Read64(ref + matchlen))
+                matchlen += 8;
+            while (ip + matchlen < matchlimit && ip[matchlen] == ref[matchlen])
+                matchlen++;
+
+            u32 ml = matchlen - MinMatch;
+            op = WriteLiterals(op, anchor, (u32)(ip - anchor), ml >= 15 ? 15 : ml);
+
+            u32 offset = (u32)(ip - ref);
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+            if (ml >= 15) op = WriteLength(op, ml - 15);
+
+            ip += matchlen;
+            anchor = ip;
+
+            if (ip < mflimit)
+                table[Hash(Read32(ip - 2))] = (u32)(ip - 2 - src) + 1;
+        }
+
+        free(table);
+    }
+
+    op = WriteLiterals(op, anchor, (u32)(end - anchor), 0);
+    return (u32)(op - dst);
+}
+
+bool Decompress(const u8* src, u32 srclen, u8* dst, u32 dstlen)
+{
+    const u8* ip = src;
+    const u8* iend = src + srclen;
+    u8* op = dst;
+    u8* oend = dst + dstlen;
+
+    for (;;)
+    {
+        if (ip >= iend) return false;
+        u8 token = *ip++;
+
+        u32 len = token >> 4;
+        if (len == 15)
+        {
+            u8 b;
+            do
+            {
+                if (ip >= iend) return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+
+        if (len > (u32)(iend - ip) || len > (u32)(oend - op)) return false;
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        u32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (u32)(op - dst)) return false;
+
+        len = token & 0xF;
+        if (len == 15)
+        {
+            u8 b;
+            do
+            {
+                if (ip >= iend) return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += MinMatch;
+
+        if (len > (u32)(oend - op)) return false;
+
+        // the match may overlap with what it produces, in which case it
+        // repeats with a period of offset. Every copy doubles the distance
+        const u8* ref = op - offset;
+        while (len)
+        {
+            u32 n = (u32)(op - ref);
+            if (n > len) n = len;
+            memcpy(op, ref, n);
+            op += n;
+            len -= n;
+        }
+    }
+
+    return op == oend;
+}
+
+}
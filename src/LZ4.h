@@ -0,0 +1,43 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "types.h"
+
+// compressor and decompressor for the LZ4 block format, used for savestate
+// files. Favours speed over ratio, savestates mostly consist of large
+// empty or repetitive areas which it does well on anyway
+namespace LZ4
+{
+
+// the size dst has to have at least to be able to compress len bytes
+u32 CompressBound(u32 len);
+
+// returns the compressed size, which might be larger than len
+// for incompressible data (but never larger than CompressBound)
+u32 Compress(const u8* src, u32 len, u8* dst);
+
+// dstlen has to be exactly the size of the original data
+// returns false if the data is corrupted
+bool Decompress(const u8* src, u32 srclen, u8* dst, u32 dstlen);
+
+}
+
+#endif // LZ4_H
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
+#include <chrono>
 #include "Config.h"
 #include "NDS.h"
 #include "ARM.h"
@@ -30,6 +31,7 @@
 #include "SPU.h"
 #include "SPI.h"
 #include "RTC.h"
+#include "Rewind.h"
 #include "Wifi.h"
 #include "AREngine.h"
 #include "Platform.h"
@@ -69,102 +71,71 @@ namespace NDS
 //
 // timings for GBA slot and wifi are set up at runtime
 
-int ConsoleType;
+Emulator DefaultInstance;
 
-u8 ARM9MemTimings[0x40000][4];
-u8 ARM7MemTimings[0x20000][4];
+// the parts of the state which are only used in here
 
-ARMv5* ARM9;
-ARMv4* ARM7;
-
-u32 NumFrames;
-u32 NumLagFrames;
-bool LagFrameFlag;
-u64 LastSysClockCycles;
-u64 FrameStartTimestamp;
-
-int CurCPU;
+u64& LastSysClockCycles = DefaultInstance.LastSysClockCycles;
+u64& FrameStartTimestamp = DefaultInstance.FrameStartTimestamp;
 
 const s32 kMaxIterationCycles = 64;
 
-u32 ARM9ClockShift;
-
 // no need to worry about those overflowing, they can keep going for atleast 4350 years
-u64 ARM9Timestamp, ARM9Target;
-u64 ARM7Timestamp, ARM7Target;
-u64 SysTimestamp;
+u64& SysTimestamp = DefaultInstance.SysTimestamp;
+
+SchedEvent (&SchedList)[Event_MAX] = DefaultInstance.SchedList;
+u32& SchedListMask = DefaultInstance.SchedListMask;
 
-SchedEvent SchedList[Event_MAX];
-u32 SchedListMask;
+// timestamp of the earliest scheduled event, so that finding the next target
+// and checking whether anything is due doesn't need to look at every event
+u64& SchedNextTimestamp = DefaultInstance.SchedNextTimestamp;
 
-u32 CPUStop;
+static_assert(Event_MAX <= 32, "scheduler masks are 32-bit");
 
 u8 ARM9BIOS[0x1000];
 u8 ARM7BIOS[0x4000];
 
-u8* MainRAM;
-u32 MainRAMMask;
-
-u8* SharedWRAM;
-u8 WRAMCnt;
-
-// putting them together so they're always next to each other
-MemRegion SWRAM_ARM9;
-MemRegion SWRAM_ARM7;
-
-u8* ARM7WRAM;
-
-u16 ExMemCnt[2];
-
-// TODO: these belong in NDSCart!
-u8 ROMSeed0[2*8];
-u8 ROMSeed1[2*8];
+u8& WRAMCnt = DefaultInstance.WRAMCnt;
 
 // IO shit
-u32 IME[2];
-u32 IE[2], IF[2];
-u32 IE2, IF2;
-
-u8 PostFlag9;
-u8 PostFlag7;
-u16 PowerControl9;
-u16 PowerControl7;
+u8& PostFlag9 = DefaultInstance.PostFlag9;
+u8& PostFlag7 = DefaultInstance.PostFlag7;
+u16& PowerControl7 = DefaultInstance.PowerControl7;
 
-u16 WifiWaitCnt;
+u16& WifiWaitCnt = DefaultInstance.WifiWaitCnt;
 
-u16 ARM7BIOSProt;
+u8 (&TimerCheckMask)[2] = DefaultInstance.TimerCheckMask;
+u64 (&TimerTimestamp)[2] = DefaultInstance.TimerTimestamp;
 
-Timer Timers[8];
-u8 TimerCheckMask[2];
-u64 TimerTimestamp[2];
+DMA* (&DMAs)[8] = DefaultInstance.DMAs;
+u32 (&DMA9Fill)[4] = DefaultInstance.DMA9Fill;
 
-DMA* DMAs[8];
-u32 DMA9Fill[4];
+u16& IPCSync9 = DefaultInstance.IPCSync9;
+u16& IPCSync7 = DefaultInstance.IPCSync7;
+u16& IPCFIFOCnt9 = DefaultInstance.IPCFIFOCnt9;
+u16& IPCFIFOCnt7 = DefaultInstance.IPCFIFOCnt7;
+FIFO<u32, 16>& IPCFIFO9 = DefaultInstance.IPCFIFO9;
+FIFO<u32, 16>& IPCFIFO7 = DefaultInstance.IPCFIFO7;
 
-u16 IPCSync9, IPCSync7;
-u16 IPCFIFOCnt9, IPCFIFOCnt7;
-FIFO<u32, 16> IPCFIFO9; // FIFO in which the ARM9 writes
-FIFO<u32, 16> IPCFIFO7;
+u16& DivCnt = DefaultInstance.DivCnt;
+u32 (&DivNumerator)[2] = DefaultInstance.DivNumerator;
+u32 (&DivDenominator)[2] = DefaultInstance.DivDenominator;
+u32 (&DivQuotient)[2] = DefaultInstance.DivQuotient;
+u32 (&DivRemainder)[2] = DefaultInstance.DivRemainder;
 
-u16 DivCnt;
-u32 DivNumerator[2];
-u32 DivDenominator[2];
-u32 DivQuotient[2];
-u32 DivRemainder[2];
+u16& SqrtCnt = DefaultInstance.SqrtCnt;
+u32 (&SqrtVal)[2] = DefaultInstance.SqrtVal;
+u32& SqrtRes = DefaultInstance.SqrtRes;
 
-u16 SqrtCnt;
-u32 SqrtVal[2];
-u32 SqrtRes;
+u16& KeyCnt = DefaultInstance.KeyCnt;
+u16& RCnt = DefaultInstance.RCnt;
 
-u32 KeyInput;
-u16 KeyCnt;
-u16 RCnt;
+bool& Running = DefaultInstance.Running;
 
-bool Running;
-
-bool RunningGame;
+bool& RunningGame = DefaultInstance.RunningGame;
 
 
+void UpdateSchedNextTimestamp();
 void DivDone(u32 param);
 void SqrtDone(u32 param);
 void RunTimer(u32 tid, s32 cycles);
@@ -177,6 +148,9 @@ bool Init()
     ARM9 = new ARMv5();
     ARM7 = new ARMv4();
 
+    SchedListMask = 0;
+    UpdateSchedNextTimestamp();
+
 #ifdef JIT_ENABLED
     ARMJIT::Init();
 #else
@@ -207,6 +181,8 @@ bool Init()
 
     if (!AREngine::Init()) return false;
 
+    if (!Rewind::Init()) return false;
+
     return true;
 }
 
@@ -234,6 +210,8 @@ void DeInit()
     DSi::DeInit();
 
     AREngine::DeInit();
+
+    Rewind::DeInit();
 }
 
 
@@ -273,6 +251,10 @@ void SetARM9RegionTimings(u32 addrstart, u32 addrend, int buswidth, int nonseq,
 
 void SetARM7RegionTimings(u32 addrstart, u32 addrend, int buswidth, int nonseq, int seq)
 {
+#ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
+#endif
+
     addrstart >>= 15;
     addrend   >>= 15;
 
@@ -451,6 +433,10 @@ void Reset()
     FILE* f;
     u32 i;
 
+#ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
+#endif
+
     RunningGame = false;
     LastSysClockCycles = 0;
 
@@ -579,6 +565,7 @@ void Reset()
 
     memset(SchedList, 0, sizeof(SchedList));
     SchedListMask = 0;
+    UpdateSchedNextTimestamp();
 
     KeyInput = 0x007F03FF;
     KeyCnt = 0;
@@ -592,6 +579,9 @@ void Reset()
     RTC::Reset();
     Wifi::Reset();
 
+    // snapshots from before are of no use anymore
+    Rewind::Reset();
+
     if (ConsoleType == 1)
     {
         DSi::Reset();
@@ -704,6 +694,11 @@ bool DoSavestate_Scheduler(Savestate* file)
 
 bool DoSavestate(Savestate* file)
 {
+#ifdef JIT_ENABLED
+    if (!file->Saving)
+        ARMJIT::FinishCompileJobs();
+#endif
+
     file->Section("NDSG");
 
     // TODO:
@@ -760,6 +755,7 @@ bool DoSavestate(Savestate* file)
 
     if (!DoSavestate_Scheduler(file)) return false;
     file->Var32(&SchedListMask);
+    if (!file->Saving) UpdateSchedNextTimestamp();
     file->Var64(&ARM9Timestamp);
     file->Var64(&ARM9Target);
     file->Var64(&ARM7Timestamp);
@@ -788,7 +784,8 @@ bool DoSavestate(Savestate* file)
         // but we do need to update the mappings
         MapSharedWRAM(WRAMCnt);
 
-        InitTimings();
+        // the fixed region timings were already set up on reset,
+        // only the ones which depend on registers need to be updated
         SetGBASlotTimings();
 
         u16 tmp = WifiWaitCnt;
@@ -818,7 +815,7 @@ bool DoSavestate(Savestate* file)
 #ifdef JIT_ENABLED
     if (!file->Saving)
     {
-        ARMJIT::ResetBlockCache();
+        ARMJIT::RetireBlockCache();
         ARMJIT_Memory::Reset();
     }
 #endif
@@ -828,6 +825,10 @@ bool DoSavestate(Savestate* file)
 
 void SetConsoleType(int type)
 {
+#ifdef JIT_ENABLED
+    ARMJIT::FinishCompileJobs();
+#endif
+
     ConsoleType = type;
 }
 
@@ -899,23 +900,52 @@ void RelocateSave(const char* path, bool write)
 
 
 
-u64 NextTarget()
+void ResetPerfCounters()
 {
-    u64 ret = SysTimestamp + kMaxIterationCycles;
+    memset(PerfCounters, 0, sizeof(PerfCounters));
+}
+
+inline u64 PerfTicks()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline u64 PerfStart()
+{
+    return PerfCountersEnabled ? PerfTicks() : 0;
+}
+
+inline void PerfEnd(int counter, u64 start)
+{
+    if (PerfCountersEnabled)
+        PerfCounters[counter] += PerfTicks() - start;
+}
+
+void UpdateSchedNextTimestamp()
+{
+    u64 next = UINT64_MAX;
 
     u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    while (mask)
     {
-        if (!mask) break;
-        if (mask & 0x1)
-        {
-            if (SchedList[i].Timestamp < ret)
-                ret = SchedList[i].Timestamp;
-        }
+        u32 i = __builtin_ctz(mask);
+        mask &= mask - 1;
 
-        mask >>= 1;
+        if (SchedList[i].Timestamp < next)
+            next = SchedList[i].Timestamp;
     }
 
+    SchedNextTimestamp = next;
+}
+
+u64 NextTarget()
+{
+    u64 ret = SysTimestamp + kMaxIterationCycles;
+
+    if (SchedNextTimestamp < ret)
+        ret = SchedNextTimestamp;
+
     return ret;
 }
 
@@ -923,20 +953,30 @@ void RunSystem(u64 timestamp)
 {
     SysTimestamp = timestamp;
 
+    if (SysTimestamp < SchedNextTimestamp)
+        return;
+
+    // the next timestamp is gathered while going through the events
+    // events which get scheduled by one of the callbacks lower it
+    // again and are only looked at the next time around
+    // (if one gets cancelled it might end up too early, which is harmless)
+    SchedNextTimestamp = UINT64_MAX;
+
     u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    while (mask)
     {
-        if (!mask) break;
-        if (mask & 0x1)
+        u32 i = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        if (SchedList[i].Timestamp <= SysTimestamp)
         {
-            if (SchedList[i].Timestamp <= SysTimestamp)
-            {
-                SchedListMask &= ~(1<<i);
-                SchedList[i].Func(SchedList[i].Param);
-            }
+            u64 perf = PerfStart();
+            SchedListMask &= ~(1<<i);
+            SchedList[i].Func(SchedList[i].Param);
+            PerfEnd(Perf_Events + i, perf);
         }
-
-        mask >>= 1;
+        else if (SchedList[i].Timestamp < SchedNextTimestamp)
+            SchedNextTimestamp = SchedList[i].Timestamp;
     }
 }
 
@@ -961,10 +1001,13 @@ u32 RunFrame()
             if (CPUStop & 0x80000000)
             {
                 // GXFIFO stall
+                u64 perf = PerfStart();
                 GPU3D::RunStall();
+                PerfEnd(Perf_GPU3D, perf);
             }
             else
             {
+                u64 perf = PerfStart();
                 if (CPUStop & 0x0FFF)
                 {
                     DMAs[0]->Run<ConsoleType>();
@@ -972,6 +1015,7 @@ u32 RunFrame()
                     if (!(CPUStop & 0x80000000)) DMAs[2]->Run<ConsoleType>();
                     if (!(CPUStop & 0x80000000)) DMAs[3]->Run<ConsoleType>();
                     if (ConsoleType == 1) DSi::RunNDMAs(0);
+                    PerfEnd(Perf_DMA, perf);
                 }
                 else
                 {
@@ -981,9 +1025,12 @@ u32 RunFrame()
                     else
         #endif
                         ARM9->Execute();
+                    PerfEnd(Perf_ARM9, perf);
                 }
 
+                perf = PerfStart();
                 GPU3D::Run();
+                PerfEnd(Perf_GPU3D, perf);
             }
             RunTimers(0);
 
@@ -994,6 +1041,7 @@ u32 RunFrame()
             {
                 ARM7Target = target; // might be changed by a reschedule
 
+                u64 perf = PerfStart();
                 if (CPUStop & 0x0FFF0000)
                 {
                     DMAs[4]->Run<ConsoleType>();
@@ -1001,6 +1049,7 @@ u32 RunFrame()
                     DMAs[6]->Run<ConsoleType>();
                     DMAs[7]->Run<ConsoleType>();
                     if (ConsoleType == 1) DSi::RunNDMAs(1);
+                    PerfEnd(Perf_DMA, perf);
                 }
                 else
                 {
@@ -1010,6 +1059,7 @@ u32 RunFrame()
                     else
 #endif
                         ARM7->Execute();
+                    PerfEnd(Perf_ARM7, perf);
                 }
 
                 RunTimers(1);
@@ -1052,16 +1102,22 @@ u32 RunFrame()
 
 u32 RunFrame()
 {
+    u32 ret;
 #ifdef JIT_ENABLED
     if (Config::JIT_Enable)
-        return NDS::ConsoleType == 1
+        ret = NDS::ConsoleType == 1
             ? RunFrame<true, 1>()
             : RunFrame<true, 0>();
     else
 #endif
-        return NDS::ConsoleType == 1
+        ret = NDS::ConsoleType == 1
             ? RunFrame<false, 1>()
             : RunFrame<false, 0>();
+
+    if (Config::RewindEnable)
+        Rewind::OnFrame();
+
+    return ret;
 }
 
 void Reschedule(u64 target)
@@ -1102,13 +1158,19 @@ void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 para
     evt->Param = param;
 
     SchedListMask |= (1<<id);
+    if (evt->Timestamp < SchedNextTimestamp)
+        SchedNextTimestamp = evt->Timestamp;
 
     Reschedule(evt->Timestamp);
 }
 
 void CancelEvent(u32 id)
 {
+    if (!(SchedListMask & (1<<id))) return;
+
     SchedListMask &= ~(1<<id);
+    if (SchedList[id].Timestamp == SchedNextTimestamp)
+        UpdateSchedNextTimestamp();
 }
 
 
@@ -21,6 +21,11 @@
 
 #include "Savestate.h"
 #include "types.h"
+#include "FIFO.h"
+
+class ARMv5;
+class ARMv4;
+class DMA;
 
 // when touching the main loop/timing code, pls test a lot of shit
 // with this enabled, to make sure it doesn't desync
@@ -55,6 +60,17 @@ enum
     Event_MAX
 };
 
+enum
+{
+    Perf_ARM9 = 0,
+    Perf_ARM7,
+    Perf_DMA,
+    Perf_GPU3D,
+    Perf_Events, // one counter per scheduler event, indexed by Perf_Events + Event_*
+
+    Perf_MAX = Perf_Events + Event_MAX
+};
+
 struct SchedEvent
 {
     void (*Func)(u32 param);
@@ -135,54 +151,162 @@ struct MemRegion
     u32 Mask;
 };
 
-extern int ConsoleType;
-extern int CurCPU;
+const u32 MainRAMMaxSize = 0x1000000;
+const u32 SharedWRAMSize = 0x8000;
+const u32 ARM7WRAMSize = 0x10000;
+
+// the state of one emulated console. So far there's only DefaultInstance,
+// the names below are references into it, so that the code using them
+// can be moved over to an Emulator piece by piece.
+// the BIOS images aren't in here, they're shared by every console
+struct Emulator
+{
+    int ConsoleType;
+
+    u8 ARM9MemTimings[0x40000][4];
+    u8 ARM7MemTimings[0x20000][4];
+
+    ARMv5* ARM9;
+    ARMv4* ARM7;
+
+    bool PerfCountersEnabled;
+    u64 PerfCounters[Perf_MAX];
+
+    u32 NumFrames;
+    u32 NumLagFrames;
+    bool LagFrameFlag;
+    u64 LastSysClockCycles;
+    u64 FrameStartTimestamp;
+
+    int CurCPU;
+
+    u32 ARM9ClockShift;
+
+    u64 ARM9Timestamp, ARM9Target;
+    u64 ARM7Timestamp, ARM7Target;
+    u64 SysTimestamp;
+
+    SchedEvent SchedList[Event_MAX];
+    u32 SchedListMask;
+    u64 SchedNextTimestamp;
+
+    u32 CPUStop;
+
+    u8* MainRAM;
+    u32 MainRAMMask;
+
+    u8* SharedWRAM;
+    u8 WRAMCnt;
+
+    MemRegion SWRAM_ARM9;
+    MemRegion SWRAM_ARM7;
+
+    u8* ARM7WRAM;
+
+    u16 ExMemCnt[2];
+
+    u8 ROMSeed0[2*8];
+    u8 ROMSeed1[2*8];
+
+    u32 IME[2];
+    u32 IE[2], IF[2];
+    u32 IE2, IF2;
+
+    u8 PostFlag9;
+    u8 PostFlag7;
+    u16 PowerControl9;
+    u16 PowerControl7;
+
+    u16 WifiWaitCnt;
+
+    u16 ARM7BIOSProt;
+
+    Timer Timers[8];
+    u8 TimerCheckMask[2];
+    u64 TimerTimestamp[2];
+
+    DMA* DMAs[8];
+    u32 DMA9Fill[4];
+
+    u16 IPCSync9, IPCSync7;
+    u16 IPCFIFOCnt9, IPCFIFOCnt7;
+    FIFO<u32, 16> IPCFIFO9; // FIFO in which the ARM9 writes
+    FIFO<u32, 16> IPCFIFO7;
+
+    u16 DivCnt;
+    u32 DivNumerator[2];
+    u32 DivDenominator[2];
+    u32 DivQuotient[2];
+    u32 DivRemainder[2];
+
+    u16 SqrtCnt;
+    u32 SqrtVal[2];
+    u32 SqrtRes;
+
+    u32 KeyInput;
+    u16 KeyCnt;
+    u16 RCnt;
+
+    bool Running;
+    bool RunningGame;
+};
+
+extern Emulator DefaultInstance;
+
+inline int& ConsoleType = DefaultInstance.ConsoleType;
+inline int& CurCPU = DefaultInstance.CurCPU;
+
+inline u8 (&ARM9MemTimings)[0x40000][4] = DefaultInstance.ARM9MemTimings;
+inline u8 (&ARM7MemTimings)[0x20000][4] = DefaultInstance.ARM7MemTimings;
+
+inline ARMv5*& ARM9 = DefaultInstance.ARM9;
+inline ARMv4*& ARM7 = DefaultInstance.ARM7;
 
-extern u8 ARM9MemTimings[0x40000][4];
-extern u8 ARM7MemTimings[0x20000][4];
+// when enabled, RunFrame accumulates the host time (in nanoseconds)
+// spent in each part of the emulation loop
+inline bool& PerfCountersEnabled = DefaultInstance.PerfCountersEnabled;
+inline u64 (&PerfCounters)[Perf_MAX] = DefaultInstance.PerfCounters;
 
-extern u32 NumFrames;
-extern u32 NumLagFrames;
-extern bool LagFrameFlag;
+inline u32& NumFrames = DefaultInstance.NumFrames;
+inline u32& NumLagFrames = DefaultInstance.NumLagFrames;
+inline bool& LagFrameFlag = DefaultInstance.LagFrameFlag;
 
-extern u64 ARM9Timestamp, ARM9Target;
-extern u64 ARM7Timestamp, ARM7Target;
-extern u32 ARM9ClockShift;
+inline u64& ARM9Timestamp = DefaultInstance.ARM9Timestamp;
+inline u64& ARM9Target = DefaultInstance.ARM9Target;
+inline u64& ARM7Timestamp = DefaultInstance.ARM7Timestamp;
+inline u64& ARM7Target = DefaultInstance.ARM7Target;
+inline u32& ARM9ClockShift = DefaultInstance.ARM9ClockShift;
 
-extern u32 IME[2];
-extern u32 IE[2];
-extern u32 IF[2];
-extern u32 IE2;
-extern u32 IF2;
-extern Timer Timers[8];
+inline u32 (&IME)[2] = DefaultInstance.IME;
+inline u32 (&IE)[2] = DefaultInstance.IE;
+inline u32 (&IF)[2] = DefaultInstance.IF;
+inline u32& IE2 = DefaultInstance.IE2;
+inline u32& IF2 = DefaultInstance.IF2;
+inline Timer (&Timers)[8] = DefaultInstance.Timers;
 
-extern u32 CPUStop;
+inline u32& CPUStop = DefaultInstance.CPUStop;
 
-extern u16 PowerControl9;
+inline u16& PowerControl9 = DefaultInstance.PowerControl9;
 
-extern u16 ExMemCnt[2];
-extern u8 ROMSeed0[2*8];
-extern u8 ROMSeed1[2*8];
+inline u16 (&ExMemCnt)[2] = DefaultInstance.ExMemCnt;
+inline u8 (&ROMSeed0)[2*8] = DefaultInstance.ROMSeed0;
+inline u8 (&ROMSeed1)[2*8] = DefaultInstance.ROMSeed1;
 
 extern u8 ARM9BIOS[0x1000];
 extern u8 ARM7BIOS[0x4000];
-extern u16 ARM7BIOSProt;
+inline u16& ARM7BIOSProt = DefaultInstance.ARM7BIOSProt;
 
-extern u8* MainRAM;
-extern u32 MainRAMMask;
+inline u8*& MainRAM = DefaultInstance.MainRAM;
+inline u32& MainRAMMask = DefaultInstance.MainRAMMask;
 
-const u32 MainRAMMaxSize = 0x1000000;
-
-const u32 SharedWRAMSize = 0x8000;
-extern u8* SharedWRAM;
+inline u8*& SharedWRAM = DefaultInstance.SharedWRAM;
 
-extern MemRegion SWRAM_ARM9;
-extern MemRegion SWRAM_ARM7;
+inline MemRegion& SWRAM_ARM9 = DefaultInstance.SWRAM_ARM9;
+inline MemRegion& SWRAM_ARM7 = DefaultInstance.SWRAM_ARM7;
 
-extern u32 KeyInput;
+inline u32& KeyInput = DefaultInstance.KeyInput;
 
-const u32 ARM7WRAMSize = 0x10000;
-extern u8* ARM7WRAM;
+inline u8*& ARM7WRAM = DefaultInstance.ARM7WRAM;
 
 bool Init();
 void DeInit();
@@ -207,6 +331,8 @@ void RelocateSave(const char* path, bool write);
 
 u32 RunFrame();
 
+void ResetPerfCounters();
+
 void TouchScreen(u16 x, u16 y);
 void ReleaseScreen();
 
@@ -222,6 +348,11 @@ int ImportSRAM(u8* data, u32 length);
 void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 param);
 void CancelEvent(u32 id);
 
+// next timestamp the system needs to be run at and running
+// all events due at the given timestamp. used by RunFrame
+u64 NextTarget();
+void RunSystem(u64 timestamp);
+
 void debug(u32 p);
 
 void Halt();
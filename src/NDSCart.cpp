@@ -1451,14 +1451,14 @@ void DoSavestate(Savestate* file)
 
 bool ReadROMParams(u32 gamecode, ROMListEntry* params)
 {
-    u32 len = sizeof(ROMList) / sizeof(ROMListEntry);
+    u32 len = ROMListSize;
 
     u32 offset = 0;
     u32 chk_size = len >> 1;
     for (;;)
     {
         u32 key = 0;
-        ROMListEntry* curentry = &ROMList[offset + chk_size];
+        const ROMListEntry* curentry = &ROMList[offset + chk_size];
         key = curentry->GameCode;
 
         if (key == gamecode)
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <time.h>
 #include "RTC.h"
+#include "NDS.h"
 
 
 namespace RTC
@@ -47,6 +48,8 @@ u8 Alarm2[3];
 u8 ClockAdjust;
 u8 FreeReg;
 
+time_t BaseTime = 0;
+
 
 bool Init()
 {
@@ -101,6 +104,26 @@ void DoSavestate(Savestate* file)
 }
 
 
+void SetBaseTime(time_t timestamp)
+{
+    BaseTime = timestamp;
+}
+
+void GetTime(struct tm* timedata)
+{
+    if (BaseTime)
+    {
+        // emulated time since boot, so the result doesn't depend on the host
+        time_t timestamp = BaseTime + (time_t)(NDS::ARM7Timestamp / 33513982);
+        gmtime_r(&timestamp, timedata);
+    }
+    else
+    {
+        time_t timestamp = time(NULL);
+        localtime_r(&timestamp, timedata);
+    }
+}
+
 u8 BCD(u8 val)
 {
     return (val % 10) | ((val / 10) << 4);
@@ -128,9 +151,8 @@ void ByteIn(u8 val)
 
             case 0x20:
                 {
-                    time_t timestamp = time(NULL);
                     struct tm timedata;
-                    localtime_r(&timestamp, &timedata);
+                    GetTime(&timedata);
 
                     Output[0] = BCD(timedata.tm_year - 100);
                     Output[1] = BCD(timedata.tm_mon + 1);
@@ -144,9 +166,8 @@ void ByteIn(u8 val)
 
             case 0x60:
                 {
-                    time_t timestamp = time(NULL);
                     struct tm timedata;
-                    localtime_r(&timestamp, &timedata);
+                    GetTime(&timedata);
 
                     Output[0] = BCD(timedata.tm_hour);
                     Output[1] = BCD(timedata.tm_min);
@@ -19,6 +19,8 @@
 #ifndef RTC_H
 #define RTC_H
 
+#include <time.h>
+
 #include "types.h"
 #include "Savestate.h"
 
@@ -30,6 +32,10 @@ void DeInit();
 void Reset();
 void DoSavestate(Savestate* file);
 
+// if set to a nonzero timestamp, the RTC starts counting from it
+// using emulated time instead of following the host clock
+void SetBaseTime(time_t timestamp);
+
 u16 Read();
 void Write(u16 val, bool byte);
 
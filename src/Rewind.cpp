@@ -0,0 +1,254 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "NDS.h"
+#include "Config.h"
+#include "Savestate.h"
+#include "Rewind.h"
+
+
+namespace Rewind
+{
+
+// the state at the newest snapshot
+SavestateBuffer Head;
+bool HasHead;
+
+SavestateBuffer Scratch;
+
+// ring buffer of deltas, starting at Oldest there are NumBack deltas
+// which each go back one snapshot, followed by NumForward deltas which go
+// forward again, the ones closest to Head are in the middle
+SavestateBuffer* Deltas;
+int Depth;
+int Oldest;
+int NumBack;
+int NumForward;
+
+u32 DeltaMemory;
+
+int FramesSinceSnapshot;
+bool JustStepped;
+
+
+bool Init()
+{
+    Deltas = nullptr;
+    Depth = 0;
+
+    Reset();
+
+    return true;
+}
+
+void DeInit()
+{
+    delete[] Deltas;
+    Deltas = nullptr;
+    Depth = 0;
+}
+
+void FreeDelta(SavestateBuffer* delta)
+{
+    DeltaMemory -= delta->Length;
+
+    if (delta->Data) free(delta->Data);
+    delta->Data = nullptr;
+    delta->Capacity = 0;
+    delta->Length = 0;
+}
+
+void Reset()
+{
+    for (int i = 0; i < Depth; i++)
+        FreeDelta(&Deltas[i]);
+
+    HasHead = false;
+    Oldest = 0;
+    NumBack = 0;
+    NumForward = 0;
+    DeltaMemory = 0;
+
+    FramesSinceSnapshot = 0;
+    JustStepped = false;
+}
+
+SavestateBuffer* GetDelta(int i)
+{
+    return &Deltas[(Oldest + i) % Depth];
+}
+
+void DropOldest()
+{
+    FreeDelta(GetDelta(0));
+    Oldest = (Oldest + 1) % Depth;
+    NumBack--;
+}
+
+void DropForward()
+{
+    for (int i = 0; i < NumForward; i++)
+        FreeDelta(GetDelta(NumBack + i));
+    NumForward = 0;
+}
+
+void SaveHead()
+{
+    Savestate* state = new Savestate(&Head, true);
+    NDS::DoSavestate(state);
+    HasHead = !state->Error;
+    delete state;
+}
+
+void LoadHead()
+{
+    Savestate* state = new Savestate(&Head, false);
+    if (!state->Error)
+        NDS::DoSavestate(state);
+    delete state;
+
+    FramesSinceSnapshot = 0;
+    JustStepped = true;
+}
+
+void TakeSnapshot()
+{
+    FramesSinceSnapshot = 0;
+
+    if (!HasHead)
+    {
+        SaveHead();
+        return;
+    }
+
+    Savestate* state = new Savestate(&Scratch, &Head);
+    NDS::DoSavestate(state);
+    delete state;
+
+    // a new snapshot means taking a new path
+    DropForward();
+
+    if (!Savestate::SwapDelta(&Head, &Scratch))
+    {
+        // the state changed too much (e.g. DSi mode was toggled),
+        // the old snapshots are of no use anymore
+        Reset();
+        SaveHead();
+        return;
+    }
+
+    // Head is now the new snapshot and Scratch the delta back to the previous one
+    u64 budget = (u64)Config::RewindMemory * 1024 * 1024;
+    while (NumBack > 0 && (NumBack == Depth || (u64)DeltaMemory + Head.Length + Scratch.Length > budget))
+        DropOldest();
+
+    if ((u64)Head.Length + Scratch.Length > budget)
+        return;
+
+    // hand the delta over to the ring buffer and take the
+    // memory of the slot it goes into in exchange
+    SavestateBuffer* slot = GetDelta(NumBack);
+    u8* data = slot->Data;
+    u32 capacity = slot->Capacity;
+    slot->Data = Scratch.Data;
+    slot->Capacity = Scratch.Capacity;
+    slot->Length = Scratch.Length;
+    Scratch.Data = data;
+    Scratch.Capacity = capacity;
+    Scratch.Length = 0;
+
+    DeltaMemory += slot->Length;
+    NumBack++;
+}
+
+void OnFrame()
+{
+    int depth = Config::RewindDepth > 0 ? Config::RewindDepth : 1;
+    if (depth != Depth)
+    {
+        Reset();
+        delete[] Deltas;
+        Depth = depth;
+        Deltas = new SavestateBuffer[Depth];
+    }
+
+    if (JustStepped)
+    {
+        // this frame was only run to show the snapshot which was stepped to
+        JustStepped = false;
+        FramesSinceSnapshot = 1;
+        return;
+    }
+
+    FramesSinceSnapshot++;
+    if (!HasHead || FramesSinceSnapshot >= Config::RewindInterval)
+        TakeSnapshot();
+}
+
+bool StepBack()
+{
+    if (!HasHead) return false;
+
+    if (FramesSinceSnapshot < 2)
+    {
+        if (NumBack == 0) return false;
+
+        // the delta is turned around, so that it can bring us forward again
+        if (!Savestate::SwapDelta(&Head, GetDelta(NumBack - 1)))
+            return false;
+
+        NumBack--;
+        NumForward++;
+    }
+
+    LoadHead();
+    return true;
+}
+
+bool StepForward()
+{
+    if (!HasHead || NumForward == 0) return false;
+
+    if (!Savestate::SwapDelta(&Head, GetDelta(NumBack)))
+        return false;
+
+    NumBack++;
+    NumForward--;
+
+    LoadHead();
+    return true;
+}
+
+int NumSnapshotsBack()
+{
+    return NumBack;
+}
+
+int NumSnapshotsForward()
+{
+    return NumForward;
+}
+
+u32 MemoryUsage()
+{
+    return DeltaMemory + Head.Length;
+}
+
+}
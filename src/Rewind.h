@@ -0,0 +1,52 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "types.h"
+
+// while Config::RewindEnable is set a snapshot is taken every
+// Config::RewindInterval frames. Only the newest snapshot is kept as a whole,
+// for the others the deltas to get from one to the one before are kept
+// in a ring buffer, limited by Config::RewindDepth and Config::RewindMemory
+namespace Rewind
+{
+
+bool Init();
+void DeInit();
+void Reset();
+
+// called by NDS::RunFrame after every frame
+void OnFrame();
+
+// loads the previous snapshot. If more than one frame was run since the
+// newest snapshot was taken or loaded, that one is loaded instead, so that
+// a frame can be run after every step to display something
+bool StepBack();
+// goes forward again through the snapshots which were stepped back from,
+// as long as no new one was taken since then
+bool StepForward();
+
+int NumSnapshotsBack();
+int NumSnapshotsForward();
+u32 MemoryUsage();
+
+}
+
+#endif
@@ -17,8 +17,11 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "Savestate.h"
 #include "Platform.h"
+#include "LZ4.h"
 
 /*
     Savestate format
@@ -28,7 +31,7 @@
     04 - version major
     06 - version minor
     08 - length
-    0C - reserved (should be game serial later!)
+    0C - number of sections in the table of contents, 0 if there is none
 
     section header:
     00 - section magic
@@ -41,17 +44,59 @@
     version difference:
     * different major means savestate file is incompatible
     * different minor means adjustments may have to be made
+    * version 8 is the same as version 9 without a table of contents
+
+    savestates in memory consist of the sections directly following the header,
+    files have a table of contents after the header instead. One entry per section:
+    00 - section magic
+    04 - offset of the section data within the file
+    08 - compressed length
+    0C - uncompressed length, if both are the same the data isn't compressed
+
+    the section data doesn't include the section header and is compressed
+    using the LZ4 block format. This way only the sections which are actually
+    needed have to be decompressed, while the uncompressed form stays cheap
+    to make in memory (e.g. for rewinding)
+
+    delta savestates:
+    00 - magic MELD
+    04 - version major
+    06 - version minor
+    08 - length of the full state
+    0C - reserved
+
+    followed by the blocks which differ from the base state:
+    00 - offset within the full state
+    04 - length
+    08 - data
+
+    the base state isn't identified in any way, keeping track
+    of which delta belongs to which state is up to the user
 */
 
-Savestate::Savestate(const char* filename, bool save)
+// granularity at which deltas are made
+const u32 DeltaBlockSize = 256;
+
+// upper bound for the uncompressed size of a section in a file, well above
+// the largest one the core writes (DSi main RAM), so a corrupted table
+// of contents can't make loading allocate arbitrary amounts of memory
+const u32 MaxSectionSize = 0x4000000;
+
+
+SavestateBuffer::~SavestateBuffer()
 {
-    const char* magic = "MELN";
+    if (Data) free(Data);
+}
 
+Savestate::Savestate(const char* filename, bool save)
+{
     Error = false;
+    Saving = save;
+    Buffer = &FileBuffer;
+    DeltaBase = nullptr;
 
     if (save)
     {
-        Saving = true;
         file = Platform::OpenLocalFile(filename, "wb");
         if (!file)
         {
@@ -59,18 +104,9 @@ Savestate::Savestate(const char* filename, bool save)
             Error = true;
             return;
         }
-
-        VersionMajor = SAVESTATE_MAJOR;
-        VersionMinor = SAVESTATE_MINOR;
-
-        fwrite(magic, 4, 1, file);
-        fwrite(&VersionMajor, 2, 1, file);
-        fwrite(&VersionMinor, 2, 1, file);
-        fseek(file, 8, SEEK_CUR); // length to be fixed later
     }
     else
     {
-        Saving = false;
         file = Platform::OpenFile(filename, "rb");
         if (!file)
         {
@@ -79,14 +115,113 @@ Savestate::Savestate(const char* filename, bool save)
             return;
         }
 
-        u32 len;
         fseek(file, 0, SEEK_END);
-        len = (u32)ftell(file);
+        u32 len = (u32)ftell(file);
         fseek(file, 0, SEEK_SET);
 
+        FileBuffer.Data = (u8*)malloc(len);
+        FileBuffer.Capacity = len;
+        FileBuffer.Length = len;
+        if (len && (!FileBuffer.Data || fread(FileBuffer.Data, len, 1, file) != 1))
+        {
+            printf("savestate: failed to read %s\n", filename);
+            Error = true;
+            return;
+        }
+    }
+
+    Open();
+}
+
+Savestate::Savestate(SavestateBuffer* buffer, bool save)
+{
+    Error = false;
+    Saving = save;
+    Buffer = buffer;
+    DeltaBase = nullptr;
+    file = nullptr;
+
+    Open();
+}
+
+Savestate::Savestate(SavestateBuffer* delta, const SavestateBuffer* base)
+{
+    Error = false;
+    Saving = true;
+    Buffer = delta;
+    DeltaBase = base;
+    file = nullptr;
+    delta->Length = 0;
+
+    Open();
+}
+
+void Savestate::Open()
+{
+    const char* magic = "MELN";
+
+    Pos = 0;
+    CurSection = -1;
+    Packed = nullptr;
+    NumSections = 0;
+
+    if (DeltaBase)
+    {
+        VersionMajor = SAVESTATE_MAJOR;
+        VersionMinor = SAVESTATE_MINOR;
+
+        u32 zero = 0;
+        if (DeltaBase->Length < 16 || memcmp(DeltaBase->Data, magic, 4)
+            || memcmp(&DeltaBase->Data[4], &VersionMajor, 2)
+            || memcmp(&DeltaBase->Data[6], &VersionMinor, 2)
+            || memcmp(&DeltaBase->Data[12], &zero, 4))
+        {
+            printf("savestate: delta base isn't a current savestate\n");
+            Error = true;
+            return;
+        }
+
+        if (!Grow(Buffer, 16))
+        {
+            Error = true;
+            return;
+        }
+
+        memcpy(&Buffer->Data[0], "MELD", 4);
+        memcpy(&Buffer->Data[4], &VersionMajor, 2);
+        memcpy(&Buffer->Data[6], &VersionMinor, 2);
+        memcpy(&Buffer->Data[8], &DeltaBase->Data[8], 4);
+        memset(&Buffer->Data[12], 0, 4);
+
+        Pos = 16;
+        DeltaPos = 16;
+        LastBlock = 0;
+    }
+    else if (Saving)
+    {
+        VersionMajor = SAVESTATE_MAJOR;
+        VersionMinor = SAVESTATE_MINOR;
+
+        u8 header[16] = {0};
+        memcpy(&header[0], magic, 4);
+        memcpy(&header[4], &VersionMajor, 2);
+        memcpy(&header[6], &VersionMinor, 2);
+        // length to be fixed later
+        VarArray(header, 16);
+    }
+    else
+    {
+        u32 len = Buffer->Length;
+        if (len < 16)
+        {
+            printf("savestate: too short (%d bytes)\n", len);
+            Error = true;
+            return;
+        }
+
         u32 buf = 0;
 
-        fread(&buf, 4, 1, file);
+        Var32(&buf);
         if (buf != ((u32*)magic)[0])
         {
             printf("savestate: invalid magic %08X\n", buf);
@@ -97,16 +232,16 @@ Savestate::Savestate(const char* filename, bool save)
         VersionMajor = 0;
         VersionMinor = 0;
 
-        fread(&VersionMajor, 2, 1, file);
-        if (VersionMajor != SAVESTATE_MAJOR)
+        VarArray(&VersionMajor, 2);
+        if (VersionMajor != SAVESTATE_MAJOR && VersionMajor != 8)
         {
             printf("savestate: bad version major %d, expecting %d\n", VersionMajor, SAVESTATE_MAJOR);
             Error = true;
             return;
         }
 
-        fread(&VersionMinor, 2, 1, file);
-        if (VersionMinor > SAVESTATE_MINOR)
+        VarArray(&VersionMinor, 2);
+        if (VersionMajor == SAVESTATE_MAJOR && VersionMinor > SAVESTATE_MINOR)
         {
             printf("savestate: state from the future, %d > %d\n", VersionMinor, SAVESTATE_MINOR);
             Error = true;
@@ -114,7 +249,7 @@ Savestate::Savestate(const char* filename, bool save)
         }
 
         buf = 0;
-        fread(&buf, 4, 1, file);
+        Var32(&buf);
         if (buf != len)
         {
             printf("savestate: bad length %d\n", buf);
@@ -122,84 +257,252 @@ Savestate::Savestate(const char* filename, bool save)
             return;
         }
 
-        fseek(file, 4, SEEK_CUR);
-    }
+        buf = 0;
+        Var32(&buf);
+        if (buf)
+        {
+            if (VersionMajor < 9 || buf > (len - 0x10) / 0x10)
+            {
+                printf("savestate: bad table of contents\n");
+                Error = true;
+                return;
+            }
 
-    CurSection = -1;
+            for (u32 i = 0; i < buf; i++)
+            {
+                u32 offset, packedlen, unpackedlen;
+                memcpy(&offset, &Buffer->Data[0x14 + i*0x10], 4);
+                memcpy(&packedlen, &Buffer->Data[0x18 + i*0x10], 4);
+                memcpy(&unpackedlen, &Buffer->Data[0x1C + i*0x10], 4);
+                if (offset > len || packedlen > len - offset || packedlen > unpackedlen
+                    || unpackedlen > MaxSectionSize)
+                {
+                    printf("savestate: bad table of contents\n");
+                    Error = true;
+                    return;
+                }
+            }
+
+            Packed = Buffer;
+            NumSections = buf;
+        }
+    }
 }
 
 Savestate::~Savestate()
 {
-    if (Error) return;
+    if (!Error && DeltaBase)
+    {
+        if (Pos != DeltaBase->Length)
+            printf("savestate: state doesn't line up with the delta base\n");
+        else
+            Buffer->Length = DeltaPos;
+    }
+    else if (!Error && Saving)
+    {
+        FinishSection();
 
-    if (Saving)
+        u32 len = Pos;
+        memcpy(&Buffer->Data[8], &len, 4);
+        Buffer->Length = len;
+
+        if (file)
+        {
+            SavestateBuffer packed;
+            if (!Pack(Buffer, &packed) || fwrite(packed.Data, packed.Length, 1, file) != 1)
+                printf("savestate: failed to write state\n");
+        }
+    }
+
+    if (file) fclose(file);
+}
+
+bool Savestate::Grow(SavestateBuffer* buffer, u32 size)
+{
+    if (size <= buffer->Capacity) return true;
+
+    // done in 64 bits, doubling past 2GB would overflow otherwise
+    u64 capacity = buffer->Capacity ? buffer->Capacity : 0x10000;
+    while (capacity < size)
+        capacity *= 2;
+
+    if (capacity > 0xFFFFFFFF)
+    {
+        printf("savestate: too large (%u bytes)\n", size);
+        return false;
+    }
+
+    u8* data = (u8*)realloc(buffer->Data, capacity);
+    if (!data)
     {
-        if (CurSection != 0xFFFFFFFF)
+        printf("savestate: out of memory (%u bytes)\n", (u32)capacity);
+        return false;
+    }
+
+    buffer->Data = data;
+    buffer->Capacity = (u32)capacity;
+    return true;
+}
+
+bool Savestate::Pack(const SavestateBuffer* state, SavestateBuffer* out)
+{
+    u32 numsections = 0;
+    u32 size = 0x10;
+    for (u32 pos = 0x10; pos < state->Length;)
+    {
+        u32 len;
+        memcpy(&len, &state->Data[pos+4], 4);
+        if (len < 0x10 || len > state->Length - pos)
         {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
+            printf("savestate: bad section at %08X\n", pos);
+            return false;
+        }
 
-            u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+        numsections++;
+        size += 0x10 + LZ4::CompressBound(len - 0x10);
+        pos += len;
+    }
+
+    if (!Grow(out, size)) return false;
 
-            fseek(file, pos, SEEK_SET);
+    u32 outpos = 0x10 + numsections*0x10;
+    u32 tocpos = 0x10;
+    for (u32 pos = 0x10; pos < state->Length;)
+    {
+        u32 len;
+        memcpy(&len, &state->Data[pos+4], 4);
+
+        const u8* data = &state->Data[pos+0x10];
+        u32 unpackedlen = len - 0x10;
+        u32 packedlen = LZ4::Compress(data, unpackedlen, &out->Data[outpos]);
+        if (packedlen >= unpackedlen)
+        {
+            memcpy(&out->Data[outpos], data, unpackedlen);
+            packedlen = unpackedlen;
         }
 
-        fseek(file, 0, SEEK_END);
-        u32 len = (u32)ftell(file);
-        fseek(file, 8, SEEK_SET);
-        fwrite(&len, 4, 1, file);
+        memcpy(&out->Data[tocpos], &state->Data[pos], 4);
+        memcpy(&out->Data[tocpos+4], &outpos, 4);
+        memcpy(&out->Data[tocpos+8], &packedlen, 4);
+        memcpy(&out->Data[tocpos+12], &unpackedlen, 4);
+
+        tocpos += 0x10;
+        outpos += packedlen;
+        pos += len;
     }
 
-    if (file) fclose(file);
+    memcpy(&out->Data[0], &state->Data[0], 8);
+    memcpy(&out->Data[8], &outpos, 4);
+    memcpy(&out->Data[12], &numsections, 4);
+    out->Length = outpos;
+    return true;
+}
+
+void Savestate::FinishSection()
+{
+    if (CurSection != 0xFFFFFFFF)
+    {
+        u32 len = Pos - CurSection;
+        memcpy(&Buffer->Data[CurSection+4], &len, 4);
+    }
 }
 
 void Savestate::Section(const char* magic)
 {
     if (Error) return;
 
-    if (Saving)
+    if (DeltaBase)
     {
-        if (CurSection != 0xFFFFFFFF)
+        // section headers are the same as in the base state,
+        // as long as the layout of everything is the same
+        if (Pos + 0x10 > DeltaBase->Length || memcmp(&DeltaBase->Data[Pos], magic, 4))
         {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
+            printf("savestate: section %s doesn't line up with the delta base\n", magic);
+            Error = true;
+            return;
+        }
 
-            u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+        CurSection = Pos;
+        Pos += 0x10;
+    }
+    else if (Saving)
+    {
+        FinishSection();
 
-            fseek(file, pos, SEEK_SET);
-        }
+        CurSection = Pos;
+
+        u8 header[16] = {0};
+        memcpy(&header[0], magic, 4);
+        VarArray(header, 16);
+    }
+    else if (Packed)
+    {
+        Buffer = &SectionBuffer;
+        Buffer->Length = 0;
+        Pos = 0;
+
+        for (u32 i = 0; i < NumSections; i++)
+        {
+            const u8* entry = &Packed->Data[0x10 + i*0x10];
+            if (memcmp(entry, magic, 4)) continue;
 
-        CurSection = (u32)ftell(file);
+            u32 offset, packedlen, len;
+            memcpy(&offset, &entry[4], 4);
+            memcpy(&packedlen, &entry[8], 4);
+            memcpy(&len, &entry[12], 4);
 
-        fwrite(magic, 4, 1, file);
-        fseek(file, 12, SEEK_CUR);
+            if (!Grow(Buffer, len))
+            {
+                Error = true;
+                return;
+            }
+
+            if (packedlen == len)
+            {
+                memcpy(Buffer->Data, &Packed->Data[offset], len);
+            }
+            else if (!LZ4::Decompress(&Packed->Data[offset], packedlen, Buffer->Data, len))
+            {
+                printf("savestate: section %s is corrupted\n", magic);
+                Error = true;
+                return;
+            }
+
+            Buffer->Length = len;
+            return;
+        }
+
+        printf("savestate: section %s not found. blarg\n", magic);
     }
     else
     {
-        fseek(file, 0x10, SEEK_SET);
+        Pos = 0x10;
 
         for (;;)
         {
-            u32 buf = 0;
+            if (Pos + 0x10 > Buffer->Length)
+            {
+                printf("savestate: section %s not found. blarg\n", magic);
+                return;
+            }
 
-            fread(&buf, 4, 1, file);
+            u32 buf, len;
+            memcpy(&buf, &Buffer->Data[Pos], 4);
+            memcpy(&len, &Buffer->Data[Pos+4], 4);
             if (buf != ((u32*)magic)[0])
             {
-                if (buf == 0)
+                if (len < 0x10)
                 {
                     printf("savestate: section %s not found. blarg\n", magic);
+                    Pos = Buffer->Length;
                     return;
                 }
 
-                buf = 0;
-                fread(&buf, 4, 1, file);
-                fseek(file, buf-8, SEEK_CUR);
+                Pos += len;
                 continue;
             }
 
-            fseek(file, 12, SEEK_CUR);
+            Pos += 0x10;
             break;
         }
     }
@@ -207,86 +510,230 @@ void Savestate::Section(const char* magic)
 
 void Savestate::Var8(u8* var)
 {
-    if (Error) return;
+    VarArray(var, 1);
+}
 
+void Savestate::Var16(u16* var)
+{
+    VarArray(var, 2);
+}
+
+void Savestate::Var32(u32* var)
+{
+    VarArray(var, 4);
+}
+
+void Savestate::Var64(u64* var)
+{
+    VarArray(var, 8);
+}
+
+void Savestate::Bool32(bool* var)
+{
+    // for compability
     if (Saving)
     {
-        fwrite(var, 1, 1, file);
+        u32 val = *var;
+        Var32(&val);
     }
     else
     {
-        fread(var, 1, 1, file);
+        u32 val;
+        Var32(&val);
+        *var = val != 0;
     }
 }
 
-void Savestate::Var16(u16* var)
+void Savestate::VarArray(void* data, u32 len)
 {
     if (Error) return;
 
-    if (Saving)
+    if (DeltaBase)
     {
-        fwrite(var, 2, 1, file);
+        DeltaArray((const u8*)data, len);
+    }
+    else if (Saving)
+    {
+        if (Pos + len > Buffer->Capacity && !Grow(Buffer, Pos + len))
+        {
+            Error = true;
+            return;
+        }
+
+        memcpy(&Buffer->Data[Pos], data, len);
+        Pos += len;
     }
     else
     {
-        fread(var, 2, 1, file);
+        // reading past the end leaves the variable untouched, like fread would
+        if (Pos + len > Buffer->Length)
+        {
+            Pos = Buffer->Length;
+            return;
+        }
+
+        memcpy(data, &Buffer->Data[Pos], len);
+        Pos += len;
     }
 }
 
-void Savestate::Var32(u32* var)
+void Savestate::DeltaArray(const u8* data, u32 len)
 {
-    if (Error) return;
-
-    if (Saving)
+    if (Pos + len > DeltaBase->Length)
     {
-        fwrite(var, 4, 1, file);
+        printf("savestate: state doesn't line up with the delta base\n");
+        Error = true;
+        return;
     }
-    else
+
+    const u8* base = &DeltaBase->Data[Pos];
+    u32 offset = 0;
+    while (offset < len)
     {
-        fread(var, 4, 1, file);
+        // compare in blocks aligned within the whole state, so that
+        // the many small variables don't each end up in their own block
+        u32 blocklen = DeltaBlockSize - ((Pos + offset) & (DeltaBlockSize-1));
+        if (blocklen > len - offset) blocklen = len - offset;
+
+        if (memcmp(&data[offset], &base[offset], blocklen))
+        {
+            u32 blockstart = Pos + offset;
+
+            // extend the previous block if this directly follows it
+            bool extend = false;
+            if (LastBlock)
+            {
+                u32 laststart, lastlen;
+                memcpy(&laststart, &Buffer->Data[LastBlock], 4);
+                memcpy(&lastlen, &Buffer->Data[LastBlock+4], 4);
+                extend = laststart + lastlen == blockstart;
+            }
+
+            u32 size = DeltaPos + (extend ? 0 : 8) + blocklen;
+            if (size > Buffer->Capacity && !Grow(Buffer, size))
+            {
+                Error = true;
+                return;
+            }
+
+            if (extend)
+            {
+                u32 lastlen;
+                memcpy(&lastlen, &Buffer->Data[LastBlock+4], 4);
+                lastlen += blocklen;
+                memcpy(&Buffer->Data[LastBlock+4], &lastlen, 4);
+            }
+            else
+            {
+                LastBlock = DeltaPos;
+                memcpy(&Buffer->Data[DeltaPos], &blockstart, 4);
+                memcpy(&Buffer->Data[DeltaPos+4], &blocklen, 4);
+                DeltaPos += 8;
+            }
+
+            memcpy(&Buffer->Data[DeltaPos], &data[offset], blocklen);
+            DeltaPos += blocklen;
+        }
+
+        offset += blocklen;
     }
+
+    Pos += len;
 }
 
-void Savestate::Var64(u64* var)
+bool Savestate::CheckDelta(const SavestateBuffer* base, const SavestateBuffer* delta)
 {
-    if (Error) return;
+    if (delta->Length < 16 || memcmp(delta->Data, "MELD", 4))
+    {
+        printf("savestate: invalid delta\n");
+        return false;
+    }
 
-    if (Saving)
+    u32 len;
+    memcpy(&len, &delta->Data[8], 4);
+    if (len != base->Length
+        || memcmp(&delta->Data[4], &base->Data[4], 4))
     {
-        fwrite(var, 8, 1, file);
+        printf("savestate: delta doesn't belong to this state\n");
+        return false;
     }
-    else
+
+    // check everything first, so that a bad delta doesn't leave a half updated state
+    u32 pos = 16;
+    while (pos < delta->Length)
     {
-        fread(var, 8, 1, file);
+        u32 blockstart, blocklen;
+        if (delta->Length - pos < 8)
+        {
+            printf("savestate: corrupted delta\n");
+            return false;
+        }
+        memcpy(&blockstart, &delta->Data[pos], 4);
+        memcpy(&blocklen, &delta->Data[pos+4], 4);
+        pos += 8;
+
+        if (blocklen > delta->Length - pos || blocklen > len || blockstart > len - blocklen)
+        {
+            printf("savestate: corrupted delta\n");
+            return false;
+        }
+        pos += blocklen;
     }
+
+    return true;
 }
 
-void Savestate::Bool32(bool* var)
+bool Savestate::ApplyDelta(const SavestateBuffer* base, const SavestateBuffer* delta, SavestateBuffer* out)
 {
-    // for compability
-    if (Saving)
+    if (!CheckDelta(base, delta)) return false;
+
+    u32 len = base->Length;
+
+    if (out != base)
     {
-        u32 val = *var;
-        Var32(&val);
+        if (!Grow(out, len)) return false;
+
+        memcpy(out->Data, base->Data, len);
+        out->Length = len;
     }
-    else
+
+    u32 pos = 16;
+    while (pos < delta->Length)
     {
-        u32 val;
-        Var32(&val);
-        *var = val != 0;
+        u32 blockstart, blocklen;
+        memcpy(&blockstart, &delta->Data[pos], 4);
+        memcpy(&blocklen, &delta->Data[pos+4], 4);
+        pos += 8;
+
+        memcpy(&out->Data[blockstart], &delta->Data[pos], blocklen);
+        pos += blocklen;
     }
+
+    return true;
 }
 
-void Savestate::VarArray(void* data, u32 len)
+bool Savestate::SwapDelta(SavestateBuffer* state, SavestateBuffer* delta)
 {
-    if (Error) return;
+    if (!CheckDelta(state, delta)) return false;
 
-    if (Saving)
-    {
-        fwrite(data, len, 1, file);
-    }
-    else
+    u32 pos = 16;
+    while (pos < delta->Length)
     {
-        fread(data, len, 1, file);
+        u32 blockstart, blocklen;
+        memcpy(&blockstart, &delta->Data[pos], 4);
+        memcpy(&blocklen, &delta->Data[pos+4], 4);
+        pos += 8;
+
+        u8* a = &state->Data[blockstart];
+        u8* b = &delta->Data[pos];
+        for (u32 i = 0; i < blocklen; i++)
+        {
+            u8 tmp = a[i];
+            a[i] = b[i];
+            b[i] = tmp;
+        }
+        pos += blocklen;
     }
+
+    return true;
 }
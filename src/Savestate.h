@@ -22,15 +22,44 @@
 #include <stdio.h>
 #include "types.h"
 
-#define SAVESTATE_MAJOR 8
+#define SAVESTATE_MAJOR 9
 #define SAVESTATE_MINOR 0
 
+// memory a savestate can be written to or read from directly,
+// owned by the caller and meant to be kept around, so that saving
+// a state every frame doesn't have to allocate anything
+struct SavestateBuffer
+{
+    SavestateBuffer() {}
+    SavestateBuffer(const SavestateBuffer&) = delete;
+    SavestateBuffer& operator=(const SavestateBuffer&) = delete;
+    ~SavestateBuffer();
+
+    u8* Data = nullptr;
+    u32 Capacity = 0;
+    u32 Length = 0; // size of the state it contains
+};
+
 class Savestate
 {
 public:
     Savestate(const char* filename, bool save);
+    // when saving the buffer is grown as needed, when loading
+    // the state is read from it in place
+    Savestate(SavestateBuffer* buffer, bool save);
+    // saves a delta state, which only contains the parts that differ from base
+    // if the state doesn't line up with base (e.g. different console type)
+    // delta is left empty (Length 0) and a full state has to be saved instead
+    Savestate(SavestateBuffer* delta, const SavestateBuffer* base);
     ~Savestate();
 
+    // reconstructs a full state from a delta and the state it was made against
+    // out may be the same buffer as base, to update it in place
+    static bool ApplyDelta(const SavestateBuffer* base, const SavestateBuffer* delta, SavestateBuffer* out);
+    // applies a delta to the state and at the same time turns it
+    // into the delta which brings the state back to how it was before
+    static bool SwapDelta(SavestateBuffer* state, SavestateBuffer* delta);
+
     bool Error;
 
     bool Saving;
@@ -59,6 +88,31 @@ public:
 
 private:
     FILE* file;
+
+    // file backed savestates also go through a buffer, so
+    // the file is only read or written once as a whole
+    SavestateBuffer FileBuffer;
+    SavestateBuffer* Buffer;
+    u32 Pos;
+
+    // when saving a delta Pos is the position within the full state
+    // and the changed blocks are appended to Buffer at DeltaPos
+    const SavestateBuffer* DeltaBase;
+    u32 DeltaPos;
+    u32 LastBlock;
+
+    // files with a table of contents, each section is
+    // decompressed into SectionBuffer once it's requested
+    const SavestateBuffer* Packed;
+    u32 NumSections;
+    SavestateBuffer SectionBuffer;
+
+    void Open();
+    static bool Grow(SavestateBuffer* buffer, u32 size);
+    static bool CheckDelta(const SavestateBuffer* base, const SavestateBuffer* delta);
+    static bool Pack(const SavestateBuffer* state, SavestateBuffer* out);
+    void FinishSection();
+    void DeltaArray(const u8* data, u32 len);
 };
 
 #endif // SAVESTATE_H
@@ -44,6 +44,7 @@ char PrevSRAMPath[ROMSlot_MAX][1024]; // for savestate 'undo load'
 char NDSROMExtension[4];
 
 bool SavestateLoaded;
+SavestateBuffer TimewarpState; // for savestate 'undo load'
 
 ARCodeFile* CheatFile;
 bool CheatsOn;
@@ -661,7 +662,7 @@ bool LoadState(const char* filename)
     u32 oldGBACartCRC = GBACart::CartCRC;
 
     // backup
-    Savestate* backup = new Savestate("timewarp.mln", true);
+    Savestate* backup = new Savestate(&TimewarpState, true);
     NDS::DoSavestate(backup);
     delete backup;
 
@@ -675,7 +676,7 @@ bool LoadState(const char* filename)
         //uiMsgBoxError(MainWindow, "Error", "Could not load savestate file.");
 
         // current state might be crapoed, so restore from sane backup
-        state = new Savestate("timewarp.mln", false);
+        state = new Savestate(&TimewarpState, false);
         failed = true;
     }
 
@@ -757,7 +758,7 @@ void UndoStateLoad()
     // pray that this works
     // what do we do if it doesn't???
     // but it should work.
-    Savestate* backup = new Savestate("timewarp.mln", false);
+    Savestate* backup = new Savestate(&TimewarpState, false);
     NDS::DoSavestate(backup);
     delete backup;
 
@@ -0,0 +1,213 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// geometry engine benchmark
+//
+// while a ROM runs every command the geometry engine executes can be
+// captured to a file. the capture is then replayed without any CPU, DMA
+// or FIFO timing: each command is written to its command port and executed
+// right away, and whenever a frame is flushed the polygons are moved to the
+// rendering side like on VBlank, without rendering them.
+//
+// this measures the matrix, vertex, lighting, clipping and polygon setup
+// work on its own. the polygons which come out are hashed, so that
+// different builds can be checked to give the same results.
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <vector>
+
+#include "NDS.h"
+#include "GPU3D.h"
+#include "GeometryBench.h"
+#include "SchedulerBench.h"
+
+#include "xxhash/xxhash.h"
+
+namespace GeometryBench
+{
+
+struct Command
+{
+    u32 Command;
+    u32 Param;
+};
+
+const u32 Magic = 0x4C435847; // GXCL
+
+std::vector<Command> Captured;
+
+void Capture(u8 command, u32 param)
+{
+    Captured.push_back({command, param});
+}
+
+void HashPolygons(XXH64_state_t* state)
+{
+    for (u32 i = 0; i < GPU3D::RenderNumPolygons; i++)
+    {
+        GPU3D::Polygon* poly = GPU3D::RenderPolygonRAM[i];
+
+        XXH64_update(state, &poly->NumVertices, sizeof(poly->NumVertices));
+        XXH64_update(state, &poly->Attr, sizeof(poly->Attr));
+        XXH64_update(state, &poly->TexParam, sizeof(poly->TexParam));
+        XXH64_update(state, &poly->TexPalette, sizeof(poly->TexPalette));
+        XXH64_update(state, poly->FinalZ, poly->NumVertices * sizeof(s32));
+        XXH64_update(state, poly->FinalW, poly->NumVertices * sizeof(s32));
+
+        for (u32 j = 0; j < poly->NumVertices; j++)
+        {
+            GPU3D::Vertex* vtx = poly->Vertices[j];
+
+            XXH64_update(state, vtx->Position, sizeof(vtx->Position));
+            XXH64_update(state, vtx->Color, sizeof(vtx->Color));
+            XXH64_update(state, vtx->TexCoords, sizeof(vtx->TexCoords));
+            XXH64_update(state, vtx->FinalPosition, sizeof(vtx->FinalPosition));
+            XXH64_update(state, vtx->FinalColor, sizeof(vtx->FinalColor));
+            XXH64_update(state, vtx->HiresPosition, sizeof(vtx->HiresPosition));
+        }
+    }
+}
+
+void ResetGeometry()
+{
+    GPU3D::Reset();
+    GPU3D::SetEnabled(true, true);
+}
+
+}
+
+void StartGeometryCapture()
+{
+    GeometryBench::Captured.clear();
+    GPU3D::CaptureCommand = GeometryBench::Capture;
+}
+
+bool FinishGeometryCapture(const char* path)
+{
+    using namespace GeometryBench;
+
+    GPU3D::CaptureCommand = nullptr;
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("failed to write geometry capture %s\n", path);
+        return false;
+    }
+
+    fwrite(&Magic, sizeof(Magic), 1, f);
+    fwrite(Captured.data(), sizeof(Command), Captured.size(), f);
+    fclose(f);
+
+    printf("geometry_capture.commands=%zu\n", Captured.size());
+    Captured.clear();
+    return true;
+}
+
+bool BenchGeometry(const char* path, int frames)
+{
+    using namespace GeometryBench;
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("failed to open geometry capture %s\n", path);
+        return false;
+    }
+
+    u32 magic = 0;
+    fread(&magic, sizeof(magic), 1, f);
+
+    std::vector<Command> list;
+    Command cmd;
+    while (fread(&cmd, sizeof(cmd), 1, f) == 1)
+        list.push_back(cmd);
+    fclose(f);
+
+    u32 capturedFrames = 0;
+    for (const Command& c : list)
+        if (c.Command == 0x50) capturedFrames++;
+
+    if (magic != Magic || !capturedFrames)
+    {
+        printf("%s isn't a geometry capture or doesn't contain any frames\n", path);
+        return false;
+    }
+
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+
+    u64 commands = 0, polygons = 0;
+    u64 time = 0;
+    int frame = 0;
+    size_t pos = 0;
+
+    // the capture is replayed from a fresh state each time it's looped,
+    // so every pass gives the same polygons
+    ResetGeometry();
+
+    u64 start = GetTimeNS();
+    while (frame < frames)
+    {
+        if (pos == list.size())
+        {
+            ResetGeometry();
+            pos = 0;
+        }
+
+        const Command& c = list[pos++];
+
+        // invalid commands from packed command words, these don't do anything
+        // and there's no command port they could be written to on their own
+        if (c.Command > 0 && c.Command < 0x10)
+            continue;
+
+        // nothing is executing in between, so the command always goes
+        // straight to the pipe and is the next one to run
+        GPU3D::Write32(0x04000400 + (c.Command << 2), c.Param);
+        GPU3D::ExecuteCommand();
+        commands++;
+
+        if (c.Command == 0x50)
+        {
+            GPU3D::VBlank();
+            time += GetTimeNS() - start;
+
+            polygons += GPU3D::RenderNumPolygons;
+            HashPolygons(hashState);
+            frame++;
+
+            start = GetTimeNS();
+        }
+    }
+
+    u64 hash = XXH64_digest(hashState);
+    XXH64_freeState(hashState);
+
+    printf("geometry.captured_frames=%u\n", capturedFrames);
+    printf("geometry.frames=%d\n", frames);
+    printf("geometry.commands=%" PRIu64 "\n", commands);
+    printf("geometry.polygons_per_frame=%" PRIu64 "\n", polygons / frames);
+    printf("geometry.time_ms=%.3f\n", time / 1000000.0);
+    printf("geometry.ms_per_frame=%.4f\n", time / 1000000.0 / frames);
+    printf("geometry.ns_per_command=%.2f\n", (double)time / commands);
+    printf("geometry.hash=%016" PRIx64 "\n", hash);
+
+    return true;
+}
@@ -0,0 +1,34 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef GEOMETRYBENCH_H
+#define GEOMETRYBENCH_H
+
+#include "types.h"
+
+// records every geometry command which is executed from now on
+void StartGeometryCapture();
+// stops recording and writes the captured display lists to path
+bool FinishGeometryCapture(const char* path);
+
+// replays the display lists captured to path through the geometry engine
+// until the given amount of frames were flushed and prints the results
+// expects the core to be initialised, but not running anything
+bool BenchGeometry(const char* path, int frames);
+
+#endif // GEOMETRYBENCH_H
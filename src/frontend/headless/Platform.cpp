@@ -0,0 +1,201 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Platform.h"
+
+extern bool EmuStopped;
+
+namespace Platform
+{
+
+void StopEmu()
+{
+    EmuStopped = true;
+}
+
+FILE* OpenFile(const char* path, const char* mode, bool mustexist)
+{
+    FILE* ret;
+
+    if (mustexist)
+    {
+        ret = fopen(path, "rb");
+        if (ret) ret = freopen(path, mode, ret);
+    }
+    else
+        ret = fopen(path, mode);
+
+    return ret;
+}
+
+FILE* OpenLocalFile(const char* path, const char* mode)
+{
+    // everything is relative to the working directory, so that
+    // several runners can be started side by side from different ones
+    return OpenFile(path, mode);
+}
+
+FILE* OpenDataFile(const char* path)
+{
+    return OpenLocalFile(path, "rb");
+}
+
+void Sleep(u64 usecs)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(usecs));
+}
+
+Thread* Thread_Create(std::function<void()> func)
+{
+    return (Thread*)new std::thread(func);
+}
+
+void Thread_Free(Thread* thread)
+{
+    std::thread* t = (std::thread*)thread;
+    if (t->joinable()) t->detach();
+    delete t;
+}
+
+void Thread_Wait(Thread* thread)
+{
+    ((std::thread*)thread)->join();
+}
+
+struct MySemaphore
+{
+    std::mutex Mutex;
+    std::condition_variable CondVar;
+    int Count = 0;
+};
+
+Semaphore* Semaphore_Create()
+{
+    return (Semaphore*)new MySemaphore();
+}
+
+void Semaphore_Free(Semaphore* sema)
+{
+    delete (MySemaphore*)sema;
+}
+
+void Semaphore_Reset(Semaphore* sema)
+{
+    MySemaphore* mysema = (MySemaphore*)sema;
+    std::lock_guard<std::mutex> lock(mysema->Mutex);
+    mysema->Count = 0;
+}
+
+void Semaphore_Wait(Semaphore* sema)
+{
+    MySemaphore* mysema = (MySemaphore*)sema;
+    std::unique_lock<std::mutex> lock(mysema->Mutex);
+    mysema->CondVar.wait(lock, [mysema]() { return mysema->Count > 0; });
+    mysema->Count--;
+}
+
+void Semaphore_Post(Semaphore* sema, int count)
+{
+    if (count <= 0) return;
+
+    MySemaphore* mysema = (MySemaphore*)sema;
+    {
+        std::lock_guard<std::mutex> lock(mysema->Mutex);
+        mysema->Count += count;
+    }
+    if (count == 1)
+        mysema->CondVar.notify_one();
+    else
+        mysema->CondVar.notify_all();
+}
+
+Mutex* Mutex_Create()
+{
+    return (Mutex*)new std::mutex();
+}
+
+void Mutex_Free(Mutex* mutex)
+{
+    delete (std::mutex*)mutex;
+}
+
+void Mutex_Lock(Mutex* mutex)
+{
+    ((std::mutex*)mutex)->lock();
+}
+
+void Mutex_Unlock(Mutex* mutex)
+{
+    ((std::mutex*)mutex)->unlock();
+}
+
+bool Mutex_TryLock(Mutex* mutex)
+{
+    return ((std::mutex*)mutex)->try_lock();
+}
+
+void* GL_GetProcAddress(const char* proc)
+{
+    return NULL;
+}
+
+bool MP_Init()
+{
+    return false;
+}
+
+void MP_DeInit()
+{}
+
+int MP_SendPacket(u8* data, int len)
+{
+    return 0;
+}
+
+int MP_RecvPacket(u8* data, bool block)
+{
+    return 0;
+}
+
+bool LAN_Init()
+{
+    return false;
+}
+
+void LAN_DeInit()
+{}
+
+int LAN_SendPacket(u8* data, int len)
+{
+    return 0;
+}
+
+int LAN_RecvPacket(u8* data)
+{
+    return 0;
+}
+
+}
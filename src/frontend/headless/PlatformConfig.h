@@ -0,0 +1,40 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef PLATFORMCONFIG_H
+#define PLATFORMCONFIG_H
+
+#include "Config.h"
+
+namespace Config
+{
+
+extern int ConsoleType;
+extern int DirectBoot;
+extern int SavestateRelocSRAM;
+
+extern int Threaded3D;
+extern int Threaded3DNumThreads;
+
+extern int Renderer2D;
+extern int Deferred2D;
+extern int Threaded2D;
+
+}
+
+#endif // PLATFORMCONFIG_H
@@ -0,0 +1,189 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// event scheduler microbenchmark
+//
+// runs the RunFrame loop without any CPU, only the scheduler:
+// get the next target, run everything that's due, repeat.
+// this is compared against a copy of the old scheduler which
+// scanned every event slot on each NextTarget/RunSystem call.
+//
+// two workloads are measured:
+// * typical: only LCD and SPU, what most games have running most of the time
+// * saturated: every slot fires constantly with very short periods,
+//   a worst case where nearly every iteration runs callbacks
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "NDS.h"
+#include "SchedulerBench.h"
+
+namespace SchedulerBench
+{
+
+const s32 PeriodsTypical[NDS::Event_MAX] =
+{
+    2130, 1024
+};
+
+const s32 PeriodsSaturated[NDS::Event_MAX] =
+{
+    2130, 64, 120, 33, 47, 18, 400, 34, 13, 90, 260, 71, 1000, 55, 26, 310
+};
+
+const s32* Periods;
+u64 EventCount;
+
+void CoreEvent(u32 id)
+{
+    EventCount++;
+    NDS::ScheduleEvent(id, true, Periods[id], CoreEvent, id);
+}
+
+// the scheduler how it was before the next event timestamp was cached
+namespace Linear
+{
+
+NDS::SchedEvent List[NDS::Event_MAX];
+u32 Mask;
+u64 Timestamp;
+u64 Target;
+
+// same work as NDS::ScheduleEvent for a periodic event
+__attribute__((noinline)) void Schedule(u32 id, s32 delay, void (*func)(u32))
+{
+    if (Mask & (1<<id))
+    {
+        printf("!! EVENT %d ALREADY SCHEDULED\n", id);
+        return;
+    }
+
+    NDS::SchedEvent* evt = &List[id];
+    evt->Timestamp += delay;
+    evt->Func = func;
+    evt->Param = id;
+
+    Mask |= (1<<id);
+
+    if (evt->Timestamp < Target)
+        Target = evt->Timestamp;
+}
+
+void Event(u32 id)
+{
+    EventCount++;
+    Schedule(id, Periods[id], Event);
+}
+
+__attribute__((noinline)) u64 NextTarget()
+{
+    u64 ret = Timestamp + 64;
+
+    u32 mask = Mask;
+    for (int i = 0; i < NDS::Event_MAX; i++)
+    {
+        if (!mask) break;
+        if (mask & 0x1)
+        {
+            if (List[i].Timestamp < ret)
+                ret = List[i].Timestamp;
+        }
+
+        mask >>= 1;
+    }
+
+    return ret;
+}
+
+__attribute__((noinline)) void RunSystem(u64 timestamp)
+{
+    Timestamp = timestamp;
+
+    u32 mask = Mask;
+    for (int i = 0; i < NDS::Event_MAX; i++)
+    {
+        if (!mask) break;
+        if (mask & 0x1)
+        {
+            if (List[i].Timestamp <= Timestamp)
+            {
+                Mask &= ~(1<<i);
+                List[i].Func(List[i].Param);
+            }
+        }
+
+        mask >>= 1;
+    }
+}
+
+}
+
+void Run(const char* name, const s32* periods, u64 iterations)
+{
+    Periods = periods;
+
+    for (int i = 0; i < NDS::Event_MAX; i++)
+        NDS::CancelEvent(i);
+    Linear::Mask = 0;
+    Linear::Timestamp = 0;
+    NDS::RunSystem(0);
+
+    for (int i = 0; i < NDS::Event_MAX; i++)
+    {
+        if (!periods[i]) continue;
+
+        Linear::List[i].Timestamp = 0;
+        Linear::Schedule(i, periods[i], Linear::Event);
+        NDS::ScheduleEvent(i, false, periods[i], CoreEvent, i);
+    }
+
+    EventCount = 0;
+    u64 start = GetTimeNS();
+    for (u64 i = 0; i < iterations; i++)
+        Linear::RunSystem(Linear::NextTarget());
+    u64 linearTime = GetTimeNS() - start;
+    u64 linearEvents = EventCount;
+
+    EventCount = 0;
+    start = GetTimeNS();
+    for (u64 i = 0; i < iterations; i++)
+        NDS::RunSystem(NDS::NextTarget());
+    u64 coreTime = GetTimeNS() - start;
+    u64 coreEvents = EventCount;
+
+    for (int i = 0; i < NDS::Event_MAX; i++)
+        NDS::CancelEvent(i);
+
+    if (linearEvents != coreEvents)
+        printf("%s.mismatch=%" PRIu64 "/%" PRIu64 "\n", name, linearEvents, coreEvents);
+
+    printf("%s.events=%" PRIu64 "\n", name, coreEvents);
+    printf("%s.linear_ns_per_iteration=%.3f\n", name, (double)linearTime / iterations);
+    printf("%s.core_ns_per_iteration=%.3f\n", name, (double)coreTime / iterations);
+    printf("%s.speedup=%.2f\n", name, (double)linearTime / coreTime);
+}
+
+}
+
+void BenchScheduler(u64 iterations)
+{
+    printf("iterations=%" PRIu64 "\n", iterations);
+    SchedulerBench::Run("typical", SchedulerBench::PeriodsTypical, iterations);
+    SchedulerBench::Run("saturated", SchedulerBench::PeriodsSaturated, iterations);
+}
@@ -0,0 +1,30 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef SCHEDULERBENCH_H
+#define SCHEDULERBENCH_H
+
+#include "types.h"
+
+u64 GetTimeNS();
+
+// runs the event scheduler microbenchmark and prints the results
+// expects the core to be initialised, but not running anything
+void BenchScheduler(u64 iterations);
+
+#endif // SCHEDULERBENCH_H
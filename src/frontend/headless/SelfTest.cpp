@@ -0,0 +1,207 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// checks of core code which can be done without running a ROM
+//
+// each check prints selftest.<name>=1 or 0, so it can be run
+// by ctest and still be looked at like the other headless modes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Savestate.h"
+#include "GPU3D_Soft.h"
+#include "SelfTest.h"
+
+namespace SelfTest
+{
+
+// a packed savestate with a table of contents holding a single
+// section TEST, whose data is stored uncompressed
+void MakePackedState(SavestateBuffer* buffer, u32 unpackedlen)
+{
+    const u32 len = 0x24;
+    buffer->Data = (u8*)malloc(len);
+    buffer->Capacity = len;
+    buffer->Length = len;
+
+    u16 major = SAVESTATE_MAJOR, minor = SAVESTATE_MINOR;
+    u32 numsections = 1;
+    u32 offset = 0x20, packedlen = 4;
+    u32 data = 0x12345678;
+
+    memcpy(&buffer->Data[0x00], "MELN", 4);
+    memcpy(&buffer->Data[0x04], &major, 2);
+    memcpy(&buffer->Data[0x06], &minor, 2);
+    memcpy(&buffer->Data[0x08], &len, 4);
+    memcpy(&buffer->Data[0x0C], &numsections, 4);
+    memcpy(&buffer->Data[0x10], "TEST", 4);
+    memcpy(&buffer->Data[0x14], &offset, 4);
+    memcpy(&buffer->Data[0x18], &packedlen, 4);
+    memcpy(&buffer->Data[0x1C], &unpackedlen, 4);
+    memcpy(&buffer->Data[0x20], &data, 4);
+}
+
+bool SavestateBogusLength()
+{
+    // the section is read back fine as long as the lengths add up
+    {
+        SavestateBuffer buffer;
+        MakePackedState(&buffer, 4);
+
+        Savestate state(&buffer, false);
+        u32 val = 0;
+        state.Section("TEST");
+        state.Var32(&val);
+        if (state.Error || val != 0x12345678)
+            return false;
+    }
+
+    // an uncompressed length which would need gigabytes has to be rejected
+    // up front, instead of trying to allocate it once the section is requested
+    const u32 bogus[] = {0x04000001, 0x80000001, 0xFFFFFFFF};
+    for (u32 unpackedlen : bogus)
+    {
+        SavestateBuffer buffer;
+        MakePackedState(&buffer, unpackedlen);
+
+        Savestate state(&buffer, false);
+        if (!state.Error)
+            return false;
+    }
+
+    return true;
+}
+
+// xorshift, so every run checks the same values
+u32 RandState = 0x2545F491;
+
+s32 Random(s32 min, s32 max)
+{
+    RandState ^= RandState << 13;
+    RandState ^= RandState >> 17;
+    RandState ^= RandState << 5;
+    return min + (s32)(RandState % (u32)(max - min + 1));
+}
+
+// W values for which the denominator of the perspective factor at x is den
+// while w0 is roughly the given value. the quotient doesn't fit into 32 bits
+// if den is small enough, which random W values practically never give
+bool MakeSmallDenominator(s32 x, s32 xdiff, s32 den, s32 w0approx, s32& w0, s32& w1)
+{
+    // x*a + (xdiff-x)*b = 1, only solvable if they have no common divisor
+    s32 m = xdiff - x;
+    s32 r0 = x, r1 = m, a0 = 1, a1 = 0;
+    while (r1)
+    {
+        s32 q = r0 / r1;
+        s32 t = r0 - q*r1; r0 = r1; r1 = t;
+        t = a0 - q*a1; a0 = a1; a1 = t;
+    }
+    if (r0 != 1) return false;
+
+    s32 a = a0 * den;
+    s32 b = (den - x*a) / m;
+
+    // moving along (m, -x) keeps the denominator the same
+    s32 t = (w0approx - a) / m;
+    w0 = a + t*m;
+    w1 = b - t*x;
+    return true;
+}
+
+bool PerspectiveFactors()
+{
+    u32 factors[64];
+    int overflows = 0, zeros = 0;
+
+    for (int i = 0; i < 300000; i++)
+    {
+        s32 w0, w1, xdiff, x, count;
+        if (i % 3 == 2)
+        {
+            // the special position is within the first 4, so the
+            // batch is the one computing it, not the scalar remainder
+            s32 special = Random(128, 400);
+            xdiff = special + Random(1, 111);
+            s32 den = Random(0, 1) ? Random(1, 2) : -Random(1, 2);
+            if (!MakeSmallDenominator(special, xdiff, den, Random(-0x10000, 0x10000), w0, w1))
+                continue;
+
+            x = special - Random(0, 3);
+            count = Random(4, 16);
+        }
+        else
+        {
+            // small W values make zero denominators likely
+            s32 wrange = (i % 3) ? 4 : 0x10000;
+            w0 = Random(-wrange, wrange);
+            w1 = Random(-wrange, wrange);
+            xdiff = Random(1, 511);
+            x = Random(0, xdiff);
+            count = Random(1, 64);
+        }
+
+        GPU3D::CalcPerspectiveFactorsX(factors, x, count, xdiff, w0, w1);
+
+        for (s32 j = 0; j < count; j++)
+        {
+            s64 num = ((s64)(x+j) * w0) << 8;
+            s32 den = ((x+j) * w0) + ((xdiff-(x+j)) * w1);
+            if (den == 0)
+                zeros++;
+            else if (num / den != (s32)(num / den))
+                overflows++;
+
+            if (factors[j] != GPU3D::PerspectiveFactorX(x+j, xdiff, w0, w1))
+            {
+                printf("perspective factor mismatch: x=%d xdiff=%d w0=%d w1=%d, %08X instead of %08X\n",
+                    x+j, xdiff, w0, w1, factors[j], GPU3D::PerspectiveFactorX(x+j, xdiff, w0, w1));
+                return false;
+            }
+        }
+    }
+
+    // otherwise the cases the batch handles specially weren't tested
+    if (!overflows || !zeros)
+    {
+        printf("perspective factors: no overflowing (%d) or zero denominators (%d) checked\n", overflows, zeros);
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+bool RunSelfTest()
+{
+    bool ok = true;
+    bool res;
+
+    res = SelfTest::SavestateBogusLength();
+    printf("selftest.savestate_bogus_length=%d\n", res);
+    ok = ok && res;
+
+    res = SelfTest::PerspectiveFactors();
+    printf("selftest.perspective_factors=%d\n", res);
+    ok = ok && res;
+
+    return ok;
+}
@@ -0,0 +1,652 @@
+/*
+    Copyright 2016-2021 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// headless runner, meant for batch testing and benchmarking
+//
+// boots a ROM (optionally loads a savestate), runs a fixed amount of frames
+// as fast as possible without any audio or video output and prints
+// the results as key=value lines on stdout, so they can be easily
+// consumed by scripts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <chrono>
+#include <vector>
+
+#include "NDS.h"
+#include "GPU.h"
+#include "SPU.h"
+#include "RTC.h"
+#include "Savestate.h"
+#include "Rewind.h"
+#include "FrontendUtil.h"
+#include "Platform.h"
+
+#include "PlatformConfig.h"
+#include "SchedulerBench.h"
+#include "GeometryBench.h"
+#include "SelfTest.h"
+
+#include "xxhash/xxhash.h"
+
+bool EmuStopped = false;
+
+const char* EventNames[] =
+{
+    "LCD",
+    "SPU",
+    "Wifi",
+    "DisplayFIFO",
+    "ROMTransfer",
+    "ROMSPITransfer",
+    "SPITransfer",
+    "Div",
+    "Sqrt",
+    "DSi_SDMMCTransfer",
+    "DSi_SDIOTransfer",
+    "DSi_NWifi",
+    "DSi_CamIRQ",
+    "DSi_CamTransfer",
+    "DSi_RAMSizeChange",
+    "DSi_DSP",
+};
+static_assert(sizeof(EventNames) / sizeof(EventNames[0]) == NDS::Event_MAX, "event name table out of date");
+
+struct Options
+{
+    bool SelfTest = false;
+    u64 SchedulerBenchIterations = 0;
+    const char* GeometryBenchPath = nullptr;
+
+    const char* ROMPath = nullptr;
+    const char* SavestatePath = nullptr;
+    const char* WriteSavestatePath = nullptr;
+    const char* GeometryCapturePath = nullptr;
+    const char* DumpFramePath = nullptr;
+
+    int Frames = 600;
+    int WarmupFrames = 0;
+
+    bool Profile = false;
+    bool HashEveryFrame = false;
+    bool SavestateRoundtrip = false;
+    bool DeltaSavestates = false;
+    int RewindSteps = 0;
+    bool Compare2D = false;
+
+    // 2000-01-01 00:00:00 UTC, so that games reading the RTC behave the same on every run
+    long long RTCTime = 946684800;
+};
+
+void PrintUsage(const char* exe)
+{
+    printf("usage: %s [options] <rom>\n", exe);
+    printf("\n");
+    printf("  --frames N          run N frames (default 600)\n");
+    printf("  --warmup N          run N frames before measuring (default 0)\n");
+    printf("  --savestate FILE    load FILE after booting the ROM\n");
+    printf("  --write-savestate FILE\n");
+    printf("                      save the state to FILE after the last frame\n");
+    printf("  --profile           report host time spent per subsystem\n");
+    printf("  --hash-every-frame  also hash every measured frame, combined into frames_hash\n");
+    printf("  --dump-frame FILE   write the last frame of both screens to FILE as a PPM image\n");
+    printf("  --savestate-roundtrip\n");
+    printf("                      save and reload an in-memory savestate every frame\n");
+    printf("  --delta-savestates  make the roundtrip save deltas against the previous frame\n");
+    printf("  --rewind N          keep rewind snapshots, afterwards step back N of them,\n");
+    printf("                      run up to the last frame again and compare the result\n");
+    printf("  --dsi               emulate a DSi instead of a DS\n");
+    printf("  --firmware-boot     boot through the firmware instead of directly\n");
+    printf("  --single-thread-3d  don't use a separate thread for 3D rendering\n");
+    printf("  --3d-threads N      amount of threads 3D rendering is split across,\n");
+    printf("                      0 to pick it depending on the amount of cores\n");
+    printf("  --2d-renderer N     2D renderer, 0 = software, 1 = NEON/SSE4.1 software, 2 = deko3d,\n");
+    printf("                      -1 to pick the fastest one available (default)\n");
+    printf("  --2d-deferred       record the 2D register state and render whole frames at once\n");
+    printf("  --threaded-2d       render the recorded 2D scanlines on a separate thread\n");
+    printf("  --compare-2d        render every measured frame again with the software 2D renderer\n");
+    printf("                      and count the pixels the selected renderer gets different\n");
+#ifdef JIT_ENABLED
+    printf("  --jit / --no-jit    enable or disable the JIT recompiler\n");
+    printf("  --jit-block-size N  maximum JIT block size (1-32)\n");
+    printf("  --jit-background    compile JIT blocks on a separate thread\n");
+#endif
+    printf("  --bios9 FILE        ARM9 BIOS path\n");
+    printf("  --bios7 FILE        ARM7 BIOS path\n");
+    printf("  --firmware FILE     firmware path\n");
+    printf("  --rtc-time T        UNIX timestamp the RTC starts at, 0 to follow the host clock\n");
+    printf("  --capture-geometry FILE\n");
+    printf("                      write the geometry commands executed during the measured frames to FILE\n");
+    printf("  --bench-scheduler N run N iterations of the event scheduler microbenchmark\n");
+    printf("                      instead of running a ROM\n");
+    printf("  --bench-geometry FILE\n");
+    printf("                      replay the geometry commands captured to FILE for as many frames\n");
+    printf("                      as given by --frames instead of running a ROM\n");
+    printf("  --self-test         run the checks which don't need a ROM instead of running one\n");
+    printf("\n");
+    printf("everything else is taken from melonDS.ini in the working directory\n");
+}
+
+bool ParseArgs(int argc, char** argv, Options& opt)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* val = (i+1 < argc) ? argv[i+1] : nullptr;
+
+#define NEED_VALUE() if (!val) { printf("missing value for %s\n", arg); return false; } i++;
+
+        if (!strcmp(arg, "--frames")) { NEED_VALUE(); opt.Frames = atoi(val); }
+        else if (!strcmp(arg, "--warmup")) { NEED_VALUE(); opt.WarmupFrames = atoi(val); }
+        else if (!strcmp(arg, "--savestate")) { NEED_VALUE(); opt.SavestatePath = val; }
+        else if (!strcmp(arg, "--write-savestate")) { NEED_VALUE(); opt.WriteSavestatePath = val; }
+        else if (!strcmp(arg, "--profile")) opt.Profile = true;
+        else if (!strcmp(arg, "--hash-every-frame")) opt.HashEveryFrame = true;
+        else if (!strcmp(arg, "--dump-frame")) { NEED_VALUE(); opt.DumpFramePath = val; }
+        else if (!strcmp(arg, "--savestate-roundtrip")) opt.SavestateRoundtrip = true;
+        else if (!strcmp(arg, "--delta-savestates")) opt.SavestateRoundtrip = opt.DeltaSavestates = true;
+        else if (!strcmp(arg, "--rewind")) { NEED_VALUE(); opt.RewindSteps = atoi(val); Config::RewindEnable = 1; }
+        else if (!strcmp(arg, "--dsi")) Config::ConsoleType = 1;
+        else if (!strcmp(arg, "--firmware-boot")) Config::DirectBoot = 0;
+        else if (!strcmp(arg, "--single-thread-3d")) Config::Threaded3D = 0;
+        else if (!strcmp(arg, "--3d-threads")) { NEED_VALUE(); Config::Threaded3DNumThreads = atoi(val); }
+        else if (!strcmp(arg, "--2d-renderer")) { NEED_VALUE(); Config::Renderer2D = atoi(val); }
+        else if (!strcmp(arg, "--2d-deferred")) Config::Deferred2D = 1;
+        else if (!strcmp(arg, "--threaded-2d")) Config::Threaded2D = 1;
+        else if (!strcmp(arg, "--compare-2d")) opt.Compare2D = true;
+#ifdef JIT_ENABLED
+        else if (!strcmp(arg, "--jit")) Config::JIT_Enable = 1;
+        else if (!strcmp(arg, "--no-jit")) Config::JIT_Enable = 0;
+        else if (!strcmp(arg, "--jit-block-size")) { NEED_VALUE(); Config::JIT_MaxBlockSize = atoi(val); }
+        else if (!strcmp(arg, "--jit-background")) Config::JIT_BackgroundCompile = 1;
+#endif
+        else if (!strcmp(arg, "--bios9")) { NEED_VALUE(); strncpy(Config::BIOS9Path, val, 1023); }
+        else if (!strcmp(arg, "--bios7")) { NEED_VALUE(); strncpy(Config::BIOS7Path, val, 1023); }
+        else if (!strcmp(arg, "--firmware")) { NEED_VALUE(); strncpy(Config::FirmwarePath, val, 1023); }
+        else if (!strcmp(arg, "--rtc-time")) { NEED_VALUE(); opt.RTCTime = atoll(val); }
+        else if (!strcmp(arg, "--capture-geometry")) { NEED_VALUE(); opt.GeometryCapturePath = val; }
+        else if (!strcmp(arg, "--bench-scheduler")) { NEED_VALUE(); opt.SchedulerBenchIterations = strtoull(val, NULL, 10); }
+        else if (!strcmp(arg, "--bench-geometry")) { NEED_VALUE(); opt.GeometryBenchPath = val; }
+        else if (!strcmp(arg, "--self-test")) opt.SelfTest = true;
+        else if (arg[0] == '-')
+        {
+            printf("unknown option %s\n", arg);
+            return false;
+        }
+        else if (!opt.ROMPath) opt.ROMPath = arg;
+        else
+        {
+            printf("more than one ROM specified\n");
+            return false;
+        }
+
+#undef NEED_VALUE
+    }
+
+    if (!opt.ROMPath && !opt.SchedulerBenchIterations && !opt.GeometryBenchPath && !opt.SelfTest)
+    {
+        printf("no ROM specified\n");
+        return false;
+    }
+    if (opt.Frames <= 0 || opt.WarmupFrames < 0)
+    {
+        printf("bad frame count\n");
+        return false;
+    }
+    if (opt.Compare2D && (opt.RewindSteps || opt.GeometryCapturePath))
+    {
+        // these would see every frame twice
+        printf("--compare-2d can't be combined with --rewind or --capture-geometry\n");
+        return false;
+    }
+
+#ifdef JIT_ENABLED
+    if (Config::JIT_MaxBlockSize < 1) Config::JIT_MaxBlockSize = 1;
+    if (Config::JIT_MaxBlockSize > 32) Config::JIT_MaxBlockSize = 32;
+#endif
+
+    return true;
+}
+
+u64 HashFramebuffer()
+{
+    int fbsize = GPU3D::CurrentRenderer->Accelerated ? (256*3 + 1) * 192 : 256 * 192;
+    XXH64_state_t* hashState = XXH64_createState();
+    XXH64_reset(hashState, 0);
+    XXH64_update(hashState, GPU::Framebuffer[GPU::FrontBuffer][0], fbsize*4);
+    XXH64_update(hashState, GPU::Framebuffer[GPU::FrontBuffer][1], fbsize*4);
+    u64 hash = XXH64_digest(hashState);
+    XXH64_freeState(hashState);
+    return hash;
+}
+
+bool DumpFramebuffer(const char* path)
+{
+    if (GPU3D::CurrentRenderer->Accelerated)
+    {
+        printf("can't dump the frame of an accelerated renderer\n");
+        return false;
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("failed to write frame %s\n", path);
+        return false;
+    }
+
+    // both screens on top of each other, the pixels are stored as BGRA
+    fprintf(f, "P6 256 384 255\n");
+    for (int screen = 0; screen < 2; screen++)
+    {
+        u32* src = GPU::Framebuffer[GPU::FrontBuffer][screen];
+        for (int i = 0; i < 256*192; i++)
+        {
+            u8 rgb[3] = {(u8)(src[i] >> 16), (u8)(src[i] >> 8), (u8)src[i]};
+            fwrite(rgb, 3, 1, f);
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+struct Compare2DStats
+{
+    int Frames = 0;
+    int FirstFrame = -1;
+    u64 Pixels = 0;
+    int FirstX = 0, FirstY = 0;
+    u32 FirstColor = 0, FirstExpected = 0;
+};
+
+// goes back to the state before the frame which was just run and runs it
+// again with the software 2D renderer. emulation is deterministic, so only
+// the renderer can make the two frames differ
+bool Compare2DFrame(SavestateBuffer* before, int frame, Compare2DStats& stats)
+{
+    if (GPU3D::CurrentRenderer->Accelerated)
+    {
+        printf("can't compare the frames of an accelerated renderer\n");
+        return false;
+    }
+
+    std::vector<u32> rendered(256*192*2);
+    memcpy(&rendered[0], GPU::Framebuffer[GPU::FrontBuffer][0], 256*192*4);
+    memcpy(&rendered[256*192], GPU::Framebuffer[GPU::FrontBuffer][1], 256*192*4);
+
+    Savestate* state = new Savestate(before, false);
+    if (!state->Error)
+        NDS::DoSavestate(state);
+    bool error = state->Error;
+    delete state;
+    if (error)
+    {
+        printf("failed to load the state to compare the 2D renderers against\n");
+        return false;
+    }
+
+    GPU::SetRenderer2D(0, Config::Deferred2D != 0, Config::Threaded2D != 0);
+    NDS::RunFrame();
+    SPU::DrainOutput();
+
+    u32 differing = 0;
+    for (int screen = 0; screen < 2; screen++)
+    {
+        u32* expected = GPU::Framebuffer[GPU::FrontBuffer][screen];
+        for (int i = 0; i < 256*192; i++)
+        {
+            u32 color = rendered[screen*256*192 + i];
+            if (color == expected[i])
+                continue;
+
+            if (stats.FirstFrame == -1)
+            {
+                stats.FirstFrame = frame;
+                stats.FirstX = i & 0xFF;
+                stats.FirstY = screen*192 + (i >> 8);
+                stats.FirstColor = color;
+                stats.FirstExpected = expected[i];
+            }
+            differing++;
+        }
+    }
+
+    if (differing)
+    {
+        stats.Frames++;
+        stats.Pixels += differing;
+    }
+
+    GPU::SetRenderer2D(Config::Renderer2D, Config::Deferred2D != 0, Config::Threaded2D != 0);
+    return true;
+}
+
+u64 GetTimeNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// boots the ROM and runs the measured frames, returns the exit code
+// the core and renderer are set up and shut down by the caller
+int RunROM(const Options& opt)
+{
+    int res = Frontend::LoadROM(opt.ROMPath, Frontend::ROMSlot_NDS);
+    if (res != Frontend::Load_OK)
+    {
+        printf("failed to load ROM %s (error %d)\n", opt.ROMPath, res);
+        return 1;
+    }
+
+    if (opt.SavestatePath)
+    {
+        Savestate* state = new Savestate(opt.SavestatePath, false);
+        if (state->Error)
+        {
+            printf("failed to load savestate %s\n", opt.SavestatePath);
+            delete state;
+            return 1;
+        }
+
+        NDS::DoSavestate(state);
+        delete state;
+    }
+
+    for (int i = 0; i < opt.WarmupFrames && !EmuStopped; i++)
+        NDS::RunFrame();
+
+    NDS::ResetPerfCounters();
+    NDS::PerfCountersEnabled = opt.Profile;
+
+    if (opt.GeometryCapturePath)
+        StartGeometryCapture();
+
+    u64 startARM9 = NDS::ARM9Timestamp;
+    u64 startARM7 = NDS::ARM7Timestamp;
+    u64 startTime = GetTimeNS();
+
+    SavestateBuffer roundtripState;
+    SavestateBuffer roundtripDelta;
+    SavestateBuffer compareState;
+    Compare2DStats compareStats;
+    u64 saveTime = 0, loadTime = 0;
+    u64 deltaSize = 0;
+    int deltaCount = 0;
+
+    XXH64_state_t* framesHashState = XXH64_createState();
+    XXH64_reset(framesHashState, 0);
+
+    // errors during the run still go through the cleanup below
+    bool failed = false;
+
+    int frames = 0;
+    for (; frames < opt.Frames && !EmuStopped; frames++)
+    {
+        if (opt.Compare2D)
+        {
+            Savestate* state = new Savestate(&compareState, true);
+            if (!state->Error)
+                NDS::DoSavestate(state);
+            failed = state->Error;
+            delete state;
+            if (failed)
+            {
+                printf("failed to save the state to compare the 2D renderers against\n");
+                break;
+            }
+        }
+
+        NDS::RunFrame();
+        // keep the audio buffer from filling up, like a real frontend would
+        SPU::DrainOutput();
+
+        if (opt.HashEveryFrame)
+        {
+            // catches differences which don't last until the end
+            u64 frameHash = HashFramebuffer();
+            XXH64_update(framesHashState, &frameHash, sizeof(frameHash));
+        }
+
+        if (opt.Compare2D && !Compare2DFrame(&compareState, frames, compareStats))
+        {
+            failed = true;
+            break;
+        }
+
+        if (opt.SavestateRoundtrip)
+        {
+            // reloading the state which was just saved shouldn't change
+            // anything, so the framebuffer hash is expected to stay the same
+            // with deltas the state of the previous frame is brought up to date
+            // by applying the delta to it, so that it's also verified
+            bool delta = opt.DeltaSavestates && roundtripState.Length;
+
+            u64 t0 = GetTimeNS();
+            Savestate* state = delta
+                ? new Savestate(&roundtripDelta, &roundtripState)
+                : new Savestate(&roundtripState, true);
+            NDS::DoSavestate(state);
+            delete state;
+
+            if (delta)
+            {
+                if (!Savestate::ApplyDelta(&roundtripState, &roundtripDelta, &roundtripState))
+                {
+                    printf("failed to apply delta savestate\n");
+                    failed = true;
+                    break;
+                }
+                deltaSize += roundtripDelta.Length;
+                deltaCount++;
+            }
+
+            u64 t1 = GetTimeNS();
+            state = new Savestate(&roundtripState, false);
+            if (!state->Error)
+                NDS::DoSavestate(state);
+            failed = state->Error;
+            delete state;
+            if (failed)
+            {
+                printf("failed to reload the savestate\n");
+                break;
+            }
+
+            u64 t2 = GetTimeNS();
+            saveTime += t1 - t0;
+            loadTime += t2 - t1;
+        }
+    }
+
+    u64 elapsed = GetTimeNS() - startTime;
+    u64 cyclesARM9 = NDS::ARM9Timestamp - startARM9;
+    u64 cyclesARM7 = NDS::ARM7Timestamp - startARM7;
+
+    NDS::PerfCountersEnabled = false;
+
+    if (opt.GeometryCapturePath)
+        FinishGeometryCapture(opt.GeometryCapturePath);
+
+    // hash the last frame, to catch output differences between runs
+    u64 hash = HashFramebuffer();
+    u64 framesHash = XXH64_digest(framesHashState);
+    XXH64_freeState(framesHashState);
+
+    if (failed)
+        return 1;
+    if (frames == 0)
+    {
+        // nothing was measured, there's nothing to divide the results by
+        printf("emulation stopped before the first measured frame\n");
+        return 2;
+    }
+
+    if (opt.DumpFramePath)
+        DumpFramebuffer(opt.DumpFramePath);
+
+    int rewindBack = 0, rewindReplayed = 0;
+    u32 rewindMemory = Rewind::MemoryUsage();
+    u64 rewindHash = 0;
+    if (opt.RewindSteps)
+    {
+        // emulation is deterministic, so after going back
+        // the same frame has to come out again
+        u32 lastFrame = NDS::NumFrames;
+        rewindBack = Rewind::NumSnapshotsBack();
+
+        for (int i = 0; i < opt.RewindSteps; i++)
+        {
+            if (!Rewind::StepBack()) break;
+        }
+
+        while (NDS::NumFrames < lastFrame && !EmuStopped)
+        {
+            NDS::RunFrame();
+            SPU::DrainOutput();
+            rewindReplayed++;
+        }
+
+        rewindHash = HashFramebuffer();
+    }
+
+    double seconds = elapsed / 1000000000.0;
+
+    printf("rom=%s\n", opt.ROMPath);
+    printf("frames=%d\n", frames);
+    printf("time_ms=%.3f\n", seconds * 1000.0);
+    printf("fps=%.2f\n", frames / seconds);
+    printf("ms_per_frame=%.4f\n", seconds * 1000.0 / frames);
+    printf("arm9_cycles_per_frame=%" PRIu64 "\n", cyclesARM9 / frames);
+    printf("arm7_cycles_per_frame=%" PRIu64 "\n", cyclesARM7 / frames);
+    printf("lag_frames=%u\n", NDS::NumLagFrames);
+    printf("framebuffer_hash=%016" PRIx64 "\n", hash);
+    if (opt.HashEveryFrame)
+        printf("frames_hash=%016" PRIx64 "\n", framesHash);
+
+    if (opt.SavestateRoundtrip)
+    {
+        printf("savestate.size=%u\n", roundtripState.Length);
+        printf("savestate.save_ms=%.4f\n", saveTime / 1000000.0 / frames);
+        printf("savestate.load_ms=%.4f\n", loadTime / 1000000.0 / frames);
+        if (deltaCount)
+            printf("savestate.delta_size=%" PRIu64 "\n", deltaSize / deltaCount);
+    }
+
+    if (opt.RewindSteps)
+    {
+        printf("rewind.snapshots=%d\n", rewindBack);
+        printf("rewind.memory=%u\n", rewindMemory);
+        printf("rewind.frames_replayed=%d\n", rewindReplayed);
+        printf("rewind.hash_match=%d\n", rewindHash == hash);
+    }
+
+    if (opt.Compare2D)
+    {
+        printf("compare_2d.frames_differing=%d\n", compareStats.Frames);
+        printf("compare_2d.pixels_differing=%" PRIu64 "\n", compareStats.Pixels);
+        if (compareStats.Frames)
+        {
+            // y counts down both screens, like in --dump-frame
+            printf("compare_2d.first_frame=%d\n", compareStats.FirstFrame);
+            printf("compare_2d.first_pixel=%d,%d\n", compareStats.FirstX, compareStats.FirstY);
+            printf("compare_2d.first_color=%06x\n", compareStats.FirstColor & 0xFFFFFF);
+            printf("compare_2d.first_expected=%06x\n", compareStats.FirstExpected & 0xFFFFFF);
+        }
+    }
+
+    if (opt.Profile)
+    {
+        printf("profile.arm9_ms=%.3f\n", NDS::PerfCounters[NDS::Perf_ARM9] / 1000000.0);
+        printf("profile.arm7_ms=%.3f\n", NDS::PerfCounters[NDS::Perf_ARM7] / 1000000.0);
+        printf("profile.dma_ms=%.3f\n", NDS::PerfCounters[NDS::Perf_DMA] / 1000000.0);
+        printf("profile.gpu3d_ms=%.3f\n", NDS::PerfCounters[NDS::Perf_GPU3D] / 1000000.0);
+        for (int i = 0; i < NDS::Event_MAX; i++)
+        {
+            u64 time = NDS::PerfCounters[NDS::Perf_Events + i];
+            if (time)
+                printf("profile.event_%s_ms=%.3f\n", EventNames[i], time / 1000000.0);
+        }
+    }
+
+    if (opt.WriteSavestatePath)
+    {
+        Savestate* state = new Savestate(opt.WriteSavestatePath, true);
+        if (state->Error)
+            printf("failed to write savestate %s\n", opt.WriteSavestatePath);
+        else
+            NDS::DoSavestate(state);
+        delete state;
+    }
+
+    return EmuStopped ? 2 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    Config::Load();
+
+    Options opt;
+    if (!ParseArgs(argc, argv, opt))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (opt.SelfTest)
+        return RunSelfTest() ? 0 : 1;
+
+    if (!NDS::Init())
+    {
+        printf("failed to initialise the emulator core\n");
+        return 1;
+    }
+
+    if (opt.SchedulerBenchIterations)
+    {
+        BenchScheduler(opt.SchedulerBenchIterations);
+        NDS::DeInit();
+        return 0;
+    }
+
+    if (opt.GeometryBenchPath)
+    {
+        bool ok = BenchGeometry(opt.GeometryBenchPath, opt.Frames);
+        NDS::DeInit();
+        return ok ? 0 : 1;
+    }
+
+    GPU::InitRenderer(0);
+    GPU::RenderSettings settings{Config::Threaded3D != 0, Config::Threaded3DNumThreads, 1, false};
+    GPU::SetRenderSettings(0, settings);
+    GPU::SetRenderer2D(Config::Renderer2D, Config::Deferred2D != 0, Config::Threaded2D != 0);
+
+    RTC::SetBaseTime((time_t)opt.RTCTime);
+
+    Frontend::Init_ROM();
+
+    int ret = RunROM(opt);
+
+    Frontend::DeInit_ROM();
+    GPU::DeInitRenderer();
+    NDS::DeInit();
+
+    return ret;
+}
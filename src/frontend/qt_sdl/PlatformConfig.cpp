@@ -52,6 +52,11 @@ int ScreenVSyncInterval;
 
 int _3DRenderer;
 int Threaded3D;
+int Threaded3DNumThreads;
+
+int Renderer2D;
+int Deferred2D;
+int Threaded2D;
 
 int GL_ScaleFactor;
 int GL_BetterPolygons;
@@ -125,6 +130,7 @@ ConfigEntry PlatformConfigFile[] =
     {"HKKey_SolarSensorDecrease", 0, &HKKeyMapping[HK_SolarSensorDecrease], -1, NULL, 0},
     {"HKKey_SolarSensorIncrease", 0, &HKKeyMapping[HK_SolarSensorIncrease], -1, NULL, 0},
     {"HKKey_FrameStep",           0, &HKKeyMapping[HK_FrameStep],           -1, NULL, 0},
+    {"HKKey_Rewind",              0, &HKKeyMapping[HK_Rewind],              -1, NULL, 0},
 
     {"HKJoy_Lid",                 0, &HKJoyMapping[HK_Lid],                 -1, NULL, 0},
     {"HKJoy_Mic",                 0, &HKJoyMapping[HK_Mic],                 -1, NULL, 0},
@@ -137,6 +143,7 @@ ConfigEntry PlatformConfigFile[] =
     {"HKJoy_SolarSensorDecrease", 0, &HKJoyMapping[HK_SolarSensorDecrease], -1, NULL, 0},
     {"HKJoy_SolarSensorIncrease", 0, &HKJoyMapping[HK_SolarSensorIncrease], -1, NULL, 0},
     {"HKJoy_FrameStep",           0, &HKJoyMapping[HK_FrameStep],           -1, NULL, 0},
+    {"HKJoy_Rewind",              0, &HKJoyMapping[HK_Rewind],              -1, NULL, 0},
 
     {"JoystickID", 0, &JoystickID, 0, NULL, 0},
 
@@ -160,6 +167,11 @@ ConfigEntry PlatformConfigFile[] =
 
     {"3DRenderer", 0, &_3DRenderer, 0, NULL, 0},
     {"Threaded3D", 0, &Threaded3D, 1, NULL, 0},
+    {"Threaded3DNumThreads", 0, &Threaded3DNumThreads, 0, NULL, 0},
+
+    {"Renderer2D", 0, &Renderer2D, -1, NULL, 0},
+    {"Deferred2D", 0, &Deferred2D, 0, NULL, 0},
+    {"Threaded2D", 0, &Threaded2D, 0, NULL, 0},
 
     {"GL_ScaleFactor", 0, &GL_ScaleFactor, 1, NULL, 0},
     {"GL_BetterPolygons", 0, &GL_BetterPolygons, 0, NULL, 0},
@@ -34,6 +34,7 @@ enum
     HK_SolarSensorDecrease,
     HK_SolarSensorIncrease,
     HK_FrameStep,
+    HK_Rewind,
     HK_MAX
 };
 
@@ -68,6 +69,11 @@ extern int ScreenVSyncInterval;
 
 extern int _3DRenderer;
 extern int Threaded3D;
+extern int Threaded3DNumThreads;
+
+extern int Renderer2D;
+extern int Deferred2D;
+extern int Threaded2D;
 
 extern int GL_ScaleFactor;
 extern int GL_BetterPolygons;
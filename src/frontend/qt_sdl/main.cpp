@@ -74,6 +74,7 @@
 #include "PlatformConfig.h"
 
 #include "Savestate.h"
+#include "Rewind.h"
 
 #include "main_shaders.h"
 
@@ -343,6 +344,7 @@ void EmuThread::run()
 
     videoSettingsDirty = false;
     videoSettings.Soft_Threaded = Config::Threaded3D != 0;
+    videoSettings.Soft_NumThreads = Config::Threaded3DNumThreads;
     videoSettings.GL_ScaleFactor = Config::GL_ScaleFactor;
 
 #ifdef OGLRENDERER_ENABLED
@@ -359,6 +361,7 @@ void EmuThread::run()
 
     GPU::InitRenderer(videoRenderer);
     GPU::SetRenderSettings(videoRenderer, videoSettings);
+    GPU::SetRenderer2D(Config::Renderer2D, Config::Deferred2D != 0, Config::Threaded2D != 0);
 
     Input::Init();
 
@@ -434,6 +437,8 @@ void EmuThread::run()
                 videoSettingsDirty = false;
 
                 videoSettings.Soft_Threaded = Config::Threaded3D != 0;
+                videoSettings.Soft_NumThreads = Config::Threaded3DNumThreads;
+    videoSettings.Soft_NumThreads = Config::Threaded3DNumThreads;
                 videoSettings.GL_ScaleFactor = Config::GL_ScaleFactor;
                 videoSettings.GL_BetterPolygons = Config::GL_BetterPolygons;
 
@@ -493,6 +498,11 @@ void EmuThread::run()
             }
 #endif
 
+            // while rewinding, go back one snapshot every frame
+            // and run a frame from there to have something to show
+            if (Config::RewindEnable && Input::HotkeyDown(HK_Rewind))
+                Rewind::StepBack();
+
             // emulate
             u32 nlines = NDS::RunFrame();
 
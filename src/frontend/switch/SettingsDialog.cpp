@@ -293,6 +293,7 @@ void DoGui(BoxGui::Frame& parent)
             bool branchOptimisations = Config::JIT_BranchOptimisations;
             bool literalOptimisations = Config::JIT_LiteralOptimisations;
             bool fastMemory = Config::JIT_FastMemory;
+            bool backgroundCompile = Config::JIT_BackgroundCompile;
 
             DoCheckbox(settingsFrame, settingsSkewer, "Enable JIT recompiler", jitEnable, true);
             if (jitEnable)
@@ -301,12 +302,14 @@ void DoGui(BoxGui::Frame& parent)
                 DoCheckbox(settingsFrame, settingsSkewer, "Enable JIT Branch Optimisations", branchOptimisations);
                 DoCheckbox(settingsFrame, settingsSkewer, "Enable JIT Literal Optimisations", literalOptimisations);
                 DoCheckbox(settingsFrame, settingsSkewer, "Enable JIT Fast Memory", fastMemory);
+                DoCheckbox(settingsFrame, settingsSkewer, "Compile blocks in the background", backgroundCompile);
             }
 
             Config::JIT_Enable = jitEnable;
             Config::JIT_BranchOptimisations = branchOptimisations;
             Config::JIT_LiteralOptimisations = literalOptimisations;
             Config::JIT_FastMemory = fastMemory;
+            Config::JIT_BackgroundCompile = backgroundCompile;
         }
         break;
     case uiScreen_DisplaySettings:
@@ -15,6 +15,7 @@
 #include "FrontendUtil.h"
 #include "Config.h"
 #include "Platform.h"
+#include "Rewind.h"
 
 #include "PlatformConfig.h"
 
@@ -249,7 +250,7 @@ void Init()
 {
     NDS::Init();
     GPU::InitRenderer(0);
-    GPU::RenderSettings settings{true, 1, false};
+    GPU::RenderSettings settings{true, 1, 1, false};
     GPU::SetRenderSettings(0, settings);
 
     for (int j = 0; j < 2; j++)
@@ -685,6 +686,11 @@ void UpdateAndDraw(u64& keysDown, u64& keysUp)
 
             bool fastForward = Config::TouchscreenMode < 2
                 && (PlatformKeysHeld & (Config::LeftHandedMode ? HidNpadButton_ZR : HidNpadButton_ZL));
+            // fast forward button + left stick rewinds, one snapshot and a frame at a time
+            bool rewind = Config::RewindEnable && fastForward && (PlatformKeysHeld & HidNpadButton_StickL);
+            if (rewind)
+                Rewind::StepBack();
+
             u64 totalFrameLength = 0;
             do
             {
@@ -698,7 +704,7 @@ void UpdateAndDraw(u64& keysDown, u64& keysUp)
 
                 totalFrameLength += frameLength;
                 //svcSleepThread(1000*1000*500);
-            } while ((!Config::LimitFramerate || fastForward) && totalFrameLength < 1000000000/60);
+            } while ((!Config::LimitFramerate || fastForward) && !rewind && totalFrameLength < 1000000000/60);
         }
     }
 
@@ -5,6 +5,7 @@
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include "bit.h"
 #include "core_timing.h"
 #include "crash.h"